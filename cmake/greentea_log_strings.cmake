@@ -0,0 +1,16 @@
+# Copyright (c) 2021 ARM Limited. All rights reserved.
+# SPDX-License-Identifier: Apache-2.0
+
+# Write the greentea_log_table section of an executable to <executable>.log-strings after each
+# build. This is the table of format strings the host needs to decode GREENTEA_LOG().
+function(greentea_log_strings target)
+    if(NOT CMAKE_OBJCOPY)
+        message(FATAL_ERROR "greentea_log_strings() needs objcopy")
+    endif()
+    add_custom_command(TARGET ${target} POST_BUILD
+        COMMAND ${CMAKE_OBJCOPY} -O binary --only-section=greentea_log_table
+                $<TARGET_FILE:${target}> $<TARGET_FILE:${target}>.log-strings
+        COMMENT "Extracting the log strings of ${target}"
+        VERBATIM
+    )
+endfunction()
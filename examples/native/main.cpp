@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include "greentea-client/test_env.h"
+#include "greentea-host/harness.h"
+
+/* Test suite, which would run on the device */
+
+static int suite()
+{
+    GREENTEA_SETUP(/* timeout */ 20, /* host_test */ "example_host");
+
+    GREENTEA_TESTCASE_START("greetings");
+    greentea_send_kv("device_greetings", "Hello from the device!");
+    char key[64];
+    char value[64];
+    greentea_parse_kv(key, value, sizeof(key), sizeof(value));
+    printf("Message received from the host: %s\r\n", value);
+    const bool passed = strcmp(key, "host_greetings") == 0;
+    GREENTEA_TESTCASE_FINISH("greetings", passed, !passed);
+
+    GREENTEA_TESTSUITE_RESULT(passed);
+    return 0;
+}
+
+/* Host side, replacing mbedhtrun and example_host.py */
+
+int main()
+{
+    greentea::host::harness harness;
+    harness.on("device_greetings", [](greentea::host::harness & h, const std::string &, const std::string & value) {
+        printf("Message received from the device: %s\n", value.c_str());
+        h.send("host_greetings", "Hello from the host!");
+    });
+    return harness.run(suite).exit_code;
+}
@@ -25,9 +25,19 @@ class ExampleHostTest(BaseHostTest):
         """Register callback to expected key.
         """
         self.register_callback('device_greetings', self._callback_device_greetings)
+        self.register_callback('device_measurement', self._callback_device_measurement)
 
     def _callback_device_greetings(self, key, value, timestamp):
         """Reply to greetings from the device.
         """
         self.log("Message received from the device: " + value)
         self.send_kv('host_greetings', "Hello from the host!")
+
+    def _callback_device_measurement(self, key, value, timestamp):
+        """Parse a floating point value from the device.
+
+        The client sends the shortest digits which read back to the exact
+        value, so float() recovers it without loss of precision.
+        """
+        measurement = float(value)
+        self.log("Measurement received from the device: " + repr(measurement))
@@ -16,6 +16,8 @@
 
 #include <cstdio>
 #include <cstring>
+#include <poll.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 // For PTY (pseudo-terminals) which are available on most UNIX-like
@@ -49,6 +51,13 @@ int greentea_getc()
     }
 }
 
+int greentea_wait_rx(uint32_t timeout_ms)
+{
+    // Sleep in the kernel until htrun sends something
+    struct pollfd poll_fd = { pty_master, POLLIN, 0 };
+    return poll(&poll_fd, 1, timeout_ms > INT32_MAX ? -1 : (int)timeout_ms) != 0;
+}
+
 void greentea_putc(int c)
 {
     char in = c;
@@ -60,10 +69,53 @@ void greentea_putc(int c)
 
 void greentea_write_string(const char *str)
 {
-    size_t len = strlen(str);
+    greentea_write_n(str, strlen(str));
+}
+
+void greentea_write_n(const char *str, size_t len)
+{
     ssize_t bytes = write(pty_master, str, len);
-    if (bytes != len) {
-        printf("Error: greentea_write_string failed\r\n");
+    if (bytes < 0 || (size_t)bytes != len) {
+        printf("Error: greentea_write_n failed\r\n");
+    }
+}
+
+void greentea_writev(const struct greentea_iovec *iov, size_t count)
+{
+    // Pass the key-value message to the kernel as one gather list, without copying it
+    struct iovec pieces[16];
+    while (count) {
+        const size_t batch = count < 16 ? count : 16;
+        size_t n = batch;
+        size_t remaining = 0;
+        for (size_t i = 0; i < batch; i++) {
+            pieces[i].iov_base = const_cast<void *>(iov[i].iov_base);
+            pieces[i].iov_len = iov[i].iov_len;
+            remaining += iov[i].iov_len;
+        }
+
+        struct iovec *next = pieces;
+        while (remaining) {
+            ssize_t bytes = writev(pty_master, next, n);
+            if (bytes < 0) {
+                printf("Error: greentea_writev failed\r\n");
+                return;
+            }
+            remaining -= bytes;
+            // Skip what was written after a partial write
+            while (n && (size_t)bytes >= next->iov_len) {
+                bytes -= next->iov_len;
+                next++;
+                n--;
+            }
+            if (n) {
+                next->iov_base = static_cast<char *>(next->iov_base) + bytes;
+                next->iov_len -= bytes;
+            }
+        }
+
+        iov += batch;
+        count -= batch;
     }
 }
 
@@ -83,10 +135,15 @@ int main()
     printf("In another terminal, please go to the same repository and run:\r\n");
     printf("  mbedhtrun --skip-flashing --skip-reset -e ./examples/pty -p %s\r\n", tty_name);
 
-    // Wait for htrun to connect.
+    // Wait for htrun to connect, for up to a minute.
     // The client will instruct htrun to use example_host.py and test is
     // expected to take less than 20 seconds AFTER connection is established.
-    GREENTEA_SETUP(/* timeout */ 20, /* host_test */ "example_host");
+    if (GREENTEA_SETUP_TIMEOUT(/* timeout */ 20, /* host_test */ "example_host", /* sync_timeout_ms */ 60000) != 0) {
+        printf("Host did not connect\r\n");
+        close(pty_master);
+        close(pty_slave);
+        return 1;
+    }
 
     printf("Host connected\r\n");
 
@@ -94,6 +151,10 @@ int main()
     greentea_send_kv("device_greetings", "Hello from the device!");
     printf("Sent\r\n");
 
+    printf("Sending a measurement to the host...\r\n");
+    greentea_send_kv("device_measurement", 0.1 + 0.2);
+    printf("Sent\r\n");
+
     printf("Expecting greetings from the host...\r\n");
     char key[64];
     char value[64];
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GREENTEA_HOST_DAEMON_H_
+#define GREENTEA_HOST_DAEMON_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "greentea-host/session.h"
+
+/**
+ *  Multi-DUT host daemon
+ *
+ *  Acts as the host of many DUTs (devices under test) at once from a single epoll loop
+ *  on one thread. Each DUT is a channel: a serial port, PTY or socket with its own
+ *  session, i.e. key-value parser, protocol state, timeout and result.
+ *
+ *  Example usage:
+ *
+ *  greentea::host::dut_daemon d;
+ *  for (const char *port : ports) {
+ *      d.add_channel(port, greentea::host::open_serial(port, 115200));
+ *  }
+ *  d.run();
+ *  for (size_t i = 0; i < d.channel_count(); i++) {
+ *      printf("%s: %s\n", d.channel_name(i).c_str(), d.channel(i).get_result().status.c_str());
+ *  }
+ */
+
+namespace greentea {
+namespace host {
+
+/**
+ * Open a serial port in raw mode for a channel.
+ *
+ * @param path Device path, e.g. "/dev/ttyACM0"
+ * @param baud Baud rate, one of the standard rates
+ *
+ * @return File descriptor, or -1 on error with errno set
+ */
+int open_serial(const char *path, int baud);
+
+class dut_daemon {
+public:
+    /**
+     * Called when the test suite of a channel ended, successfully or not.
+     */
+    typedef std::function<void(size_t index, session &s)> finished_handler;
+
+    /**
+     * @param sync_timeout_ms Time each DUT has to answer the __sync message, in milliseconds
+     */
+    explicit dut_daemon(int sync_timeout_ms = 10000);
+    ~dut_daemon();
+    dut_daemon(const dut_daemon &) = delete;
+    dut_daemon &operator=(const dut_daemon &) = delete;
+
+    /**
+     * Add a DUT to the daemon and send it __sync.
+     *
+     * @note The daemon takes ownership of the file descriptor, makes it non-blocking
+     *       and closes it when the channel finishes.
+     *
+     * @param name Name of the channel, used to prefix its text output
+     * @param fd File descriptor connected to the DUT
+     *
+     * @return Index of the channel, or -1 if fd could not be added
+     */
+    int add_channel(const std::string &name, int fd);
+
+    /**
+     * Session of a channel, e.g. to register handlers or read its result.
+     */
+    session &channel(size_t index);
+
+    const std::string &channel_name(size_t index) const;
+
+    size_t channel_count() const;
+
+    /**
+     * Number of channels whose test suite has not ended.
+     */
+    size_t active_count() const;
+
+    /**
+     * Register the receiver of the text output of all channels, by default it is printed
+     * to stdout prefixed with the channel name.
+     */
+    void on_text(std::function<void(size_t index, const std::string &line)> h);
+
+    void on_finished(finished_handler h);
+
+    /**
+     * Advertise the fastest line rate the serial ports of the channels added from now on can
+     * switch to, see session::set_max_line_rate().
+     */
+    void set_max_line_rate(uint32_t bits_per_s);
+
+    /**
+     * Wait for and process output of the channels once.
+     *
+     * @param max_wait_ms Longest time to wait for output, -1 for no limit other than
+     *                    the deadlines of the channels
+     *
+     * @return Number of channels still active
+     */
+    size_t poll(int max_wait_ms);
+
+    /**
+     * Process the channels until all of them finished.
+     */
+    void run();
+
+private:
+    struct channel_state;
+
+    void finish(channel_state &ch);
+    void read_channel(channel_state &ch);
+
+    int _epoll_fd;
+    int _sync_timeout_ms;
+    uint32_t _max_line_rate = 0;
+    std::vector<std::unique_ptr<channel_state>> _channels;
+    size_t _active = 0;
+    std::function<void(size_t index, const std::string &line)> _text;
+    finished_handler _finished;
+};
+
+} // namespace host
+} // namespace greentea
+
+#endif // GREENTEA_HOST_DAEMON_H_
@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GREENTEA_HOST_HARNESS_H_
+#define GREENTEA_HOST_HARNESS_H_
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include "greentea-host/session.h"
+
+/**
+ *  Native host harness
+ *
+ *  Runs a test suite on the same machine as the host side, without a PTY or mbedhtrun.
+ *  The suite talks to the harness over a socket pair which replaces the I/O functions of
+ *  test_io.h, so a test suite executable only needs to link to greentea::host.
+ *
+ *  Example usage:
+ *
+ *  static int suite()
+ *  {
+ *      GREENTEA_SETUP(20, "default_auto");
+ *      ...
+ *      GREENTEA_TESTSUITE_RESULT(passed);
+ *      return 0;
+ *  }
+ *
+ *  int main()
+ *  {
+ *      greentea::host::harness harness;
+ *      return harness.run(suite).exit_code;
+ *  }
+ */
+
+namespace greentea {
+namespace host {
+
+/**
+ * How the test suite is run by the harness.
+ */
+enum class run_mode {
+    fork,   /**< In a child process, which is killed on timeout */
+    thread  /**< In a thread of the same process, which is abandoned on timeout */
+};
+
+/**
+ * Kind of link between the harness and the suite.
+ */
+enum class link_type {
+    socket, /**< A socket pair */
+    pipe,   /**< A pipe in each direction */
+    pty     /**< A pseudo-terminal in raw mode, like a DUT on a serial port, on Linux and macOS */
+};
+
+/**
+ * Harness settings.
+ */
+struct options {
+    run_mode mode = run_mode::fork;
+    /** Time the suite has to answer the __sync message, in milliseconds */
+    int sync_timeout_ms = 10000;
+    /** Print the suite's output outside of key-value messages to stdout */
+    bool echo = true;
+    /** Print a summary of the results to stdout */
+    bool report = true;
+    /** Share of the test cases to run, when the suite calls GREENTEA_TESTCASE_SHARD() */
+    size_t shard_index = 0;
+    size_t shard_count = 1;
+    /** Names of the test cases to run instead of a shard, if not empty */
+    std::vector<std::string> shard_cases;
+    /**
+     * File with the format strings of GREENTEA_LOG(), see log_decoder::load(). If empty,
+     * those of this process are used, as the suite is part of it.
+     */
+    std::string log_strings;
+    /**
+     * Link to the suite. Writing to a pipe whose other end is closed raises SIGPIPE, so it
+     * should be ignored when using pipes in thread mode, where a suite may outlive the run.
+     */
+    link_type link = link_type::socket;
+    /** Fastest line rate advertised to the suite over a PTY link, 0 to keep the current one */
+    uint32_t max_line_rate = 0;
+    /** Round trips and payload bytes in each direction of the link benchmark, see GREENTEA_LINK_BENCH() */
+    int link_bench_pings = 0;
+    size_t link_bench_bytes = 0;
+};
+
+/**
+ * Connect the I/O functions of test_io.h in this process to a file descriptor.
+ *
+ * @details The harness does this in the process or thread running the suite. It can also be
+ *          used to run a suite against another host over a socket, PTY or serial port.
+ *
+ * @param fd File descriptor the test suite reads from and writes to
+ */
+void set_device_fd(int fd);
+
+/**
+ * Connect the I/O functions of test_io.h in this process to a file descriptor for each
+ * direction, e.g. a pair of pipes.
+ *
+ * @param rx_fd File descriptor the test suite reads from
+ * @param tx_fd File descriptor the test suite writes to
+ */
+void set_device_fds(int rx_fd, int tx_fd);
+
+/**
+ * Host side of a test suite run.
+ */
+class harness {
+public:
+    /**
+     * Handler of a key-value message from the suite, like a callback of a host test.
+     *
+     * @param h Harness, to reply with send()
+     * @param key Message key
+     * @param value Message value, with the separators of multiple values in place
+     */
+    typedef std::function<void(harness &h, const std::string &key, const std::string &value)> handler;
+
+    harness() = default;
+    explicit harness(const options &opts) : _options(opts) {}
+
+    /**
+     * Register a handler for messages with a key.
+     *
+     * @note Protocol keys starting with "__" and "end" are handled by the harness, but can be
+     *       observed with a handler too.
+     */
+    void on(const std::string &key, handler h);
+
+    /**
+     * Send a key-value message to the suite. Only valid while a handler runs.
+     */
+    void send(const std::string &key, const std::string &value);
+
+    /**
+     * Run a test suite and act as its host until it sends __exit, times out or ends.
+     *
+     * @details The harness sends __sync, expects it echoed back within the sync timeout,
+     *          then honours the __timeout the suite requested and records the test cases
+     *          and the result of the suite.
+     *
+     * @param suite Test suite entry point
+     *
+     * @return Outcome of the run
+     */
+    result run(int (*suite)());
+
+private:
+    options _options;
+    std::map<std::string, handler> _handlers;
+    session *_session = nullptr;
+};
+
+} // namespace host
+} // namespace greentea
+
+#endif // GREENTEA_HOST_HARNESS_H_
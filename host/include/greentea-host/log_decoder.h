@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GREENTEA_HOST_LOG_DECODER_H_
+#define GREENTEA_HOST_LOG_DECODER_H_
+
+#include <string>
+#include <vector>
+
+namespace greentea {
+namespace host {
+
+/**
+ * Formats the records of the __log messages sent by GREENTEA_LOG(), see test_log.h.
+ *
+ * @details The format strings are looked up in the content of the greentea_log_table
+ *          section of the suite's image. Records whose format string is unknown, e.g. because the table
+ *          is from another build, are shown with their ID.
+ */
+class log_decoder {
+public:
+    log_decoder() = default;
+
+    /**
+     * @param strings Content of the greentea_log_table section
+     */
+    explicit log_decoder(std::string strings) : _strings(std::move(strings)) {}
+
+    /**
+     * Read the content of the greentea_log_table section from a file, e.g. one written by the
+     * greentea_log_strings() CMake function.
+     *
+     * @return false if the file could not be read
+     */
+    bool load(const std::string &path);
+
+    /**
+     * Decode the value of a __log message.
+     *
+     * @return One line of text per record
+     */
+    std::vector<std::string> decode(const std::string &value) const;
+
+private:
+    std::string format(unsigned long id, const unsigned char *data, size_t size) const;
+
+    std::string _strings;
+};
+
+} // namespace host
+} // namespace greentea
+
+#endif // GREENTEA_HOST_LOG_DECODER_H_
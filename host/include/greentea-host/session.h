@@ -0,0 +1,378 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GREENTEA_HOST_SESSION_H_
+#define GREENTEA_HOST_SESSION_H_
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "greentea-client/test_env.h"
+#include "greentea-host/log_decoder.h"
+
+namespace greentea {
+namespace host {
+
+/**
+ * Outcome of a test case, from __testcase_start and __testcase_finish messages.
+ */
+struct testcase_result {
+    std::string name;
+    int passed = 0;
+    int failed = 0;
+    bool finished = false;
+};
+
+/**
+ * Totals of the test cases sent by the suite along with its result, see
+ * GREENTEA_TESTSUITE_RESULT().
+ */
+struct testcase_summary {
+    /** Whether __testcase_summary was received */
+    bool received = false;
+    /** Number of test cases announced with __testcase_count, 0 if none was received */
+    int count = 0;
+    int passed = 0;
+    int failed = 0;
+    /** Durations of the test cases in the order they finished, if the DUT measured them */
+    std::vector<unsigned long> durations_us;
+};
+
+/**
+ * Relation of the DUT clock to the host clock, from the last __clock_sync message, see
+ * GREENTEA_CLOCK_SYNC(). Host time is that of std::chrono::steady_clock since its epoch.
+ */
+struct clock_sync {
+    /** Number of __clock_sync messages received, 0 if the DUT did not synchronize */
+    int count = 0;
+    /** DUT time of the measurement, in microseconds */
+    long long device_us = 0;
+    /** Host time minus DUT time at device_us, in microseconds */
+    long long offset_us = 0;
+    /** Round-trip time of the exchange the offset was measured with, in microseconds */
+    long long rtt_us = 0;
+    /** Change of the offset per DUT time elapsed since the first measurement, in parts per billion */
+    long long drift_ppb = 0;
+
+    /**
+     * Convert a DUT timestamp to host time.
+     *
+     * @param device_time_us Time of greentea_time_us() on the DUT, in microseconds
+     *
+     * @return Host time in microseconds, the DUT timestamp itself if the DUT did not synchronize
+     */
+    long long to_host_us(long long device_time_us) const;
+};
+
+/**
+ * What the DUT supports, from its answer to the capabilities the session advertises before
+ * __sync, see GREENTEA_SETUP().
+ */
+struct dut_capabilities {
+    /** Whether __capabilities was received, older clients do not send it */
+    bool received = false;
+    /** Largest value the suite accepts in a message from the host */
+    size_t max_value_size = 0;
+    /** Message formats the DUT sends or accepts, e.g. "kv+stream+log" */
+    std::string framing;
+    /** Line rate agreed on in bits per second, 0 if unchanged */
+    uint32_t line_rate = 0;
+};
+
+/**
+ * Latency and throughput of the link to the DUT, measured when the suite calls
+ * GREENTEA_LINK_BENCH() and the session was configured with session::set_link_bench().
+ */
+struct link_bench_result {
+    /** Number of round trips measured, 0 if the benchmark did not run */
+    int pings = 0;
+    long rtt_p50_us = 0;
+    long rtt_p90_us = 0;
+    long rtt_p99_us = 0;
+    long rtt_max_us = 0;
+    /** Sustained payload throughput in each direction, in bytes per second */
+    double to_host_bytes_per_s = 0;
+    double to_device_bytes_per_s = 0;
+};
+
+/**
+ * Delivery of the messages the DUT journaled, numbered with __seq, see test_journal.h.
+ */
+struct journal_stats {
+    /** Number of journaled messages received, each counted once */
+    unsigned long messages = 0;
+    /** Messages received only when the DUT replayed them */
+    unsigned long recovered = 0;
+    /** Messages received again and dropped */
+    unsigned long duplicates = 0;
+    /** Messages numbered by the DUT which were never received */
+    unsigned long lost = 0;
+};
+
+/**
+ * Outcome of a test suite run.
+ */
+struct result {
+    /**
+     * "success" or "failure" as reported by the suite, "timeout", "testcase_timeout" if a test
+     * case exceeded its __testcase_timeout, "heartbeat_lost" if the suite went silent after
+     * sending __heartbeat, "no_sync" if the suite did not answer __sync, "no_exit" if it ended
+     * without __exit, "no_result" if it sent __exit without a result, or "error" if it could
+     * not be run
+     */
+    std::string status;
+    /** 0 if the suite reported success, 1 otherwise, suitable as exit status */
+    int exit_code = 1;
+    std::string host_test_name;
+    /** Suite timeout in seconds from the __timeout message, 0 if none was received */
+    int timeout = 0;
+    std::vector<testcase_result> testcases;
+    testcase_summary summary;
+    /** Lines logged with GREENTEA_LOG(), in the order they were sent */
+    std::vector<std::string> log;
+    /** Number of log records the DUT dropped because its buffer was full */
+    unsigned long log_dropped = 0;
+    dut_capabilities capabilities;
+    /** Clock synchronization of the DUT, if it called GREENTEA_CLOCK_SYNC() */
+    clock_sync clock;
+    /** Link benchmark, if the suite called GREENTEA_LINK_BENCH() */
+    link_bench_result link_bench;
+    /** Journaled messages, if the suite ran a journal */
+    journal_stats journal;
+    /** Time from the __sync answer to the __exit message, in milliseconds */
+    long duration_ms = 0;
+};
+
+/**
+ * Host side of the key-value protocol with one DUT (device under test) over a file descriptor.
+ *
+ * @details A session does no I/O wait of its own: the owner reads the DUT's output whenever it
+ *          is available and passes it to feed(), and calls expire() once deadline() is reached.
+ *          The output is parsed with a greentea_kv_parser, so any number of sessions can be
+ *          driven from one event loop.
+ */
+class session {
+public:
+    typedef std::chrono::steady_clock clock;
+
+    /**
+     * Number of heartbeat periods without any output after which the DUT is considered dead
+     */
+    static const int heartbeat_periods = 3;
+
+    /**
+     * Handler of a key-value message from the DUT, like a callback of a host test.
+     *
+     * @param s Session, to reply with send()
+     * @param key Message key
+     * @param value Message value, with the separators of multiple values in place
+     */
+    typedef std::function<void(session &s, const std::string &key, const std::string &value)> handler;
+
+    /**
+     * Receiver of the lines of output from the DUT which hold no key-value message, and of
+     * the lines decoded from __log messages.
+     */
+    typedef std::function<void(const std::string &line)> text_handler;
+
+    /**
+     * @param fd File descriptor to write messages to the DUT, e.g. a socket, PTY or serial port
+     * @param sync_timeout_ms Time the DUT has to answer the __sync message, in milliseconds
+     */
+    session(int fd, int sync_timeout_ms);
+    session(const session &) = delete;
+    session &operator=(const session &) = delete;
+
+    /**
+     * Register a handler for messages with a key.
+     *
+     * @note Protocol keys starting with "__" and "end" are handled by the session, but can be
+     *       observed with a handler too.
+     */
+    void on(const std::string &key, handler h);
+
+    /**
+     * Register the receiver of text output.
+     */
+    void on_text(text_handler h);
+
+    /**
+     * Send a key-value message to the DUT.
+     */
+    void send(const std::string &key, const std::string &value);
+
+    /**
+     * Assign the test cases whose position modulo count is index to the DUT, when the suite
+     * asks with GREENTEA_TESTCASE_SHARD(). By default all test cases are assigned.
+     */
+    void assign_shard(size_t index, size_t count);
+
+    /**
+     * Assign the named test cases to the DUT, when the suite asks with GREENTEA_TESTCASE_SHARD().
+     */
+    void assign_cases(const std::vector<std::string> &names);
+
+    /**
+     * Set the decoder of the __log messages, which needs the format strings of the suite.
+     */
+    void set_log_decoder(const log_decoder &decoder);
+
+    /**
+     * Run the link benchmark when the suite asks with GREENTEA_LINK_BENCH(). By default it is
+     * skipped.
+     *
+     * @param pings Number of round trips to measure
+     * @param bytes Payload bytes to transfer in each direction
+     */
+    void set_link_bench(int pings, size_t bytes);
+
+    /**
+     * Advertise the fastest line rate the file descriptor can switch to, if it is a serial
+     * port or PTY. The session switches to the rate agreed on with the DUT. By default the
+     * line rate is left unchanged.
+     *
+     * @param bits_per_s Line rate in bits per second, 0 to keep the current one
+     */
+    void set_max_line_rate(uint32_t bits_per_s);
+
+    /**
+     * Send __sync and start waiting for the DUT to answer it.
+     */
+    void start();
+
+    /**
+     * Process output read from the DUT.
+     */
+    void feed(const char *data, size_t size);
+
+    /**
+     * Record the end of the DUT's output, e.g. because it was disconnected.
+     */
+    void end_of_stream();
+
+    /**
+     * Record that deadline() has passed, which is a timeout if the session is not finished.
+     */
+    void expire();
+
+    /**
+     * Time by which the DUT must answer __sync, or finish the suite once it sent __timeout,
+     * whichever comes first of that, the end of the __testcase_timeout of the running test
+     * case and heartbeat_periods periods after the last output once it sent __heartbeat.
+     */
+    clock::time_point deadline() const;
+
+    /**
+     * Whether the suite ended, successfully or not.
+     */
+    bool finished() const
+    {
+        return _finished;
+    }
+
+    int fd() const
+    {
+        return _fd;
+    }
+
+    const result &get_result() const
+    {
+        return _result;
+    }
+
+private:
+    bool journal_accept(const std::string &key, const std::string &value);
+    void journal_replay(unsigned long from);
+    void dispatch(const std::string &key, const std::string &value);
+    void finish(const char *status);
+    void bench_start(size_t chunk);
+    void bench_step(const std::string &key, const std::string &value, clock::time_point now);
+    void bench_ping();
+    void bench_done();
+
+    int _fd;
+    std::map<std::string, handler> _handlers;
+    text_handler _text;
+
+    greentea_kv_parser _parser;
+    char _key[64];
+    char _value[1024];
+    std::string _line;
+    bool _line_has_message = false;
+
+    result _result;
+    std::string _uuid;
+    std::string _shard_key;
+    std::string _shard_value;
+    log_decoder _log_decoder;
+    enum class bench_phase { idle, ping, to_device, to_host } _bench_phase = bench_phase::idle;
+    int _bench_pings = 0;
+    size_t _bench_bytes = 0;
+    size_t _bench_chunk = 0;
+    size_t _bench_received = 0;
+    uint32_t _max_line_rate = 0;
+    std::set<unsigned long> _journal_seen;
+    unsigned long _journal_pending = 0;
+    bool _journal_replayed = false;
+    unsigned long _journal_announced = 0;
+    unsigned long _journal_last = 0;
+    unsigned long _journal_requested = 0;
+    std::vector<long> _bench_rtts_us;
+    clock::time_point _bench_sent_at;
+    clock::time_point _deadline;
+    clock::time_point _testcase_deadline;
+    bool _testcase_timed = false;
+    std::chrono::milliseconds _heartbeat{0};
+    clock::time_point _last_output;
+    clock::time_point _synced_at;
+    int _sync_timeout_ms;
+    bool _synced = false;
+    bool _finished = false;
+};
+
+/**
+ * Change the line rate of a serial port or PTY, keeping its other settings.
+ *
+ * @param fd File descriptor of the terminal
+ * @param bits_per_s Line rate in bits per second, one of the standard baud rates
+ *
+ * @return true on success, false if fd is not a terminal or the rate is not supported
+ */
+bool set_line_rate(int fd, uint32_t bits_per_s);
+
+/**
+ * Combine the outcomes of the shards of a test suite run on several DUTs.
+ *
+ * @details The result is "success" only if every shard succeeded, otherwise it is the status
+ *          of the first shard which did not. Test cases are listed shard by shard, their
+ *          summaries are added up, and the timeout and duration are those of the longest
+ *          shard, as shards run in parallel. The journal statistics are added up. Clock
+ *          synchronization is specific to each DUT and is not merged.
+ *
+ * @param shards Outcome of each shard
+ *
+ * @return Outcome of the whole suite
+ */
+result merge_results(const std::vector<result> &shards);
+
+} // namespace host
+} // namespace greentea
+
+#endif // GREENTEA_HOST_SESSION_H_
@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <termios.h>
+#include <unistd.h>
+#include "greentea-host/daemon.h"
+
+using namespace greentea::host;
+
+/**
+ * Maximum number of channel events handled per wait
+ */
+static const int max_events = 64;
+
+struct dut_daemon::channel_state {
+    channel_state(size_t index, const std::string &name, int fd, int sync_timeout_ms) :
+        index(index), name(name), s(fd, sync_timeout_ms)
+    {
+    }
+
+    size_t index;
+    std::string name;
+    session s;
+    bool active = true;
+};
+
+int greentea::host::open_serial(const char *path, int baud)
+{
+    const int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) {
+        return -1;
+    }
+    struct termios tio;
+    if (tcgetattr(fd, &tio) != 0) {
+        close(fd);
+        return -1;
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (!set_line_rate(fd, baud)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    return fd;
+}
+
+dut_daemon::dut_daemon(int sync_timeout_ms) :
+    _epoll_fd(epoll_create1(EPOLL_CLOEXEC)),
+    _sync_timeout_ms(sync_timeout_ms)
+{
+    _text = [this](size_t index, const std::string & line) {
+        printf("[%s] %s\n", _channels[index]->name.c_str(), line.c_str());
+    };
+}
+
+dut_daemon::~dut_daemon()
+{
+    for (auto &ch : _channels) {
+        if (ch->active) {
+            close(ch->s.fd());
+        }
+    }
+    if (_epoll_fd >= 0) {
+        close(_epoll_fd);
+    }
+}
+
+int dut_daemon::add_channel(const std::string &name, int fd)
+{
+    if (_epoll_fd < 0 || fd < 0) {
+        return -1;
+    }
+    const int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        return -1;
+    }
+
+    const size_t index = _channels.size();
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = index;
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+        return -1;
+    }
+
+    _channels.emplace_back(new channel_state(index, name, fd, _sync_timeout_ms));
+    channel_state &ch = *_channels.back();
+    ch.s.on_text([this, index](const std::string & line) {
+        if (_text) {
+            _text(index, line);
+        }
+    });
+    _active++;
+    ch.s.set_max_line_rate(_max_line_rate);
+    ch.s.start();
+    return static_cast<int>(index);
+}
+
+session &dut_daemon::channel(size_t index)
+{
+    return _channels.at(index)->s;
+}
+
+const std::string &dut_daemon::channel_name(size_t index) const
+{
+    return _channels.at(index)->name;
+}
+
+size_t dut_daemon::channel_count() const
+{
+    return _channels.size();
+}
+
+size_t dut_daemon::active_count() const
+{
+    return _active;
+}
+
+void dut_daemon::on_text(std::function<void(size_t index, const std::string &line)> h)
+{
+    _text = h;
+}
+
+void dut_daemon::on_finished(finished_handler h)
+{
+    _finished = h;
+}
+
+void dut_daemon::set_max_line_rate(uint32_t bits_per_s)
+{
+    _max_line_rate = bits_per_s;
+}
+
+void dut_daemon::finish(channel_state &ch)
+{
+    ch.active = false;
+    _active--;
+    epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, ch.s.fd(), NULL);
+    close(ch.s.fd());
+    if (_finished) {
+        _finished(ch.index, ch.s);
+    }
+}
+
+void dut_daemon::read_channel(channel_state &ch)
+{
+    char buffer[512];
+    while (ch.active) {
+        const ssize_t bytes = read(ch.s.fd(), buffer, sizeof(buffer));
+        if (bytes > 0) {
+            ch.s.feed(buffer, bytes);
+        } else if (bytes < 0 && errno == EINTR) {
+            continue;
+        } else if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        } else {
+            // End of file, or EIO from a PTY whose other end was closed
+            ch.s.end_of_stream();
+        }
+        if (ch.s.finished()) {
+            finish(ch);
+        }
+    }
+}
+
+size_t dut_daemon::poll(int max_wait_ms)
+{
+    if (!_active) {
+        return 0;
+    }
+
+    // Wait no longer than the earliest deadline
+    session::clock::time_point now = session::clock::now();
+    session::clock::time_point earliest = session::clock::time_point::max();
+    for (auto &ch : _channels) {
+        if (ch->active && ch->s.deadline() < earliest) {
+            earliest = ch->s.deadline();
+        }
+    }
+    long long wait_ms = std::chrono::duration_cast<std::chrono::milliseconds>(earliest - now).count() + 1;
+    if (wait_ms < 0) {
+        wait_ms = 0;
+    }
+    if (max_wait_ms >= 0 && wait_ms > max_wait_ms) {
+        wait_ms = max_wait_ms;
+    }
+
+    struct epoll_event events[max_events];
+    const int count = epoll_wait(_epoll_fd, events, max_events, static_cast<int>(wait_ms));
+    for (int i = 0; i < count; i++) {
+        channel_state &ch = *_channels[events[i].data.u64];
+        read_channel(ch);
+    }
+
+    now = session::clock::now();
+    for (auto &ch : _channels) {
+        if (ch->active && ch->s.deadline() <= now) {
+            ch->s.expire();
+            finish(*ch);
+        }
+    }
+    return _active;
+}
+
+void dut_daemon::run()
+{
+    while (poll(-1)) {
+    }
+}
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ *  Implementation of test_io.h for test suites run by the native host harness
+ */
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "greentea-client/test_io.h"
+#include "greentea-host/harness.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/**
+ * Maximum number of pieces passed to the socket at once
+ */
+#define DEVICE_IOV_MAX  16
+
+static int device_rx_fd = -1;
+static int device_tx_fd = -1;
+static bool device_is_socket = true;
+
+/**
+ * Input read ahead from the socket
+ */
+static unsigned char input[64];
+static size_t input_size = 0;
+static size_t input_pos = 0;
+
+void greentea::host::set_device_fd(int fd)
+{
+    set_device_fds(fd, fd);
+}
+
+void greentea::host::set_device_fds(int rx_fd, int tx_fd)
+{
+    device_rx_fd = rx_fd;
+    device_tx_fd = tx_fd;
+    device_is_socket = true;
+    input_size = 0;
+    input_pos = 0;
+}
+
+int greentea_getc()
+{
+    if (input_pos == input_size) {
+        ssize_t bytes;
+        do {
+            bytes = read(device_rx_fd, input, sizeof(input));
+        } while (bytes < 0 && errno == EINTR);
+        if (bytes <= 0) {
+            return EOF;
+        }
+        input_size = bytes;
+        input_pos = 0;
+    }
+    return input[input_pos++];
+}
+
+int greentea_wait_rx(uint32_t timeout_ms)
+{
+    if (input_pos < input_size) {
+        return 1;
+    }
+    struct pollfd poll_fd = { device_rx_fd, POLLIN, 0 };
+    int ready;
+    do {
+        ready = poll(&poll_fd, 1, timeout_ms > INT32_MAX ? -1 : (int)timeout_ms);
+    } while (ready < 0 && errno == EINTR);
+    // Errors and hang-ups are reported by greentea_getc()
+    return ready != 0;
+}
+
+void greentea_writev(const struct greentea_iovec *iov, size_t count)
+{
+    struct iovec pieces[DEVICE_IOV_MAX];
+    while (count) {
+        const size_t batch = count < DEVICE_IOV_MAX ? count : DEVICE_IOV_MAX;
+        size_t remaining = 0;
+        for (size_t i = 0; i < batch; i++) {
+            pieces[i].iov_base = const_cast<void *>(iov[i].iov_base);
+            pieces[i].iov_len = iov[i].iov_len;
+            remaining += iov[i].iov_len;
+        }
+
+        struct msghdr msg = {};
+        msg.msg_iov = pieces;
+        msg.msg_iovlen = batch;
+        while (remaining) {
+            // The harness may be gone after a timeout, do not get killed by SIGPIPE.
+            // Other file descriptors than sockets, e.g. a PTY, are written with writev().
+            const ssize_t bytes = device_is_socket ? sendmsg(device_tx_fd, &msg, MSG_NOSIGNAL) :
+                                  writev(device_tx_fd, msg.msg_iov, msg.msg_iovlen);
+            if (bytes < 0) {
+                if (device_is_socket && errno == ENOTSOCK) {
+                    device_is_socket = false;
+                    continue;
+                }
+                if (errno == EINTR) {
+                    continue;
+                }
+                return;
+            }
+            remaining -= bytes;
+            // Skip what was written after a partial write
+            size_t written = bytes;
+            while (msg.msg_iovlen && written >= msg.msg_iov->iov_len) {
+                written -= msg.msg_iov->iov_len;
+                msg.msg_iov++;
+                msg.msg_iovlen--;
+            }
+            if (msg.msg_iovlen) {
+                msg.msg_iov->iov_base = static_cast<char *>(msg.msg_iov->iov_base) + written;
+                msg.msg_iov->iov_len -= written;
+            }
+        }
+
+        iov += batch;
+        count -= batch;
+    }
+}
+
+void greentea_write_n(const char *str, size_t len)
+{
+    const struct greentea_iovec iov = { str, len };
+    greentea_writev(&iov, 1);
+}
+
+void greentea_write_string(const char *str)
+{
+    greentea_write_n(str, strlen(str));
+}
+
+void greentea_putc(int c)
+{
+    const char byte = c;
+    greentea_write_n(&byte, 1);
+}
+
+uint32_t greentea_max_line_rate(void)
+{
+    // Any standard rate works on a PTY, as it does not pace the data
+    return isatty(device_tx_fd) ? 3000000 : 0;
+}
+
+int greentea_set_line_rate(uint32_t bits_per_s)
+{
+    return greentea::host::set_line_rate(device_tx_fd, bits_per_s) ? 0 : -1;
+}
+
+uint64_t greentea_time_us(void)
+{
+    // Measures the test cases of the summary sent by GREENTEA_TESTSUITE_RESULT()
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+#if defined(__APPLE__)
+#include <util.h>
+#elif defined(__linux__)
+#include <pty.h>
+#endif
+#include "greentea-client/test_io.h"
+#include "greentea-client/test_log.h"
+#include "greentea-host/harness.h"
+
+using namespace greentea::host;
+
+void harness::on(const std::string &key, handler h)
+{
+    _handlers[key] = h;
+}
+
+void harness::send(const std::string &key, const std::string &value)
+{
+    if (_session) {
+        _session->send(key, value);
+    }
+}
+
+static void print_report(const result &res)
+{
+    printf("greentea-host: host test '%s', timeout %ds\n", res.host_test_name.c_str(), res.timeout);
+    for (const testcase_result &testcase : res.testcases) {
+        const char *outcome = !testcase.finished ? "INCOMPLETE" : testcase.failed ? "FAIL" : "OK";
+        printf("greentea-host:   %-40s %s (passed %d, failed %d)\n",
+               testcase.name.c_str(), outcome, testcase.passed, testcase.failed);
+    }
+    if (res.summary.received) {
+        printf("greentea-host: %d test cases, %d passed, %d failed\n",
+               res.summary.count, res.summary.passed, res.summary.failed);
+    }
+    if (res.clock.count) {
+        printf("greentea-host: device clock offset %lld us, round trip %lld us, drift %lld ppb\n",
+               res.clock.offset_us, res.clock.rtt_us, res.clock.drift_ppb);
+    }
+    if (res.link_bench.pings) {
+        printf("greentea-host: link round trip p50 %ld us, p90 %ld us, p99 %ld us, max %ld us\n",
+               res.link_bench.rtt_p50_us, res.link_bench.rtt_p90_us, res.link_bench.rtt_p99_us,
+               res.link_bench.rtt_max_us);
+    }
+    if (res.link_bench.to_host_bytes_per_s || res.link_bench.to_device_bytes_per_s) {
+        printf("greentea-host: link throughput %.0f bytes/s to host, %.0f bytes/s to device\n",
+               res.link_bench.to_host_bytes_per_s, res.link_bench.to_device_bytes_per_s);
+    }
+    if (res.journal.messages || res.journal.lost) {
+        printf("greentea-host: journal %lu messages, %lu recovered, %lu lost\n",
+               res.journal.messages, res.journal.recovered, res.journal.lost);
+    }
+    if (res.log_dropped) {
+        printf("greentea-host: %lu log records dropped\n", res.log_dropped);
+    }
+    printf("greentea-host: result %s in %ld ms\n", res.status.c_str(), res.duration_ms);
+    fflush(stdout);
+}
+
+/**
+ * File descriptors of both ends of the link between the harness and the suite, one for each
+ * direction, which are the same but for pipes.
+ */
+struct link_fds {
+    int host_rx = -1;
+    int host_tx = -1;
+    int device_rx = -1;
+    int device_tx = -1;
+};
+
+static void close_pair(int rx_fd, int tx_fd)
+{
+    close(rx_fd);
+    if (tx_fd != rx_fd) {
+        close(tx_fd);
+    }
+}
+
+static bool open_link(link_type type, link_fds &fds)
+{
+    int pair[2];
+    switch (type) {
+        case link_type::socket:
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+                return false;
+            }
+            fds.host_rx = fds.host_tx = pair[0];
+            fds.device_rx = fds.device_tx = pair[1];
+            return true;
+
+        case link_type::pipe: {
+            int to_host[2];
+            if (pipe(pair) != 0) {
+                return false;
+            }
+            if (pipe(to_host) != 0) {
+                close_pair(pair[0], pair[1]);
+                return false;
+            }
+            fds.host_tx = pair[1];
+            fds.device_rx = pair[0];
+            fds.device_tx = to_host[1];
+            fds.host_rx = to_host[0];
+            return true;
+        }
+
+        case link_type::pty: {
+#if defined(__APPLE__) || defined(__linux__)
+            // Raw mode, so the line discipline neither echoes nor translates the messages
+            struct termios tio;
+            if (openpty(&pair[0], &pair[1], NULL, NULL, NULL) != 0) {
+                return false;
+            }
+            if (tcgetattr(pair[1], &tio) != 0) {
+                close_pair(pair[0], pair[1]);
+                return false;
+            }
+            cfmakeraw(&tio);
+            if (tcsetattr(pair[1], TCSANOW, &tio) != 0) {
+                close_pair(pair[0], pair[1]);
+                return false;
+            }
+            fds.host_rx = fds.host_tx = pair[0];
+            fds.device_rx = fds.device_tx = pair[1];
+            return true;
+#else
+            return false;
+#endif
+        }
+    }
+    return false;
+}
+
+result harness::run(int (*suite)())
+{
+    result res;
+    link_fds fds;
+
+    if (!open_link(_options.link, fds)) {
+        res.status = "error";
+        return res;
+    }
+
+    // Output pending in stdio buffers must not be duplicated in the child process
+    fflush(NULL);
+
+    pid_t pid = -1;
+    std::thread suite_thread;
+    if (_options.mode == run_mode::fork) {
+        pid = fork();
+        if (pid == 0) {
+            close_pair(fds.host_rx, fds.host_tx);
+            set_device_fds(fds.device_rx, fds.device_tx);
+            const int ret = suite();
+            greentea_flush();
+            fflush(NULL);
+            _exit(ret);
+        }
+        close_pair(fds.device_rx, fds.device_tx);
+        if (pid < 0) {
+            close_pair(fds.host_rx, fds.host_tx);
+            res.status = "error";
+            return res;
+        }
+    } else {
+        const int device_rx = fds.device_rx;
+        const int device_tx = fds.device_tx;
+        suite_thread = std::thread([suite, device_rx, device_tx]() {
+            set_device_fds(device_rx, device_tx);
+            suite();
+            greentea_flush();
+            close_pair(device_rx, device_tx);
+        });
+    }
+
+    session s(fds.host_tx, _options.sync_timeout_ms);
+    _session = &s;
+    if (_options.shard_cases.empty()) {
+        s.assign_shard(_options.shard_index, _options.shard_count);
+    } else {
+        s.assign_cases(_options.shard_cases);
+    }
+    log_decoder decoder;
+    if (!_options.log_strings.empty()) {
+        decoder.load(_options.log_strings);
+    } else {
+#if GREENTEA_CLIENT_LOG
+        size_t size;
+        const char *strings = greentea_log_strings(&size);
+        decoder = log_decoder(std::string(strings ? strings : "", size));
+#endif
+    }
+    s.set_log_decoder(decoder);
+    s.set_link_bench(_options.link_bench_pings, _options.link_bench_bytes);
+    s.set_max_line_rate(_options.max_line_rate);
+    for (const auto &h : _handlers) {
+        const handler &callback = h.second;
+        s.on(h.first, [this, callback](session &, const std::string & key, const std::string & value) {
+            callback(*this, key, value);
+        });
+    }
+    if (_options.echo) {
+        s.on_text([](const std::string & line) {
+            printf("%s\n", line.c_str());
+            fflush(stdout);
+        });
+    }
+    s.start();
+
+    bool timed_out = false;
+    while (!s.finished()) {
+        const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(s.deadline() - session::clock::now());
+        if (remaining.count() <= 0) {
+            s.expire();
+            timed_out = true;
+            break;
+        }
+
+        struct pollfd poll_fd = { fds.host_rx, POLLIN, 0 };
+        const int ready = poll(&poll_fd, 1, static_cast<int>(remaining.count()));
+        if (ready <= 0) {
+            continue;
+        }
+
+        char buffer[256];
+        const ssize_t bytes = read(fds.host_rx, buffer, sizeof(buffer));
+        if (bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes <= 0) {
+            s.end_of_stream();
+            break;
+        }
+        s.feed(buffer, bytes);
+    }
+
+    _session = nullptr;
+    res = s.get_result();
+    close_pair(fds.host_rx, fds.host_tx);
+
+    if (pid > 0) {
+        if (timed_out) {
+            kill(pid, SIGKILL);
+        }
+        int status;
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+        }
+    } else if (suite_thread.joinable()) {
+        if (!timed_out) {
+            suite_thread.join();
+        } else {
+            // A thread can not be stopped, the suite is left running on its closed socket
+            suite_thread.detach();
+        }
+    }
+
+    if (_options.report) {
+        print_report(res);
+    }
+    return res;
+}
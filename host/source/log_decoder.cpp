@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include "greentea-host/log_decoder.h"
+
+using namespace greentea::host;
+
+namespace {
+
+/**
+ * Reader of the arguments of a record, which notes when it runs out of data.
+ */
+struct record_reader {
+    const unsigned char *data;
+    size_t size;
+    bool complete;
+
+    unsigned long long varint()
+    {
+        unsigned long long val = 0;
+        for (unsigned shift = 0; size && shift < 64; shift += 7) {
+            const unsigned char byte = *data++;
+            size--;
+            val |= (unsigned long long)(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return val;
+            }
+        }
+        complete = false;
+        return 0;
+    }
+
+    long long zigzag()
+    {
+        const unsigned long long val = varint();
+        return (long long)(val >> 1) ^ -(long long)(val & 1);
+    }
+
+    double floating()
+    {
+        if (size < 8) {
+            complete = false;
+            size = 0;
+            return 0;
+        }
+        uint64_t bits = 0;
+        for (size_t i = 0; i < 8; i++) {
+            bits |= (uint64_t)data[i] << (8 * i);
+        }
+        data += 8;
+        size -= 8;
+        double val;
+        memcpy(&val, &bits, sizeof(val));
+        return val;
+    }
+
+    std::string string()
+    {
+        const unsigned long long len = varint();
+        if (!complete || len > size) {
+            complete = false;
+            size = 0;
+            return std::string();
+        }
+        const std::string val(reinterpret_cast<const char *>(data), len);
+        data += len;
+        size -= len;
+        return val;
+    }
+};
+
+/**
+ * Append a value formatted with a printf conversion specification.
+ */
+template <typename T>
+void append_format(std::string &out, const std::string &spec, T value)
+{
+    const int len = snprintf(nullptr, 0, spec.c_str(), value);
+    if (len > 0) {
+        std::vector<char> buffer(len + 1);
+        snprintf(buffer.data(), buffer.size(), spec.c_str(), value);
+        out.append(buffer.data(), len);
+    }
+}
+
+/**
+ * Decode base64, without padding and ignoring any other character.
+ */
+std::vector<unsigned char> base64_decode(const std::string &text)
+{
+    std::vector<unsigned char> data;
+    uint32_t group = 0;
+    int bits = 0;
+    for (const char c : text) {
+        int digit;
+        if (c >= 'A' && c <= 'Z') {
+            digit = c - 'A';
+        } else if (c >= 'a' && c <= 'z') {
+            digit = c - 'a' + 26;
+        } else if (c >= '0' && c <= '9') {
+            digit = c - '0' + 52;
+        } else if (c == '+') {
+            digit = 62;
+        } else if (c == '/') {
+            digit = 63;
+        } else {
+            continue;
+        }
+        group = group << 6 | digit;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            data.push_back((group >> bits) & 0xff);
+        }
+    }
+    return data;
+}
+
+} // namespace
+
+bool log_decoder::load(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::ostringstream content;
+    content << file.rdbuf();
+    _strings = content.str();
+    return true;
+}
+
+std::vector<std::string> log_decoder::decode(const std::string &value) const
+{
+    std::vector<std::string> lines;
+    const std::vector<unsigned char> data = base64_decode(value);
+    size_t pos = 0;
+    while (pos < data.size()) {
+        const size_t length = data[pos++];
+        if (length == 0 || pos + length > data.size()) {
+            break;
+        }
+        record_reader reader = { data.data() + pos, length, true };
+        const unsigned long long id = reader.varint();
+        lines.push_back(format(id, reader.data, reader.size));
+        pos += length;
+    }
+    return lines;
+}
+
+std::string log_decoder::format(unsigned long id, const unsigned char *data, size_t size) const
+{
+    if (id >= _strings.size()) {
+        return "<unknown log format " + std::to_string(id) + ">";
+    }
+    record_reader reader = { data, size, true };
+    const char *p = _strings.c_str() + id;
+    std::string out;
+    while (*p) {
+        if (*p != '%') {
+            out += *p++;
+            continue;
+        }
+        p++;
+        if (*p == '%') {
+            out += *p++;
+            continue;
+        }
+
+        // The arguments are decoded at their full width, so length modifiers are replaced
+        std::string spec = "%";
+        while (*p && strchr("-+ #0", *p)) {
+            spec += *p++;
+        }
+        if (*p == '*') {
+            spec += std::to_string(reader.zigzag());
+            p++;
+        }
+        while (*p >= '0' && *p <= '9') {
+            spec += *p++;
+        }
+        if (*p == '.') {
+            spec += *p++;
+            if (*p == '*') {
+                spec += std::to_string(reader.zigzag());
+                p++;
+            }
+            while (*p >= '0' && *p <= '9') {
+                spec += *p++;
+            }
+        }
+        while (*p && strchr("hljztL", *p)) {
+            p++;
+        }
+
+        const char conversion = *p;
+        if (!conversion) {
+            break;
+        }
+        p++;
+        switch (conversion) {
+            case 'd':
+            case 'i': {
+                const long long val = reader.zigzag();
+                if (reader.complete) {
+                    append_format(out, spec + "ll" + conversion, val);
+                }
+                break;
+            }
+            case 'u':
+            case 'o':
+            case 'x':
+            case 'X': {
+                const unsigned long long val = reader.varint();
+                if (reader.complete) {
+                    append_format(out, spec + "ll" + conversion, val);
+                }
+                break;
+            }
+            case 'c': {
+                const int val = static_cast<int>(reader.varint());
+                if (reader.complete) {
+                    append_format(out, spec + conversion, val);
+                }
+                break;
+            }
+            case 'p': {
+                const unsigned long long val = reader.varint();
+                if (reader.complete) {
+                    append_format(out, "0x%llx", val);
+                }
+                break;
+            }
+            case 'f':
+            case 'F':
+            case 'e':
+            case 'E':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A': {
+                const double val = reader.floating();
+                if (reader.complete) {
+                    append_format(out, spec + conversion, val);
+                }
+                break;
+            }
+            case 's': {
+                const std::string val = reader.string();
+                if (reader.complete) {
+                    append_format(out, spec + conversion, val.c_str());
+                }
+                break;
+            }
+            case 'n':
+                break;
+            default:
+                out += spec + conversion;
+                break;
+        }
+        if (!reader.complete) {
+            // Left out of the record, which was full
+            out += '?';
+            reader.complete = true;
+        }
+    }
+    return out;
+}
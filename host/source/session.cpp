@@ -0,0 +1,601 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <poll.h>
+#include <random>
+#include <sys/socket.h>
+#include <termios.h>
+#include <unistd.h>
+#include "greentea-host/session.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+using namespace greentea::host;
+
+/**
+ * Generate a random UUID for the __sync message, like mbedhtrun does.
+ */
+static std::string make_uuid()
+{
+    static const char digits[] = "0123456789abcdef";
+    std::random_device random;
+    std::string uuid;
+    for (int i = 0; i < 32; i++) {
+        if (i == 8 || i == 12 || i == 16 || i == 20) {
+            uuid += '-';
+        }
+        uuid += digits[random() % 16];
+    }
+    return uuid;
+}
+
+/**
+ * Write all data to a file descriptor, which may be non-blocking.
+ */
+static void write_all(int fd, const char *data, size_t size)
+{
+    bool is_socket = true;
+    while (size) {
+        // Sockets are written without SIGPIPE in case the DUT is gone
+        ssize_t bytes = is_socket ? ::send(fd, data, size, MSG_NOSIGNAL) : write(fd, data, size);
+        if (bytes < 0) {
+            if (is_socket && errno == ENOTSOCK) {
+                is_socket = false;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                struct pollfd poll_fd = { fd, POLLOUT, 0 };
+                if (poll(&poll_fd, 1, 1000) <= 0) {
+                    return;
+                }
+            } else if (errno != EINTR) {
+                return;
+            }
+            continue;
+        }
+        data += bytes;
+        size -= bytes;
+    }
+}
+
+/**
+ * Host time of a time point, as used by the clock synchronization.
+ */
+static long long host_time_us(session::clock::time_point time)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+}
+
+long long clock_sync::to_host_us(long long device_time_us) const
+{
+    // Scale in floating point, the product of a long run and the drift overflows 64 bits
+    return device_time_us + offset_us + (long long)((double)(device_time_us - device_us) * drift_ppb / 1e9);
+}
+
+/**
+ * Value of a standard baud rate for termios, B0 if there is none.
+ */
+static speed_t line_rate_speed(uint32_t bits_per_s)
+{
+    switch (bits_per_s) {
+        case 9600:
+            return B9600;
+        case 19200:
+            return B19200;
+        case 38400:
+            return B38400;
+        case 57600:
+            return B57600;
+        case 115200:
+            return B115200;
+        case 230400:
+            return B230400;
+#ifdef B460800
+        case 460800:
+            return B460800;
+#endif
+#ifdef B921600
+        case 921600:
+            return B921600;
+#endif
+#ifdef B1000000
+        case 1000000:
+            return B1000000;
+#endif
+#ifdef B2000000
+        case 2000000:
+            return B2000000;
+#endif
+#ifdef B3000000
+        case 3000000:
+            return B3000000;
+#endif
+        default:
+            return B0;
+    }
+}
+
+bool greentea::host::set_line_rate(int fd, uint32_t bits_per_s)
+{
+    const speed_t speed = line_rate_speed(bits_per_s);
+    struct termios tio;
+    if (speed == B0 || tcgetattr(fd, &tio) != 0) {
+        return false;
+    }
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    return tcsetattr(fd, TCSADRAIN, &tio) == 0;
+}
+
+const int session::heartbeat_periods;
+
+session::session(int fd, int sync_timeout_ms) :
+    _fd(fd),
+    _shard_key("__shard"),
+    _shard_value("0/1"),
+    _sync_timeout_ms(sync_timeout_ms)
+{
+    greentea_kv_parser_init(&_parser, _key, sizeof(_key), _value, sizeof(_value), GREENTEA_KV_MULTI_VALUE);
+    _deadline = clock::now() + std::chrono::milliseconds(_sync_timeout_ms);
+}
+
+void session::on(const std::string &key, handler h)
+{
+    _handlers[key] = h;
+}
+
+void session::on_text(text_handler h)
+{
+    _text = h;
+}
+
+void session::send(const std::string &key, const std::string &value)
+{
+    const std::string message = "{{" + key + ";" + value + "}}\n";
+    write_all(_fd, message.data(), message.size());
+}
+
+void session::assign_shard(size_t index, size_t count)
+{
+    _shard_key = "__shard";
+    _shard_value = std::to_string(index) + "/" + std::to_string(count);
+}
+
+void session::assign_cases(const std::vector<std::string> &names)
+{
+    _shard_key = "__shard_cases";
+    _shard_value.clear();
+    for (const std::string &name : names) {
+        if (!_shard_value.empty()) {
+            _shard_value += ',';
+        }
+        _shard_value += name;
+    }
+}
+
+void session::set_log_decoder(const log_decoder &decoder)
+{
+    _log_decoder = decoder;
+}
+
+void session::set_link_bench(int pings, size_t bytes)
+{
+    _bench_pings = pings;
+    _bench_bytes = bytes;
+}
+
+void session::set_max_line_rate(uint32_t bits_per_s)
+{
+    _max_line_rate = bits_per_s;
+}
+
+void session::start()
+{
+    _uuid = make_uuid();
+    _deadline = clock::now() + std::chrono::milliseconds(_sync_timeout_ms);
+    _synced_at = clock::now();
+    // Clients which do not support the exchange skip anything but __sync
+    send("__capabilities", "kv+stream+log+journal+shard," + std::to_string(sizeof(_value) - 1) + "," + std::to_string(_max_line_rate));
+    send("__sync", _uuid);
+}
+
+void session::feed(const char *data, size_t size)
+{
+    if (size) {
+        _last_output = clock::now();
+    }
+    for (size_t i = 0; i < size && !_finished; i++) {
+        const char c = data[i];
+        if (greentea_kv_parser_push(&_parser, (unsigned char)c) == GREENTEA_KV_MESSAGE) {
+            _line_has_message = true;
+            const std::string key(_key);
+            const std::string value(_value);
+            if (journal_accept(key, value)) {
+                dispatch(key, value);
+            }
+        }
+
+        // Lines holding a key-value message are not text output
+        if (c == '\n') {
+            if (!_line_has_message && _text) {
+                _text(_line);
+            }
+            _line.clear();
+            _line_has_message = false;
+        } else if (c != '\r') {
+            _line += c;
+        }
+    }
+}
+
+void session::end_of_stream()
+{
+    if (!_line.empty() && !_line_has_message && _text) {
+        _text(_line);
+    }
+    _line.clear();
+    finish(_synced ? "no_exit" : "no_sync");
+}
+
+session::clock::time_point session::deadline() const
+{
+    clock::time_point deadline = _deadline;
+    if (_testcase_timed && _testcase_deadline < deadline) {
+        deadline = _testcase_deadline;
+    }
+    if (_heartbeat.count() && _last_output + heartbeat_periods * _heartbeat < deadline) {
+        deadline = _last_output + heartbeat_periods * _heartbeat;
+    }
+    return deadline;
+}
+
+void session::expire()
+{
+    // The cause is the earliest of the deadlines
+    const clock::time_point due = deadline();
+    if (!_synced) {
+        finish("no_sync");
+    } else if (_testcase_timed && _testcase_deadline <= due) {
+        finish("testcase_timeout");
+    } else if (_heartbeat.count() && _last_output + heartbeat_periods * _heartbeat <= due) {
+        finish("heartbeat_lost");
+    } else {
+        finish("timeout");
+    }
+}
+
+void session::finish(const char *status)
+{
+    if (_finished) {
+        return;
+    }
+    _finished = true;
+    if (status) {
+        _result.status = status;
+    } else if (_result.status.empty()) {
+        _result.status = "no_result";
+    }
+    _result.exit_code = _result.status == "success" ? 0 : 1;
+    _result.journal.lost = 0;
+    for (unsigned long seq = 1; seq <= _journal_last; seq++) {
+        _result.journal.lost += !_journal_seen.count(seq);
+    }
+}
+
+/**
+ * Whether the DUT journals messages with a key, as greentea-client does.
+ */
+static bool journaled_key(const std::string &key)
+{
+    return key.compare(0, 2, "__") != 0 || key.compare(0, 11, "__testcase_") == 0;
+}
+
+/**
+ * Track the numbers of the journaled messages, asking the DUT to replay those which were lost.
+ *
+ * @return false if the message is a duplicate which must not be dispatched
+ */
+bool session::journal_accept(const std::string &key, const std::string &value)
+{
+    if (key == "__seq") {
+        const unsigned long seq = strtoul(value.c_str(), NULL, 10);
+        // Replays come after later messages, only a number beyond the last one shows a gap
+        if (seq > _journal_announced + 1 && _journal_announced + 1 > _journal_requested) {
+            journal_replay(_journal_announced + 1);
+        }
+        _journal_pending = seq;
+        _journal_replayed = seq <= _journal_announced;
+        _journal_announced = std::max(_journal_announced, seq);
+        _journal_last = std::max(_journal_last, seq);
+        return true;
+    }
+    if (key == "__journal_end") {
+        _journal_last = std::max(_journal_last, strtoul(value.c_str(), NULL, 10));
+        for (unsigned long seq = 1; seq <= _journal_last; seq++) {
+            if (!_journal_seen.count(seq)) {
+                journal_replay(seq);
+                break;
+            }
+        }
+        send("__journal_done", "0");
+        return true;
+    }
+
+    // The DUT writes the number right before the message, a different key means it was lost
+    const unsigned long seq = _journal_pending;
+    _journal_pending = 0;
+    if (!seq || !journaled_key(key)) {
+        return true;
+    }
+    if (!_journal_seen.insert(seq).second) {
+        _result.journal.duplicates++;
+        return false;
+    }
+    _result.journal.messages++;
+    if (_journal_replayed) {
+        _result.journal.recovered++;
+    }
+    return true;
+}
+
+void session::journal_replay(unsigned long from)
+{
+    _journal_requested = from;
+    send("__replay", std::to_string(from));
+}
+
+void session::dispatch(const std::string &key, const std::string &value)
+{
+    const clock::time_point now = clock::now();
+
+    if (key == "__sync") {
+        if (value == _uuid) {
+            _synced = true;
+            _synced_at = now;
+        }
+    } else if (key == "__timeout") {
+        _result.timeout = atoi(value.c_str());
+        _deadline = now + std::chrono::seconds(_result.timeout);
+    } else if (key == "__capabilities") {
+        // framing;max_value_size;line_rate
+        const std::string::size_type size_pos = value.find(';');
+        const std::string::size_type rate_pos = size_pos == std::string::npos ? std::string::npos :
+                                                value.find(';', size_pos + 1);
+        _result.capabilities.received = true;
+        _result.capabilities.framing = value.substr(0, size_pos);
+        if (rate_pos != std::string::npos) {
+            _result.capabilities.max_value_size = strtoul(value.c_str() + size_pos + 1, NULL, 10);
+            _result.capabilities.line_rate = strtoul(value.c_str() + rate_pos + 1, NULL, 10);
+        }
+        // The DUT switches once this message is out, and waits for the confirmation at the new rate
+        const uint32_t rate = _result.capabilities.line_rate;
+        if (rate && rate <= _max_line_rate && greentea::host::set_line_rate(_fd, rate)) {
+            send("__line_rate", std::to_string(rate));
+        }
+    } else if (key == "__host_test_name") {
+        _result.host_test_name = value;
+    } else if (key == "__shard_request") {
+        send(_shard_key, _shard_value);
+    } else if (key == "__testcase_timeout") {
+        _testcase_deadline = now + std::chrono::milliseconds(atol(value.c_str()));
+        _testcase_timed = true;
+    } else if (key == "__heartbeat") {
+        _heartbeat = std::chrono::milliseconds(atol(value.c_str()));
+    } else if (key == "__testcase_start") {
+        _testcase_timed = false;
+        testcase_result testcase;
+        testcase.name = value;
+        _result.testcases.push_back(testcase);
+    } else if (key == "__testcase_finish") {
+        _testcase_timed = false;
+        // name;passed;failed, the name is matched with the last test case started
+        const std::string::size_type failed_pos = value.rfind(';');
+        const std::string::size_type passed_pos = failed_pos == std::string::npos || failed_pos == 0 ?
+                                                  std::string::npos : value.rfind(';', failed_pos - 1);
+        if (passed_pos != std::string::npos) {
+            const std::string name = value.substr(0, passed_pos);
+            for (auto it = _result.testcases.rbegin(); it != _result.testcases.rend(); ++it) {
+                if (it->name == name && !it->finished) {
+                    it->passed = atoi(value.c_str() + passed_pos + 1);
+                    it->failed = atoi(value.c_str() + failed_pos + 1);
+                    it->finished = true;
+                    break;
+                }
+            }
+        }
+    } else if (key == "__testcase_count") {
+        _result.summary.count = atoi(value.c_str());
+    } else if (key == "__testcase_summary") {
+        // passed;failed
+        const std::string::size_type failed_pos = value.find(';');
+        _result.summary.received = true;
+        _result.summary.passed = atoi(value.c_str());
+        _result.summary.failed = failed_pos == std::string::npos ? 0 : atoi(value.c_str() + failed_pos + 1);
+    } else if (key == "__testcase_durations") {
+        // us,us,...
+        const char *p = value.c_str();
+        char *end;
+        _result.summary.durations_us.clear();
+        while (*p) {
+            _result.summary.durations_us.push_back(strtoul(p, &end, 10));
+            p = *end == ',' ? end + 1 : "";
+        }
+    } else if (key == "__log") {
+        for (const std::string &line : _log_decoder.decode(value)) {
+            _result.log.push_back(line);
+            if (_text) {
+                _text(line);
+            }
+        }
+    } else if (key == "__log_dropped") {
+        _result.log_dropped = strtoul(value.c_str(), NULL, 10);
+    } else if (key == "__clock_ping") {
+        // seq;t1, answered with seq,t2,t3 as the DUT parses a single value
+        const std::string seq = value.substr(0, value.find(';'));
+        send("__clock_pong", seq + "," + std::to_string(host_time_us(now)) + "," +
+             std::to_string(host_time_us(clock::now())));
+    } else if (key == "__clock_sync") {
+        // device_us;offset_us;rtt_us;drift_ppb
+        const char *p = value.c_str();
+        char *end;
+        long long fields[4] = {0};
+        for (long long &field : fields) {
+            field = strtoll(p, &end, 10);
+            p = *end == ';' ? end + 1 : end;
+        }
+        _result.clock.count++;
+        _result.clock.device_us = fields[0];
+        _result.clock.offset_us = fields[1];
+        _result.clock.rtt_us = fields[2];
+        _result.clock.drift_ppb = fields[3];
+    } else if (key == "__link_bench_request") {
+        bench_start(strtoul(value.c_str(), NULL, 10));
+    } else if (key == "__link_bench_pong" || key == "__link_bench_data" || key == "__link_bench_ack") {
+        bench_step(key, value, now);
+    } else if (key == "end") {
+        _result.status = value;
+    } else if (key == "__exit") {
+        _result.duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - _synced_at).count();
+        finish(NULL);
+    }
+
+    auto it = _handlers.find(key);
+    if (it != _handlers.end()) {
+        it->second(*this, key, value);
+    }
+}
+
+void session::bench_start(size_t chunk)
+{
+    if ((_bench_pings <= 0 && _bench_bytes == 0) || chunk == 0) {
+        send("__link_bench_done", "skip");
+        return;
+    }
+    _bench_chunk = chunk;
+    _bench_rtts_us.clear();
+    _result.link_bench = link_bench_result();
+    bench_ping();
+}
+
+/**
+ * Send the next ping, or start the transfer to the DUT once all round trips are measured.
+ */
+void session::bench_ping()
+{
+    if ((int)_bench_rtts_us.size() < _bench_pings) {
+        _bench_phase = bench_phase::ping;
+        _bench_sent_at = clock::now();
+        send("__link_bench_ping", std::to_string(_bench_rtts_us.size()));
+        return;
+    }
+
+    // The DUT counts the payload and reports it when asked with the final ack
+    static const char pattern[] = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    std::string payload;
+    for (size_t i = 0; i < _bench_chunk; i++) {
+        payload += pattern[i % (sizeof(pattern) - 1)];
+    }
+    _bench_phase = bench_phase::to_device;
+    _bench_sent_at = clock::now();
+    for (size_t sent = 0; sent < _bench_bytes; sent += _bench_chunk) {
+        send("__link_bench_data", payload.substr(0, std::min(_bench_chunk, _bench_bytes - sent)));
+    }
+    send("__link_bench_ack", "0");
+}
+
+void session::bench_step(const std::string &key, const std::string &value, clock::time_point now)
+{
+    const double elapsed_s = std::chrono::duration<double>(now - _bench_sent_at).count();
+    if (_bench_phase == bench_phase::ping && key == "__link_bench_pong") {
+        if (value == std::to_string(_bench_rtts_us.size())) {
+            _bench_rtts_us.push_back(std::chrono::duration_cast<std::chrono::microseconds>(now - _bench_sent_at).count());
+            bench_ping();
+        }
+    } else if (_bench_phase == bench_phase::to_device && key == "__link_bench_ack") {
+        _result.link_bench.to_device_bytes_per_s = elapsed_s > 0 ? strtoul(value.c_str(), NULL, 10) / elapsed_s : 0;
+        _bench_phase = bench_phase::to_host;
+        _bench_received = 0;
+        _bench_sent_at = clock::now();
+        send("__link_bench_send", std::to_string(_bench_bytes));
+    } else if (_bench_phase == bench_phase::to_host && key == "__link_bench_data") {
+        _bench_received += value.size();
+    } else if (_bench_phase == bench_phase::to_host && key == "__link_bench_ack") {
+        _result.link_bench.to_host_bytes_per_s = elapsed_s > 0 ? _bench_received / elapsed_s : 0;
+        bench_done();
+    }
+}
+
+/**
+ * Compute the percentiles of the round trips and send the results to the DUT.
+ */
+void session::bench_done()
+{
+    link_bench_result &bench = _result.link_bench;
+    std::vector<long> rtts = _bench_rtts_us;
+    std::sort(rtts.begin(), rtts.end());
+    // Nearest rank
+    auto percentile = [&rtts](int p) {
+        return rtts.empty() ? 0 : rtts[(rtts.size() * p + 99) / 100 - 1];
+    };
+    bench.pings = rtts.size();
+    bench.rtt_p50_us = percentile(50);
+    bench.rtt_p90_us = percentile(90);
+    bench.rtt_p99_us = percentile(99);
+    bench.rtt_max_us = percentile(100);
+    _bench_phase = bench_phase::idle;
+    send("__link_bench_done", std::to_string(bench.rtt_p50_us) + "," + std::to_string(bench.rtt_p90_us) + "," +
+         std::to_string(bench.rtt_p99_us) + "," + std::to_string(bench.rtt_max_us) + "," +
+         std::to_string((unsigned long)bench.to_host_bytes_per_s) + "," +
+         std::to_string((unsigned long)bench.to_device_bytes_per_s));
+}
+
+result greentea::host::merge_results(const std::vector<result> &shards)
+{
+    result merged;
+    merged.status = "success";
+    for (const result &shard : shards) {
+        if (merged.host_test_name.empty()) {
+            merged.host_test_name = shard.host_test_name;
+        }
+        if (merged.status == "success") {
+            merged.status = shard.status;
+        }
+        merged.timeout = std::max(merged.timeout, shard.timeout);
+        merged.duration_ms = std::max(merged.duration_ms, shard.duration_ms);
+        merged.testcases.insert(merged.testcases.end(), shard.testcases.begin(), shard.testcases.end());
+        merged.summary.received = merged.summary.received || shard.summary.received;
+        merged.summary.count += shard.summary.count;
+        merged.summary.passed += shard.summary.passed;
+        merged.summary.failed += shard.summary.failed;
+        merged.summary.durations_us.insert(merged.summary.durations_us.end(), shard.summary.durations_us.begin(),
+                                           shard.summary.durations_us.end());
+        merged.log.insert(merged.log.end(), shard.log.begin(), shard.log.end());
+        merged.log_dropped += shard.log_dropped;
+        merged.journal.messages += shard.journal.messages;
+        merged.journal.recovered += shard.journal.recovered;
+        merged.journal.duplicates += shard.journal.duplicates;
+        merged.journal.lost += shard.journal.lost;
+    }
+    if (shards.empty()) {
+        merged.status = "no_result";
+    }
+    merged.exit_code = merged.status == "success" ? 0 : 1;
+    return merged;
+}
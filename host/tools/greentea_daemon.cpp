@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ *  greentea-daemon: act as the host of several DUTs connected to serial ports or PTYs
+ *
+ *  Usage: greentea-daemon [-b baud] [-r max_baud] [-s sync_timeout_ms] [-l log_strings] port...
+ *
+ *  Each DUT must be reset to start its test suite once the daemon is running. The exit
+ *  status is 0 only if the suites of all DUTs reported success. log_strings is the file
+ *  with the format strings of GREENTEA_LOG(), written by the greentea_log_strings() CMake
+ *  function, to decode the __log messages of the DUTs. max_baud is the fastest baud rate
+ *  advertised to the DUTs, which switch to it if their transport supports it.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include "greentea-host/daemon.h"
+
+using namespace greentea::host;
+
+int main(int argc, char **argv)
+{
+    int baud = 115200;
+    int sync_timeout_ms = 10000;
+    uint32_t max_baud = 0;
+    log_decoder decoder;
+    int opt;
+    while ((opt = getopt(argc, argv, "b:r:s:l:")) != -1) {
+        switch (opt) {
+            case 'b':
+                baud = atoi(optarg);
+                break;
+            case 'r':
+                max_baud = strtoul(optarg, NULL, 10);
+                break;
+            case 's':
+                sync_timeout_ms = atoi(optarg);
+                break;
+            case 'l':
+                if (!decoder.load(optarg)) {
+                    fprintf(stderr, "Failed to read %s: %s\n", optarg, strerror(errno));
+                    return 2;
+                }
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-b baud] [-r max_baud] [-s sync_timeout_ms] [-l log_strings] port...\n", argv[0]);
+                return 2;
+        }
+    }
+    if (optind == argc) {
+        fprintf(stderr, "Usage: %s [-b baud] [-r max_baud] [-s sync_timeout_ms] [-l log_strings] port...\n", argv[0]);
+        return 2;
+    }
+
+    dut_daemon d(sync_timeout_ms);
+    d.set_max_line_rate(max_baud);
+    d.on_finished([&d](size_t index, session & s) {
+        const result &res = s.get_result();
+        printf("[%s] result %s, %zu test cases in %ld ms\n", d.channel_name(index).c_str(),
+               res.status.c_str(), res.testcases.size(), res.duration_ms);
+    });
+
+    for (int i = optind; i < argc; i++) {
+        const int fd = open_serial(argv[i], baud);
+        const int index = fd < 0 ? -1 : d.add_channel(argv[i], fd);
+        if (index < 0) {
+            fprintf(stderr, "Failed to open %s: %s\n", argv[i], strerror(errno));
+            return 2;
+        }
+        d.channel(index).set_log_decoder(decoder);
+    }
+    d.run();
+
+    int failed = 0;
+    for (size_t i = 0; i < d.channel_count(); i++) {
+        failed += d.channel(i).get_result().exit_code != 0;
+    }
+    printf("%zu DUTs, %d failed\n", d.channel_count(), failed);
+    return failed ? 1 : 0;
+}
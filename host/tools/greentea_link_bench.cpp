@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ *  greentea-link-bench: measure the links of the native host harness with GREENTEA_LINK_BENCH()
+ *
+ *  Usage: greentea-link-bench [-n pings] [-b bytes] [-t] [socket|pipe|pty]...
+ *
+ *  Runs a suite doing nothing but the link benchmark over each of the links given, all of
+ *  them by default, and prints the round-trip percentiles and the throughput in each
+ *  direction. The suite runs in a child process, or in a thread with -t. This is the
+ *  baseline of the protocol overhead against which a DUT on a serial port or USB can be
+ *  compared.
+ */
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include "greentea-client/test_env.h"
+#include "greentea-host/harness.h"
+
+using namespace greentea::host;
+
+static int bench_suite()
+{
+    GREENTEA_SETUP(60, "default_auto");
+    GREENTEA_TESTSUITE_RESULT(GREENTEA_LINK_BENCH(NULL) == 0);
+    return 0;
+}
+
+static bool parse_link(const char *name, link_type &type)
+{
+    if (strcmp(name, "socket") == 0) {
+        type = link_type::socket;
+    } else if (strcmp(name, "pipe") == 0) {
+        type = link_type::pipe;
+    } else if (strcmp(name, "pty") == 0) {
+        type = link_type::pty;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    static const char usage[] = "Usage: %s [-n pings] [-b bytes] [-t] [socket|pipe|pty]...\n";
+    options opts;
+    opts.echo = false;
+    opts.report = false;
+    opts.link_bench_pings = 1000;
+    opts.link_bench_bytes = 1 << 20;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:b:t")) != -1) {
+        switch (opt) {
+            case 'n':
+                opts.link_bench_pings = atoi(optarg);
+                break;
+            case 'b':
+                opts.link_bench_bytes = strtoul(optarg, NULL, 10);
+                break;
+            case 't':
+                opts.mode = run_mode::thread;
+                break;
+            default:
+                fprintf(stderr, usage, argv[0]);
+                return 2;
+        }
+    }
+
+    const char *const all_links[] = { "socket", "pipe", "pty" };
+    const char *const *links = optind < argc ? argv + optind : all_links;
+    const int count = optind < argc ? argc - optind : 3;
+
+    // A suite left running after a timeout must not kill the process through a closed pipe
+    signal(SIGPIPE, SIG_IGN);
+
+    int exit_code = 0;
+    printf("%-8s %8s %8s %8s %8s %14s %14s\n", "link", "p50 us", "p90 us", "p99 us", "max us",
+           "to host B/s", "to device B/s");
+    for (int i = 0; i < count; i++) {
+        if (!parse_link(links[i], opts.link)) {
+            fprintf(stderr, usage, argv[0]);
+            return 2;
+        }
+        harness h(opts);
+        const result res = h.run(bench_suite);
+        if (res.status != "success") {
+            printf("%-8s %s\n", links[i], res.status.c_str());
+            exit_code = 1;
+            continue;
+        }
+        const link_bench_result &bench = res.link_bench;
+        printf("%-8s %8ld %8ld %8ld %8ld %14.0f %14.0f\n", links[i], bench.rtt_p50_us, bench.rtt_p90_us,
+               bench.rtt_p99_us, bench.rtt_max_us, bench.to_host_bytes_per_s, bench.to_device_bytes_per_s);
+        fflush(stdout);
+    }
+    return exit_code;
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GREENTEA_CLIENT_CONFIG_H_
+#define GREENTEA_CLIENT_CONFIG_H_
+
+/**
+ *  Compile-time selection of greentea-client features
+ *
+ *  Each feature is enabled unless its macro is defined to 0, e.g. with the CMake options of
+ *  the same names, which pass the definitions on to everything linking greentea-client.
+ *  Disabled features are left out of the headers as well, so using one is a compile error
+ *  rather than a silent no-op.
+ */
+
+/**
+ * Whether the target has lock-free atomic read-modify-write operations, detected from the
+ * compiler. Armv6-M, e.g. Cortex-M0 and M0+, has none, and newlib provides no library
+ * fallback for them.
+ */
+#ifndef GREENTEA_CLIENT_ATOMICS
+#if defined(__ARM_ARCH_6M__) || (defined(__GCC_ATOMIC_INT_LOCK_FREE) && __GCC_ATOMIC_INT_LOCK_FREE < 2)
+#define GREENTEA_CLIENT_ATOMICS     0
+#else
+#define GREENTEA_CLIENT_ATOMICS     1
+#endif
+#endif
+
+/**
+ * Receiving from the host: the handshake, greentea_parse_kv() and the other parsing
+ * functions, and everything built on them. Without it the client is transmit-only:
+ * GREENTEA_SETUP() sends its messages without waiting for __sync, so the host must not
+ * expect the handshake (mbedhtrun --sync 0), and greentea_getc() is never called.
+ */
+#ifndef GREENTEA_CLIENT_PARSER
+#define GREENTEA_CLIENT_PARSER      1
+#endif
+
+/**
+ * printf-style values with greentea_send_kvf() and floating point values.
+ */
+#ifndef GREENTEA_CLIENT_FORMAT
+#define GREENTEA_CLIENT_FORMAT      1
+#endif
+
+/**
+ * Protocol extensions beyond what htrun and utest use: the test case summary and
+ * durations, per test case timeouts, the heartbeat and test case sharding.
+ *
+ * @note Without GREENTEA_CLIENT_ATOMICS, the heartbeat must be run from an interrupt
+ *       of the core running the suite, as a periodic timer of a single core does.
+ */
+#ifndef GREENTEA_CLIENT_EXTENDED
+#define GREENTEA_CLIENT_EXTENDED    1
+#endif
+
+/**
+ * Recording of the traffic with greentea_trace_start(), see test_trace.h.
+ */
+#ifndef GREENTEA_CLIENT_TRACE
+#define GREENTEA_CLIENT_TRACE       1
+#endif
+
+/**
+ * Deferred logging with GREENTEA_LOG(), see test_log.h. The format strings are collected
+ * in a section of the image, which needs an ELF toolchain.
+ *
+ * @note The log buffer relies on GREENTEA_CLIENT_ATOMICS, so it is left out by default
+ *       on targets without them.
+ */
+#ifndef GREENTEA_CLIENT_LOG
+#if defined(__ELF__) && GREENTEA_CLIENT_ATOMICS
+#define GREENTEA_CLIENT_LOG         1
+#else
+#define GREENTEA_CLIENT_LOG         0
+#endif
+#endif
+
+/**
+ * Journal of the result messages, replayed to a host which lost some of them, see
+ * test_journal.h. Replays are requested by the host, so it needs the parser.
+ */
+#ifndef GREENTEA_CLIENT_JOURNAL
+#define GREENTEA_CLIENT_JOURNAL     GREENTEA_CLIENT_PARSER
+#endif
+
+/**
+ * Test cases flagged GREENTEA_CASE_PARALLEL_SAFE run on a pool of threads, see
+ * test_runner.h, which needs a native build with std::thread.
+ */
+#ifndef GREENTEA_CLIENT_PARALLEL
+#if defined(__linux__) || defined(__APPLE__)
+#define GREENTEA_CLIENT_PARALLEL    1
+#else
+#define GREENTEA_CLIENT_PARALLEL    0
+#endif
+#endif
+
+#endif // GREENTEA_CLIENT_CONFIG_H_
@@ -0,0 +1,406 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GREENTEA_CLIENT_TEST_COROUTINE_H_
+#define GREENTEA_CLIENT_TEST_COROUTINE_H_
+
+#if !defined(__cpp_impl_coroutine)
+#error "test_coroutine.h needs C++20 coroutines, e.g. -std=c++20 (and -fcoroutines for GCC 10)"
+#endif
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdio>
+#include <exception>
+#include <string_view>
+#include "greentea-client/greentea_config.h"
+#include "greentea-client/test_env.h"
+#include "greentea-client/test_io.h"
+#include "greentea-client/test_send.h"
+
+#if GREENTEA_CLIENT_PARSER
+
+/**
+ *  Conversations with the host as C++20 coroutines
+ *
+ *  Example usage:
+ *
+ *  greentea::task echo(int rounds)
+ *  {
+ *      for (int i = 0; i < rounds; i++) {
+ *          co_await greentea::send("echo", i);
+ *          greentea::message reply = co_await greentea::recv("echo");
+ *          GREENTEA_CHECK(reply.value == std::to_string(i));
+ *      }
+ *  }
+ *
+ *  greentea::scheduler conversations;
+ *  conversations.spawn(echo(10));
+ *  conversations.spawn(other_conversation());
+ *  conversations.run();
+ *
+ *  A scheduler parses what it is fed with its own push parser and resumes the coroutine
+ *  waiting for the key of each message, so any number of conversations share one thread
+ *  and their frames instead of a thread stack each. It is fed either by run(), which reads
+ *  with greentea_kv_parser_read() until all its tasks have finished, or by the receive path
+ *  of the application with feed(), e.g. from the event loop of an RTOS task. Messages are sent
+ *  with greentea::send(), whose result can be co_awaited: the message is written before
+ *  send() returns, so the coroutine carries on at once.
+ *
+ *  A scheduler and its tasks belong to one thread. Coroutine frames are allocated with
+ *  operator new, which returns an invalid task rather than throwing when it fails.
+ */
+
+namespace greentea {
+
+class scheduler;
+
+/**
+ * A message received by a coroutine, valid until the coroutine next suspends.
+ */
+struct message {
+    std::string_view key;
+    std::string_view value;     /**< Truncated to scheduler::value_size - 1 characters */
+    size_t length;              /**< Length of the value sent, larger than value.size() if truncated */
+};
+
+/**
+ * Coroutine of a conversation with the host, run by a scheduler.
+ */
+class task {
+public:
+    class promise_type {
+    public:
+        task get_return_object() noexcept
+        {
+            return task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        static task get_return_object_on_allocation_failure() noexcept
+        {
+            return task(nullptr);
+        }
+
+        // Nothing runs until the task is spawned, and the frame is freed once it returns
+        std::suspend_always initial_suspend() const noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never final_suspend() const noexcept
+        {
+            return {};
+        }
+
+        void return_void() const noexcept
+        {
+        }
+
+        void unhandled_exception() const noexcept
+        {
+            std::terminate();
+        }
+
+        ~promise_type();
+
+    private:
+        friend class scheduler;
+        friend class recv_awaiter;
+
+        scheduler *_scheduler = nullptr;
+        promise_type *_next = nullptr;
+    };
+
+    task(task &&other) noexcept : _handle(other._handle)
+    {
+        other._handle = nullptr;
+    }
+
+    task(const task &) = delete;
+    task &operator=(const task &) = delete;
+
+    ~task()
+    {
+        if (_handle) {
+            _handle.destroy();
+        }
+    }
+
+    /**
+     * Check whether the frame of the coroutine could be allocated.
+     */
+    explicit operator bool() const noexcept
+    {
+        return static_cast<bool>(_handle);
+    }
+
+private:
+    friend class scheduler;
+
+    explicit task(std::coroutine_handle<promise_type> handle) noexcept : _handle(handle)
+    {
+    }
+
+    std::coroutine_handle<promise_type> _handle;
+};
+
+/**
+ * Awaitable of recv(), which suspends the coroutine until a message arrives.
+ */
+class recv_awaiter {
+public:
+    explicit recv_awaiter(const char *key) noexcept : _key(key)
+    {
+    }
+
+    recv_awaiter(const recv_awaiter &) = delete;
+    recv_awaiter &operator=(const recv_awaiter &) = delete;
+
+    ~recv_awaiter();
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<task::promise_type> handle) noexcept;
+
+    message await_resume() const noexcept
+    {
+        return _message;
+    }
+
+private:
+    friend class scheduler;
+
+    const char *_key;
+    std::coroutine_handle<> _handle;
+    scheduler *_scheduler = nullptr;
+    recv_awaiter *_next = nullptr;
+    message _message = {};
+};
+
+/**
+ * Wait in a coroutine for the next message with a key.
+ *
+ * @details Several coroutines waiting for the same key are handed its messages in the order
+ *          they started to wait, one message each.
+ *
+ * @param key Key of the message, or NULL for a message with any key
+ *
+ * @return Awaitable resuming with the message
+ */
+inline recv_awaiter recv(const char *key = nullptr) noexcept
+{
+    return recv_awaiter(key);
+}
+
+/**
+ * Single-threaded scheduler resuming the coroutines of conversations as their messages arrive.
+ */
+class scheduler {
+public:
+    /** Sizes of the buffers of the key and the value of the message being received */
+    static const size_t key_size = 32;
+    static const size_t value_size = GREENTEA_MAX_VALUE_SIZE + 1;
+
+    scheduler() noexcept
+    {
+        greentea_kv_parser_init(&_parser, _key, sizeof(_key), _value, sizeof(_value), 0);
+    }
+
+    scheduler(const scheduler &) = delete;
+    scheduler &operator=(const scheduler &) = delete;
+
+    /**
+     * Destroy the frames of the tasks which are still waiting.
+     */
+    ~scheduler()
+    {
+        while (_tasks) {
+            std::coroutine_handle<task::promise_type>::from_promise(*_tasks).destroy();
+        }
+    }
+
+    /**
+     * Run a task until it first waits for a message, then whenever the message arrives.
+     *
+     * @param t Task returned by a coroutine
+     *
+     * @return false if the frame of the coroutine could not be allocated
+     */
+    bool spawn(task t) noexcept
+    {
+        if (!t) {
+            return false;
+        }
+        std::coroutine_handle<task::promise_type> handle = t._handle;
+        t._handle = nullptr;
+        handle.promise()._scheduler = this;
+        handle.promise()._next = _tasks;
+        _tasks = &handle.promise();
+        handle.resume();
+        return true;
+    }
+
+    /**
+     * Push the next character received from the host.
+     *
+     * @details Resumes the coroutine waiting for the message the character completes, if any,
+     *          which runs until it waits again or returns.
+     */
+    void push(int c) noexcept
+    {
+        if (greentea_kv_parser_push(&_parser, c) == GREENTEA_KV_MESSAGE) {
+            dispatch();
+        }
+    }
+
+    /**
+     * Push characters received from the host, see push().
+     */
+    void feed(const char *data, size_t size) noexcept
+    {
+        for (size_t i = 0; i < size; i++) {
+            push(static_cast<unsigned char>(data[i]));
+        }
+    }
+
+    /**
+     * Read with greentea_kv_parser_read() until all tasks have returned.
+     *
+     * @details Output held back by the flush policy is flushed before each read, and
+     *          replay requests of the journal are served rather than dispatched.
+     *
+     * @return true if all tasks returned, false if the stream ended first
+     */
+    bool run() noexcept
+    {
+        while (_tasks) {
+            const int result = greentea_kv_parser_read(&_parser);
+            if (result == EOF) {
+                return false;
+            }
+            if (result == GREENTEA_KV_MESSAGE) {
+                dispatch();
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Check whether all tasks have returned.
+     */
+    bool done() const noexcept
+    {
+        return _tasks == nullptr;
+    }
+
+    /**
+     * Number of messages received while no coroutine was waiting for their key, which are dropped.
+     */
+    size_t unhandled() const noexcept
+    {
+        return _unhandled;
+    }
+
+private:
+    friend class task::promise_type;
+    friend class recv_awaiter;
+
+    void dispatch() noexcept
+    {
+        const std::string_view key(_key);
+        for (recv_awaiter **waiter = &_waiters; *waiter; waiter = &(*waiter)->_next) {
+            recv_awaiter *const found = *waiter;
+            if (!found->_key || key == found->_key) {
+                *waiter = found->_next;
+                found->_scheduler = nullptr;
+                found->_message = message{key, std::string_view(_value), _parser.value.length};
+                found->_handle.resume();
+                return;
+            }
+        }
+        _unhandled++;
+    }
+
+    void wait(recv_awaiter *waiter) noexcept
+    {
+        // Appended, so that waiters for the same key are served in order
+        recv_awaiter **last = &_waiters;
+        while (*last) {
+            last = &(*last)->_next;
+        }
+        waiter->_next = nullptr;
+        *last = waiter;
+    }
+
+    void cancel(recv_awaiter *waiter) noexcept
+    {
+        for (recv_awaiter **entry = &_waiters; *entry; entry = &(*entry)->_next) {
+            if (*entry == waiter) {
+                *entry = waiter->_next;
+                return;
+            }
+        }
+    }
+
+    void finished(task::promise_type *promise) noexcept
+    {
+        for (task::promise_type **entry = &_tasks; *entry; entry = &(*entry)->_next) {
+            if (*entry == promise) {
+                *entry = promise->_next;
+                return;
+            }
+        }
+    }
+
+    greentea_kv_parser _parser;
+    char _key[key_size];
+    char _value[value_size];
+    task::promise_type *_tasks = nullptr;
+    recv_awaiter *_waiters = nullptr;
+    size_t _unhandled = 0;
+};
+
+inline task::promise_type::~promise_type()
+{
+    if (_scheduler) {
+        _scheduler->finished(this);
+    }
+}
+
+inline recv_awaiter::~recv_awaiter()
+{
+    // The frame of a waiting coroutine is destroyed with its scheduler
+    if (_scheduler) {
+        _scheduler->cancel(this);
+    }
+}
+
+inline void recv_awaiter::await_suspend(std::coroutine_handle<task::promise_type> handle) noexcept
+{
+    _handle = handle;
+    _scheduler = handle.promise()._scheduler;
+    _scheduler->wait(this);
+}
+
+} // namespace greentea
+
+#endif // GREENTEA_CLIENT_PARSER
+
+#endif // GREENTEA_CLIENT_TEST_COROUTINE_H_
@@ -18,10 +18,15 @@
 #ifndef GREENTEA_CLIENT_TEST_ENV_H_
 #define GREENTEA_CLIENT_TEST_ENV_H_
 
+#include <stdarg.h>
 #include <stddef.h>
+#include <stdint.h>
+#include "greentea-client/greentea_config.h"
 #include "greentea-client/test_io.h"
 
 #ifdef __cplusplus
+#include "greentea-client/test_send.h"
+
 #define GREENTEA_CLIENT_VERSION_STRING "1.3.0"
 
 /**
@@ -49,38 +54,155 @@
 
 /**
  *  Generic test suite transport protocol keys
+ *
+ *  The keys are arrays, so their lengths are known at compile time where they are defined
+ *  and messages carrying them are sent without measuring the key.
+ */
+extern const char GREENTEA_TEST_ENV_END[];
+extern const char GREENTEA_TEST_ENV_EXIT[];
+extern const char GREENTEA_TEST_ENV_SYNC[];
+extern const char GREENTEA_TEST_ENV_TIMEOUT[];
+extern const char GREENTEA_TEST_ENV_HOST_TEST_NAME[];
+extern const char GREENTEA_TEST_ENV_HOST_TEST_VERSION[];
+
+#if GREENTEA_CLIENT_PARSER
+/**
+ *  Capability exchange transport protocol keys
+ *
+ *  A host which supports the exchange advertises itself before __sync with
+ *  {{__capabilities;<framing>,<max value size>,<max line rate>}}. GREENTEA_SETUP() then
+ *  answers after __version with {{__capabilities;<framing>;<max value size>;<line rate>}},
+ *  where framing lists the message formats the DUT sends or accepts, e.g. "kv+stream+log",
+ *  and line rate is the fastest both sides support, 0 to keep the current one. Other hosts
+ *  are not sent anything.
+ */
+extern const char GREENTEA_TEST_ENV_CAPABILITIES[];
+extern const char GREENTEA_TEST_ENV_LINE_RATE[];
+
+/**
+ *  Largest value GREENTEA_SETUP() and GREENTEA_SETUP_TIMEOUT() accept in a message from the
+ *  host, advertised in the capability exchange so the host can split larger data.
+ *  GREENTEA_SETUP_UUID() advertises what its buffer takes instead.
  */
-extern const char *GREENTEA_TEST_ENV_END;
-extern const char *GREENTEA_TEST_ENV_EXIT;
-extern const char *GREENTEA_TEST_ENV_SYNC;
-extern const char *GREENTEA_TEST_ENV_TIMEOUT;
-extern const char *GREENTEA_TEST_ENV_HOST_TEST_NAME;
-extern const char *GREENTEA_TEST_ENV_HOST_TEST_VERSION;
+#ifndef GREENTEA_MAX_VALUE_SIZE
+#define GREENTEA_MAX_VALUE_SIZE     64
+#endif
+
+/**
+ *  Time GREENTEA_SETUP() waits for the host to confirm a new line rate, in milliseconds
+ */
+#ifndef GREENTEA_LINE_RATE_TIMEOUT_MS
+#define GREENTEA_LINE_RATE_TIMEOUT_MS 500
+#endif
+#endif // GREENTEA_CLIENT_PARSER
 
 /**
  *  Test suite success code strings
  */
-extern const char *GREENTEA_TEST_ENV_SUCCESS;
-extern const char *GREENTEA_TEST_ENV_FAILURE;
+extern const char GREENTEA_TEST_ENV_SUCCESS[];
+extern const char GREENTEA_TEST_ENV_FAILURE[];
 
 /**
  *  Test case transport protocol start/finish keys
  */
-extern const char *GREENTEA_TEST_ENV_TESTCASE_NAME;
-extern const char *GREENTEA_TEST_ENV_TESTCASE_COUNT;
-extern const char *GREENTEA_TEST_ENV_TESTCASE_START;
-extern const char *GREENTEA_TEST_ENV_TESTCASE_FINISH;
-extern const char *GREENTEA_TEST_ENV_TESTCASE_SUMMARY;
+extern const char GREENTEA_TEST_ENV_TESTCASE_NAME[];
+extern const char GREENTEA_TEST_ENV_TESTCASE_COUNT[];
+extern const char GREENTEA_TEST_ENV_TESTCASE_START[];
+extern const char GREENTEA_TEST_ENV_TESTCASE_FINISH[];
+extern const char GREENTEA_TEST_ENV_TESTCASE_SUMMARY[];
+#if GREENTEA_CLIENT_EXTENDED
+extern const char GREENTEA_TEST_ENV_TESTCASE_DURATIONS[];
+extern const char GREENTEA_TEST_ENV_TESTCASE_TIMEOUT[];
+extern const char GREENTEA_TEST_ENV_HEARTBEAT[];
+#endif // GREENTEA_CLIENT_EXTENDED
+
+#if GREENTEA_CLIENT_EXTENDED
+/**
+ *  Number of test case durations kept for the __testcase_durations message
+ */
+#ifndef GREENTEA_SUMMARY_MAX_CASES
+#define GREENTEA_SUMMARY_MAX_CASES  64
+#endif
+
+/**
+ *  Test case sharding transport protocol keys
+ */
+extern const char GREENTEA_TEST_ENV_SHARD_REQUEST[];
+extern const char GREENTEA_TEST_ENV_SHARD[];
+extern const char GREENTEA_TEST_ENV_SHARD_CASES[];
+
+/**
+ *  Maximum number of test cases which can be assigned by name, see GREENTEA_TESTCASE_SHARD()
+ */
+#ifndef GREENTEA_SHARD_MAX_CASES
+#define GREENTEA_SHARD_MAX_CASES    256
+#endif
+
+/**
+ *  Maximum length of a test case name which can be assigned by name, including the terminator
+ */
+#ifndef GREENTEA_SHARD_NAME_SIZE
+#define GREENTEA_SHARD_NAME_SIZE    64
+#endif
+
+/**
+ *  Clock synchronization transport protocol keys
+ */
+extern const char GREENTEA_TEST_ENV_CLOCK_PING[];
+extern const char GREENTEA_TEST_ENV_CLOCK_PONG[];
+extern const char GREENTEA_TEST_ENV_CLOCK_SYNC[];
+
+/**
+ *  Number of ping exchanges of GREENTEA_CLOCK_SYNC(), the one with the shortest round trip is kept
+ */
+#ifndef GREENTEA_CLOCK_SYNC_ROUNDS
+#define GREENTEA_CLOCK_SYNC_ROUNDS  8
+#endif
+
+/**
+ *  Time GREENTEA_CLOCK_SYNC() waits for each answer of the host, in milliseconds
+ */
+#ifndef GREENTEA_CLOCK_SYNC_TIMEOUT_MS
+#define GREENTEA_CLOCK_SYNC_TIMEOUT_MS 1000
+#endif
+
+/**
+ *  Link benchmark transport protocol keys
+ */
+extern const char GREENTEA_TEST_ENV_LINK_BENCH_REQUEST[];
+extern const char GREENTEA_TEST_ENV_LINK_BENCH_PING[];
+extern const char GREENTEA_TEST_ENV_LINK_BENCH_PONG[];
+extern const char GREENTEA_TEST_ENV_LINK_BENCH_DATA[];
+extern const char GREENTEA_TEST_ENV_LINK_BENCH_SEND[];
+extern const char GREENTEA_TEST_ENV_LINK_BENCH_ACK[];
+extern const char GREENTEA_TEST_ENV_LINK_BENCH_DONE[];
+extern const char GREENTEA_TEST_ENV_LINK_BENCH_RESULT[];
+
+/**
+ *  Payload bytes of each bulk transfer message of GREENTEA_LINK_BENCH(), in both directions
+ */
+#ifndef GREENTEA_LINK_BENCH_CHUNK_SIZE
+#define GREENTEA_LINK_BENCH_CHUNK_SIZE 64
+#endif
+
+/**
+ *  Time GREENTEA_LINK_BENCH() waits for each message of the host, in milliseconds
+ */
+#ifndef GREENTEA_LINK_BENCH_TIMEOUT_MS
+#define GREENTEA_LINK_BENCH_TIMEOUT_MS 5000
+#endif
+#endif // GREENTEA_CLIENT_EXTENDED
 
 /**
  *  Code Coverage (LCOV)  transport protocol keys
  */
-extern const char *GREENTEA_TEST_ENV_LCOV_START;
+extern const char GREENTEA_TEST_ENV_LCOV_START[];
 
 /**
  *  Greentea-client related API for communication with host side
  */
 
+#if GREENTEA_CLIENT_PARSER
 /**
  * Handshake with the host and send setup data (timeout and host test name). Allows you to preserve the sync UUID.
  *
@@ -96,11 +218,17 @@ extern const char *GREENTEA_TEST_ENV_LCOV_START;
  * @param size Size of the buffer
  */
 void GREENTEA_SETUP_UUID(const int timeout, const char *host_test_name, char *buffer, size_t size);
+#endif // GREENTEA_CLIENT_PARSER
 
 /**
  * Notify the host side that test suite execution was complete.
  *
- * @details This sends an __exit message.
+ * @details This sends an __exit message. If test cases were registered or reported since
+ *          GREENTEA_SETUP(), it is preceded by {{__testcase_summary;passed;failed}} with the
+ *          number of test cases which passed and failed, as utest sends it, and, if
+ *          greentea_time_us() is implemented, by {{__testcase_durations;us,us,...}} with the
+ *          duration of the first GREENTEA_SUMMARY_MAX_CASES test cases in the order they
+ *          finished, so the host does not need to collect the results case by case.
  *
  * @note If __exit is not received by the host side it will assume TIMEOUT.
  *
@@ -119,15 +247,81 @@ void GREENTEA_TESTSUITE_RESULT(const int result);
  */
 void GREENTEA_TESTCASE_START(const char *test_case_name);
 
+#if GREENTEA_CLIENT_EXTENDED
+/**
+ * Notify the host side that a test case started, which must finish within a time limit.
+ *
+ * @details Sends {{__testcase_timeout;timeout_ms}} after the __testcase_start message. A host
+ *          which supports it aborts the suite if the test case does not finish in time,
+ *          instead of waiting for the timeout of the whole suite.
+ *
+ * @param test_case_name Test case name
+ * @param timeout_ms Time the test case has to finish, in milliseconds
+ */
+void GREENTEA_TESTCASE_START(const char *test_case_name, uint32_t timeout_ms);
+#endif // GREENTEA_CLIENT_EXTENDED
+
 /**
  * Notify the host side that a test case finished.
  *
+ * @details The test case counts as failed in the summary sent by GREENTEA_TESTSUITE_RESULT()
+ *          if failures is not 0.
+ *
  * @param test_case_name Test case name
  * @param passes Number of test passes
  * @param failures Number of test failures
  */
 void GREENTEA_TESTCASE_FINISH(const char *test_case_name, const size_t passes, const size_t failures);
 
+/**
+ * Notify the host side of the test cases the suite is going to run.
+ *
+ * @details Sends __testcase_name for each test case, then __testcase_count.
+ *
+ * @param names Names of the test cases, in order
+ * @param count Number of test cases
+ */
+void GREENTEA_TESTCASE_NAMES(const char *const names[], size_t count);
+
+#if GREENTEA_CLIENT_PARSER && GREENTEA_CLIENT_EXTENDED
+/**
+ * Receive the share of the test cases this DUT runs from the host, so that a suite can
+ * be split across several identical DUTs.
+ *
+ * @details Call after GREENTEA_SETUP(). Sends the name of each test case with
+ *          __testcase_name, then __shard_request with the number of test cases, and waits
+ *          for the host to answer with one of:
+ *          - {{__shard;index/count}}: the test cases whose position modulo count is index,
+ *            "0/1" for all of them,
+ *          - {{__shard_cases;name,name,...}}: the test cases named, or at the position
+ *            given by "#index", at most GREENTEA_SHARD_MAX_CASES. The list is matched as it
+ *            arrives and may be of any length, but names containing ',' can not be selected.
+ *          __testcase_count is then sent with the number of test cases assigned. The suite
+ *          runs only the cases for which greentea_testcase_assigned() is true and reports
+ *          them with the usual __testcase_start and __testcase_finish messages, so the
+ *          results of all DUTs can be merged.
+ *
+ * @note Only a host which advertised "shard" in its capabilities is asked for a share.
+ *       With other hosts, such as mbedhtrun, all test cases are announced as with
+ *       GREENTEA_TESTCASE_NAMES() and assigned to this DUT.
+ *
+ * @param names Names of all test cases of the suite, in order
+ * @param count Number of test cases
+ *
+ * @return Number of test cases assigned to this DUT
+ */
+size_t GREENTEA_TESTCASE_SHARD(const char *const names[], size_t count);
+
+/**
+ * Check if a test case was assigned to this DUT by GREENTEA_TESTCASE_SHARD().
+ *
+ * @param index Position of the test case in the names passed to GREENTEA_TESTCASE_SHARD()
+ *
+ * @return true if the test case is to be run, true for all without GREENTEA_TESTCASE_SHARD()
+ */
+bool greentea_testcase_assigned(size_t index);
+#endif // GREENTEA_CLIENT_PARSER && GREENTEA_CLIENT_EXTENDED
+
 /**
  *  Test suite result related notification API
  */
@@ -140,6 +334,48 @@ void GREENTEA_TESTCASE_FINISH(const char *test_case_name, const size_t passes, c
  */
 void greentea_send_kv(const char *key, const int value);
 
+#if GREENTEA_CLIENT_FORMAT
+/**
+ * Encapsulate and send a key-value message from the DUT (device under test) to the host
+ *
+ * @details The value is written with the shortest digits that read back to the same
+ *          double, in decimal or scientific notation ("0.1", "250.0", "1.5e-07"),
+ *          without relying on floating point support in the libc printf. The host can
+ *          parse it exactly with Python's float() or strtod().
+ *
+ * @param key Message key (message/event name)
+ * @param value Message payload, floating point value
+ */
+void greentea_send_kv(const char *key, const double value);
+
+/**
+ * Encapsulate and send a key-value message from the DUT (device under test) to the host
+ *
+ * @details As greentea_send_kv(const char *, const double) but with the shortest digits
+ *          that read back to the same float, e.g. 0.1f is sent as "0.1".
+ *
+ * @param key Message key (message/event name)
+ * @param value Message payload, floating point value
+ */
+void greentea_send_kv(const char *key, const float value);
+#endif // GREENTEA_CLIENT_FORMAT
+
+/**
+ * Encapsulate and send a key-value message with an integer payload of another type than int
+ *
+ * @details Sends integers of any width (long, size_t, uint64_t, ...) in full, and keeps such
+ *          calls from being ambiguous between the int and floating point overloads.
+ *
+ * @param key Message key (message/event name)
+ * @param value Message payload, integer value
+ */
+template <typename T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, int>::value &&
+                                              !std::is_same<T, char>::value && !std::is_same<T, bool>::value, int>::type = 0>
+void greentea_send_kv(const char *key, const T value)
+{
+    greentea::send(key, value);
+}
+
 /**
  * Encapsulate and send a key-value-value message from the DUT (device under test) to the host
  *
@@ -234,6 +470,115 @@ extern "C" {
  */
 void GREENTEA_SETUP(const int timeout, const char *host_test);
 
+#if GREENTEA_CLIENT_PARSER
+/**
+ * Handshake with the host and send setup data, giving up if the host does not answer.
+ *
+ * @details Works like GREENTEA_SETUP() but waits for the __sync message for at most
+ *          sync_timeout_ms milliseconds, see greentea_parse_kv_timeout(), so the DUT can
+ *          retry, log or power down instead of waiting for ever.
+ *
+ * @param timeout Maximum number of seconds allowed from the start to the end of the tests
+ * @param host_test Name of the host test
+ * @param sync_timeout_ms Maximum time to wait for the host in milliseconds
+ *
+ * @return 0 on success, -1 if the host did not sync in time or the stream ended
+ */
+int GREENTEA_SETUP_TIMEOUT(const int timeout, const char *host_test, uint32_t sync_timeout_ms);
+#endif // GREENTEA_CLIENT_PARSER
+
+#if GREENTEA_CLIENT_EXTENDED
+/**
+ * Start a heartbeat, so the host notices within a few periods that the DUT stopped
+ * running, rather than at the end of the suite timeout.
+ *
+ * @details Sends {{__heartbeat;interval_ms}} now and on each period of the timer started
+ *          with greentea_periodic_timer(), until GREENTEA_TESTSUITE_RESULT(). A heartbeat
+ *          falling due while another key-value message is being written is skipped. The
+ *          host may abort the suite if no output arrives for a few periods.
+ *
+ * @param interval_ms Period of the heartbeat in milliseconds
+ *
+ * @return 0 on success, -1 if the I/O does not support timers, in which case no
+ *         heartbeat is sent
+ */
+int GREENTEA_HEARTBEAT(uint32_t interval_ms);
+
+/**
+ * Send a heartbeat now, if GREENTEA_HEARTBEAT() started one.
+ *
+ * @details This is the callback of the timer, it can also be called directly, e.g. from
+ *          an existing periodic task.
+ */
+void greentea_heartbeat(void);
+#endif // GREENTEA_CLIENT_EXTENDED
+
+#if GREENTEA_CLIENT_PARSER && GREENTEA_CLIENT_EXTENDED
+/**
+ * Measure the offset, drift and round-trip time between the clock of greentea_time_us()
+ * and the clock of the host, so the host can place device timestamps on its own timeline.
+ *
+ * @details Call right after GREENTEA_SETUP(), and again during the run to measure the drift.
+ *          Each of GREENTEA_CLOCK_SYNC_ROUNDS exchanges, NTP-style:
+ *          - the DUT sends {{__clock_ping;seq;t1}} with its time t1,
+ *          - the host answers {{__clock_pong;seq,t2,t3}} with its times of reception t2 and
+ *            transmission t3,
+ *          - the DUT receives the answer at t4.
+ *          The exchange with the shortest round trip (t4 - t1) - (t3 - t2) gives the offset
+ *          ((t2 - t1) + (t3 - t4)) / 2 of the host clock from the device clock, which is sent
+ *          with {{__clock_sync;device_us;offset_us;rtt_us;drift_ppb}}. device_us is the device
+ *          time of the measurement, halfway through the exchange, and drift_ppb the change of
+ *          the offset since the first measurement after GREENTEA_SETUP(), in parts per
+ *          billion of the device time elapsed, 0 for the first one. A device timestamp d is
+ *          then host time d + offset_us + (d - device_us) * drift_ppb / 10^9.
+ *
+ * @note This requires a host which supports clock synchronization, other hosts do not
+ *       answer and the function gives up after GREENTEA_CLOCK_SYNC_TIMEOUT_MS.
+ *
+ * @return 0 on success, -1 if greentea_time_us() has no clock or the host did not answer
+ */
+int GREENTEA_CLOCK_SYNC(void);
+
+/**
+ * Link characteristics measured by the host, see GREENTEA_LINK_BENCH().
+ */
+struct greentea_link_bench_result {
+    uint32_t rtt_p50_us;            /**< Median round-trip time of a ping */
+    uint32_t rtt_p90_us;            /**< 90th percentile of the round-trip time */
+    uint32_t rtt_p99_us;            /**< 99th percentile of the round-trip time */
+    uint32_t rtt_max_us;            /**< Longest round-trip time */
+    uint32_t to_host_bytes_per_s;   /**< Sustained payload throughput from the DUT to the host */
+    uint32_t to_device_bytes_per_s; /**< Sustained payload throughput from the host to the DUT */
+};
+
+/**
+ * Let the host measure the latency and throughput of the link through the I/O of test_io.h,
+ * to tell a slow link from slow firmware.
+ *
+ * @details Sends {{__link_bench_request;GREENTEA_LINK_BENCH_CHUNK_SIZE}} and serves the
+ *          benchmark the host drives, if configured to, until it is done:
+ *          - {{__link_bench_ping;seq}} is echoed as {{__link_bench_pong;seq}}, for the
+ *            percentiles of the round-trip time,
+ *          - the payload of {{__link_bench_data;...}} messages is counted, and reported with
+ *            {{__link_bench_ack;bytes}} when the host sends {{__link_bench_ack;0}},
+ *          - {{__link_bench_send;bytes}} is answered with bytes of payload in
+ *            {{__link_bench_data;...}} messages of GREENTEA_LINK_BENCH_CHUNK_SIZE bytes, then
+ *            {{__link_bench_ack;bytes}},
+ *          - {{__link_bench_done;p50,p90,p99,max,to_host,to_device}} ends the benchmark with
+ *            the results, which are sent back as {{__link_bench_result;...}} so they are part
+ *            of the captured output, or {{__link_bench_done;skip}} if the host does not run it.
+ *          Neither side needs a clock on the DUT, all times are measured by the host.
+ *
+ * @note Call between GREENTEA_SETUP() and the first test case.
+ *
+ * @param result Destination of the results, may be NULL
+ *
+ * @return 0 on success, -1 if the host skipped the benchmark or did not answer within
+ *         GREENTEA_LINK_BENCH_TIMEOUT_MS
+ */
+int GREENTEA_LINK_BENCH(struct greentea_link_bench_result *result);
+#endif // GREENTEA_CLIENT_PARSER && GREENTEA_CLIENT_EXTENDED
+
 /**
  * Encapsulate and send a key-value message from the DUT (device under test) to the host.
  *
@@ -242,6 +587,116 @@ void GREENTEA_SETUP(const int timeout, const char *host_test);
  */
 void greentea_send_kv(const char *key, const char *val);
 
+/**
+ * Encapsulate and send a key-value message with a key and value of known length.
+ *
+ * @details Neither the key nor the value need to be NUL-terminated, so they can be
+ *          sent straight from network or DMA buffers. Both are written in place,
+ *          without copies.
+ *
+ * @note The key and value must not contain the protocol characters ";{}".
+ *
+ * @param key Message key (message/event name)
+ * @param key_len Length of the key
+ * @param val Message payload
+ * @param val_len Length of the payload
+ */
+void greentea_send_kv_n(const char *key, size_t key_len, const char *val, size_t val_len);
+
+#if GREENTEA_CLIENT_FORMAT
+/**
+ * Encapsulate and send a key-value message with a printf-style formatted value.
+ *
+ * @details The value is formatted by a small built-in formatter straight into the
+ *          outgoing message, without an intermediate buffer, heap or libc printf.
+ *          Supported are the flags '-' and '0', width and precision (including '*'),
+ *          the length modifiers hh, h, l, ll and z and the conversions
+ *          %d %i %u %x %X %c %s %% and %f. The precision of an integer is its minimum
+ *          number of digits. %f is printed in fixed-point with the requested precision
+ *          (default 6, at most 9 digits) and rounded as printf does, except that a value
+ *          of 2^64 / 10^precision or more is printed as "ovf".
+ *
+ * @param key Message key (message/event name)
+ * @param format printf-style format of the message payload
+ */
+void greentea_send_kvf(const char *key, const char *format, ...)
+#if defined(__GNUC__)
+__attribute__((format(printf, 2, 3)))
+#endif
+;
+
+/**
+ * Encapsulate and send a key-value message with a formatted value, see greentea_send_kvf().
+ *
+ * @param key Message key (message/event name)
+ * @param format printf-style format of the message payload
+ * @param args Arguments for the format
+ */
+void greentea_vsend_kvf(const char *key, const char *format, va_list args);
+#endif // GREENTEA_CLIENT_FORMAT
+
+/**
+ *  Size of the buffer used by greentea_send_kv_stream() to pull value chunks from a producer
+ */
+#ifndef GREENTEA_STREAM_CHUNK_SIZE
+#define GREENTEA_STREAM_CHUNK_SIZE  32
+#endif
+
+/**
+ * Producer of a streamed key-value message value.
+ *
+ * @param buffer Buffer to fill with the next chunk of the value
+ * @param size Size of the buffer in bytes
+ * @param context User context passed to greentea_send_kv_stream()
+ *
+ * @return Number of bytes written to the buffer, 0 once the value is complete
+ */
+typedef size_t (*greentea_value_producer)(char *buffer, size_t size, void *context);
+
+/**
+ * Encapsulate and send a key-value message whose value is pulled in chunks from a producer.
+ *
+ * @details The preamble and key are written first, then the producer is called repeatedly
+ *          to fill a buffer of GREENTEA_STREAM_CHUNK_SIZE bytes which is written to the
+ *          stream, until it returns 0. The message is then closed. The value never needs to
+ *          be held in memory as a whole, but all chunks end up in a single {{key;value}} message.
+ *
+ * @note As with greentea_send_kv(), the value must not contain NUL or the protocol
+ *       characters ";{}".
+ *
+ * @param key Message key (message/event name)
+ * @param producer Callback providing the value chunks
+ * @param context User context passed to each producer call
+ */
+void greentea_send_kv_stream(const char *key, greentea_value_producer producer, void *context);
+
+/**
+ * Output flush policy, see greentea_set_flush_policy().
+ */
+enum greentea_flush_policy {
+    GREENTEA_FLUSH_FRAME,   /**< Flush after every key-value message (default) */
+    GREENTEA_FLUSH_BATCH,   /**< Flush after every threshold messages, 0 for never */
+    GREENTEA_FLUSH_BYTES,   /**< Flush once at least threshold bytes are pending */
+    GREENTEA_FLUSH_TIME     /**< Flush at the end of a message once the oldest pending one is threshold milliseconds old */
+};
+
+/**
+ * Select when buffered output is pushed to the host with greentea_flush().
+ *
+ * @details The policy is evaluated at the end of each key-value message, so a flush never
+ *          splits a message. Regardless of the policy, output is also flushed before
+ *          waiting for input from the host, with each heartbeat and at the end of the test
+ *          suite. Pending output is flushed when the policy changes. GREENTEA_FLUSH_TIME
+ *          requires greentea_time_us() to be implemented. As nothing else checks the age
+ *          of pending messages, the last of a burst waits for the next message, read or
+ *          heartbeat, so GREENTEA_HEARTBEAT() bounds how long it is held.
+ *
+ * @param policy Flush policy
+ * @param threshold Number of messages, bytes or milliseconds, depending on the policy
+ */
+void greentea_set_flush_policy(enum greentea_flush_policy policy, uint32_t threshold);
+
+#if GREENTEA_CLIENT_PARSER
 /**
  * Parse input strings for key-value pairs: {{key;value}}
  *       This function should replace scanf() used to
@@ -261,6 +716,221 @@ void greentea_send_kv(const char *key, const char *val);
 int greentea_parse_kv(char *key, char *val,
                       const int key_len, const int val_len);
 
+/**
+ * Parse input strings for key-value pairs: {{key;value}}, waiting at most a given time.
+ *
+ * @details Works like greentea_parse_kv() but gives up after timeout_ms milliseconds,
+ *          waiting for input with greentea_wait_rx() so the CPU can sleep meanwhile.
+ *          The time limit applies to the whole message if greentea_time_us() is implemented,
+ *          otherwise to each wait for input. A message partially received when the time
+ *          is up is discarded. With a timeout of 0, only input already available is parsed.
+ *
+ * @note If the I/O does not implement greentea_wait_rx(), this blocks like greentea_parse_kv().
+ *
+ * @param out_key Ouput data with key
+ * @param out_value Ouput data with value
+ * @param out_key_size out_key total size
+ * @param out_value_size out_value total data
+ * @param timeout_ms Maximum time to wait in milliseconds
+ *
+ * @return 1 if key-value pair was found,
+ *         0 if end of the stream was found,
+ *         -1 on timeout
+ */
+int greentea_parse_kv_timeout(char *out_key, char *out_value,
+                              const int out_key_size, const int out_value_size,
+                              uint32_t timeout_ms);
+
+/**
+ * Parse input strings for key-value pairs: {{key;value}}, reporting their lengths.
+ *
+ * @details Works like greentea_parse_kv() except that the key and value are not
+ *          NUL-terminated, so the whole buffers are available for them. The lengths
+ *          reported are those of the received key and value; a length larger than the
+ *          buffer size means the data was truncated to the buffer size.
+ *
+ * @note This function blocks until the full key-value message is received.
+ *
+ * @param out_key Output data with key
+ * @param out_key_size out_key total size
+ * @param out_key_len If not NULL, receives the length of the key
+ * @param out_value Output data with value
+ * @param out_value_size out_value total size
+ * @param out_value_len If not NULL, receives the length of the value
+ *
+ * @return !0 if key-value pair was found,
+ *         0 if end of the stream was found
+ */
+int greentea_parse_kv_n(char *out_key, size_t out_key_size, size_t *out_key_len,
+                        char *out_value, size_t out_value_size, size_t *out_value_len);
+
+/**
+ * Consumer of a streamed key-value message value.
+ *
+ * @details Called with consecutive chunks of the value as they are received. If the message
+ *          turns out to be malformed after part of its value was delivered, the sink is called
+ *          once with NULL data and size 0 and must discard what it has received so far.
+ *
+ * @param data Next chunk of the value, NULL to discard the value received so far
+ * @param size Size of the chunk in bytes
+ * @param context User context passed to greentea_parse_kv_stream()
+ */
+typedef void (*greentea_value_sink)(const char *data, size_t size, void *context);
+
+/**
+ * Parse input strings for key-value pairs: {{key;value}}, delivering the value to a sink.
+ *
+ * @details Works like greentea_parse_kv() except that the value is not stored in a buffer
+ *          but handed to the sink in chunks of up to GREENTEA_STREAM_CHUNK_SIZE bytes as it
+ *          arrives, so values of any length can be received without being truncated.
+ *
+ * @note This function blocks until the full key-value message is received.
+ *
+ * @param out_key Output data with key
+ * @param out_key_size out_key total size
+ * @param sink Callback receiving the value chunks
+ * @param context User context passed to each sink call
+ * @param out_crc If not NULL, receives the CRC-32 (IEEE 802.3) of the value
+ *
+ * @return !0 if key-value pair was found,
+ *         0 if end of the stream was found
+ */
+int greentea_parse_kv_stream(char *out_key, const int out_key_size,
+                             greentea_value_sink sink, void *context,
+                             uint32_t *out_crc);
+
+/**
+ * Caller-provided memory receiving a streamed value, see greentea_value_arena_sink().
+ */
+struct greentea_value_arena {
+    char *buffer;   /**< Destination of the value, not NUL-terminated */
+    size_t size;    /**< Size of buffer in bytes */
+    size_t length;  /**< Length of the value received, larger than size if it did not fit */
+};
+
+/**
+ * Value sink storing chunks into a struct greentea_value_arena passed as context.
+ *
+ * @details Bytes which do not fit the arena are dropped but still counted in its length,
+ *          so the caller can detect a value that was too large. Reset length to 0 before use.
+ */
+void greentea_value_arena_sink(const char *data, size_t size, void *context);
+
+/**
+ * Destination of a token of a key-value message, see struct greentea_kv_parser.
+ *
+ * @details Without a sink the token is stored in str and truncated to size - 1 characters
+ *          followed by a NUL terminator, or to size characters if it is not terminated.
+ *          With a sink, str is a chunk buffer which is handed to the sink each time it
+ *          fills up and once more at the end of the token, so tokens of any length can be
+ *          received. The fields are managed by the parser.
+ */
+struct greentea_kv_token {
+    char *str;
+    int size;
+    int idx;
+    greentea_value_sink sink;
+    void *context;
+    size_t length;      /**< Length of the token received, which may exceed size */
+    uint32_t crc;       /**< Running CRC-32 of the token, with a sink only */
+    int terminated;     /**< Non-zero to NUL-terminate the token */
+};
+
+/**
+ * Flags of a struct greentea_kv_parser.
+ */
+enum greentea_kv_parser_flags {
+    /**
+     * The value extends to the closing "}}" and may contain ';' and any other character
+     * except '{', '}' and line breaks, as in messages with several values sent by the
+     * device. Without it, the value is limited to the characters of the key-value grammar.
+     */
+    GREENTEA_KV_MULTI_VALUE = 1
+};
+
+/**
+ * Reentrant push-style key-value message parser.
+ *
+ * @details Characters are pushed one at a time as they arrive, so any number of streams
+ *          can be parsed concurrently, e.g. from an event loop. greentea_parse_kv() and
+ *          friends are built on it.
+ */
+struct greentea_kv_parser {
+    int state;
+    int flags;
+    struct greentea_kv_token key;
+    struct greentea_kv_token value;
+};
+
+/**
+ * Result of greentea_kv_parser_push().
+ */
+enum greentea_kv_parser_result {
+    GREENTEA_KV_INCOMPLETE = 0, /**< More characters are needed */
+    GREENTEA_KV_MESSAGE = 1     /**< A complete message is in the key and value buffers */
+};
+
+/**
+ * Set up a parser storing keys and values NUL-terminated into buffers.
+ *
+ * @param parser Parser to initialise
+ * @param key Buffer receiving the key of each message
+ * @param key_size Size of the key buffer
+ * @param value Buffer receiving the value of each message
+ * @param value_size Size of the value buffer
+ * @param flags Combination of greentea_kv_parser_flags
+ */
+void greentea_kv_parser_init(struct greentea_kv_parser *parser,
+                             char *key, size_t key_size,
+                             char *value, size_t value_size,
+                             int flags);
+
+/**
+ * Push the next character of a stream to a parser.
+ *
+ * @details When GREENTEA_KV_MESSAGE is returned, the key and value buffers hold the message,
+ *          with the full lengths in parser->key.length and parser->value.length, until the
+ *          next character is pushed. Whitespace after a message, such as its line ending,
+ *          is skipped.
+ *
+ * @param parser Parser
+ * @param c Next character
+ *
+ * @return GREENTEA_KV_MESSAGE if the character completed a message, otherwise GREENTEA_KV_INCOMPLETE
+ */
+enum greentea_kv_parser_result greentea_kv_parser_push(struct greentea_kv_parser *parser, int c);
+
+/**
+ * Push characters to a parser until a message is complete or the data is used up.
+ *
+ * @param parser Parser
+ * @param data Characters to push
+ * @param size Number of characters
+ * @param consumed Receives the number of characters pushed
+ *
+ * @return GREENTEA_KV_MESSAGE if a message was completed by the last character pushed,
+ *         otherwise GREENTEA_KV_INCOMPLETE
+ */
+enum greentea_kv_parser_result greentea_kv_parser_feed(struct greentea_kv_parser *parser,
+                                                       const char *data, size_t size,
+                                                       size_t *consumed);
+
+/**
+ * Read the next character with greentea_getc() and push it to a parser.
+ *
+ * @details Works like the reading done by greentea_parse_kv(), for a parser fed from the
+ *          stream of the test suite: messages held back by the flush policy are flushed
+ *          before reading, the character is recorded to the trace in progress, and replay
+ *          requests of the journal are served without being reported as messages.
+ *
+ * @param parser Parser
+ *
+ * @return GREENTEA_KV_MESSAGE if the character completed a message, GREENTEA_KV_INCOMPLETE
+ *         if not, or EOF at the end of the stream
+ */
+int greentea_kv_parser_read(struct greentea_kv_parser *parser);
+#endif // GREENTEA_CLIENT_PARSER
+
 #ifdef __cplusplus
 }
 #endif
@@ -18,6 +18,9 @@
 #ifndef GREENTEA_CLIENT_TEST_IO_H_
 #define GREENTEA_CLIENT_TEST_IO_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -47,6 +50,127 @@ void greentea_putc(int c);
  */
 void greentea_write_string(const char *str);
 
+/**
+ *  Optional Greentea-client IO
+ *
+ *  The functions below have default implementations which an application
+ *  or an I/O backend can replace by defining its own.
+ */
+
+/**
+ * Write a number of characters to stream of data.
+ *
+ * @details The data does not need to be NUL-terminated and may come straight from a
+ *          network or DMA buffer. The default copies it in small NUL-terminated chunks
+ *          to greentea_write_string(), and writes NUL bytes of the data with greentea_putc().
+ *
+ * @param str Characters to write
+ * @param len Number of characters
+ */
+void greentea_write_n(const char *str, size_t len);
+
+/**
+ * Piece of data in a gather list, see greentea_writev().
+ */
+struct greentea_iovec {
+    const void *iov_base;   /**< Start of the data */
+    size_t iov_len;         /**< Size of the data in bytes */
+};
+
+/**
+ * Write a gather list to stream of data.
+ *
+ * @details All key-value messages are written through this function. Messages sent with
+ *          greentea_send_kv() and greentea::send() are passed as a single list made of
+ *          the constant framing ("{{", ";", "}}\r\n") in static storage, and the key and
+ *          values in place, so a backend with DMA or writev() support can send a message
+ *          without copying it. The data must be written in order before returning.
+ *          The default writes each piece with greentea_write_n().
+ *
+ * @param iov Gather list
+ * @param count Number of entries in the gather list
+ */
+void greentea_writev(const struct greentea_iovec *iov, size_t count);
+
+/**
+ * Push buffered output to the host.
+ *
+ * @details Called by greentea-client only right after a complete key-value message,
+ *          as decided by the flush policy (see greentea_set_flush_policy()), before
+ *          waiting for input and at the end of the test suite. The default does nothing,
+ *          which suits unbuffered transports.
+ */
+void greentea_flush(void);
+
+/**
+ * Read a monotonic clock.
+ *
+ * @details Used for time based policies and measurements. The default returns 0,
+ *          which disables anything time based.
+ *
+ * @return Time in microseconds since an arbitrary point
+ */
+uint64_t greentea_time_us(void);
+
+/**
+ * Wait until input can be read from stream of data, or a time limit expires.
+ *
+ * @details Used by greentea_parse_kv_timeout() and GREENTEA_SETUP_TIMEOUT() so that the
+ *          CPU can sleep, e.g. in poll() or until a UART interrupt, instead of blocking in
+ *          greentea_getc() for ever. The end of the stream counts as input, so that
+ *          greentea_getc() then reports EOF. The default does not support waiting, in
+ *          which case greentea_getc() is called and blocks as usual.
+ *
+ * @param timeout_ms Time to wait in milliseconds, 0 to only check
+ *
+ * @return 1 if greentea_getc() will not block, 0 on timeout, -1 if waiting is not supported
+ */
+int greentea_wait_rx(uint32_t timeout_ms);
+
+/**
+ * Callback of a periodic timer, see greentea_periodic_timer().
+ */
+typedef void (*greentea_timer_callback)(void);
+
+/**
+ * Start or stop calling a function periodically, from a timer interrupt or thread.
+ *
+ * @details Drives the heartbeat started with GREENTEA_HEARTBEAT(). The callback writes a
+ *          short key-value message with greentea_writev() and calls greentea_flush(), so
+ *          these must be safe to call from the context of the timer. The default does not
+ *          support timers.
+ *
+ * @param interval_ms Period in milliseconds, 0 to stop the timer
+ * @param callback Function to call on each period
+ *
+ * @return 0 on success, -1 if timers are not supported
+ */
+int greentea_periodic_timer(uint32_t interval_ms, greentea_timer_callback callback);
+
+/**
+ * Get the highest line rate the transport can switch to, e.g. the fastest baud rate of a UART.
+ *
+ * @details Advertised to the host in the capability exchange of GREENTEA_SETUP(). The
+ *          default returns 0, which keeps the line rate unchanged.
+ *
+ * @return Line rate in bits per second, 0 if it can not be changed
+ */
+uint32_t greentea_max_line_rate(void);
+
+/**
+ * Switch the transport to another line rate.
+ *
+ * @details Called by GREENTEA_SETUP() with the rate agreed with the host, at most
+ *          greentea_max_line_rate(), once the output at the current rate is flushed.
+ *          The host switches when it receives the agreed rate and confirms with
+ *          {{__line_rate;<rate>}} at the new rate. The default does not support it.
+ *
+ * @param bits_per_s Line rate in bits per second
+ *
+ * @return 0 on success, -1 if the line rate can not be changed
+ */
+int greentea_set_line_rate(uint32_t bits_per_s);
+
 #ifdef __cplusplus
 }
 #endif
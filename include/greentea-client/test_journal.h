@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GREENTEA_CLIENT_TEST_JOURNAL_H_
+#define GREENTEA_CLIENT_TEST_JOURNAL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "greentea-client/greentea_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if GREENTEA_CLIENT_JOURNAL
+/**
+ *  Journal of the result messages, replayed to a host which lost some of them
+ *
+ *  While a journal runs, each message carrying results, that is __testcase_start,
+ *  __testcase_finish and the other __testcase_ messages, end and the messages with the
+ *  suite's own keys, is appended to a store. To a host which advertised "journal" in its
+ *  capabilities, see GREENTEA_SETUP(), the message is preceded by {{__seq;<n>}}, numbering
+ *  the journaled messages from 1, so the host can tell which ones it missed and drop
+ *  duplicates:
+ *
+ *    {{__replay;<n>}}          host: send the messages from number n again
+ *    {{__journal_end;<n>}}     DUT: n messages were journaled, sent by GREENTEA_TESTSUITE_RESULT()
+ *                              before __exit
+ *    {{__journal_done;0}}      host: nothing more to replay
+ *
+ *  Replay requests are served by greentea_parse_kv(), greentea_parse_kv_timeout(),
+ *  greentea_parse_kv_n() and greentea_kv_parser_read() while the suite waits for its own
+ *  messages, and by GREENTEA_TESTSUITE_RESULT(), which waits up to GREENTEA_JOURNAL_TIMEOUT_MS
+ *  for __journal_done. The oldest messages are dropped once the store is full, as is a
+ *  message larger than the store.
+ */
+extern const char GREENTEA_TEST_ENV_SEQ[];
+extern const char GREENTEA_TEST_ENV_REPLAY[];
+extern const char GREENTEA_TEST_ENV_JOURNAL_END[];
+extern const char GREENTEA_TEST_ENV_JOURNAL_DONE[];
+
+/**
+ * Time GREENTEA_TESTSUITE_RESULT() waits for the host to collect lost messages, in milliseconds
+ */
+#ifndef GREENTEA_JOURNAL_TIMEOUT_MS
+#define GREENTEA_JOURNAL_TIMEOUT_MS 1000
+#endif
+
+/**
+ * Memory holding the journal, e.g. external RAM or FRAM which is larger than the internal RAM.
+ *
+ * @details The journal is written and read at offsets from 0 to size - 1, a write or read
+ *          never crosses the end. Where the entries are is kept in RAM, so a store does not
+ *          carry the journal over a reset of the DUT.
+ */
+struct greentea_journal_store {
+    size_t size;    /**< Size of the store in bytes, at most 65535 are used per message */
+    void (*write)(size_t offset, const void *data, size_t size, void *context);
+    void (*read)(size_t offset, void *data, size_t size, void *context);
+    void *context;  /**< User context passed to write and read */
+};
+
+/**
+ * Start a journal in a buffer in RAM. A journal already running is stopped first.
+ *
+ * @param buffer Memory holding the journal, until greentea_journal_stop()
+ * @param size Size of the buffer in bytes
+ */
+void greentea_journal_start(void *buffer, size_t size);
+
+/**
+ * Start a journal in a store of the application. A journal already running is stopped first.
+ *
+ * @param store Functions accessing the store, copied by the call
+ */
+void greentea_journal_start_store(const struct greentea_journal_store *store);
+
+/**
+ * Stop journaling and drop the journal.
+ */
+void greentea_journal_stop(void);
+#endif // GREENTEA_CLIENT_JOURNAL
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // GREENTEA_CLIENT_TEST_JOURNAL_H_
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GREENTEA_CLIENT_TEST_LOG_H_
+#define GREENTEA_CLIENT_TEST_LOG_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "greentea-client/greentea_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ *  Deferred logging
+ *
+ *  GREENTEA_LOG() takes a printf-style format string and arguments, but leaves the
+ *  formatting to the host: the format string is placed in the greentea_log_table section
+ *  of the image and only its offset in the section and the raw arguments are stored in a
+ *  buffer in RAM, which takes microseconds rather than the milliseconds of printing a line.
+ *  greentea_log_drain() later sends the buffered records as __log messages, and the host
+ *  rebuilds the text with the content of the section, e.g. extracted after the build with
+ *  the greentea_log_strings() CMake function.
+ *
+ *  Example usage:
+ *
+ *  GREENTEA_LOG("sent %u bytes to %s in %d us", size, name, elapsed);
+ *
+ *  Record format, all integers are unsigned LEB128 varints:
+ *
+ *  <RECORD>  ::= <LENGTH> <ID> <ARGUMENT>*
+ *
+ *  LENGTH is a single byte, the number of bytes after it. ID is the offset of the format
+ *  string in the greentea_log_table section. The arguments are encoded in the order of the
+ *  conversions of the format string:
+ *  - d and i as zigzag encoded varints, so that small negative values stay short,
+ *  - u, o, x, X, c and p as varints,
+ *  - floating point conversions as the 8 bytes of an IEEE 754 double, least significant first,
+ *  - s as the varint length followed by the characters, which are cut short if the record
+ *    would not fit GREENTEA_LOG_RECORD_SIZE.
+ *  Arguments which do not fit a record are left out. Each __log message holds whole
+ *  records, base64 encoded without padding.
+ */
+
+#if GREENTEA_CLIENT_LOG
+/**
+ * Size of the buffer holding records until they are sent, a power of two
+ */
+#ifndef GREENTEA_LOG_BUFFER_SIZE
+#define GREENTEA_LOG_BUFFER_SIZE    256
+#endif
+
+/**
+ * Maximum size of a record, including its length, at most 256
+ */
+#ifndef GREENTEA_LOG_RECORD_SIZE
+#define GREENTEA_LOG_RECORD_SIZE    64
+#endif
+
+/**
+ * Maximum size of the records sent in one __log message, before base64 encoding
+ */
+#ifndef GREENTEA_LOG_FRAME_SIZE
+#define GREENTEA_LOG_FRAME_SIZE     96
+#endif
+
+/**
+ *  Deferred logging transport protocol keys
+ */
+extern const char GREENTEA_TEST_ENV_LOG[];
+extern const char GREENTEA_TEST_ENV_LOG_DROPPED[];
+
+/**
+ * Log a message to be formatted by the host.
+ *
+ * @details The format string must be a string literal. Records are dropped while the buffer
+ *          is full, see greentea_log_dropped(). Safe to call from interrupts and any thread.
+ *
+ * @param format printf-style format string, without %n
+ */
+#define GREENTEA_LOG(format, ...)                                                               \
+    do {                                                                                        \
+        static const char greentea_log_format[]                                                 \
+            __attribute__((section("greentea_log_table"), used)) = format;                      \
+        if (0) {                                                                                \
+            greentea_log_check_format(format, ##__VA_ARGS__);                                   \
+        }                                                                                       \
+        greentea_log(greentea_log_format, ##__VA_ARGS__);                                       \
+    } while (0)
+
+/**
+ * Store a record to the log buffer, see GREENTEA_LOG().
+ *
+ * @param format Format string in the greentea_log_table section
+ */
+void greentea_log(const char *format, ...);
+
+/**
+ * Send the records in the log buffer to the host as __log messages.
+ *
+ * @details Safe to call from a timer, an idle thread or between test cases. If a key-value
+ *          message is being written or another drain runs, it returns without sending and
+ *          the records are sent by a later call. The buffer is also drained by
+ *          GREENTEA_TESTSUITE_RESULT(). If records were dropped since the last drain,
+ *          {{__log_dropped;count}} is sent with the total number of records dropped.
+ */
+void greentea_log_drain(void);
+
+/**
+ * Get the number of records dropped because the log buffer was full.
+ */
+uint32_t greentea_log_dropped(void);
+
+/**
+ * Get the content of the greentea_log_table section of this image, which is the table of
+ * format strings the host needs to decode the records, e.g. for a host running in the same
+ * image.
+ *
+ * @param size Receives the size of the section in bytes
+ *
+ * @return Start of the section, NULL if GREENTEA_LOG() is not used
+ */
+const char *greentea_log_strings(size_t *size);
+
+/**
+ * Let the compiler check the arguments of GREENTEA_LOG() against its format string.
+ */
+static inline void greentea_log_check_format(const char *format, ...) __attribute__((format(printf, 1, 2)));
+static inline void greentea_log_check_format(const char *format, ...)
+{
+    (void)format;
+}
+#else
+#define GREENTEA_LOG(format, ...) do { } while (0)
+#endif // GREENTEA_CLIENT_LOG
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // GREENTEA_CLIENT_TEST_LOG_H_
@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GREENTEA_CLIENT_TEST_RUNNER_H_
+#define GREENTEA_CLIENT_TEST_RUNNER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "greentea-client/greentea_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ *  Test case runner
+ *
+ *  Runs the test cases of a suite in order, each between __testcase_start and
+ *  __testcase_finish, and ends the suite with GREENTEA_TESTSUITE_RESULT(), which sends the
+ *  summary and durations. The test cases are either a constant table:
+ *
+ *  static const struct greentea_case cases[] = {
+ *      { "init", test_init, 0, 0 },
+ *      { "write", test_write, 500, 0 },
+ *  };
+ *  greentea_run_cases(cases, 2);
+ *
+ *  or registered where they are defined, on ELF toolchains:
+ *
+ *  GREENTEA_CASE(init)
+ *  {
+ *      GREENTEA_CHECK(init() == 0);
+ *  }
+ *  greentea_run_registered_cases();
+ *
+ *  Neither needs the heap nor static constructors: a table is constant data, and the
+ *  registered test cases are collected by the linker in the greentea_case_table section.
+ *
+ *  A host which advertised "shard" in its capabilities, see GREENTEA_SETUP(), chooses which
+ *  test cases run, as with GREENTEA_TESTCASE_SHARD(). It can name them, or give their
+ *  position with "#<index>", e.g. to run again only those which failed. Otherwise all of
+ *  them run.
+ *
+ *  In native builds with GREENTEA_CLIENT_PARALLEL, consecutive test cases flagged
+ *  GREENTEA_CASE_PARALLEL_SAFE run at the same time on a pool of threads, started for the
+ *  first of them and kept until the suite ends. Their messages are held and sent in the order
+ *  of the test cases once they are done, so the host sees the same messages as if they ran
+ *  one after the other. A test case with a timeout_ms runs on the thread of the suite even
+ *  if it is flagged, as the host only learns of the limit with __testcase_start. Elsewhere
+ *  they run one after the other.
+ */
+
+/**
+ * The test case may run on another thread at the same time as other such test cases. It
+ * must not wait for the host, nor share state with them.
+ */
+#define GREENTEA_CASE_PARALLEL_SAFE 0x1
+
+/**
+ * Test case of the runner
+ */
+struct greentea_case {
+    const char *name;       /**< Name of the test case, the first member */
+    void (*run)(void);      /**< Body of the test case */
+    uint32_t timeout_ms;    /**< Time the test case has to finish, 0 for no limit */
+    uint32_t flags;         /**< GREENTEA_CASE_ flags */
+};
+
+#if defined(__ELF__)
+/*
+ * The entries of the greentea_case_table section make an array: their alignment is explicit
+ * so that the compiler does not raise it and leave gaps, and no_reorder keeps GCC from
+ * emitting those of a translation unit out of order.
+ */
+#if defined(__has_attribute)
+#if __has_attribute(no_reorder)
+#define GREENTEA_CASE_NO_REORDER , no_reorder
+#endif
+#endif
+#ifndef GREENTEA_CASE_NO_REORDER
+#define GREENTEA_CASE_NO_REORDER
+#endif
+
+/**
+ * Define a test case run by greentea_run_registered_cases(). The body of the test case follows.
+ *
+ * @details Test cases run in the order they are defined within a translation unit, and in
+ *          the order the translation units are linked.
+ *
+ * @param name Name of the test case, an identifier
+ * @param timeout_ms Time the test case has to finish in milliseconds, 0 for no limit
+ * @param flags GREENTEA_CASE_ flags
+ */
+#define GREENTEA_CASE_DEFINE(name, timeout_ms, flags)                                           \
+    static void greentea_case_##name(void);                                                     \
+    static const struct greentea_case greentea_case_entry_##name                                \
+        __attribute__((section("greentea_case_table"), aligned(__alignof__(struct greentea_case)), \
+                       used GREENTEA_CASE_NO_REORDER)) =                                        \
+            { #name, greentea_case_##name, timeout_ms, flags };                                 \
+    static void greentea_case_##name(void)
+
+/**
+ * Define a test case run by greentea_run_registered_cases(), which must finish within a
+ * time limit. The body of the test case follows.
+ *
+ * @param name Name of the test case, an identifier
+ * @param timeout_ms Time the test case has to finish in milliseconds
+ */
+#define GREENTEA_CASE_TIMEOUT(name, timeout_ms) GREENTEA_CASE_DEFINE(name, timeout_ms, 0)
+
+/**
+ * Define a test case run by greentea_run_registered_cases(). The body of the test case follows.
+ *
+ * @param name Name of the test case, an identifier
+ */
+#define GREENTEA_CASE(name) GREENTEA_CASE_DEFINE(name, 0, 0)
+
+/**
+ * Define a test case run by greentea_run_registered_cases() which is parallel safe, see
+ * GREENTEA_CASE_PARALLEL_SAFE. The body of the test case follows.
+ *
+ * @param name Name of the test case, an identifier
+ */
+#define GREENTEA_PARALLEL_CASE(name) GREENTEA_CASE_DEFINE(name, 0, GREENTEA_CASE_PARALLEL_SAFE)
+
+/**
+ * Run the test cases defined with GREENTEA_CASE(), see greentea_run_cases().
+ *
+ * @return Number of test cases which failed
+ */
+size_t greentea_run_registered_cases(void);
+#endif // __ELF__
+
+/**
+ * Run test cases and send the result of the suite.
+ *
+ * @details Call after GREENTEA_SETUP(). Sends the names of the test cases, or lets the
+ *          host choose which ones run, then runs them in order, each reported with
+ *          __testcase_start, and __testcase_timeout if it has a time limit, and
+ *          __testcase_finish with the checks it passed and failed. Ends with
+ *          GREENTEA_TESTSUITE_RESULT(), which passes if no test case failed.
+ *
+ * @note Time limits need GREENTEA_CLIENT_EXTENDED and host selection also
+ *       GREENTEA_CLIENT_PARSER, otherwise they are left out.
+ *
+ * @param cases Test cases
+ * @param count Number of test cases
+ *
+ * @return Number of test cases which failed
+ */
+size_t greentea_run_cases(const struct greentea_case *cases, size_t count);
+
+#if GREENTEA_CLIENT_PARALLEL
+/**
+ * Set the number of threads running parallel safe test cases.
+ *
+ * @param workers Number of threads, 0 for one per hardware thread, which is the default,
+ *                1 to run them one after the other
+ */
+void greentea_set_case_workers(size_t workers);
+#endif // GREENTEA_CLIENT_PARALLEL
+
+/**
+ * Count a check of the running test case, see GREENTEA_CHECK().
+ *
+ * @param passed Non-zero if the check passed
+ */
+void greentea_case_check(int passed);
+
+/**
+ * Check a condition in a test case run by greentea_run_cases(). The test case carries on
+ * and fails if any check failed.
+ */
+#define GREENTEA_CHECK(condition) greentea_case_check((condition) ? 1 : 0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // GREENTEA_CLIENT_TEST_RUNNER_H_
@@ -0,0 +1,294 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GREENTEA_CLIENT_TEST_SEND_H_
+#define GREENTEA_CLIENT_TEST_SEND_H_
+
+#include <stddef.h>
+#include <string.h>
+#include <type_traits>
+#include <utility>
+#include "greentea-client/greentea_config.h"
+#include "greentea-client/test_io.h"
+
+/**
+ *  Type-safe key-value message sending for C++
+ *
+ *  Example usage:
+ *
+ *  greentea::send("sample", channel_name, uint64_t(timestamp), 42);
+ *  // {{sample;adc0;1618329600000;42}}
+ *
+ *  The encoding of each value is selected at compile time from its type:
+ *  - integers of any width and enums are written in decimal,
+ *  - char is written as a single character,
+ *  - float and double are written with the shortest digits that read back to the
+ *    same value, e.g. "0.1", "250.0" or "1.5e-07", if GREENTEA_CLIENT_FORMAT is enabled,
+ *  - C strings and any type with char data() and size() members (std::string,
+ *    std::string_view, std::span<const char>, ...) are written as text, the latter
+ *    without the need for a NUL terminator.
+ *  Other types are rejected at compile time.
+ */
+
+namespace greentea {
+namespace detail {
+
+/**
+ * Constant framing of key-value messages, in static storage so it can be referenced
+ * from a gather list.
+ */
+extern const greentea_iovec preamble;
+extern const greentea_iovec separator;
+extern const greentea_iovec postamble;
+
+/**
+ * Write the gather list of a complete key-value message to the stream.
+ */
+void write_frame(const greentea_iovec *iov, size_t count);
+
+#if GREENTEA_CLIENT_FORMAT
+/**
+ * Format a floating point value with the shortest digits that read back to the same value,
+ * into a buffer of encoded::storage_size bytes.
+ *
+ * @return Number of characters written
+ */
+size_t format_floating(char *buffer, double val);
+size_t format_floating(char *buffer, float val);
+#endif // GREENTEA_CLIENT_FORMAT
+
+/**
+ * A single value encoded as text, either referenced in place or formatted into inline storage.
+ */
+class encoded {
+public:
+    static const size_t storage_size = 40;
+
+    greentea_iovec get() const
+    {
+        return greentea_iovec{_data, _size};
+    }
+
+    void assign(const char *data, size_t size)
+    {
+        _data = data;
+        _size = size;
+    }
+
+    void assign_char(char c)
+    {
+        _storage[0] = c;
+        assign(_storage, 1);
+    }
+
+    void assign_integer(unsigned long long magnitude, bool negative)
+    {
+        // Fill from the end, so the exact length is known once the digits are written
+        char *const end = _storage + storage_size;
+        char *p = end;
+        do {
+            *--p = '0' + (magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude);
+        if (negative) {
+            *--p = '-';
+        }
+        assign(p, end - p);
+    }
+
+#if GREENTEA_CLIENT_FORMAT
+    template <typename FloatType>
+    void assign_floating(FloatType val)
+    {
+        assign(_storage, format_floating(_storage, val));
+    }
+#endif // GREENTEA_CLIENT_FORMAT
+
+private:
+    char _storage[storage_size];
+    const char *_data = nullptr;
+    size_t _size = 0;
+};
+
+inline void encode(encoded &out, const char *str)
+{
+    out.assign(str ? str : "", str ? strlen(str) : 0);
+}
+
+inline void encode(encoded &out, char c)
+{
+    out.assign_char(c);
+}
+
+template <typename T, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, int>::type = 0>
+inline void encode(encoded &out, T val)
+{
+    // Negate in unsigned arithmetic so that the minimum value does not overflow
+    const unsigned long long magnitude = static_cast<unsigned long long>(val);
+    out.assign_integer(val < 0 ? 0ULL - magnitude : magnitude, val < 0);
+}
+
+template <typename T, typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value, int>::type = 0>
+inline void encode(encoded &out, T val)
+{
+    out.assign_integer(val, false);
+}
+
+template <typename T, typename std::enable_if<std::is_enum<T>::value, int>::type = 0>
+inline void encode(encoded &out, T val)
+{
+    encode(out, static_cast<typename std::underlying_type<T>::type>(val));
+}
+
+#if GREENTEA_CLIENT_FORMAT
+inline void encode(encoded &out, float val)
+{
+    out.assign_floating(val);
+}
+
+inline void encode(encoded &out, double val)
+{
+    out.assign_floating(val);
+}
+
+inline void encode(encoded &out, long double val)
+{
+    out.assign_floating(static_cast<double>(val));
+}
+#endif // GREENTEA_CLIENT_FORMAT
+
+template <typename T, typename std::enable_if<
+              std::is_same<decltype(std::declval<const T &>().data()), const char *>::value &&
+              std::is_convertible<decltype(std::declval<const T &>().size()), size_t>::value, int>::type = 0>
+inline void encode(encoded &out, const T &text)
+{
+    out.assign(text.data(), text.size());
+}
+
+template <size_t N>
+inline void emit(greentea_iovec (&frame)[N], size_t)
+{
+    write_frame(frame, N);
+}
+
+/**
+ * Encode the values one by one on the stack and write the message once all are encoded.
+ */
+template <size_t N, typename T, typename... Rest>
+inline void emit(greentea_iovec (&frame)[N], size_t index, const T &first, const Rest &... rest)
+{
+    encoded value;
+    encode(value, first);
+    frame[index] = separator;
+    frame[index + 1] = value.get();
+    emit(frame, index + 2, rest...);
+}
+
+template <typename T>
+inline size_t encoded_size(const T &val)
+{
+    encoded value;
+    encode(value, val);
+    return value.get().iov_len;
+}
+
+} // namespace detail
+
+/**
+ * Result of greentea::send(), which a coroutine of test_coroutine.h can co_await. The message
+ * is written before send() returns, so the coroutine is never suspended.
+ */
+struct sent {
+    bool await_ready() const noexcept
+    {
+        return true;
+    }
+
+    template <typename Handle>
+    void await_suspend(Handle) const noexcept
+    {
+    }
+
+    void await_resume() const noexcept
+    {
+    }
+};
+
+/**
+ * Encapsulate and send a key-value message with any number of typed values and a key
+ * of known length: {{key;value1;value2;...}}
+ *
+ * @details Each value is encoded according to its type on the stack and the complete
+ *          message is handed to greentea_writev() as one gather list, without heap,
+ *          libc formatter or copies of the key and string values.
+ *
+ * @param key Message key (message/event name), not necessarily NUL-terminated
+ * @param key_len Length of the key
+ * @param values Message payload
+ */
+template <typename... Args>
+sent send_n(const char *key, size_t key_len, const Args &... values)
+{
+    static_assert(sizeof...(Args) > 0, "greentea::send requires at least one value");
+    if (!key) {
+        return sent();
+    }
+    greentea_iovec frame[2 * sizeof...(Args) + 3];
+    frame[0] = detail::preamble;
+    frame[1] = greentea_iovec{key, key_len};
+    frame[2 * sizeof...(Args) + 2] = detail::postamble;
+    detail::emit(frame, 2, values...);
+    return sent();
+}
+
+/**
+ * Encapsulate and send a key-value message with any number of typed values: {{key;value1;value2;...}}
+ *
+ * @see send_n()
+ *
+ * @param key Message key (message/event name)
+ * @param values Message payload
+ */
+template <typename... Args>
+sent send(const char *key, const Args &... values)
+{
+    return send_n(key, key ? strlen(key) : 0, values...);
+}
+
+/**
+ * Compute the exact number of bytes greentea::send() writes for a message.
+ *
+ * @param key Message key (message/event name)
+ * @param values Message payload
+ *
+ * @return Size of the message in bytes, including framing and line ending
+ */
+template <typename... Args>
+size_t frame_size(const char *key, const Args &... values)
+{
+    const size_t sizes[] = { detail::encoded_size(values)... };
+    size_t size = detail::preamble.iov_len + strlen(key) + detail::postamble.iov_len +
+                  detail::separator.iov_len * sizeof...(Args);
+    for (size_t value_size : sizes) {
+        size += value_size;
+    }
+    return size;
+}
+
+} // namespace greentea
+
+#endif // GREENTEA_CLIENT_TEST_SEND_H_
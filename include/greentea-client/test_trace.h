@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GREENTEA_CLIENT_TEST_TRACE_H_
+#define GREENTEA_CLIENT_TEST_TRACE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "greentea-client/greentea_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ *  Record and replay of the traffic between the DUT (device under test) and the host
+ *
+ *  Trace format, all integers are unsigned LEB128 varints:
+ *
+ *  <TRACE>  ::= "GTTR" <VERSION> <RECORD>*
+ *  <RECORD> ::= <DIRECTION> <DELTA> <LENGTH> <BYTE>{LENGTH}
+ *
+ *  VERSION is a single byte, GREENTEA_TRACE_VERSION. DIRECTION is a greentea_trace_direction.
+ *  DELTA is the time of the first byte of the record in microseconds, as read from
+ *  greentea_time_us(), relative to the previous record or to the start of the trace.
+ */
+
+#define GREENTEA_TRACE_MAGIC        "GTTR"
+#define GREENTEA_TRACE_VERSION      1
+
+/**
+ * Size of the buffer coalescing consecutive bytes of the same direction into one record
+ */
+#ifndef GREENTEA_TRACE_RECORD_SIZE
+#define GREENTEA_TRACE_RECORD_SIZE  64
+#endif
+
+/**
+ * Direction of the traffic in a trace record.
+ */
+enum greentea_trace_direction {
+    GREENTEA_TRACE_TX = 0,  /**< Written by the DUT to the host */
+    GREENTEA_TRACE_RX = 1   /**< Read by the DUT from the host */
+};
+
+#if GREENTEA_CLIENT_TRACE
+/**
+ * Receiver of the trace.
+ *
+ * @param data Next bytes of the trace
+ * @param size Number of bytes
+ * @param context User context passed to greentea_trace_start()
+ */
+typedef void (*greentea_trace_output)(const void *data, size_t size, void *context);
+
+/**
+ * Start recording all traffic through the I/O functions of test_io.h to a trace.
+ *
+ * @details Works with any I/O backend: every byte greentea-client reads with greentea_getc()
+ *          and every key-value message it writes is recorded with its time. Consecutive bytes
+ *          of the same direction are collected in a buffer of GREENTEA_TRACE_RECORD_SIZE bytes
+ *          and handed to the output as one record when the direction changes, the buffer is
+ *          full or recording stops. A trace already in progress is stopped first.
+ *
+ * @param output Receiver of the trace, e.g. writing it to a file
+ * @param context User context passed to each output call
+ */
+void greentea_trace_start(greentea_trace_output output, void *context);
+
+/**
+ * Stop recording and hand the last record to the output.
+ */
+void greentea_trace_stop(void);
+#endif // GREENTEA_CLIENT_TRACE
+
+/**
+ *  Replay backend
+ *
+ *  The functions below are provided by the greentea::client_replay library, which
+ *  implements test_io.h on top of a recorded trace instead of a real transport.
+ */
+
+/**
+ * Pace of a replay, see greentea_replay_start().
+ */
+enum greentea_replay_timing {
+    GREENTEA_REPLAY_FAST,       /**< Deliver input as fast as it is read, with a virtual clock */
+    GREENTEA_REPLAY_REALTIME    /**< Deliver input no earlier than it was originally received */
+};
+
+/**
+ * Outcome of a replay so far, see greentea_replay_get_status().
+ */
+struct greentea_replay_status {
+    size_t rx_delivered;    /**< Recorded input bytes read by the DUT */
+    size_t tx_expected;     /**< Output bytes in the trace */
+    size_t tx_written;      /**< Output bytes written by the DUT */
+    size_t tx_matched;      /**< Output bytes written identical to the trace before the first difference */
+    int diverged;           /**< Non-zero once the output differed from the trace */
+};
+
+/**
+ * Replay a recorded trace.
+ *
+ * @details greentea_getc() returns the recorded input, then EOF. Output written by the
+ *          DUT is compared with the recorded output. In GREENTEA_REPLAY_FAST mode,
+ *          greentea_time_us() returns the recorded time of the traffic replayed so far, so
+ *          time based behaviour is reproduced deterministically. In GREENTEA_REPLAY_REALTIME
+ *          mode, greentea_time_us() reads the host's monotonic clock and reading a byte
+ *          waits until it is due according to the trace.
+ *
+ * @param trace Trace data, which must remain valid until the replay ends
+ * @param size Size of the trace in bytes
+ * @param timing Pace of the replay
+ *
+ * @return 0 on success, -1 if the data is not a trace of a supported version
+ */
+int greentea_replay_start(const void *trace, size_t size, enum greentea_replay_timing timing);
+
+/**
+ * Get the outcome of the replay so far.
+ *
+ * @param status Receives the outcome
+ */
+void greentea_replay_get_status(struct greentea_replay_status *status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // GREENTEA_CLIENT_TEST_TRACE_H_
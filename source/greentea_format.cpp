@@ -0,0 +1,833 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstring>
+#include <limits>
+#include <stdint.h>
+#include "greentea-client/greentea_config.h"
+#include "greentea_format.h"
+
+#if GREENTEA_CLIENT_FORMAT
+
+/**
+ *****************************************************************************
+ *  Integer formatting
+ *****************************************************************************
+ */
+
+size_t greentea_format_uint(char *buffer, unsigned long long val, unsigned int base, bool upper)
+{
+    const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char reversed[GREENTEA_INT_STRING_SIZE];
+    size_t len = 0;
+
+    do {
+        reversed[len++] = digits[val % base];
+        val /= base;
+    } while (val);
+
+    for (size_t i = 0; i < len; i++) {
+        buffer[i] = reversed[len - 1 - i];
+    }
+    buffer[len] = '\0';
+    return len;
+}
+
+size_t greentea_format_int(char *buffer, long long val)
+{
+    if (val < 0) {
+        buffer[0] = '-';
+        // Negate in unsigned arithmetic so that LLONG_MIN does not overflow
+        return 1 + greentea_format_uint(buffer + 1, 0ULL - (unsigned long long)val, 10, false);
+    }
+    return greentea_format_uint(buffer, val, 10, false);
+}
+
+/**
+ *****************************************************************************
+ *  Fixed-point formatting
+ *****************************************************************************
+ */
+
+/**
+ * Round the fraction of a value scaled by a power of ten to an integer, exactly.
+ *
+ * @details The fraction has at most 53 significant bits, so it is m / 2^shift with an
+ *          integer m, and m * scale fits in 83 bits, which are split in two halves.
+ *          Ties are rounded to even, as printf does.
+ *
+ * @param fraction Fraction in [0, 1)
+ * @param scale Power of ten up to 10^GREENTEA_FIXED_MAX_PRECISION
+ * @param odd Whether the integer part scaled is odd, which decides ties
+ *
+ * @return fraction * scale rounded to the nearest integer
+ */
+static unsigned long long round_scaled_fraction(double fraction, unsigned long long scale, bool odd)
+{
+    // A fraction below 2^-32 scales to less than a half
+    int shift = 53;
+    while (fraction < 0.5 && shift < 84) {
+        fraction *= 2;
+        shift++;
+    }
+    if (fraction < 0.5) {
+        return 0;
+    }
+    const uint64_t m = (uint64_t)(fraction * 9007199254740992.0);
+    const uint64_t low = (m & 0xFFFFFFFFu) * scale;
+    const uint64_t high = (m >> 32) * scale + (low >> 32);
+    // m * scale = high * 2^32 + (low & 0xFFFFFFFF), and shift - 32 is between 21 and 52
+    const int high_shift = shift - 32;
+    const uint64_t rest = high & ((1ULL << high_shift) - 1);
+    const uint64_t half = 1ULL << (high_shift - 1);
+    const unsigned long long rounded = high >> high_shift;
+    if (rest != half || (low & 0xFFFFFFFFu) != 0) {
+        return rest < half ? rounded : rounded + 1;
+    }
+    // Exactly halfway, towards the even result
+    return ((rounded & 1) != 0) != odd ? rounded + 1 : rounded;
+}
+
+size_t greentea_format_fixed(char *buffer, double val, int precision)
+{
+    size_t len = 0;
+    if (val != val) {
+        memcpy(buffer, "nan", 3);
+        return 3;
+    }
+    // The sign bit, so that -0.0 keeps its sign as with printf
+    uint64_t bits;
+    memcpy(&bits, &val, sizeof(bits));
+    if (bits >> 63) {
+        buffer[len++] = '-';
+        val = -val;
+    }
+
+    unsigned long long scale = 1;
+    for (int i = 0; i < precision; i++) {
+        scale *= 10;
+    }
+    // 2^64 as a double, the limit of the scaled representation
+    if (val * scale >= 18446744073709551616.0) {
+        memcpy(buffer + len, val > 1e308 ? "inf" : "ovf", 3);
+        return len + 3;
+    }
+
+    // The integer part is exact, and so is the fraction left over
+    const unsigned long long integer = (unsigned long long)val;
+    const unsigned long long scaled = integer * scale +
+                                      round_scaled_fraction(val - (double)integer, scale, (integer * scale) & 1);
+    len += greentea_format_uint(buffer + len, scaled / scale, 10, false);
+    if (precision > 0) {
+        char fraction[GREENTEA_INT_STRING_SIZE];
+        const size_t fraction_len = greentea_format_uint(fraction, scaled % scale, 10, false);
+        buffer[len++] = '.';
+        for (size_t i = fraction_len; i < (size_t)precision; i++) {
+            buffer[len++] = '0';
+        }
+        memcpy(buffer + len, fraction, fraction_len);
+        len += fraction_len;
+    }
+    return len;
+}
+
+/**
+ *****************************************************************************
+ *  Shortest round-trip floating point formatting
+ *****************************************************************************
+ *
+ *  Implementation of the Grisu2 algorithm from Florian Loitsch, "Printing
+ *  Floating-Point Numbers Quickly and Accurately with Integers" (PLDI 2010).
+ *  The digits produced always read back to the same value, and are the shortest
+ *  such digits for the vast majority of inputs. Only 64-bit integer arithmetic
+ *  and a table of about 1 KB are needed, which suits small targets better than
+ *  algorithms with large tables or arbitrary precision fallbacks.
+ *
+ *  The code up to the end of the anonymous namespace is derived from dtoa_impl of
+ *  JSON for Modern C++ (https://github.com/nlohmann/json), under the MIT license
+ *  rather than the Apache 2.0 license of the rest of this file:
+ *
+ *  SPDX-FileCopyrightText: 2013-2022 Niels Lohmann <https://nlohmann.me>
+ *  SPDX-License-Identifier: MIT
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
+
+namespace {
+
+/**
+ * Floating point value f * 2^e with a 64-bit significand
+ */
+struct DiyFp {
+    uint64_t f;
+    int e;
+};
+
+DiyFp diyfp_sub(DiyFp x, DiyFp y)
+{
+    return DiyFp{x.f - y.f, x.e};
+}
+
+/**
+ * Multiply two values, rounding the 128-bit product of the significands to the upper 64 bits.
+ */
+DiyFp diyfp_mul(DiyFp x, DiyFp y)
+{
+    const uint64_t u_lo = x.f & 0xFFFFFFFF;
+    const uint64_t u_hi = x.f >> 32;
+    const uint64_t v_lo = y.f & 0xFFFFFFFF;
+    const uint64_t v_hi = y.f >> 32;
+
+    const uint64_t p0 = u_lo * v_lo;
+    const uint64_t p1 = u_lo * v_hi;
+    const uint64_t p2 = u_hi * v_lo;
+    const uint64_t p3 = u_hi * v_hi;
+
+    uint64_t q = (p0 >> 32) + (p1 & 0xFFFFFFFF) + (p2 & 0xFFFFFFFF);
+    q += uint64_t(1) << 31;
+
+    return DiyFp{p3 + (p2 >> 32) + (p1 >> 32) + (q >> 32), x.e + y.e + 64};
+}
+
+DiyFp diyfp_normalize(DiyFp x)
+{
+    while ((x.f >> 63) == 0) {
+        x.f <<= 1;
+        x.e--;
+    }
+    return x;
+}
+
+/**
+ * Value and the boundaries of its rounding interval, all with the same exponent
+ */
+struct Boundaries {
+    DiyFp w;
+    DiyFp minus;
+    DiyFp plus;
+};
+
+template <typename FloatType, typename Bits>
+Boundaries compute_boundaries(FloatType value)
+{
+    const int precision = std::numeric_limits<FloatType>::digits;
+    const int bias = std::numeric_limits<FloatType>::max_exponent - 1 + (precision - 1);
+    const int min_exp = 1 - bias;
+    const uint64_t hidden_bit = uint64_t(1) << (precision - 1);
+
+    Bits bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const uint64_t e = bits >> (precision - 1);
+    const uint64_t f = bits & (hidden_bit - 1);
+
+    const DiyFp v = e == 0 ? DiyFp{f, min_exp} : DiyFp{f + hidden_bit, int(e) - bias};
+
+    // The lower boundary is closer if the significand is a power of two, except for the
+    // smallest normal number whose predecessor is a denormal with the same spacing.
+    const bool lower_boundary_is_closer = f == 0 && e > 1;
+    const DiyFp m_plus = DiyFp{2 * v.f + 1, v.e - 1};
+    const DiyFp m_minus = lower_boundary_is_closer ? DiyFp{4 * v.f - 1, v.e - 2} : DiyFp{2 * v.f - 1, v.e - 1};
+
+    const DiyFp w_plus = diyfp_normalize(m_plus);
+    const DiyFp w_minus = DiyFp{m_minus.f << (m_minus.e - w_plus.e), w_plus.e};
+
+    return Boundaries{diyfp_normalize(v), w_minus, w_plus};
+}
+
+/**
+ * Normalized approximation f * 2^e of 10^k
+ */
+struct CachedPower {
+    uint64_t f;
+    int e;
+    int k;
+};
+
+// Smallest binary exponent the scaled value is brought to, which is at most -32 so that
+// its integral part fits in 32 bits
+const int kAlpha = -60;
+
+const int kCachedPowersMinDecExp = -300;
+const int kCachedPowersDecStep = 8;
+
+const CachedPower kCachedPowers[] = {
+    { 0xAB70FE17C79AC6CA, -1060, -300 },
+    { 0xFF77B1FCBEBCDC4F, -1034, -292 },
+    { 0xBE5691EF416BD60C, -1007, -284 },
+    { 0x8DD01FAD907FFC3C,  -980, -276 },
+    { 0xD3515C2831559A83,  -954, -268 },
+    { 0x9D71AC8FADA6C9B5,  -927, -260 },
+    { 0xEA9C227723EE8BCB,  -901, -252 },
+    { 0xAECC49914078536D,  -874, -244 },
+    { 0x823C12795DB6CE57,  -847, -236 },
+    { 0xC21094364DFB5637,  -821, -228 },
+    { 0x9096EA6F3848984F,  -794, -220 },
+    { 0xD77485CB25823AC7,  -768, -212 },
+    { 0xA086CFCD97BF97F4,  -741, -204 },
+    { 0xEF340A98172AACE5,  -715, -196 },
+    { 0xB23867FB2A35B28E,  -688, -188 },
+    { 0x84C8D4DFD2C63F3B,  -661, -180 },
+    { 0xC5DD44271AD3CDBA,  -635, -172 },
+    { 0x936B9FCEBB25C996,  -608, -164 },
+    { 0xDBAC6C247D62A584,  -582, -156 },
+    { 0xA3AB66580D5FDAF6,  -555, -148 },
+    { 0xF3E2F893DEC3F126,  -529, -140 },
+    { 0xB5B5ADA8AAFF80B8,  -502, -132 },
+    { 0x87625F056C7C4A8B,  -475, -124 },
+    { 0xC9BCFF6034C13053,  -449, -116 },
+    { 0x964E858C91BA2655,  -422, -108 },
+    { 0xDFF9772470297EBD,  -396, -100 },
+    { 0xA6DFBD9FB8E5B88F,  -369,  -92 },
+    { 0xF8A95FCF88747D94,  -343,  -84 },
+    { 0xB94470938FA89BCF,  -316,  -76 },
+    { 0x8A08F0F8BF0F156B,  -289,  -68 },
+    { 0xCDB02555653131B6,  -263,  -60 },
+    { 0x993FE2C6D07B7FAC,  -236,  -52 },
+    { 0xE45C10C42A2B3B06,  -210,  -44 },
+    { 0xAA242499697392D3,  -183,  -36 },
+    { 0xFD87B5F28300CA0E,  -157,  -28 },
+    { 0xBCE5086492111AEB,  -130,  -20 },
+    { 0x8CBCCC096F5088CC,  -103,  -12 },
+    { 0xD1B71758E219652C,   -77,   -4 },
+    { 0x9C40000000000000,   -50,    4 },
+    { 0xE8D4A51000000000,   -24,   12 },
+    { 0xAD78EBC5AC620000,     3,   20 },
+    { 0x813F3978F8940984,    30,   28 },
+    { 0xC097CE7BC90715B3,    56,   36 },
+    { 0x8F7E32CE7BEA5C70,    83,   44 },
+    { 0xD5D238A4ABE98068,   109,   52 },
+    { 0x9F4F2726179A2245,   136,   60 },
+    { 0xED63A231D4C4FB27,   162,   68 },
+    { 0xB0DE65388CC8ADA8,   189,   76 },
+    { 0x83C7088E1AAB65DB,   216,   84 },
+    { 0xC45D1DF942711D9A,   242,   92 },
+    { 0x924D692CA61BE758,   269,  100 },
+    { 0xDA01EE641A708DEA,   295,  108 },
+    { 0xA26DA3999AEF774A,   322,  116 },
+    { 0xF209787BB47D6B85,   348,  124 },
+    { 0xB454E4A179DD1877,   375,  132 },
+    { 0x865B86925B9BC5C2,   402,  140 },
+    { 0xC83553C5C8965D3D,   428,  148 },
+    { 0x952AB45CFA97A0B3,   455,  156 },
+    { 0xDE469FBD99A05FE3,   481,  164 },
+    { 0xA59BC234DB398C25,   508,  172 },
+    { 0xF6C69A72A3989F5C,   534,  180 },
+    { 0xB7DCBF5354E9BECE,   561,  188 },
+    { 0x88FCF317F22241E2,   588,  196 },
+    { 0xCC20CE9BD35C78A5,   614,  204 },
+    { 0x98165AF37B2153DF,   641,  212 },
+    { 0xE2A0B5DC971F303A,   667,  220 },
+    { 0xA8D9D1535CE3B396,   694,  228 },
+    { 0xFB9B7CD9A4A7443C,   720,  236 },
+    { 0xBB764C4CA7A44410,   747,  244 },
+    { 0x8BAB8EEFB6409C1A,   774,  252 },
+    { 0xD01FEF10A657842C,   800,  260 },
+    { 0x9B10A4E5E9913129,   827,  268 },
+    { 0xE7109BFBA19C0C9D,   853,  276 },
+    { 0xAC2820D9623BF429,   880,  284 },
+    { 0x80444B5E7AA7CF85,   907,  292 },
+    { 0xBF21E44003ACDD2D,   933,  300 },
+    { 0x8E679C2F5E44FF8F,   960,  308 },
+    { 0xD433179D9C8CB841,   986,  316 },
+    { 0x9E19DB92B4E31BA9,  1013,  324 }
+};
+
+CachedPower get_cached_power_for_binary_exponent(int e)
+{
+    // k = ceil((kAlpha - e - 1) * log10(2)), with log10(2) ~= 78913 / 2^18
+    const int f = kAlpha - e - 1;
+    const int k = (f * 78913) / (1 << 18) + (f > 0);
+    const int index = (-kCachedPowersMinDecExp + k + (kCachedPowersDecStep - 1)) / kCachedPowersDecStep;
+    return kCachedPowers[index];
+}
+
+/**
+ * Number of decimal digits of n, and the largest power of ten not above it.
+ */
+int find_largest_pow10(uint32_t n, uint32_t &pow10)
+{
+    int digits = 10;
+    pow10 = 1000000000;
+    while (digits > 1 && n < pow10) {
+        pow10 /= 10;
+        digits--;
+    }
+    return digits;
+}
+
+/**
+ * Move the last digit towards the exact value while staying within the rounding interval.
+ */
+void grisu2_round(char *buffer, int length, uint64_t dist, uint64_t delta, uint64_t rest, uint64_t ten_k)
+{
+    while (rest < dist && delta - rest >= ten_k && (rest + ten_k < dist || dist - rest > rest + ten_k - dist)) {
+        buffer[length - 1]--;
+        rest += ten_k;
+    }
+}
+
+/**
+ * Generate the shortest digits of a value in (M_minus, M_plus), closest to w.
+ */
+void grisu2_digit_gen(char *buffer, int &length, int &decimal_exponent, DiyFp M_minus, DiyFp w, DiyFp M_plus)
+{
+    uint64_t delta = diyfp_sub(M_plus, M_minus).f;
+    uint64_t dist = diyfp_sub(M_plus, w).f;
+
+    // Split M_plus into an integral part p1 and a fractional part p2
+    const DiyFp one = DiyFp{uint64_t(1) << -M_plus.e, M_plus.e};
+    uint32_t p1 = uint32_t(M_plus.f >> -one.e);
+    uint64_t p2 = M_plus.f & (one.f - 1);
+
+    uint32_t pow10;
+    int n = find_largest_pow10(p1, pow10);
+
+    while (n > 0) {
+        buffer[length++] = char('0' + p1 / pow10);
+        p1 %= pow10;
+        n--;
+
+        const uint64_t rest = (uint64_t(p1) << -one.e) + p2;
+        if (rest <= delta) {
+            decimal_exponent += n;
+            grisu2_round(buffer, length, dist, delta, rest, uint64_t(pow10) << -one.e);
+            return;
+        }
+        pow10 /= 10;
+    }
+
+    int m = 0;
+    for (;;) {
+        p2 *= 10;
+        buffer[length++] = char('0' + (p2 >> -one.e));
+        p2 &= one.f - 1;
+        m++;
+
+        delta *= 10;
+        dist *= 10;
+        if (p2 <= delta) {
+            break;
+        }
+    }
+    decimal_exponent -= m;
+    grisu2_round(buffer, length, dist, delta, p2, one.f);
+}
+
+/**
+ * Produce the digits and decimal exponent of a positive value: value ~= digits * 10^decimal_exponent.
+ */
+void grisu2(char *buffer, int &length, int &decimal_exponent, const Boundaries &b)
+{
+    const CachedPower cached = get_cached_power_for_binary_exponent(b.plus.e);
+    const DiyFp c_minus_k = DiyFp{cached.f, cached.e};
+
+    const DiyFp w = diyfp_mul(b.w, c_minus_k);
+    const DiyFp w_minus = diyfp_mul(b.minus, c_minus_k);
+    const DiyFp w_plus = diyfp_mul(b.plus, c_minus_k);
+
+    // Shrink the interval by one unit on both sides to absorb the multiplication errors
+    const DiyFp M_minus = DiyFp{w_minus.f + 1, w_minus.e};
+    const DiyFp M_plus = DiyFp{w_plus.f - 1, w_plus.e};
+
+    decimal_exponent = -cached.k;
+    grisu2_digit_gen(buffer, length, decimal_exponent, M_minus, w, M_plus);
+}
+
+/**
+ * Lay out the digits in decimal notation if the exponent is in [min_exp, max_exp),
+ * otherwise in scientific notation. A decimal point is always present.
+ */
+size_t format_digits(char *buffer, int length, int decimal_exponent, int min_exp, int max_exp)
+{
+    const int k = length;
+    const int n = length + decimal_exponent;
+
+    if (k <= n && n <= max_exp) {
+        // digits[000].0
+        memset(buffer + k, '0', n - k);
+        buffer[n] = '.';
+        buffer[n + 1] = '0';
+        return n + 2;
+    }
+
+    if (0 < n && n <= max_exp) {
+        // dig.its
+        memmove(buffer + n + 1, buffer + n, k - n);
+        buffer[n] = '.';
+        return k + 1;
+    }
+
+    if (min_exp < n && n <= 0) {
+        // 0.[000]digits
+        memmove(buffer + 2 - n, buffer, k);
+        buffer[0] = '0';
+        buffer[1] = '.';
+        memset(buffer + 2, '0', -n);
+        return 2 - n + k;
+    }
+
+    // d.igitse+123
+    size_t len = 1;
+    if (k > 1) {
+        memmove(buffer + 2, buffer + 1, k - 1);
+        buffer[1] = '.';
+        len = k + 1;
+    }
+    buffer[len++] = 'e';
+    int exponent = n - 1;
+    if (exponent < 0) {
+        buffer[len++] = '-';
+        exponent = -exponent;
+    } else {
+        buffer[len++] = '+';
+    }
+    if (exponent < 10) {
+        buffer[len++] = '0';
+    }
+    char digits[GREENTEA_INT_STRING_SIZE];
+    const size_t digits_len = greentea_format_uint(digits, exponent, 10, false);
+    memcpy(buffer + len, digits, digits_len);
+    return len + digits_len;
+}
+
+template <typename FloatType, typename Bits>
+size_t format_shortest(char *buffer, FloatType value)
+{
+    size_t len = 0;
+    if (value != value) {
+        memcpy(buffer, "nan", 3);
+        return 3;
+    }
+
+    Bits bits;
+    memcpy(&bits, &value, sizeof(bits));
+    if (bits >> (sizeof(bits) * 8 - 1)) {
+        buffer[len++] = '-';
+        value = -value;
+    }
+
+    if (value > std::numeric_limits<FloatType>::max()) {
+        memcpy(buffer + len, "inf", 3);
+        return len + 3;
+    }
+    if (value == 0) {
+        memcpy(buffer + len, "0.0", 3);
+        return len + 3;
+    }
+
+    int length = 0;
+    int decimal_exponent = 0;
+    grisu2(buffer + len, length, decimal_exponent, compute_boundaries<FloatType, Bits>(value));
+    return len + format_digits(buffer + len, length, decimal_exponent, -4, std::numeric_limits<FloatType>::digits10);
+}
+
+} // namespace, end of the code under the MIT license
+
+size_t greentea_format_double(char *buffer, double val)
+{
+    return format_shortest<double, uint64_t>(buffer, val);
+}
+
+size_t greentea_format_float(char *buffer, float val)
+{
+    return format_shortest<float, uint32_t>(buffer, val);
+}
+
+/**
+ *****************************************************************************
+ *  printf-style formatting
+ *****************************************************************************
+ */
+
+#define FORMAT_CHUNK_SIZE   32
+
+/**
+ * Output staging buffer of the formatter.
+ *
+ * @details Short pieces (single characters, numbers) are gathered in the chunk,
+ *          long strings are passed through to the output without being copied.
+ */
+struct FormatOutput {
+    greentea_format_output output;
+    void *context;
+    char chunk[FORMAT_CHUNK_SIZE];
+    size_t len;
+};
+
+static void format_flush(FormatOutput *out)
+{
+    if (out->len) {
+        out->output(out->chunk, out->len, out->context);
+        out->len = 0;
+    }
+}
+
+static void format_write(FormatOutput *out, const char *data, size_t size)
+{
+    if (size > FORMAT_CHUNK_SIZE - out->len) {
+        format_flush(out);
+        if (size > FORMAT_CHUNK_SIZE) {
+            out->output(data, size, out->context);
+            return;
+        }
+    }
+    memcpy(out->chunk + out->len, data, size);
+    out->len += size;
+}
+
+static void format_pad(FormatOutput *out, char c, int count)
+{
+    while (count-- > 0) {
+        format_write(out, &c, 1);
+    }
+}
+
+/**
+ * Write a converted field, padded to the requested width.
+ *
+ * @param sign_len Number of leading sign characters which go before zero padding
+ * @param zeros Number of zeros between the sign and the digits, for the precision of integers
+ */
+static void format_field(FormatOutput *out, const char *data, size_t size, size_t sign_len,
+                         int zeros, int width, bool left, bool zero)
+{
+    int padding = width - (int)size - zeros;
+    if (padding < 0) {
+        padding = 0;
+    }
+    if (!left) {
+        if (zero) {
+            zeros += padding;
+        } else {
+            format_pad(out, ' ', padding);
+        }
+        padding = 0;
+    }
+    format_write(out, data, sign_len);
+    format_pad(out, '0', zeros);
+    format_write(out, data + sign_len, size - sign_len);
+    format_pad(out, ' ', padding);
+}
+
+void greentea_vformat(greentea_format_output output, void *context, const char *format, va_list args)
+{
+    FormatOutput out;
+    out.output = output;
+    out.context = context;
+    out.len = 0;
+
+    while (*format) {
+        const char *literal = format;
+        while (*format && *format != '%') {
+            format++;
+        }
+        if (format != literal) {
+            format_write(&out, literal, format - literal);
+        }
+        if (!*format) {
+            break;
+        }
+        format++;
+
+        // Flags
+        bool left = false;
+        bool zero = false;
+        for (;; format++) {
+            if (*format == '-') {
+                left = true;
+            } else if (*format == '0') {
+                zero = true;
+            } else {
+                break;
+            }
+        }
+
+        // Width
+        int width = 0;
+        if (*format == '*') {
+            width = va_arg(args, int);
+            if (width < 0) {
+                left = true;
+                width = -width;
+            }
+            format++;
+        } else {
+            while (*format >= '0' && *format <= '9') {
+                width = width * 10 + (*format++ - '0');
+            }
+        }
+
+        // Precision
+        int precision = -1;
+        if (*format == '.') {
+            format++;
+            precision = 0;
+            if (*format == '*') {
+                precision = va_arg(args, int);
+                format++;
+            } else {
+                while (*format >= '0' && *format <= '9') {
+                    precision = precision * 10 + (*format++ - '0');
+                }
+            }
+        }
+
+        // Length modifier; char and short arguments are promoted to int and converted back
+        int longs = 0;
+        int shorts = 0;
+        bool size = false;
+        while (*format == 'l' || *format == 'h' || *format == 'z') {
+            if (*format == 'l') {
+                longs++;
+            } else if (*format == 'h') {
+                shorts++;
+            } else {
+                size = true;
+            }
+            format++;
+        }
+
+        char field[GREENTEA_FIXED_STRING_SIZE];
+        size_t field_len = 0;
+        size_t sign_len = 0;
+        bool integer = false;
+        const char conversion = *format;
+        if (conversion) {
+            format++;
+        }
+
+        switch (conversion) {
+            case 'd':
+            case 'i': {
+                long long val;
+                if (longs >= 2) {
+                    val = va_arg(args, long long);
+                } else if (longs == 1) {
+                    val = va_arg(args, long);
+                } else if (size) {
+                    val = (long long)va_arg(args, size_t);
+                } else if (shorts >= 2) {
+                    val = (signed char)va_arg(args, int);
+                } else if (shorts == 1) {
+                    val = (short)va_arg(args, int);
+                } else {
+                    val = va_arg(args, int);
+                }
+                field_len = greentea_format_int(field, val);
+                sign_len = val < 0;
+                integer = true;
+                break;
+            }
+
+            case 'u':
+            case 'x':
+            case 'X': {
+                unsigned long long val;
+                if (longs >= 2) {
+                    val = va_arg(args, unsigned long long);
+                } else if (longs == 1) {
+                    val = va_arg(args, unsigned long);
+                } else if (size) {
+                    val = va_arg(args, size_t);
+                } else if (shorts >= 2) {
+                    val = (unsigned char)va_arg(args, unsigned int);
+                } else if (shorts == 1) {
+                    val = (unsigned short)va_arg(args, unsigned int);
+                } else {
+                    val = va_arg(args, unsigned int);
+                }
+                field_len = greentea_format_uint(field, val, conversion == 'u' ? 10 : 16, conversion == 'X');
+                integer = true;
+                break;
+            }
+
+            case 'f': {
+                const double val = va_arg(args, double);
+                if (precision < 0) {
+                    precision = 6;
+                } else if (precision > GREENTEA_FIXED_MAX_PRECISION) {
+                    precision = GREENTEA_FIXED_MAX_PRECISION;
+                }
+                field_len = greentea_format_fixed(field, val, precision);
+                sign_len = field[0] == '-';
+                break;
+            }
+
+            case 'c':
+                field[0] = (char)va_arg(args, int);
+                field_len = 1;
+                zero = false;
+                break;
+
+            case 's': {
+                const char *str = va_arg(args, const char *);
+                if (!str) {
+                    str = "(null)";
+                }
+                size_t len = 0;
+                while (str[len] && (precision < 0 || len < (size_t)precision)) {
+                    len++;
+                }
+                format_field(&out, str, len, 0, 0, width, left, false);
+                continue;
+            }
+
+            case '%':
+                field[0] = '%';
+                field_len = 1;
+                break;
+
+            default:
+                // Unsupported conversion, leave the rest of the format string out
+                format_flush(&out);
+                return;
+        }
+
+        // The precision of an integer is its minimum number of digits, so 0 has none with 0
+        int zeros = 0;
+        if (integer && precision >= 0) {
+            const int digits = (int)(field_len - sign_len);
+            if (precision == 0 && field[sign_len] == '0') {
+                field_len = sign_len;
+            } else if (precision > digits) {
+                zeros = precision - digits;
+            }
+            zero = false;
+        }
+        format_field(&out, field, field_len, sign_len, zeros, width, left, zero);
+    }
+
+    format_flush(&out);
+}
+
+#endif // GREENTEA_CLIENT_FORMAT
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GREENTEA_CLIENT_FORMAT_H_
+#define GREENTEA_CLIENT_FORMAT_H_
+
+#include <stdarg.h>
+#include <stddef.h>
+
+/**
+ *  Greentea-client internal formatting helpers, used instead of the libc printf family
+ */
+
+/**
+ * Buffer size large enough for any integer formatted by greentea_format_int/uint
+ */
+#define GREENTEA_INT_STRING_SIZE    24
+
+/**
+ * Format an unsigned integer.
+ *
+ * @param buffer Output buffer of at least GREENTEA_INT_STRING_SIZE bytes, NUL-terminated on return
+ * @param val Value to format
+ * @param base Numeric base, 10 or 16
+ * @param upper Use upper case hexadecimal digits
+ *
+ * @return Number of characters written, excluding the terminator
+ */
+size_t greentea_format_uint(char *buffer, unsigned long long val, unsigned int base, bool upper);
+
+/**
+ * Format a signed decimal integer.
+ *
+ * @param buffer Output buffer of at least GREENTEA_INT_STRING_SIZE bytes, NUL-terminated on return
+ * @param val Value to format
+ *
+ * @return Number of characters written, excluding the terminator
+ */
+size_t greentea_format_int(char *buffer, long long val);
+
+/**
+ * Maximum number of fractional digits of greentea_format_fixed()
+ */
+#define GREENTEA_FIXED_MAX_PRECISION    9
+
+/**
+ * Buffer size large enough for any number formatted by greentea_format_fixed()
+ */
+#define GREENTEA_FIXED_STRING_SIZE  (GREENTEA_INT_STRING_SIZE + GREENTEA_FIXED_MAX_PRECISION + 2)
+
+/**
+ * Format a double in fixed-point notation using integer arithmetic only.
+ *
+ * @details The exact binary value is rounded, ties to even, and the sign of -0.0 is kept,
+ *          as with printf. Values whose scaled magnitude does not fit in 64 bits are written
+ *          as "ovf", infinities as "inf" and NaN as "nan".
+ *
+ * @param buffer Output buffer of at least GREENTEA_FIXED_STRING_SIZE bytes, not NUL-terminated
+ * @param val Value to format
+ * @param precision Number of fractional digits, at most GREENTEA_FIXED_MAX_PRECISION
+ *
+ * @return Number of characters written
+ */
+size_t greentea_format_fixed(char *buffer, double val, int precision);
+
+/**
+ * Buffer size large enough for any number formatted by greentea_format_double/float
+ */
+#define GREENTEA_FLOAT_STRING_SIZE  32
+
+/**
+ * Format a double with the shortest digits that read back to the same value.
+ *
+ * @details Decimal notation is used for magnitudes in [1e-4, 1e15), for example
+ *          "0.1", "250.0" or "0.000125", and scientific notation otherwise, for example
+ *          "1.5e+20" or "5e-324". A decimal point or exponent is always present, so the
+ *          text is recognised as floating point. Infinity and NaN are written as "inf",
+ *          "-inf" and "nan". The text is accepted by strtod() and Python's float().
+ *
+ * @param buffer Output buffer of at least GREENTEA_FLOAT_STRING_SIZE bytes, not NUL-terminated
+ * @param val Value to format
+ *
+ * @return Number of characters written
+ */
+size_t greentea_format_double(char *buffer, double val);
+
+/**
+ * Format a float with the shortest digits that read back to the same float.
+ *
+ * @details As greentea_format_double(), with decimal notation for magnitudes in [1e-4, 1e6).
+ *
+ * @param buffer Output buffer of at least GREENTEA_FLOAT_STRING_SIZE bytes, not NUL-terminated
+ * @param val Value to format
+ *
+ * @return Number of characters written
+ */
+size_t greentea_format_float(char *buffer, float val);
+
+/**
+ * Receiver of formatted output.
+ *
+ * @param data Formatted characters, not NUL-terminated
+ * @param size Number of characters
+ * @param context User context passed to greentea_vformat()
+ */
+typedef void (*greentea_format_output)(const char *data, size_t size, void *context);
+
+/**
+ * Minimal printf-style formatter.
+ *
+ * @details Supports the flags '-' and '0', field width and precision (including '*'),
+ *          the length modifiers hh, h, l, ll and z and the conversions %d %i %u %x %X
+ *          %c %s %% and %f. %f is printed in fixed-point with the requested precision
+ *          (default 6, at most 9 digits) using integer arithmetic only.
+ *          Output is produced in small pieces on the stack, no heap is used.
+ *
+ * @param output Receiver of the formatted characters
+ * @param context User context passed to output
+ * @param format Format string
+ * @param args Arguments
+ */
+void greentea_vformat(greentea_format_output output, void *context, const char *format, va_list args);
+
+#endif // GREENTEA_CLIENT_FORMAT_H_
@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include "greentea_journal.h"
+
+#if GREENTEA_CLIENT_JOURNAL
+
+/**
+ * Each entry is the length of the message, 2 bytes little-endian, followed by the message.
+ * An entry of length 0 stands for a message which did not fit the store.
+ */
+static const size_t entry_header_size = 2;
+static const size_t max_entry_size = 0xFFFF;
+
+/**
+ * Store of the running journal, of size 0 when there is none
+ */
+static greentea_journal_store journal_store = { 0, NULL, NULL, NULL };
+
+/**
+ * The entries are a ring in the store: used bytes, the oldest numbered first_seq, end
+ * at head, where the next byte goes. The entry of a message being written is the last.
+ */
+static size_t journal_head = 0;
+static size_t journal_used = 0;
+static unsigned long journal_first_seq = 1;
+static unsigned long journal_next_seq = 1;
+
+/**
+ * Entry of the message being written, with the bytes of it in the ring
+ */
+static bool entry_open = false;
+static bool entry_dropped = false;
+static size_t entry_start = 0;
+static size_t entry_used = 0;
+
+static void ram_write(size_t offset, const void *data, size_t size, void *context)
+{
+    memcpy(static_cast<char *>(context) + offset, data, size);
+}
+
+static void ram_read(size_t offset, void *data, size_t size, void *context)
+{
+    memcpy(data, static_cast<const char *>(context) + offset, size);
+}
+
+/**
+ * Position in the ring of a position up to one store size past its end.
+ */
+static size_t journal_wrap(size_t position)
+{
+    return position >= journal_store.size ? position - journal_store.size : position;
+}
+
+static void store_write(size_t position, const void *data, size_t size)
+{
+    const size_t first = journal_store.size - position < size ? journal_store.size - position : size;
+    journal_store.write(position, data, first, journal_store.context);
+    if (first < size) {
+        journal_store.write(0, static_cast<const char *>(data) + first, size - first, journal_store.context);
+    }
+}
+
+static void store_read(size_t position, void *data, size_t size)
+{
+    const size_t first = journal_store.size - position < size ? journal_store.size - position : size;
+    journal_store.read(position, data, first, journal_store.context);
+    if (first < size) {
+        journal_store.read(0, static_cast<char *>(data) + first, size - first, journal_store.context);
+    }
+}
+
+static size_t read_entry_size(size_t position)
+{
+    uint8_t header[entry_header_size];
+    store_read(position, header, sizeof(header));
+    return header[0] | (size_t)header[1] << 8;
+}
+
+/**
+ * Drop the oldest entries until size more bytes fit the ring, which the caller made
+ * sure they do along with the open entry.
+ */
+static void journal_reserve(size_t size)
+{
+    while (journal_used + size > journal_store.size) {
+        const size_t tail = journal_wrap(journal_head + journal_store.size - journal_used);
+        journal_used -= entry_header_size + read_entry_size(tail);
+        journal_first_seq++;
+    }
+}
+
+unsigned long greentea_journal_seq(const char *key, size_t key_len)
+{
+    static const char testcase_prefix[] = "__testcase_";
+    if (!journal_store.size) {
+        return 0;
+    }
+    // The suite's own keys and "end" carry results, as do the test case messages
+    const bool protocol = key_len >= 2 && key[0] == '_' && key[1] == '_';
+    if (protocol && (key_len < sizeof(testcase_prefix) - 1 ||
+                     memcmp(key, testcase_prefix, sizeof(testcase_prefix) - 1) != 0)) {
+        return 0;
+    }
+    return journal_next_seq;
+}
+
+void greentea_journal_open(void)
+{
+    journal_reserve(entry_header_size);
+    entry_open = true;
+    entry_dropped = false;
+    entry_start = journal_head;
+    entry_used = entry_header_size;
+    journal_head = journal_wrap(journal_head + entry_header_size);
+    journal_used += entry_header_size;
+    journal_next_seq++;
+}
+
+void greentea_journal_append(const void *data, size_t size)
+{
+    if (!entry_open || entry_dropped) {
+        return;
+    }
+    if (entry_used + size > journal_store.size || entry_used - entry_header_size + size > max_entry_size) {
+        // Only the length of 0 is kept, the older entries are not dropped for nothing
+        journal_head = journal_wrap(entry_start + entry_header_size);
+        journal_used -= entry_used - entry_header_size;
+        entry_used = entry_header_size;
+        entry_dropped = true;
+        return;
+    }
+    journal_reserve(size);
+    store_write(journal_head, data, size);
+    journal_head = journal_wrap(journal_head + size);
+    journal_used += size;
+    entry_used += size;
+}
+
+void greentea_journal_close(void)
+{
+    if (!entry_open) {
+        return;
+    }
+    const size_t size = entry_used - entry_header_size;
+    const uint8_t header[entry_header_size] = { (uint8_t)size, (uint8_t)(size >> 8) };
+    store_write(entry_start, header, sizeof(header));
+    entry_open = false;
+}
+
+unsigned long greentea_journal_last(void)
+{
+    return journal_store.size ? journal_next_seq - 1 : 0;
+}
+
+void greentea_journal_replay(unsigned long from, greentea_journal_output output, void *context)
+{
+    size_t position = journal_wrap(journal_head + journal_store.size - journal_used);
+    size_t remaining = journal_used - (entry_open ? entry_used : 0);
+    for (unsigned long seq = journal_first_seq; remaining; seq++) {
+        const size_t size = read_entry_size(position);
+        position = journal_wrap(position + entry_header_size);
+        if (seq >= from && size) {
+            output(seq, NULL, 0, context);
+            uint8_t chunk[32];
+            for (size_t done = 0; done < size; done += sizeof(chunk)) {
+                const size_t bytes = size - done < sizeof(chunk) ? size - done : sizeof(chunk);
+                store_read(journal_wrap(position + done), chunk, bytes);
+                output(seq, chunk, bytes, context);
+            }
+        }
+        position = journal_wrap(position + size);
+        remaining -= entry_header_size + size;
+    }
+}
+
+extern "C" void greentea_journal_start(void *buffer, size_t size)
+{
+    const greentea_journal_store store = { size, ram_write, ram_read, buffer };
+    greentea_journal_start_store(&store);
+}
+
+extern "C" void greentea_journal_start_store(const greentea_journal_store *store)
+{
+    greentea_journal_stop();
+    // Room for at least the length of an entry
+    if (store && store->size > entry_header_size) {
+        journal_store = *store;
+    }
+}
+
+extern "C" void greentea_journal_stop(void)
+{
+    journal_store.size = 0;
+    journal_head = 0;
+    journal_used = 0;
+    journal_first_seq = 1;
+    journal_next_seq = 1;
+    entry_open = false;
+}
+
+#endif // GREENTEA_CLIENT_JOURNAL
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GREENTEA_CLIENT_JOURNAL_H_
+#define GREENTEA_CLIENT_JOURNAL_H_
+
+#include <stddef.h>
+#include "greentea-client/test_journal.h"
+
+/**
+ *  Greentea-client internal journal helpers, see test_journal.h for the protocol
+ */
+
+#if GREENTEA_CLIENT_JOURNAL
+/**
+ * Receiver of the journaled messages being replayed.
+ *
+ * @param seq Sequence number of the message
+ * @param data Next bytes of the message, NULL once at the start of each message
+ * @param size Number of bytes
+ * @param context User context passed to greentea_journal_replay()
+ */
+typedef void (*greentea_journal_output)(unsigned long seq, const void *data, size_t size, void *context);
+
+/**
+ * Get the sequence number the next message with a key would be journaled with.
+ *
+ * @param key Message key
+ * @param key_len Length of the key
+ *
+ * @return Sequence number, 0 if no journal runs or messages with the key are not journaled
+ */
+unsigned long greentea_journal_seq(const char *key, size_t key_len);
+
+/**
+ * Start the entry of the message numbered by greentea_journal_seq().
+ */
+void greentea_journal_open(void);
+
+/**
+ * Append bytes of the message to its entry, if one is open.
+ */
+void greentea_journal_append(const void *data, size_t size);
+
+/**
+ * Complete the entry of the message, if one is open.
+ */
+void greentea_journal_close(void);
+
+/**
+ * Get the sequence number of the last message journaled, 0 if there is none.
+ */
+unsigned long greentea_journal_last(void);
+
+/**
+ * Hand the messages still in the journal to an output, from a sequence number on.
+ */
+void greentea_journal_replay(unsigned long from, greentea_journal_output output, void *context);
+#else
+static inline void greentea_journal_append(const void *, size_t)
+{
+}
+
+static inline void greentea_journal_close(void)
+{
+}
+#endif // GREENTEA_CLIENT_JOURNAL
+
+#endif // GREENTEA_CLIENT_JOURNAL_H_
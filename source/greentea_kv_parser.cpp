@@ -0,0 +1,302 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cctype>
+#include <climits>
+#include <cstdio>
+#include "greentea-client/test_env.h"
+
+#if GREENTEA_CLIENT_PARSER
+
+/**
+ *****************************************************************************
+ *  Push-style parser of key-value messages
+ *****************************************************************************
+ */
+
+typedef greentea_kv_token TokenBuffer;
+
+static int isstring(int);
+
+/**
+ * @enum State of the key-value message parser
+ *
+ *       The parser recognises the key-value message grammar:
+ *
+ *       <MESSAGE> ::= "{{" <STRING> ";" <STRING> "}}"
+ *       <STRING>  ::= [a-zA-Z0-9_-!@#$%^&*()]+    // See isstring() function
+ *
+ *       Whitespace is skipped before each string. Characters outside of a
+ *       message, and messages which do not match the grammar, are discarded.
+ *
+ *       Examples:
+ *       message:     "{{__timeout; 1000}}"
+ *                    "{{__sync; 12345678-1234-5678-1234-567812345678}}"
+ */
+enum ParserState {
+    state_idle,         // Looking for "{{"
+    state_open,         // Found "{"
+    state_key_start,    // Found "{{", skipping whitespace before the key
+    state_key,          // In the key
+    state_value_start,  // Found ";", skipping whitespace before the value
+    state_value,        // In the value
+    state_close,        // Found "}" after the value
+    state_trail         // Found "}}", skipping whitespace after the message
+};
+
+static void token_flush(TokenBuffer *out)
+{
+    if (out->sink && out->idx > 0) {
+        out->sink(out->str, out->idx, out->context);
+        out->idx = 0;
+    }
+}
+
+static void token_begin(TokenBuffer *out)
+{
+    out->idx = 0;
+    out->length = 0;
+    out->crc = 0xFFFFFFFF;
+}
+
+static void token_append(TokenBuffer *out, int c)
+{
+    if (out->sink) {
+        // CRC-32 (IEEE 802.3), bitwise to avoid a lookup table
+        out->crc ^= (unsigned char)c;
+        for (int bit = 0; bit < 8; bit++) {
+            out->crc = (out->crc >> 1) ^ (0xEDB88320 & (0 - (out->crc & 1)));
+        }
+        out->str[out->idx++] = c;
+        if (out->idx == out->size) {
+            token_flush(out);
+        }
+    } else if (out->idx < out->size - (out->terminated ? 1 : 0)) {
+        out->str[out->idx++] = c;
+    }
+    out->length++;
+}
+
+static void token_end(TokenBuffer *out)
+{
+    if (out->sink) {
+        token_flush(out);
+    } else if (out->terminated && out->idx < out->size) {
+        out->str[out->idx] = '\0';
+    }
+}
+
+/**
+ * Tell a sink to drop a value it received from a message which turned out to be malformed.
+ */
+static void token_discard(TokenBuffer *out)
+{
+    if (out->sink && out->length > 0) {
+        out->sink(NULL, 0, out->context);
+        token_begin(out);
+    }
+}
+
+/**
+ * Check if a character can be part of a value.
+ */
+static int isvalue(const greentea_kv_parser *parser, int c)
+{
+    if (parser->flags & GREENTEA_KV_MULTI_VALUE) {
+        return c != EOF && c != '{' && c != '}' && c != '\r' && c != '\n';
+    }
+    return isstring(c);
+}
+
+static void token_init(TokenBuffer *out, char *str, size_t size, bool terminated)
+{
+    out->str = str;
+    out->size = size > INT_MAX ? INT_MAX : (int)size;
+    out->idx = 0;
+    out->sink = NULL;
+    out->context = NULL;
+    out->length = 0;
+    out->crc = 0;
+    out->terminated = terminated;
+}
+
+extern "C" void greentea_kv_parser_init(greentea_kv_parser *parser,
+                                        char *key, size_t key_size,
+                                        char *value, size_t value_size,
+                                        int flags)
+{
+    parser->state = state_idle;
+    parser->flags = flags;
+    token_init(&parser->key, key, key_size, true);
+    token_init(&parser->value, value, value_size, true);
+}
+
+extern "C" greentea_kv_parser_result greentea_kv_parser_push(greentea_kv_parser *parser, int c)
+{
+    // A character which does not fit the message in progress is looked at again
+    // as a possible start of the next message
+    while (1) {
+        switch (parser->state) {
+            case state_trail:
+                parser->state = state_idle;
+                if (isspace(c)) {
+                    return GREENTEA_KV_INCOMPLETE;
+                }
+                continue;
+
+            case state_idle:
+                if (c == '{') {
+                    parser->state = state_open;
+                }
+                return GREENTEA_KV_INCOMPLETE;
+
+            case state_open:
+                if (c == '{') {
+                    parser->state = state_key_start;
+                    return GREENTEA_KV_INCOMPLETE;
+                }
+                break;
+
+            case state_key_start:
+                if (isspace(c)) {
+                    return GREENTEA_KV_INCOMPLETE;
+                }
+                if (isstring(c)) {
+                    token_begin(&parser->key);
+                    token_append(&parser->key, c);
+                    parser->state = state_key;
+                    return GREENTEA_KV_INCOMPLETE;
+                }
+                break;
+
+            case state_key:
+                if (isstring(c)) {
+                    token_append(&parser->key, c);
+                    return GREENTEA_KV_INCOMPLETE;
+                }
+                token_end(&parser->key);
+                if (c == ';') {
+                    parser->state = state_value_start;
+                    return GREENTEA_KV_INCOMPLETE;
+                }
+                break;
+
+            case state_value_start:
+                if (isspace(c)) {
+                    return GREENTEA_KV_INCOMPLETE;
+                }
+                if (isvalue(parser, c)) {
+                    token_begin(&parser->value);
+                    token_append(&parser->value, c);
+                    parser->state = state_value;
+                    return GREENTEA_KV_INCOMPLETE;
+                }
+                break;
+
+            case state_value:
+                if (isvalue(parser, c)) {
+                    token_append(&parser->value, c);
+                    return GREENTEA_KV_INCOMPLETE;
+                }
+                token_end(&parser->value);
+                if (c == '}') {
+                    parser->state = state_close;
+                    return GREENTEA_KV_INCOMPLETE;
+                }
+                token_discard(&parser->value);
+                break;
+
+            case state_close:
+                if (c == '}') {
+                    // Found "{{KEY;VALUE}}" expression
+                    parser->state = state_trail;
+                    return GREENTEA_KV_MESSAGE;
+                }
+                token_discard(&parser->value);
+                break;
+        }
+        parser->state = state_idle;
+    }
+}
+
+extern "C" greentea_kv_parser_result greentea_kv_parser_feed(greentea_kv_parser *parser,
+                                                             const char *data, size_t size,
+                                                             size_t *consumed)
+{
+    size_t i = 0;
+    greentea_kv_parser_result result = GREENTEA_KV_INCOMPLETE;
+    while (i < size && result == GREENTEA_KV_INCOMPLETE) {
+        result = greentea_kv_parser_push(parser, (unsigned char)data[i++]);
+    }
+    if (consumed) {
+        *consumed = i;
+    }
+    return result;
+}
+
+/**
+ *  Check if a character is a punctuation.
+ *
+ *  Auxilary key-value TOKENIZER function.
+ *
+ *  @details Defines if character is in subset of allowed punctuation
+ *           characters which can be part of a key or value string.
+ *           Invalid punctuation characters are: ";{}"
+ *
+ *  @param c Input character to check
+ *  @return Return 1 if character is allowed punctuation character, otherwise return 0
+ *
+ */
+static int ispunctuation(int c)
+{
+    static const char punctuation[] = "_-!@#$%^&*()=+:<>,./?\\\"'";  // No ";{}"
+    for (size_t i = 0; i < sizeof(punctuation); ++i) {
+        if (c == punctuation[i]) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ *  Check if character is string token character.
+ *
+ *  Auxilary key-value TOKENIZER function.
+ *
+ *  @details Defines if character is in subset of allowed string
+ *           token characters.
+ *           String defines set of characters which can be a key or value string.
+ *
+ *           Allowed subset includes:
+ *           - Alphanumerical characters
+ *           - Digits
+ *           - White spaces and
+ *           - subset of punctuation characters.
+ *
+ *  @param c Input character to check
+ *  @return Return 1 if character is allowed punctuation character, otherwise return false
+ *
+ */
+static int isstring(int c)
+{
+    return (isalpha(c) ||
+            isdigit(c) ||
+            isspace(c) ||
+            ispunctuation(c));
+}
+
+#endif // GREENTEA_CLIENT_PARSER
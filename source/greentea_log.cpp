@@ -0,0 +1,432 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <cstdarg>
+#include <cstring>
+#include "greentea-client/test_env.h"
+#include "greentea_log.h"
+#include "greentea_trace.h"
+
+#if GREENTEA_CLIENT_LOG
+
+#if !GREENTEA_CLIENT_ATOMICS
+#error "Deferred logging needs lock-free atomics, set GREENTEA_CLIENT_LOG to 0 for this target"
+#endif
+
+static_assert((GREENTEA_LOG_BUFFER_SIZE & (GREENTEA_LOG_BUFFER_SIZE - 1)) == 0,
+              "GREENTEA_LOG_BUFFER_SIZE must be a power of two");
+static_assert(GREENTEA_LOG_RECORD_SIZE > 1 + GREENTEA_VARINT_SIZE && GREENTEA_LOG_RECORD_SIZE <= 256,
+              "GREENTEA_LOG_RECORD_SIZE must hold a format string ID and fit the length byte");
+static_assert(GREENTEA_LOG_FRAME_SIZE >= GREENTEA_LOG_RECORD_SIZE,
+              "GREENTEA_LOG_FRAME_SIZE must hold a record");
+static_assert(GREENTEA_LOG_BUFFER_SIZE >= GREENTEA_LOG_RECORD_SIZE,
+              "GREENTEA_LOG_BUFFER_SIZE must hold a record");
+
+/**
+ *   Deferred logging transport protocol keys
+ */
+const char GREENTEA_TEST_ENV_LOG[] = "__log";
+const char GREENTEA_TEST_ENV_LOG_DROPPED[] = "__log_dropped";
+
+/**
+ * Bounds of the greentea_log_table section, defined by the linker if GREENTEA_LOG() is used
+ */
+extern "C" const char __start_greentea_log_table[] __attribute__((weak));
+extern "C" const char __stop_greentea_log_table[] __attribute__((weak));
+
+/**
+ *****************************************************************************
+ *  Log buffer
+ *****************************************************************************
+ *
+ *  A ring of records with many producers and one consumer, which never blocks a producer.
+ *  A producer reserves space by advancing log_reserved, writes the record and stores its
+ *  length byte last. The consumer sends the records whose length byte is set, zeroes them
+ *  and advances log_released, so a length byte of 0 is a record still being written.
+ */
+
+static std::atomic<uint8_t> log_buffer[GREENTEA_LOG_BUFFER_SIZE];
+
+/**
+ * Total number of bytes reserved by producers and released by the consumer
+ */
+static std::atomic<uint32_t> log_reserved(0);
+static std::atomic<uint32_t> log_released(0);
+
+static std::atomic<uint32_t> log_dropped(0);
+
+/**
+ * Number of dropped records last reported to the host
+ */
+static uint32_t log_dropped_sent = 0;
+
+/**
+ * Held by the consumer, so that a drain from a timer and one from the suite do not overlap
+ */
+static std::atomic_flag log_draining = ATOMIC_FLAG_INIT;
+
+/**
+ * Record being encoded
+ */
+struct LogRecord {
+    uint8_t data[GREENTEA_LOG_RECORD_SIZE];
+    size_t size;
+    bool full;
+};
+
+static void log_put_varint(LogRecord *record, uint64_t val)
+{
+    uint8_t encoded[GREENTEA_VARINT_SIZE];
+    const size_t len = greentea_varint_encode(encoded, val);
+    if (record->full || record->size + len > sizeof(record->data)) {
+        record->full = true;
+        return;
+    }
+    memcpy(record->data + record->size, encoded, len);
+    record->size += len;
+}
+
+static void log_put_signed(LogRecord *record, int64_t val)
+{
+    // Zigzag encoding
+    log_put_varint(record, ((uint64_t)val << 1) ^ (uint64_t)(val >> 63));
+}
+
+static void log_put_double(LogRecord *record, double val)
+{
+    uint64_t bits;
+    memcpy(&bits, &val, sizeof(bits));
+    if (record->full || record->size + sizeof(bits) > sizeof(record->data)) {
+        record->full = true;
+        return;
+    }
+    for (size_t i = 0; i < sizeof(bits); i++) {
+        record->data[record->size++] = (uint8_t)(bits >> (8 * i));
+    }
+}
+
+static void log_put_string(LogRecord *record, const char *str)
+{
+    if (!str) {
+        str = "(null)";
+    }
+    // Lengths below 128 take one byte, which is all a record can hold
+    if (record->full || record->size + 1 > sizeof(record->data)) {
+        record->full = true;
+        return;
+    }
+    const size_t room = sizeof(record->data) - record->size - 1;
+    size_t len = strlen(str);
+    if (len > room) {
+        len = room;
+    }
+    record->data[record->size++] = (uint8_t)len;
+    memcpy(record->data + record->size, str, len);
+    record->size += len;
+}
+
+/**
+ * Length modifier of a conversion
+ */
+enum LogLength {
+    LOG_DEFAULT,
+    LOG_LONG,
+    LOG_LONG_LONG,
+    LOG_INTMAX,
+    LOG_SIZE,
+    LOG_PTRDIFF,
+    LOG_LONG_DOUBLE
+};
+
+static void log_put_arguments(LogRecord *record, const char *format, va_list args)
+{
+    const char *p = format;
+    while (*p && !record->full) {
+        if (*p++ != '%') {
+            continue;
+        }
+        while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0') {
+            p++;
+        }
+        if (*p == '*') {
+            log_put_signed(record, va_arg(args, int));
+            p++;
+        }
+        while (*p >= '0' && *p <= '9') {
+            p++;
+        }
+        if (*p == '.') {
+            p++;
+            if (*p == '*') {
+                log_put_signed(record, va_arg(args, int));
+                p++;
+            }
+            while (*p >= '0' && *p <= '9') {
+                p++;
+            }
+        }
+
+        LogLength length = LOG_DEFAULT;
+        switch (*p) {
+            case 'h':
+                p += p[1] == 'h' ? 2 : 1;
+                break;
+            case 'l':
+                length = p[1] == 'l' ? LOG_LONG_LONG : LOG_LONG;
+                p += p[1] == 'l' ? 2 : 1;
+                break;
+            case 'j':
+                length = LOG_INTMAX;
+                p++;
+                break;
+            case 'z':
+                length = LOG_SIZE;
+                p++;
+                break;
+            case 't':
+                length = LOG_PTRDIFF;
+                p++;
+                break;
+            case 'L':
+                length = LOG_LONG_DOUBLE;
+                p++;
+                break;
+        }
+
+        switch (*p) {
+            case 'd':
+            case 'i':
+                switch (length) {
+                    case LOG_LONG:
+                        log_put_signed(record, va_arg(args, long));
+                        break;
+                    case LOG_LONG_LONG:
+                        log_put_signed(record, va_arg(args, long long));
+                        break;
+                    case LOG_INTMAX:
+                        log_put_signed(record, va_arg(args, intmax_t));
+                        break;
+                    case LOG_SIZE:
+                    case LOG_PTRDIFF:
+                        log_put_signed(record, va_arg(args, ptrdiff_t));
+                        break;
+                    default:
+                        log_put_signed(record, va_arg(args, int));
+                        break;
+                }
+                break;
+            case 'u':
+            case 'o':
+            case 'x':
+            case 'X':
+                switch (length) {
+                    case LOG_LONG:
+                        log_put_varint(record, va_arg(args, unsigned long));
+                        break;
+                    case LOG_LONG_LONG:
+                        log_put_varint(record, va_arg(args, unsigned long long));
+                        break;
+                    case LOG_INTMAX:
+                        log_put_varint(record, va_arg(args, uintmax_t));
+                        break;
+                    case LOG_SIZE:
+                        log_put_varint(record, va_arg(args, size_t));
+                        break;
+                    case LOG_PTRDIFF:
+                        log_put_varint(record, (uint64_t)va_arg(args, ptrdiff_t));
+                        break;
+                    default:
+                        log_put_varint(record, va_arg(args, unsigned int));
+                        break;
+                }
+                break;
+            case 'c':
+                log_put_varint(record, (unsigned char)va_arg(args, int));
+                break;
+            case 'p':
+                log_put_varint(record, (uintptr_t)va_arg(args, void *));
+                break;
+            case 'f':
+            case 'F':
+            case 'e':
+            case 'E':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A':
+                if (length == LOG_LONG_DOUBLE) {
+                    log_put_double(record, (double)va_arg(args, long double));
+                } else {
+                    log_put_double(record, va_arg(args, double));
+                }
+                break;
+            case 's':
+                log_put_string(record, va_arg(args, const char *));
+                break;
+            case 'n':
+                // Nothing is written back, the result is not known until the host formats it
+                (void)va_arg(args, void *);
+                break;
+            case '\0':
+                return;
+        }
+        p++;
+    }
+}
+
+extern "C" void greentea_log(const char *format, ...)
+{
+    LogRecord record;
+    record.size = 1;
+    record.full = false;
+    log_put_varint(&record, format - __start_greentea_log_table);
+
+    va_list args;
+    va_start(args, format);
+    log_put_arguments(&record, format, args);
+    va_end(args);
+    record.data[0] = (uint8_t)(record.size - 1);
+
+    uint32_t start = log_reserved.load(std::memory_order_relaxed);
+    do {
+        if (start + record.size - log_released.load(std::memory_order_acquire) > GREENTEA_LOG_BUFFER_SIZE) {
+            log_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    } while (!log_reserved.compare_exchange_weak(start, start + record.size, std::memory_order_relaxed));
+
+    for (size_t i = 1; i < record.size; i++) {
+        log_buffer[(start + i) % GREENTEA_LOG_BUFFER_SIZE].store(record.data[i], std::memory_order_relaxed);
+    }
+    log_buffer[start % GREENTEA_LOG_BUFFER_SIZE].store(record.data[0], std::memory_order_release);
+    greentea::detail::log_drain = greentea_log_drain;
+}
+
+/**
+ *****************************************************************************
+ *  Log drain
+ *****************************************************************************
+ */
+
+/**
+ * Encode data in base64 without padding.
+ *
+ * @return Number of characters written, (4 * size + 2) / 3
+ */
+static size_t log_base64(char *out, const uint8_t *data, size_t size)
+{
+    static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t len = 0;
+    for (size_t i = 0; i < size; i += 3) {
+        const uint32_t group = (uint32_t)data[i] << 16 |
+                               (i + 1 < size ? (uint32_t)data[i + 1] << 8 : 0) |
+                               (i + 2 < size ? data[i + 2] : 0);
+        const size_t chars = i + 2 < size ? 4 : i + 1 < size ? 3 : 2;
+        for (size_t c = 0; c < chars; c++) {
+            out[len++] = digits[(group >> (18 - 6 * c)) & 0x3f];
+        }
+    }
+    return len;
+}
+
+/**
+ * Send the number of dropped records if it changed since it was last sent.
+ *
+ * @return false if the message could not be written yet
+ */
+static bool log_send_dropped()
+{
+    const uint32_t dropped = log_dropped.load(std::memory_order_relaxed);
+    if (dropped == log_dropped_sent) {
+        return true;
+    }
+    greentea::detail::encoded value;
+    greentea::detail::encode(value, dropped);
+    const greentea_iovec frame[] = {
+        greentea::detail::preamble,
+        { GREENTEA_TEST_ENV_LOG_DROPPED, sizeof(GREENTEA_TEST_ENV_LOG_DROPPED) - 1 },
+        greentea::detail::separator,
+        value.get(),
+        greentea::detail::postamble
+    };
+    if (!greentea::detail::try_write_frame(frame, sizeof(frame) / sizeof(frame[0]))) {
+        return false;
+    }
+    log_dropped_sent = dropped;
+    return true;
+}
+
+extern "C" void greentea_log_drain(void)
+{
+    if (log_draining.test_and_set(std::memory_order_acquire)) {
+        return;
+    }
+    bool sending = log_send_dropped();
+    while (sending) {
+        // Collect whole records for one message
+        uint8_t raw[GREENTEA_LOG_FRAME_SIZE];
+        size_t size = 0;
+        const uint32_t start = log_released.load(std::memory_order_relaxed);
+        while (true) {
+            const uint32_t pos = start + size;
+            const size_t length = log_buffer[pos % GREENTEA_LOG_BUFFER_SIZE].load(std::memory_order_acquire);
+            if (length == 0 || size + 1 + length > sizeof(raw)) {
+                break;
+            }
+            for (size_t i = 0; i <= length; i++) {
+                raw[size + i] = log_buffer[(pos + i) % GREENTEA_LOG_BUFFER_SIZE].load(std::memory_order_relaxed);
+            }
+            size += 1 + length;
+        }
+        if (size == 0) {
+            break;
+        }
+
+        char text[(4 * GREENTEA_LOG_FRAME_SIZE + 2) / 3];
+        const greentea_iovec frame[] = {
+            greentea::detail::preamble,
+            { GREENTEA_TEST_ENV_LOG, sizeof(GREENTEA_TEST_ENV_LOG) - 1 },
+            greentea::detail::separator,
+            { text, log_base64(text, raw, size) },
+            greentea::detail::postamble
+        };
+        sending = greentea::detail::try_write_frame(frame, sizeof(frame) / sizeof(frame[0]));
+        if (sending) {
+            for (size_t i = 0; i < size; i++) {
+                log_buffer[(start + i) % GREENTEA_LOG_BUFFER_SIZE].store(0, std::memory_order_relaxed);
+            }
+            log_released.store(start + size, std::memory_order_release);
+        }
+    }
+    log_draining.clear(std::memory_order_release);
+}
+
+extern "C" uint32_t greentea_log_dropped(void)
+{
+    return log_dropped.load(std::memory_order_relaxed);
+}
+
+extern "C" const char *greentea_log_strings(size_t *size)
+{
+    if (size) {
+        *size = __start_greentea_log_table ? __stop_greentea_log_table - __start_greentea_log_table : 0;
+    }
+    return __start_greentea_log_table;
+}
+
+#endif // GREENTEA_CLIENT_LOG
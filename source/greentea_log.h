@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GREENTEA_CLIENT_LOG_H_
+#define GREENTEA_CLIENT_LOG_H_
+
+#include <stddef.h>
+#include "greentea-client/test_io.h"
+#include "greentea-client/test_log.h"
+
+/**
+ *  Greentea-client internal deferred logging helpers, see test_log.h for the record format
+ */
+
+#if GREENTEA_CLIENT_LOG
+namespace greentea {
+namespace detail {
+
+/**
+ * Write a complete key-value message, unless another message is being written.
+ *
+ * @details Unlike write_frame(), never waits, so it can be used from a timer or interrupt.
+ *
+ * @return true if the message was written
+ */
+bool try_write_frame(const greentea_iovec *iov, size_t count);
+
+/**
+ * Drain of the log run by GREENTEA_TESTSUITE_RESULT(), set by the first GREENTEA_LOG() so
+ * that images which do not log do not link the logger, NULL until then
+ */
+extern void (*volatile log_drain)(void);
+
+} // namespace detail
+} // namespace greentea
+#endif // GREENTEA_CLIENT_LOG
+
+#endif // GREENTEA_CLIENT_LOG_H_
@@ -0,0 +1,440 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "greentea-client/test_env.h"
+#include "greentea-client/test_runner.h"
+#include "greentea_runner.h"
+#if GREENTEA_CLIENT_PARALLEL
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#endif
+
+#if defined(__ELF__)
+/**
+ * Bounds of the greentea_case_table section, defined by the linker if GREENTEA_CASE() is used
+ */
+extern "C" const greentea_case __start_greentea_case_table[] __attribute__((weak));
+extern "C" const greentea_case __stop_greentea_case_table[] __attribute__((weak));
+#endif
+
+/**
+ * Checks the running test case passed and failed, of each thread running test cases
+ */
+#if GREENTEA_CLIENT_PARALLEL
+static thread_local size_t case_passes = 0;
+static thread_local size_t case_failures = 0;
+#else
+static size_t case_passes = 0;
+static size_t case_failures = 0;
+#endif
+
+void greentea_case_check(int passed)
+{
+    if (passed) {
+        case_passes++;
+    } else {
+        case_failures++;
+    }
+}
+
+/**
+ * Check if a test case is to be run, which is all of them unless the host assigned them.
+ */
+static bool case_selected(bool assigned, size_t index)
+{
+#if GREENTEA_CLIENT_PARSER && GREENTEA_CLIENT_EXTENDED
+    return !assigned || greentea_testcase_assigned(index);
+#else
+    (void)assigned;
+    (void)index;
+    return true;
+#endif
+}
+
+static void start_case(const greentea_case &test_case)
+{
+#if GREENTEA_CLIENT_EXTENDED
+    if (test_case.timeout_ms) {
+        GREENTEA_TESTCASE_START(test_case.name, test_case.timeout_ms);
+        return;
+    }
+#endif
+    GREENTEA_TESTCASE_START(test_case.name);
+}
+
+/**
+ * Run a test case on the thread of the suite.
+ *
+ * @return 1 if the test case failed, otherwise 0
+ */
+static size_t run_case(const greentea_case &test_case)
+{
+    case_passes = 0;
+    case_failures = 0;
+    start_case(test_case);
+    test_case.run();
+    GREENTEA_TESTCASE_FINISH(test_case.name, case_passes, case_failures);
+    return case_failures != 0;
+}
+
+#if GREENTEA_CLIENT_PARALLEL
+/**
+ *****************************************************************************
+ *  Parallel test cases
+ *****************************************************************************
+ *
+ *  A run of consecutive test cases flagged GREENTEA_CASE_PARALLEL_SAFE is shared between
+ *  worker threads, started for the first such run and kept until the suite ends. Each worker
+ *  owns a queue of the test cases, takes the next one from its front and, once it is empty,
+ *  steals from the back of the fullest queue. The messages a
+ *  test case sends are captured on its worker, and the thread of the suite writes them to
+ *  the stream in the order of the test cases, each between its __testcase_start and
+ *  __testcase_finish, as soon as it and those before it are done.
+ */
+
+/**
+ * Number of workers, 0 for one per hardware thread
+ */
+static size_t case_workers = 0;
+
+void greentea_set_case_workers(size_t workers)
+{
+    case_workers = workers;
+}
+
+/**
+ * Check if a test case runs on the workers. One with a time limit runs on the thread of the
+ * suite, which reports its start before it runs, so the host can enforce the limit.
+ */
+static bool case_parallel(const greentea_case &test_case)
+{
+    return (test_case.flags & GREENTEA_CASE_PARALLEL_SAFE) && test_case.timeout_ms == 0;
+}
+
+/**
+ * Messages sent by a test case run by a worker
+ */
+struct case_frames : greentea::detail::frame_capture {
+    std::string data;
+    std::vector<size_t> ends;   /**< End of each message in data */
+
+    case_frames() : frame_capture { append_frame, end_frame } {}
+
+    static void append_frame(frame_capture *capture, const void *data, size_t size)
+    {
+        static_cast<case_frames *>(capture)->data.append(static_cast<const char *>(data), size);
+    }
+
+    static void end_frame(frame_capture *capture)
+    {
+        case_frames *frames = static_cast<case_frames *>(capture);
+        frames->ends.push_back(frames->data.size());
+    }
+};
+
+/**
+ * Outcome of a test case run by a worker
+ */
+struct case_outcome {
+    case_frames frames;
+    size_t passes = 0;
+    size_t failures = 0;
+    uint64_t started_us = 0;
+    uint64_t finished_us = 0;
+    bool done = false;
+};
+
+/**
+ * Test cases of a worker still to run, positions in the batch from front to back
+ */
+struct case_queue {
+    std::mutex lock;
+    size_t front = 0;
+    size_t back = 0;
+};
+
+/**
+ * Test cases run in parallel
+ */
+struct case_batch {
+    const greentea_case *cases;
+    std::vector<size_t> indexes;    /**< Position of each test case of the batch in cases */
+    std::vector<case_outcome> outcomes;
+    std::unique_ptr<case_queue[]> queues;
+    size_t workers;
+    std::mutex done_lock;
+    std::condition_variable done;
+};
+
+/**
+ * Take the next test case of a worker, stolen from another worker once its own are taken.
+ *
+ * @return true if a test case was taken, false once all are
+ */
+static bool take_case(case_batch &batch, size_t worker, size_t *position)
+{
+    {
+        case_queue &own = batch.queues[worker];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (own.front < own.back) {
+            *position = own.front++;
+            return true;
+        }
+    }
+    while (true) {
+        size_t victim = worker;
+        size_t most = 0;
+        for (size_t i = 0; i < batch.workers; i++) {
+            case_queue &queue = batch.queues[i];
+            std::lock_guard<std::mutex> guard(queue.lock);
+            if (queue.back - queue.front > most) {
+                most = queue.back - queue.front;
+                victim = i;
+            }
+        }
+        if (most == 0) {
+            return false;
+        }
+        case_queue &queue = batch.queues[victim];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        // Otherwise taken meanwhile, look again
+        if (queue.front < queue.back) {
+            *position = --queue.back;
+            return true;
+        }
+    }
+}
+
+/**
+ * Worker threads running the batches of test cases of a suite
+ */
+struct case_pool {
+    std::vector<std::thread> threads;
+    std::mutex lock;
+    std::condition_variable work;   /**< A batch was posted or the pool stops */
+    std::condition_variable idle;   /**< A worker is done with the batch */
+    case_batch *batch = nullptr;
+    unsigned long generation = 0;   /**< Number of batches posted */
+    size_t active = 0;              /**< Workers not done with the batch */
+    bool stop = false;
+
+    ~case_pool()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stop = true;
+        }
+        work.notify_all();
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+    }
+};
+
+static void run_worker(case_batch &batch, size_t worker)
+{
+    size_t position;
+    while (take_case(batch, worker, &position)) {
+        const greentea_case &test_case = batch.cases[batch.indexes[position]];
+        case_outcome &outcome = batch.outcomes[position];
+        greentea::detail::captured_frames = &outcome.frames;
+        case_passes = 0;
+        case_failures = 0;
+        outcome.started_us = greentea_time_us();
+        test_case.run();
+        outcome.finished_us = greentea_time_us();
+        outcome.passes = case_passes;
+        outcome.failures = case_failures;
+        greentea::detail::captured_frames = NULL;
+        {
+            std::lock_guard<std::mutex> guard(batch.done_lock);
+            outcome.done = true;
+        }
+        batch.done.notify_one();
+    }
+}
+
+static void run_pool_worker(case_pool &pool, size_t worker)
+{
+    unsigned long generation = 0;
+    while (true) {
+        case_batch *batch;
+        {
+            std::unique_lock<std::mutex> guard(pool.lock);
+            pool.work.wait(guard, [&pool, generation] { return pool.stop || pool.generation != generation; });
+            if (pool.stop) {
+                return;
+            }
+            generation = pool.generation;
+            batch = pool.batch;
+        }
+        run_worker(*batch, worker);
+        {
+            std::lock_guard<std::mutex> guard(pool.lock);
+            pool.active--;
+        }
+        pool.idle.notify_one();
+    }
+}
+
+/**
+ * Start the workers of a suite, as many as set with greentea_set_case_workers() but no more
+ * than the test cases they can run, from the first parallel one.
+ */
+static void start_pool(case_pool &pool, const greentea_case *cases, size_t count, bool assigned, size_t first)
+{
+    size_t workers = case_workers ? case_workers : std::thread::hardware_concurrency();
+    size_t parallel = 0;
+    for (size_t i = first; i < count && parallel < workers; i++) {
+        parallel += case_selected(assigned, i) && case_parallel(cases[i]);
+    }
+    if (parallel < 2) {
+        return;
+    }
+    for (size_t i = 0; i < parallel; i++) {
+        pool.threads.emplace_back(run_pool_worker, std::ref(pool), i);
+    }
+}
+
+/**
+ * Run test cases on the workers and report them in order.
+ *
+ * @return Number of test cases which failed
+ */
+static size_t run_parallel(case_pool &pool, const greentea_case *cases, std::vector<size_t> indexes)
+{
+    const size_t workers = pool.threads.size();
+    if (workers < 2 || indexes.size() < 2) {
+        size_t failed = 0;
+        for (const size_t index : indexes) {
+            failed += run_case(cases[index]);
+        }
+        return failed;
+    }
+
+    case_batch batch;
+    batch.cases = cases;
+    batch.indexes = std::move(indexes);
+    batch.outcomes.resize(batch.indexes.size());
+    batch.queues.reset(new case_queue[workers]);
+    batch.workers = workers;
+    for (size_t i = 0; i < workers; i++) {
+        batch.queues[i].front = batch.indexes.size() * i / workers;
+        batch.queues[i].back = batch.indexes.size() * (i + 1) / workers;
+    }
+    {
+        std::lock_guard<std::mutex> guard(pool.lock);
+        pool.batch = &batch;
+        pool.generation++;
+        pool.active = workers;
+    }
+    pool.work.notify_all();
+
+    size_t failed = 0;
+    for (size_t position = 0; position < batch.indexes.size(); position++) {
+        const case_outcome &outcome = batch.outcomes[position];
+        {
+            std::unique_lock<std::mutex> guard(batch.done_lock);
+            batch.done.wait(guard, [&outcome] { return outcome.done; });
+        }
+        const greentea_case &test_case = cases[batch.indexes[position]];
+        start_case(test_case);
+        size_t start = 0;
+        for (const size_t end : outcome.frames.ends) {
+            greentea::detail::write_captured(outcome.frames.data.data() + start, end - start);
+            start = end;
+        }
+        greentea::detail::finish_case(test_case.name, outcome.passes, outcome.failures, outcome.started_us,
+                                      outcome.finished_us);
+        failed += outcome.failures != 0;
+    }
+    // Workers may still be looking for test cases in the queues of the batch
+    std::unique_lock<std::mutex> guard(pool.lock);
+    pool.idle.wait(guard, [&pool] { return pool.active == 0; });
+    return failed;
+}
+#endif // GREENTEA_CLIENT_PARALLEL
+
+size_t greentea_run_cases(const greentea_case *cases, size_t count)
+{
+    const char *const *names = count ? &cases[0].name : NULL;
+    bool assigned = false;
+#if GREENTEA_CLIENT_PARSER && GREENTEA_CLIENT_EXTENDED
+    // Without the capability, the host may not answer __shard_request
+    assigned = greentea::detail::host_assigns_cases();
+    if (assigned) {
+        greentea::detail::request_cases(names, sizeof(cases[0]), count);
+    } else
+#endif
+    {
+        greentea::detail::announce_cases(names, sizeof(cases[0]), count);
+    }
+
+    size_t failed = 0;
+#if GREENTEA_CLIENT_PARALLEL
+    std::unique_ptr<case_pool> pool;
+#endif
+    for (size_t i = 0; i < count; i++) {
+        if (!case_selected(assigned, i)) {
+            continue;
+        }
+#if GREENTEA_CLIENT_PARALLEL
+        if (case_parallel(cases[i])) {
+            if (!pool) {
+                pool.reset(new case_pool);
+                start_pool(*pool, cases, count, assigned, i);
+            }
+            // The test cases selected up to the next one which is not run in parallel
+            std::vector<size_t> indexes;
+            for (; i < count; i++) {
+                if (!case_selected(assigned, i)) {
+                    continue;
+                }
+                if (!case_parallel(cases[i])) {
+                    break;
+                }
+                indexes.push_back(i);
+            }
+            failed += run_parallel(*pool, cases, std::move(indexes));
+            i--;
+            continue;
+        }
+#endif
+        failed += run_case(cases[i]);
+    }
+#if GREENTEA_CLIENT_PARALLEL
+    pool.reset();
+#endif
+
+    GREENTEA_TESTSUITE_RESULT(failed == 0);
+    return failed;
+}
+
+#if defined(__ELF__)
+size_t greentea_run_registered_cases(void)
+{
+    if (!__start_greentea_case_table) {
+        return greentea_run_cases(NULL, 0);
+    }
+    return greentea_run_cases(__start_greentea_case_table,
+                              __stop_greentea_case_table - __start_greentea_case_table);
+}
+#endif
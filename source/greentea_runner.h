@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GREENTEA_CLIENT_RUNNER_H_
+#define GREENTEA_CLIENT_RUNNER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "greentea-client/greentea_config.h"
+
+/**
+ *  Greentea-client internal helpers of the test case runner, see test_runner.h
+ *
+ *  The names of the test cases are read stride bytes apart, so that they can be taken from
+ *  an array of names as well as from a table of test cases whose first member is the name.
+ */
+
+namespace greentea {
+namespace detail {
+
+/**
+ * Send the names of the test cases and their number, see GREENTEA_TESTCASE_NAMES().
+ */
+void announce_cases(const char *const *names, size_t stride, size_t count);
+
+#if GREENTEA_CLIENT_PARSER && GREENTEA_CLIENT_EXTENDED
+/**
+ * Send the names of the test cases and receive those to run from the host, see
+ * GREENTEA_TESTCASE_SHARD().
+ *
+ * @return Number of test cases assigned
+ */
+size_t request_cases(const char *const *names, size_t stride, size_t count);
+
+/**
+ * Check if the host advertised "shard" in its capabilities, so it answers __shard_request.
+ */
+bool host_assigns_cases();
+#endif // GREENTEA_CLIENT_PARSER && GREENTEA_CLIENT_EXTENDED
+
+/**
+ * Send __testcase_finish and count the test case in the summary, see
+ * GREENTEA_TESTCASE_FINISH().
+ *
+ * @param started_us Time the test case started, from greentea_time_us()
+ * @param finished_us Time the test case finished, from greentea_time_us()
+ */
+void finish_case(const char *name, size_t passes, size_t failures, uint64_t started_us, uint64_t finished_us);
+
+#if GREENTEA_CLIENT_PARALLEL
+/**
+ * Holder of the messages sent by a test case running on a worker thread, until they are
+ * written to the stream in the order of the test cases. Only the runner knows how they are
+ * held, so that other images do not link it.
+ */
+struct frame_capture {
+    /** Append part of a message */
+    void (*append)(frame_capture *capture, const void *data, size_t size);
+    /** Mark the end of a message */
+    void (*end)(frame_capture *capture);
+};
+
+/**
+ * Capture of the messages sent on this thread, NULL to write them to the stream
+ */
+extern thread_local frame_capture *captured_frames;
+
+/**
+ * Write a captured message to the stream, as if it was sent now.
+ *
+ * @param frame Complete key-value message
+ * @param size Size of the message in bytes
+ */
+void write_captured(const char *frame, size_t size);
+#endif // GREENTEA_CLIENT_PARALLEL
+
+} // namespace detail
+} // namespace greentea
+
+#endif // GREENTEA_CLIENT_RUNNER_H_
@@ -15,258 +15,1321 @@
  * limitations under the License.
  */
 
+#include <atomic>
 #include <cctype>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include "greentea-client/test_env.h"
+#include "greentea_format.h"
+#include "greentea_journal.h"
+#include "greentea_log.h"
+#include "greentea_runner.h"
+#include "greentea_trace.h"
 
 /**
  *   Generic test suite transport protocol keys
  */
-const char *GREENTEA_TEST_ENV_END = "end";
-const char *GREENTEA_TEST_ENV_EXIT = "__exit";
-const char *GREENTEA_TEST_ENV_SYNC = "__sync";
-const char *GREENTEA_TEST_ENV_TIMEOUT = "__timeout";
-const char *GREENTEA_TEST_ENV_HOST_TEST_NAME = "__host_test_name";
-const char *GREENTEA_TEST_ENV_HOST_TEST_VERSION = "__version";
+const char GREENTEA_TEST_ENV_END[] = "end";
+const char GREENTEA_TEST_ENV_EXIT[] = "__exit";
+const char GREENTEA_TEST_ENV_SYNC[] = "__sync";
+const char GREENTEA_TEST_ENV_TIMEOUT[] = "__timeout";
+const char GREENTEA_TEST_ENV_HOST_TEST_NAME[] = "__host_test_name";
+const char GREENTEA_TEST_ENV_HOST_TEST_VERSION[] = "__version";
+#if GREENTEA_CLIENT_PARSER
+const char GREENTEA_TEST_ENV_CAPABILITIES[] = "__capabilities";
+const char GREENTEA_TEST_ENV_LINE_RATE[] = "__line_rate";
+#endif
+
+/**
+ *   Test suite success code strings
+ */
+const char GREENTEA_TEST_ENV_SUCCESS[] = "success";
+const char GREENTEA_TEST_ENV_FAILURE[] = "failure";
+
+/**
+ *   Test case transport protocol start/finish keys
+ */
+const char GREENTEA_TEST_ENV_TESTCASE_NAME[] = "__testcase_name";
+const char GREENTEA_TEST_ENV_TESTCASE_COUNT[] = "__testcase_count";
+const char GREENTEA_TEST_ENV_TESTCASE_START[] = "__testcase_start";
+const char GREENTEA_TEST_ENV_TESTCASE_FINISH[] = "__testcase_finish";
+const char GREENTEA_TEST_ENV_TESTCASE_SUMMARY[] = "__testcase_summary";
+#if GREENTEA_CLIENT_EXTENDED
+const char GREENTEA_TEST_ENV_TESTCASE_DURATIONS[] = "__testcase_durations";
+const char GREENTEA_TEST_ENV_TESTCASE_TIMEOUT[] = "__testcase_timeout";
+const char GREENTEA_TEST_ENV_HEARTBEAT[] = "__heartbeat";
+
+/**
+ *   Test case sharding transport protocol keys
+ */
+const char GREENTEA_TEST_ENV_SHARD_REQUEST[] = "__shard_request";
+const char GREENTEA_TEST_ENV_SHARD[] = "__shard";
+const char GREENTEA_TEST_ENV_SHARD_CASES[] = "__shard_cases";
+
+/**
+ *   Clock synchronization transport protocol keys
+ */
+const char GREENTEA_TEST_ENV_CLOCK_PING[] = "__clock_ping";
+const char GREENTEA_TEST_ENV_CLOCK_PONG[] = "__clock_pong";
+const char GREENTEA_TEST_ENV_CLOCK_SYNC[] = "__clock_sync";
+
+/**
+ *   Link benchmark transport protocol keys
+ */
+const char GREENTEA_TEST_ENV_LINK_BENCH_REQUEST[] = "__link_bench_request";
+const char GREENTEA_TEST_ENV_LINK_BENCH_PING[] = "__link_bench_ping";
+const char GREENTEA_TEST_ENV_LINK_BENCH_PONG[] = "__link_bench_pong";
+const char GREENTEA_TEST_ENV_LINK_BENCH_DATA[] = "__link_bench_data";
+const char GREENTEA_TEST_ENV_LINK_BENCH_SEND[] = "__link_bench_send";
+const char GREENTEA_TEST_ENV_LINK_BENCH_ACK[] = "__link_bench_ack";
+const char GREENTEA_TEST_ENV_LINK_BENCH_DONE[] = "__link_bench_done";
+const char GREENTEA_TEST_ENV_LINK_BENCH_RESULT[] = "__link_bench_result";
+#endif // GREENTEA_CLIENT_EXTENDED
+#if GREENTEA_CLIENT_JOURNAL
+
+/**
+ *   Result journal transport protocol keys
+ */
+const char GREENTEA_TEST_ENV_SEQ[] = "__seq";
+const char GREENTEA_TEST_ENV_REPLAY[] = "__replay";
+const char GREENTEA_TEST_ENV_JOURNAL_END[] = "__journal_end";
+const char GREENTEA_TEST_ENV_JOURNAL_DONE[] = "__journal_done";
+#endif // GREENTEA_CLIENT_JOURNAL
+// Code Coverage (LCOV)  transport protocol keys
+const char GREENTEA_TEST_ENV_LCOV_START[] = "__coverage_start";
+
+/**
+ * Send a key-value message with one of the protocol keys above, whose length is known
+ * at compile time.
+ */
+template <size_t N, typename... Args>
+static void greentea_send_protocol(const char (&key)[N], const Args &... values)
+{
+    greentea::send_n(key, N - 1, values...);
+}
+
+/**
+ *   Auxilary functions
+ */
+static void greentea_notify_timeout(const int);
+static void greentea_notify_hosttest(const char *);
+static void greentea_notify_completion(const int);
+static void greentea_notify_version();
+static void greentea_notify_capabilities(size_t max_value_size);
+static void greentea_flush_pending();
+static void greentea_stop_heartbeat();
+static void greentea_notify_summary();
+static void greentea_reset_summary();
+static void greentea_reset_clock_sync();
+static void greentea_output_lock();
+static void greentea_output_unlock();
+static void greentea_journal_sync();
+
+#if GREENTEA_CLIENT_PARSER
+/**
+ * Whether the host advertised its capabilities before __sync, the fastest line rate it supports,
+ * whether it numbers the journaled messages and whether it assigns test cases
+ */
+static bool host_capable = false;
+static uint32_t host_line_rate = 0;
+static bool host_journal = false;
+static bool host_shard = false;
+
+static void greentea_parse_host_capabilities(const char *value);
+#endif // GREENTEA_CLIENT_PARSER
+
+/**
+ * Handle the handshake with the host.
+ *
+ * @details This function contains the shared handshake functionality that is used between
+ *          GREENTEA_SETUP, GREENTEA_SETUP_UUID and GREENTEA_SETUP_TIMEOUT.
+ *
+ * @note This function is blocking. Without GREENTEA_CLIENT_PARSER there is no handshake,
+ *       the setup data is sent straight away.
+ *
+ * @param sync_timeout_ms Maximum time to wait for the host in milliseconds, negative to
+ *                        wait for ever
+ *
+ * @return 0 on success, -1 if the host did not sync in time or the stream ended
+ */
+static int _GREENTEA_SETUP_COMMON(const int timeout, const char *host_test_name, char *buffer, size_t size,
+                                  int64_t sync_timeout_ms = -1)
+{
+    // Key-value protocol handshake function. Waits for {{__sync;...}} message
+    // Sync preamble: "{{__sync;0dad4a9d-59a3-4aec-810d-d5fb09d852c1}}"
+    // Example value of sync_uuid == "0dad4a9d-59a3-4aec-810d-d5fb09d852c1"
+
+#if GREENTEA_CLIENT_PARSER
+    char _key[16] = {0};
+    const uint64_t start_us = greentea_time_us();
+    host_capable = false;
+    host_journal = false;
+    host_shard = false;
+
+    while (1) {
+        if (sync_timeout_ms < 0) {
+            greentea_parse_kv(_key, buffer, sizeof(_key), size);
+        } else {
+            const uint64_t elapsed_ms = (greentea_time_us() - start_us) / 1000;
+            const uint32_t remaining_ms = elapsed_ms >= (uint64_t)sync_timeout_ms ? 0 :
+                                          (uint32_t)(sync_timeout_ms - elapsed_ms);
+            if (greentea_parse_kv_timeout(_key, buffer, sizeof(_key), size, remaining_ms) <= 0) {
+                return -1;
+            }
+        }
+        static const char mbed_sync[] = "mbedmbedmbedmbedmbedmbedmbedmbed\r\n";
+        greentea_output_lock();
+        greentea_write_n(mbed_sync, sizeof(mbed_sync) - 1);
+        greentea_trace_record(GREENTEA_TRACE_TX, mbed_sync, sizeof(mbed_sync) - 1);
+        greentea_output_unlock();
+        if (strcmp(_key, GREENTEA_TEST_ENV_SYNC) == 0) {
+            // Found correct __sync message
+            greentea_send_kv(_key, buffer);
+            break;
+        }
+        if (strcmp(_key, GREENTEA_TEST_ENV_CAPABILITIES) == 0) {
+            greentea_parse_host_capabilities(buffer);
+        }
+    }
+#else
+    (void)buffer;
+    (void)size;
+    (void)sync_timeout_ms;
+#endif // GREENTEA_CLIENT_PARSER
+
+    greentea_reset_summary();
+    greentea_reset_clock_sync();
+    greentea_notify_version();
+    // The host is told the largest value the handshake buffer takes, with its NUL terminator
+    greentea_notify_capabilities(size ? size - 1 : 0);
+    greentea_notify_timeout(timeout);
+    greentea_notify_hosttest(host_test_name);
+    return 0;
+}
+
+/**
+ * Size of the buffer GREENTEA_SETUP() and GREENTEA_SETUP_TIMEOUT() receive the handshake in,
+ * which takes a UUID and values of GREENTEA_MAX_VALUE_SIZE
+ */
+#if GREENTEA_CLIENT_PARSER
+#define GREENTEA_SETUP_BUFFER_SIZE \
+    (GREENTEA_MAX_VALUE_SIZE + 1 > GREENTEA_UUID_LENGTH ? GREENTEA_MAX_VALUE_SIZE + 1 : GREENTEA_UUID_LENGTH)
+#else
+#define GREENTEA_SETUP_BUFFER_SIZE  GREENTEA_UUID_LENGTH
+#endif
+
+extern "C" void GREENTEA_SETUP(const int timeout, const char *host_test_name)
+{
+#if ! defined(NO_GREENTEA)
+    char _value[GREENTEA_SETUP_BUFFER_SIZE] = {0};
+    _GREENTEA_SETUP_COMMON(timeout, host_test_name, _value, sizeof(_value));
+#endif
+}
+
+#if GREENTEA_CLIENT_PARSER
+void GREENTEA_SETUP_UUID(const int timeout, const char *host_test_name, char *buffer, size_t size)
+{
+    _GREENTEA_SETUP_COMMON(timeout, host_test_name, buffer, size);
+}
+
+extern "C" int GREENTEA_SETUP_TIMEOUT(const int timeout, const char *host_test_name, uint32_t sync_timeout_ms)
+{
+    char _value[GREENTEA_SETUP_BUFFER_SIZE] = {0};
+    return _GREENTEA_SETUP_COMMON(timeout, host_test_name, _value, sizeof(_value), sync_timeout_ms);
+}
+#endif // GREENTEA_CLIENT_PARSER
+
+void GREENTEA_TESTSUITE_RESULT(const int result)
+{
+    greentea_stop_heartbeat();
+#if GREENTEA_CLIENT_LOG
+    if (greentea::detail::log_drain) {
+        greentea::detail::log_drain();
+    }
+#endif
+    greentea_notify_summary();
+    greentea_notify_completion(result);
+    greentea_flush_pending();
+}
+
+/**
+ *****************************************************************************
+ *  Test case bookkeeping
+ *****************************************************************************
+ */
+
+#if GREENTEA_CLIENT_EXTENDED
+/**
+ * Results of the test cases of the suite, sent at once by greentea_notify_summary()
+ */
+static struct {
+    size_t registered;
+    size_t passed;
+    size_t failed;
+    size_t finished;
+    uint64_t started_us;
+    bool timed;
+    uint32_t durations_us[GREENTEA_SUMMARY_MAX_CASES];
+} summary;
+#endif // GREENTEA_CLIENT_EXTENDED
+
+void GREENTEA_TESTCASE_START(const char *test_case_name)
+{
+    greentea_send_protocol(GREENTEA_TEST_ENV_TESTCASE_START, test_case_name);
+#if GREENTEA_CLIENT_EXTENDED
+    summary.started_us = greentea_time_us();
+#endif
+}
+
+#if GREENTEA_CLIENT_EXTENDED
+void GREENTEA_TESTCASE_START(const char *test_case_name, uint32_t timeout_ms)
+{
+    GREENTEA_TESTCASE_START(test_case_name);
+    greentea_send_protocol(GREENTEA_TEST_ENV_TESTCASE_TIMEOUT, timeout_ms);
+}
+#endif // GREENTEA_CLIENT_EXTENDED
+
+void GREENTEA_TESTCASE_FINISH(const char *test_case_name, const size_t passes, const size_t failed)
+{
+#if GREENTEA_CLIENT_EXTENDED
+    greentea::detail::finish_case(test_case_name, passes, failed, summary.started_us, greentea_time_us());
+#else
+    greentea::detail::finish_case(test_case_name, passes, failed, 0, 0);
+#endif
+}
+
+void greentea::detail::finish_case(const char *name, size_t passes, size_t failures, uint64_t started_us,
+                                   uint64_t finished_us)
+{
+#if GREENTEA_CLIENT_EXTENDED
+    if (summary.finished < GREENTEA_SUMMARY_MAX_CASES) {
+        const uint64_t duration = finished_us - started_us;
+        summary.durations_us[summary.finished] = duration > UINT32_MAX ? UINT32_MAX : (uint32_t)duration;
+    }
+    summary.timed = summary.timed || finished_us != 0;
+    summary.finished++;
+    if (failures) {
+        summary.failed++;
+    } else {
+        summary.passed++;
+    }
+#else
+    (void)started_us;
+    (void)finished_us;
+#endif // GREENTEA_CLIENT_EXTENDED
+    greentea_send_protocol(GREENTEA_TEST_ENV_TESTCASE_FINISH, name, passes, failures);
+}
+
+/**
+ * Get the name of a test case from names which are stride bytes apart.
+ */
+static const char *greentea_case_name(const char *const *names, size_t stride, size_t index)
+{
+    return *reinterpret_cast<const char *const *>(reinterpret_cast<const char *>(names) + index * stride);
+}
+
+void greentea::detail::announce_cases(const char *const *names, size_t stride, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        greentea_send_protocol(GREENTEA_TEST_ENV_TESTCASE_NAME, greentea_case_name(names, stride, i));
+    }
+    greentea_send_protocol(GREENTEA_TEST_ENV_TESTCASE_COUNT, count);
+#if GREENTEA_CLIENT_EXTENDED
+    summary.registered = count;
+#endif
+}
+
+void GREENTEA_TESTCASE_NAMES(const char *const names[], size_t count)
+{
+    greentea::detail::announce_cases(names, sizeof(names[0]), count);
+}
+
+#if GREENTEA_CLIENT_EXTENDED
+/**
+ * Producer of the value of the __testcase_durations message, one duration at a time.
+ */
+static size_t greentea_produce_durations(char *buffer, size_t size, void *context)
+{
+    size_t *next = static_cast<size_t *>(context);
+    const size_t count = summary.finished < GREENTEA_SUMMARY_MAX_CASES ? summary.finished : GREENTEA_SUMMARY_MAX_CASES;
+    size_t len = 0;
+    // A separator and 10 digits fit any duration
+    while (*next < count && size - len >= 11) {
+        if (*next > 0) {
+            buffer[len++] = ',';
+        }
+        greentea::detail::encoded digits;
+        greentea::detail::encode(digits, summary.durations_us[*next]);
+        const greentea_iovec text = digits.get();
+        memcpy(buffer + len, text.iov_base, text.iov_len);
+        len += text.iov_len;
+        (*next)++;
+    }
+    return len;
+}
+
+/**
+ * Send the summary of the test cases reported since the suite started, if there were any.
+ */
+static void greentea_notify_summary()
+{
+    if (summary.registered || summary.finished) {
+        greentea_send_protocol(GREENTEA_TEST_ENV_TESTCASE_SUMMARY, summary.passed, summary.failed);
+        if (summary.timed) {
+            size_t next = 0;
+            greentea_send_kv_stream(GREENTEA_TEST_ENV_TESTCASE_DURATIONS, greentea_produce_durations, &next);
+        }
+    }
+    greentea_reset_summary();
+}
+
+static void greentea_reset_summary()
+{
+    memset(&summary, 0, sizeof(summary));
+}
+#else
+static void greentea_notify_summary()
+{
+}
+
+static void greentea_reset_summary()
+{
+}
+#endif // GREENTEA_CLIENT_EXTENDED
+
+#if GREENTEA_CLIENT_PARSER && GREENTEA_CLIENT_EXTENDED
+/**
+ *****************************************************************************
+ *  Test case sharding
+ *****************************************************************************
+ */
+
+/**
+ * Test cases assigned by the host, see GREENTEA_TESTCASE_SHARD()
+ */
+static size_t shard_index = 0;
+static size_t shard_count = 1;
+static bool shard_by_name = false;
+static unsigned char shard_cases[(GREENTEA_SHARD_MAX_CASES + 7) / 8];
+
+/**
+ * State of the value sink receiving the assignment of the host
+ */
+struct ShardReceiver {
+    const char *key;
+    const char *const *names;
+    size_t stride;
+    size_t count;
+    char token[GREENTEA_SHARD_NAME_SIZE];
+    size_t length;
+};
+
+/**
+ * Select the test case named by the token received so far, or at the position given by a
+ * "#<index>" token.
+ */
+static void shard_select_token(ShardReceiver *receiver)
+{
+    if (receiver->length < sizeof(receiver->token)) {
+        const char *token = receiver->token;
+        receiver->token[receiver->length] = '\0';
+        if (token[0] == '#') {
+            char *end;
+            const unsigned long index = strtoul(token + 1, &end, 10);
+            if (end != token + 1 && *end == '\0' && index < receiver->count && index < GREENTEA_SHARD_MAX_CASES) {
+                shard_cases[index / 8] |= 1 << (index % 8);
+            }
+        } else {
+            for (size_t i = 0; i < receiver->count && i < GREENTEA_SHARD_MAX_CASES; i++) {
+                if (strcmp(greentea_case_name(receiver->names, receiver->stride, i), token) == 0) {
+                    shard_cases[i / 8] |= 1 << (i % 8);
+                }
+            }
+        }
+    }
+    receiver->length = 0;
+}
+
+/**
+ * Value sink matching the names of a __shard_cases message as they arrive, or
+ * storing the value of a __shard message, so the list is never held as a whole.
+ */
+static void shard_sink(const char *data, size_t size, void *context)
+{
+    ShardReceiver *receiver = static_cast<ShardReceiver *>(context);
+    const bool by_name = strcmp(receiver->key, GREENTEA_TEST_ENV_SHARD_CASES) == 0;
+    if (!data) {
+        memset(shard_cases, 0, sizeof(shard_cases));
+        receiver->length = 0;
+        return;
+    }
+    for (size_t i = 0; i < size; i++) {
+        if (by_name && data[i] == ',') {
+            shard_select_token(receiver);
+        } else if (receiver->length < sizeof(receiver->token)) {
+            receiver->token[receiver->length++] = data[i];
+        } else {
+            // Too long to be one of the names, never matched
+            receiver->length = sizeof(receiver->token);
+        }
+    }
+}
+
+/**
+ * Parse the "index/count" value of a __shard message.
+ */
+static void shard_parse_modulo(const char *value)
+{
+    char *end;
+    const unsigned long index = strtoul(value, &end, 10);
+    const unsigned long count = *end == '/' ? strtoul(end + 1, NULL, 10) : 0;
+    if (count > 0 && index < count) {
+        shard_index = index;
+        shard_count = count;
+    }
+}
+
+/**
+ * Assign all test cases to this DUT.
+ */
+static void shard_reset()
+{
+    shard_index = 0;
+    shard_count = 1;
+    shard_by_name = false;
+    memset(shard_cases, 0, sizeof(shard_cases));
+}
+
+size_t greentea::detail::request_cases(const char *const *names, size_t stride, size_t count)
+{
+    shard_reset();
+
+    for (size_t i = 0; i < count; i++) {
+        greentea_send_protocol(GREENTEA_TEST_ENV_TESTCASE_NAME, greentea_case_name(names, stride, i));
+    }
+    greentea_send_protocol(GREENTEA_TEST_ENV_SHARD_REQUEST, count);
+
+    char key[16];
+    ShardReceiver receiver = { key, names, stride, count, {0}, 0 };
+    while (greentea_parse_kv_stream(key, sizeof(key), shard_sink, &receiver, NULL)) {
+        if (strcmp(key, GREENTEA_TEST_ENV_SHARD_CASES) == 0) {
+            shard_select_token(&receiver);
+            shard_by_name = true;
+            break;
+        }
+        if (strcmp(key, GREENTEA_TEST_ENV_SHARD) == 0) {
+            receiver.token[receiver.length < sizeof(receiver.token) ? receiver.length : 0] = '\0';
+            shard_parse_modulo(receiver.token);
+            break;
+        }
+        receiver.length = 0;
+    }
+
+    size_t assigned = 0;
+    for (size_t i = 0; i < count; i++) {
+        assigned += greentea_testcase_assigned(i);
+    }
+    greentea_send_protocol(GREENTEA_TEST_ENV_TESTCASE_COUNT, assigned);
+    summary.registered = assigned;
+    return assigned;
+}
+
+size_t GREENTEA_TESTCASE_SHARD(const char *const names[], size_t count)
+{
+    // Without the capability, the host may not answer __shard_request
+    if (!host_shard) {
+        shard_reset();
+        greentea::detail::announce_cases(names, sizeof(names[0]), count);
+        return count;
+    }
+    return greentea::detail::request_cases(names, sizeof(names[0]), count);
+}
+
+bool greentea::detail::host_assigns_cases()
+{
+    return host_shard;
+}
+
+bool greentea_testcase_assigned(size_t index)
+{
+    if (shard_by_name) {
+        return index < GREENTEA_SHARD_MAX_CASES && (shard_cases[index / 8] & (1 << (index % 8)));
+    }
+    return index % shard_count == shard_index;
+}
+
+/**
+ *****************************************************************************
+ *  Clock synchronization
+ *****************************************************************************
+ */
+
+/**
+ * First measurement since GREENTEA_SETUP(), the reference of the drift
+ */
+static bool clock_synced = false;
+static int64_t clock_first_device_us = 0;
+static int64_t clock_first_offset_us = 0;
+
+static void greentea_reset_clock_sync()
+{
+    clock_synced = false;
+}
+
+/**
+ * Wait for the answer of the host to a ping, skipping any other message.
+ *
+ * @param seq Sequence number of the ping
+ * @param start_us Device time the ping was sent
+ * @param host_rx_us Destination of the host time the ping was received
+ * @param host_tx_us Destination of the host time the answer was sent
+ *
+ * @return true if the answer arrived within GREENTEA_CLOCK_SYNC_TIMEOUT_MS
+ */
+static bool clock_receive_pong(unsigned long seq, uint64_t start_us, uint64_t *host_rx_us, uint64_t *host_tx_us)
+{
+    char key[16];
+    char value[64];
+    while (1) {
+        const uint64_t elapsed_ms = (greentea_time_us() - start_us) / 1000;
+        if (elapsed_ms >= GREENTEA_CLOCK_SYNC_TIMEOUT_MS) {
+            return false;
+        }
+        const uint32_t remaining_ms = GREENTEA_CLOCK_SYNC_TIMEOUT_MS - (uint32_t)elapsed_ms;
+        if (greentea_parse_kv_timeout(key, value, sizeof(key), sizeof(value), remaining_ms) <= 0) {
+            return false;
+        }
+        if (strcmp(key, GREENTEA_TEST_ENV_CLOCK_PONG) != 0) {
+            continue;
+        }
+        // "seq,t2,t3", answers to earlier pings which timed out are stale
+        char *end;
+        if (strtoul(value, &end, 10) != seq || *end != ',') {
+            continue;
+        }
+        *host_rx_us = strtoull(end + 1, &end, 10);
+        if (*end != ',') {
+            continue;
+        }
+        *host_tx_us = strtoull(end + 1, &end, 10);
+        return true;
+    }
+}
+
+extern "C" int GREENTEA_CLOCK_SYNC(void)
+{
+    if (greentea_time_us() == 0) {
+        return -1;
+    }
+
+    bool measured = false;
+    int64_t best_rtt_us = 0;
+    int64_t best_offset_us = 0;
+    int64_t best_device_us = 0;
+    for (unsigned long seq = 0; seq < GREENTEA_CLOCK_SYNC_ROUNDS; seq++) {
+        const uint64_t t1 = greentea_time_us();
+        greentea_send_protocol(GREENTEA_TEST_ENV_CLOCK_PING, seq, t1);
+        uint64_t t2;
+        uint64_t t3;
+        if (!clock_receive_pong(seq, t1, &t2, &t3)) {
+            return -1;
+        }
+        const uint64_t t4 = greentea_time_us();
+
+        // Time spent on the link, without the time the host took to answer
+        int64_t rtt_us = (int64_t)(t4 - t1) - (int64_t)(t3 - t2);
+        if (rtt_us < 0) {
+            rtt_us = 0;
+        }
+        if (!measured || rtt_us < best_rtt_us) {
+            measured = true;
+            best_rtt_us = rtt_us;
+            best_offset_us = ((int64_t)(t2 - t1) + (int64_t)(t3 - t4)) / 2;
+            best_device_us = (int64_t)(t1 + (t4 - t1) / 2);
+        }
+    }
+
+    int64_t drift_ppb = 0;
+    if (!clock_synced) {
+        clock_synced = true;
+        clock_first_device_us = best_device_us;
+        clock_first_offset_us = best_offset_us;
+    } else if (best_device_us > clock_first_device_us) {
+        drift_ppb = (best_offset_us - clock_first_offset_us) * 1000000000LL /
+                    (best_device_us - clock_first_device_us);
+    }
+    greentea_send_protocol(GREENTEA_TEST_ENV_CLOCK_SYNC, best_device_us, best_offset_us, best_rtt_us, drift_ppb);
+    return 0;
+}
+
+/**
+ *****************************************************************************
+ *  Link benchmark
+ *****************************************************************************
+ */
+
+/**
+ * Send bytes of payload to the host in messages of GREENTEA_LINK_BENCH_CHUNK_SIZE bytes.
+ */
+static void link_bench_send(unsigned long bytes)
+{
+    static const char pattern[] = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    char payload[GREENTEA_LINK_BENCH_CHUNK_SIZE];
+    for (size_t i = 0; i < sizeof(payload); i++) {
+        payload[i] = pattern[i % (sizeof(pattern) - 1)];
+    }
+    const unsigned long total = bytes;
+    while (bytes) {
+        const size_t size = bytes < sizeof(payload) ? bytes : sizeof(payload);
+        greentea_send_kv_n(GREENTEA_TEST_ENV_LINK_BENCH_DATA, sizeof(GREENTEA_TEST_ENV_LINK_BENCH_DATA) - 1,
+                           payload, size);
+        bytes -= size;
+    }
+    greentea_send_protocol(GREENTEA_TEST_ENV_LINK_BENCH_ACK, total);
+}
+
+/**
+ * Parse the "p50,p90,p99,max,to_host,to_device" value of a __link_bench_done message.
+ *
+ * @return true if all results are present
+ */
+static bool link_bench_parse_done(const char *value, greentea_link_bench_result *result)
+{
+    uint32_t fields[6];
+    const char *p = value;
+    for (size_t i = 0; i < 6; i++) {
+        char *end;
+        if (!isdigit((unsigned char)*p)) {
+            return false;
+        }
+        fields[i] = strtoul(p, &end, 10);
+        p = *end == ',' ? end + 1 : end;
+    }
+    result->rtt_p50_us = fields[0];
+    result->rtt_p90_us = fields[1];
+    result->rtt_p99_us = fields[2];
+    result->rtt_max_us = fields[3];
+    result->to_host_bytes_per_s = fields[4];
+    result->to_device_bytes_per_s = fields[5];
+    return true;
+}
+
+extern "C" int GREENTEA_LINK_BENCH(greentea_link_bench_result *result)
+{
+    greentea_send_protocol(GREENTEA_TEST_ENV_LINK_BENCH_REQUEST, GREENTEA_LINK_BENCH_CHUNK_SIZE);
+
+    char key[24];
+    char value[GREENTEA_LINK_BENCH_CHUNK_SIZE + 1];
+    unsigned long received = 0;
+    while (greentea_parse_kv_timeout(key, value, sizeof(key), sizeof(value), GREENTEA_LINK_BENCH_TIMEOUT_MS) > 0) {
+        if (strcmp(key, GREENTEA_TEST_ENV_LINK_BENCH_PING) == 0) {
+            greentea_send_protocol(GREENTEA_TEST_ENV_LINK_BENCH_PONG, value);
+        } else if (strcmp(key, GREENTEA_TEST_ENV_LINK_BENCH_DATA) == 0) {
+            received += strlen(value);
+        } else if (strcmp(key, GREENTEA_TEST_ENV_LINK_BENCH_ACK) == 0) {
+            greentea_send_protocol(GREENTEA_TEST_ENV_LINK_BENCH_ACK, received);
+            received = 0;
+        } else if (strcmp(key, GREENTEA_TEST_ENV_LINK_BENCH_SEND) == 0) {
+            link_bench_send(strtoul(value, NULL, 10));
+        } else if (strcmp(key, GREENTEA_TEST_ENV_LINK_BENCH_DONE) == 0) {
+            greentea_link_bench_result measured;
+            if (!link_bench_parse_done(value, &measured)) {
+                return -1;
+            }
+            greentea_send_protocol(GREENTEA_TEST_ENV_LINK_BENCH_RESULT, measured.rtt_p50_us, measured.rtt_p90_us,
+                                   measured.rtt_p99_us, measured.rtt_max_us, measured.to_host_bytes_per_s,
+                                   measured.to_device_bytes_per_s);
+            if (result) {
+                *result = measured;
+            }
+            return 0;
+        }
+    }
+    return -1;
+}
+#else
+static void greentea_reset_clock_sync()
+{
+}
+#endif // GREENTEA_CLIENT_PARSER && GREENTEA_CLIENT_EXTENDED
+
+/**
+ *****************************************************************************
+ *  Auxilary functions and key-value protocol support
+ *****************************************************************************
+ */
+
+/**
+ *****************************************************************************
+ *  Flush policy
+ *****************************************************************************
+ */
+
+static greentea_flush_policy flush_policy = GREENTEA_FLUSH_FRAME;
+static uint32_t flush_threshold = 0;
+
+/**
+ * Messages written since the last flush
+ */
+static uint32_t pending_frames = 0;
+static size_t pending_bytes = 0;
+static uint64_t pending_since_us = 0;
+
+static void greentea_flush_locked();
+
+extern "C" void greentea_set_flush_policy(greentea_flush_policy policy, uint32_t threshold)
+{
+    greentea_flush_pending();
+    flush_policy = policy;
+    flush_threshold = threshold;
+}
+
+/**
+ * Flush all output, including messages held back by the flush policy.
+ *
+ * @details Called before waiting for input from the host and at the end of the
+ *          test suite, so the host never waits for output stuck in a buffer.
+ */
+static void greentea_flush_pending()
+{
+    greentea_output_lock();
+    greentea_flush_locked();
+    greentea_output_unlock();
+}
+
+/**
+ * Flush all output while the output lock is held.
+ */
+static void greentea_flush_locked()
+{
+    pending_frames = 0;
+    pending_bytes = 0;
+    greentea_flush();
+}
+
+/**
+ * Account for a complete key-value message and flush if the policy says so.
+ *
+ * @details Flushes only ever happen here, right after a message, so the
+ *          transport never has to push out a partial message.
+ *
+ * @param size Size of the message in bytes
+ */
+static void greentea_frame_complete(size_t size)
+{
+    bool flush = false;
+    pending_bytes += size;
+    pending_frames++;
+
+    switch (flush_policy) {
+        case GREENTEA_FLUSH_FRAME:
+            flush = true;
+            break;
+
+        case GREENTEA_FLUSH_BATCH:
+            flush = flush_threshold && pending_frames >= flush_threshold;
+            break;
+
+        case GREENTEA_FLUSH_BYTES:
+            flush = pending_bytes >= flush_threshold;
+            break;
+
+        case GREENTEA_FLUSH_TIME: {
+            const uint64_t now = greentea_time_us();
+            if (pending_frames == 1) {
+                pending_since_us = now;
+            }
+            flush = now - pending_since_us >= (uint64_t)flush_threshold * 1000;
+            break;
+        }
+    }
+
+    if (flush) {
+        greentea_flush_locked();
+    }
+}
+
+
+/**
+ *****************************************************************************
+ *  LCOV support
+ *****************************************************************************
+ */
+#ifdef GREENTEA_CLIENT_COVERAGE_REPORT_NOTIFY
+extern "C" void __gcov_flush(void);
+extern bool coverage_report;
+
+void greentea_notify_coverage_start(const char *path)
+{
+    printf("{{%s;%s;", GREENTEA_TEST_ENV_LCOV_START, path);
+}
+
+void greentea_notify_coverage_end()
+{
+    printf("}}" NL);
+}
+
+#endif
+
+/**
+ *****************************************************************************
+ *  Key-value protocol support
+ *****************************************************************************
+ */
+
+/**
+ * Constant framing of key-value messages
+ */
+const greentea_iovec greentea::detail::preamble = { "{{", 2 };
+const greentea_iovec greentea::detail::separator = { ";", 1 };
+const greentea_iovec greentea::detail::postamble = { "}}\r\n", 4 };
+
+#if (GREENTEA_CLIENT_EXTENDED || GREENTEA_CLIENT_LOG) && GREENTEA_CLIENT_ATOMICS
+/**
+ * Held while a key-value message is being written, so that a heartbeat or log drain run from
+ * a timer never ends up inside another message
+ */
+static std::atomic_flag output_busy = ATOMIC_FLAG_INIT;
+
+static void greentea_output_lock()
+{
+    // Only ever contended by a heartbeat or log drain on another thread, which is short
+    while (output_busy.test_and_set(std::memory_order_acquire)) {
+    }
+}
+
+/**
+ * Take the lock unless a message is being written, for writers which must not wait.
+ */
+static bool greentea_output_try_lock()
+{
+    return !output_busy.test_and_set(std::memory_order_acquire);
+}
+
+static void greentea_output_unlock()
+{
+    output_busy.clear(std::memory_order_release);
+}
+#elif GREENTEA_CLIENT_EXTENDED
+/**
+ * Without atomics, a plain flag held while a key-value message is being written. The
+ * heartbeat then runs from an interrupt of the same core, which takes the flag with
+ * greentea_output_try_lock() and clears it again before the interrupted code resumes, so
+ * the code writing messages never finds it taken.
+ */
+static volatile bool output_busy = false;
+
+static void greentea_output_lock()
+{
+    output_busy = true;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+
+static bool greentea_output_try_lock()
+{
+    if (output_busy) {
+        return false;
+    }
+    output_busy = true;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    return true;
+}
+
+static void greentea_output_unlock()
+{
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    output_busy = false;
+}
+#else
+// Nothing else writes to the stream without the heartbeat and log drain
+static void greentea_output_lock()
+{
+}
+
+static void greentea_output_unlock()
+{
+}
+#endif // GREENTEA_CLIENT_EXTENDED || GREENTEA_CLIENT_LOG
+
+/**
+ * Number of bytes written for the key-value message in progress
+ */
+static size_t frame_bytes = 0;
+
+static void greentea_frame_complete(size_t size);
+
+#if GREENTEA_CLIENT_PARALLEL
+thread_local greentea::detail::frame_capture *greentea::detail::captured_frames = NULL;
+
+/**
+ * Check if the messages of this thread are captured, in which case they are only appended to
+ * the capture and leave the stream, its lock and the journal alone.
+ */
+static bool greentea_capturing()
+{
+    return greentea::detail::captured_frames != NULL;
+}
+
+/**
+ * Mark the end of a captured message.
+ */
+static void greentea_capture_end()
+{
+    greentea::detail::frame_capture *capture = greentea::detail::captured_frames;
+    capture->end(capture);
+}
+#else
+static bool greentea_capturing()
+{
+    return false;
+}
+
+static void greentea_capture_end()
+{
+}
+#endif // GREENTEA_CLIENT_PARALLEL
+
+/**
+ * Write a gather list which is part of a key-value message to the stream.
+ *
+ * @details All key-value messages are written through greentea_writev(), which
+ *          allows the transport to send the pieces without copying them.
+ */
+static void greentea_write_iov(const greentea_iovec *iov, size_t count)
+{
+#if GREENTEA_CLIENT_PARALLEL
+    if (greentea_capturing()) {
+        greentea::detail::frame_capture *capture = greentea::detail::captured_frames;
+        for (size_t i = 0; i < count; i++) {
+            capture->append(capture, iov[i].iov_base, iov[i].iov_len);
+        }
+        return;
+    }
+#endif
+    greentea_writev(iov, count);
+    for (size_t i = 0; i < count; i++) {
+        greentea_trace_record(GREENTEA_TRACE_TX, iov[i].iov_base, iov[i].iov_len);
+        greentea_journal_append(iov[i].iov_base, iov[i].iov_len);
+        frame_bytes += iov[i].iov_len;
+    }
+}
 
+#if GREENTEA_CLIENT_JOURNAL
 /**
- *   Test suite success code strings
+ * Write the {{__seq;<n>}} message numbering the journaled message which follows it.
+ *
+ * @details The message is put together in one small buffer, as it adds to the stack of
+ *          every journaled message.
  */
-const char *GREENTEA_TEST_ENV_SUCCESS = "success";
-const char *GREENTEA_TEST_ENV_FAILURE = "failure";
+static void greentea_write_seq(unsigned long seq)
+{
+    static const char prefix[] = "{{__seq;";
+    char frame[sizeof(prefix) - 1 + sizeof(unsigned long) * 3 + 4];
+    size_t digits = 1;
+    for (unsigned long rest = seq / 10; rest; rest /= 10) {
+        digits++;
+    }
+    memcpy(frame, prefix, sizeof(prefix) - 1);
+    size_t length = sizeof(prefix) - 1 + digits;
+    for (size_t i = length; i > sizeof(prefix) - 1; i--, seq /= 10) {
+        frame[i - 1] = '0' + seq % 10;
+    }
+    memcpy(frame + length, "}}\r\n", 4);
+    const greentea_iovec iov = { frame, length + 4 };
+    greentea_write_iov(&iov, 1);
+}
 
 /**
- *   Test case transport protocol start/finish keys
+ * Start the journal entry of a message about to be written, if its key carries results,
+ * preceded by the number of the message for a host which takes it.
  */
-const char *GREENTEA_TEST_ENV_TESTCASE_NAME = "__testcase_name";
-const char *GREENTEA_TEST_ENV_TESTCASE_COUNT = "__testcase_count";
-const char *GREENTEA_TEST_ENV_TESTCASE_START = "__testcase_start";
-const char *GREENTEA_TEST_ENV_TESTCASE_FINISH = "__testcase_finish";
-const char *GREENTEA_TEST_ENV_TESTCASE_SUMMARY = "__testcase_summary";
-// Code Coverage (LCOV)  transport protocol keys
-const char *GREENTEA_TEST_ENV_LCOV_START = "__coverage_start";
+static void greentea_journal_begin(const char *key, size_t key_len)
+{
+    const unsigned long seq = greentea_journal_seq(key, key_len);
+    if (!seq) {
+        return;
+    }
+    if (host_journal) {
+        greentea_write_seq(seq);
+    }
+    greentea_journal_open();
+}
+#else
+static void greentea_journal_begin(const char *, size_t)
+{
+}
+#endif // GREENTEA_CLIENT_JOURNAL
 
 /**
- *   Auxilary functions
+ * Write the preamble "{{", the key and the separator ";" to the stream.
+ *
+ * @details This starts a key-value message which is required for key-value
+ *          comunication between the target and the host.
  */
-static void greentea_notify_timeout(const int);
-static void greentea_notify_hosttest(const char *);
-static void greentea_notify_completion(const int);
-static void greentea_notify_version();
+static void greentea_write_header(const char *key)
+{
+    const greentea_iovec header[] = {
+        greentea::detail::preamble,
+        { key, strlen(key) },
+        greentea::detail::separator
+    };
+    if (greentea_capturing()) {
+        greentea_write_iov(header, sizeof(header) / sizeof(header[0]));
+        return;
+    }
+    greentea_output_lock();
+    frame_bytes = 0;
+    greentea_journal_begin(key, header[1].iov_len);
+    greentea_write_iov(header, sizeof(header) / sizeof(header[0]));
+}
 
 /**
- * Handle the handshake with the host.
- *
- * @details This function contains the shared handshake functionality that is used between
- *          GREENTEA_SETUP and GREENTEA_SETUP_UUID.
+ * Write the postamble "}}\r\n" to the stream.
  *
- * @note This function is blocking.
+ * @details The key-value message is then complete and the flush policy is applied.
  */
-static void _GREENTEA_SETUP_COMMON(const int timeout, const char *host_test_name, char *buffer, size_t size)
+static void greentea_write_postamble()
 {
-    // Key-value protocol handshake function. Waits for {{__sync;...}} message
-    // Sync preamble: "{{__sync;0dad4a9d-59a3-4aec-810d-d5fb09d852c1}}"
-    // Example value of sync_uuid == "0dad4a9d-59a3-4aec-810d-d5fb09d852c1"
-
-    char _key[8] = {0};
-
-    while (1) {
-        greentea_parse_kv(_key, buffer, sizeof(_key), size);
-        greentea_write_string("mbedmbedmbedmbedmbedmbedmbedmbed\r\n");
-        if (strcmp(_key, GREENTEA_TEST_ENV_SYNC) == 0) {
-            // Found correct __sync message
-            greentea_send_kv(_key, buffer);
-            break;
-        }
+    greentea_write_iov(&greentea::detail::postamble, 1);
+    if (greentea_capturing()) {
+        greentea_capture_end();
+        return;
     }
-
-    greentea_notify_version();
-    greentea_notify_timeout(timeout);
-    greentea_notify_hosttest(host_test_name);
+    greentea_journal_close();
+    greentea_frame_complete(frame_bytes);
+    greentea_output_unlock();
 }
 
-extern "C" void GREENTEA_SETUP(const int timeout, const char *host_test_name)
+/**
+ * Write characters which are part of a key-value message to the stream.
+ *
+ * @details Also used as output of greentea_vformat().
+ */
+static void greentea_write_data(const char *data, size_t size, void *)
 {
-#if ! defined(NO_GREENTEA)
-    char _value[GREENTEA_UUID_LENGTH] = {0};
-    _GREENTEA_SETUP_COMMON(timeout, host_test_name, _value, GREENTEA_UUID_LENGTH);
-#endif
+    const greentea_iovec iov = { data, size };
+    greentea_write_iov(&iov, 1);
 }
 
-void GREENTEA_SETUP_UUID(const int timeout, const char *host_test_name, char *buffer, size_t size)
+/**
+ * Write a complete key-value message to the stream.
+ */
+static void greentea_write_message(const char *key, size_t key_len, const greentea_iovec *iov, size_t count)
 {
-    _GREENTEA_SETUP_COMMON(timeout, host_test_name, buffer, size);
+    greentea_output_lock();
+    frame_bytes = 0;
+    greentea_journal_begin(key, key_len);
+    greentea_write_iov(iov, count);
+    greentea_journal_close();
+    greentea_frame_complete(frame_bytes);
+    greentea_output_unlock();
 }
 
-void GREENTEA_TESTSUITE_RESULT(const int result)
+void greentea::detail::write_frame(const greentea_iovec *iov, size_t count)
 {
-    greentea_notify_completion(result);
+    if (greentea_capturing()) {
+        greentea_write_iov(iov, count);
+        greentea_capture_end();
+        return;
+    }
+    // The key follows the preamble
+    greentea_write_message(static_cast<const char *>(iov[1].iov_base), iov[1].iov_len, iov, count);
 }
 
-void GREENTEA_TESTCASE_START(const char *test_case_name)
+#if GREENTEA_CLIENT_PARALLEL
+void greentea::detail::write_captured(const char *frame, size_t size)
 {
-    greentea_send_kv(GREENTEA_TEST_ENV_TESTCASE_START, test_case_name);
+    // The key follows the preamble and ends at the separator
+    const char *key = frame + preamble.iov_len;
+    const void *key_end = memchr(key, ';', size - preamble.iov_len);
+    const size_t key_len = key_end ? static_cast<const char *>(key_end) - key : 0;
+    const greentea_iovec iov = { frame, size };
+    greentea_write_message(key, key_len, &iov, 1);
 }
+#endif // GREENTEA_CLIENT_PARALLEL
 
-void GREENTEA_TESTCASE_FINISH(const char *test_case_name, const size_t passes, const size_t failed)
+#if GREENTEA_CLIENT_LOG
+void (*volatile greentea::detail::log_drain)(void) = NULL;
+
+bool greentea::detail::try_write_frame(const greentea_iovec *iov, size_t count)
 {
-    greentea_send_kv(GREENTEA_TEST_ENV_TESTCASE_FINISH, test_case_name, passes, failed);
+    if (greentea_capturing()) {
+        greentea_write_iov(iov, count);
+        greentea_capture_end();
+        return true;
+    }
+    if (!greentea_output_try_lock()) {
+        return false;
+    }
+    frame_bytes = 0;
+    greentea_write_iov(iov, count);
+    greentea_frame_complete(frame_bytes);
+    greentea_output_unlock();
+    return true;
 }
+#endif // GREENTEA_CLIENT_LOG
 
+#if GREENTEA_CLIENT_EXTENDED
 /**
  *****************************************************************************
- *  Auxilary functions and key-value protocol support
+ *  Heartbeat
  *****************************************************************************
  */
 
-
 /**
- *****************************************************************************
- *  LCOV support
- *****************************************************************************
+ * Period of the heartbeat in milliseconds, 0 when it is not running
  */
-#ifdef GREENTEA_CLIENT_COVERAGE_REPORT_NOTIFY
-extern "C" void __gcov_flush(void);
-extern bool coverage_report;
+static volatile uint32_t heartbeat_interval_ms = 0;
 
-void greentea_notify_coverage_start(const char *path)
+extern "C" int GREENTEA_HEARTBEAT(uint32_t interval_ms)
 {
-    printf("{{%s;%s;", GREENTEA_TEST_ENV_LCOV_START, path);
+    if (interval_ms == 0 || greentea_periodic_timer(interval_ms, greentea_heartbeat) != 0) {
+        return -1;
+    }
+    heartbeat_interval_ms = interval_ms;
+    greentea_heartbeat();
+    return 0;
 }
 
-void greentea_notify_coverage_end()
+extern "C" void greentea_heartbeat(void)
 {
-    printf("}}" NL);
+    const uint32_t interval_ms = heartbeat_interval_ms;
+    // A message being written shows the DUT is alive as well, skip the heartbeat
+    if (interval_ms == 0 || !greentea_output_try_lock()) {
+        return;
+    }
+    // Not recorded in a trace, as it depends on the timing of the run
+    greentea::detail::encoded value;
+    greentea::detail::encode(value, interval_ms);
+    const greentea_iovec frame[] = {
+        greentea::detail::preamble,
+        { GREENTEA_TEST_ENV_HEARTBEAT, sizeof(GREENTEA_TEST_ENV_HEARTBEAT) - 1 },
+        greentea::detail::separator,
+        value.get(),
+        greentea::detail::postamble
+    };
+    greentea_writev(frame, sizeof(frame) / sizeof(frame[0]));
+    greentea_flush_locked();
+    greentea_output_unlock();
 }
 
-#endif
-
 /**
- *****************************************************************************
- *  Key-value protocol support
- *****************************************************************************
+ * Stop the heartbeat before the suite ends, so it does not outlive __exit.
  */
+static void greentea_stop_heartbeat()
+{
+    if (heartbeat_interval_ms) {
+        greentea_periodic_timer(0, NULL);
+        heartbeat_interval_ms = 0;
+    }
+}
+#else
+static void greentea_stop_heartbeat()
+{
+}
+#endif // GREENTEA_CLIENT_EXTENDED
 
-/**
- * Write the preamble characters to the stream.
- *
- * @details This function writes the preamble "{{" which is required
- *          for key-value comunication between the target and the host.
- *          This uses greentea_putc which allows the direct writing of characters
- *          using the write() method.
- *          This suite of functions are provided to allow for serial communication
- *          to the host from within a thread/ISR.
- */
-static void greentea_write_preamble()
+#if GREENTEA_CLIENT_FORMAT
+static_assert(greentea::detail::encoded::storage_size >= GREENTEA_FLOAT_STRING_SIZE, "encoded storage too small");
+
+size_t greentea::detail::format_floating(char *buffer, double val)
 {
-    greentea_putc('{');
-    greentea_putc('{');
+    return greentea_format_double(buffer, val);
 }
 
-/**
- * Write the postamble characters to the stream.
- *
- * @details This function writes the postamble "{{\r\n" which is required
- *          for key-value comunication between the target and the host.
- *          This uses greentea_putc which allows the direct writing of characters
- *          using the write() method.
- *          This suite of functions are provided to allow for serial communication
- *          to the host from within a thread/ISR.
- */
-static void greentea_write_postamble()
+size_t greentea::detail::format_floating(char *buffer, float val)
 {
-    greentea_putc('}');
-    greentea_putc('}');
-    greentea_putc('\r');
-    greentea_putc('\n');
+    return greentea_format_float(buffer, val);
 }
+#endif // GREENTEA_CLIENT_FORMAT
 
-/**
- * Write an int to the serial port.
- *
- * @details This function writes an integer value from the target
- *          to the host. The integer value is converted to a string and
- *          and then written character by character directly to the serial
- *          port using the console.
- *          The thread-safe sprintf() is used to convert the int to a string.
- *
- * @param val Integer value.
- */
-#define MAX_INT_STRING_LEN 15
-static void greentea_write_int(const int val)
+extern "C" void greentea_send_kv(const char *key, const char *val)
 {
-    char intval[MAX_INT_STRING_LEN];
-    unsigned int i = 0;
-    sprintf(intval, "%d", val);
-    while (intval[i] != '\0') {
-        greentea_putc(intval[i]);
-        i++;
+    if (val) {
+        greentea::send(key, val);
     }
 }
 
-extern "C" void greentea_send_kv(const char *key, const char *val)
+extern "C" void greentea_send_kv_n(const char *key, size_t key_len, const char *val, size_t val_len)
 {
     if (key && val) {
-        greentea_write_preamble();
-        greentea_write_string(key);
-        greentea_putc(';');
-        greentea_write_string(val);
-        greentea_write_postamble();
+        const greentea_iovec frame[] = {
+            greentea::detail::preamble,
+            { key, key_len },
+            greentea::detail::separator,
+            { val, val_len },
+            greentea::detail::postamble
+        };
+        greentea::detail::write_frame(frame, sizeof(frame) / sizeof(frame[0]));
     }
 }
 
-void greentea_send_kv(const char *key, const int val)
+extern "C" void greentea_send_kv_stream(const char *key, greentea_value_producer producer, void *context)
 {
-    if (key) {
-        greentea_write_preamble();
-        greentea_write_string(key);
-        greentea_putc(';');
-        greentea_write_int(val);
+    if (key && producer) {
+        char chunk[GREENTEA_STREAM_CHUNK_SIZE];
+        size_t len;
+        greentea_write_header(key);
+        while ((len = producer(chunk, GREENTEA_STREAM_CHUNK_SIZE, context)) > 0) {
+            if (len > GREENTEA_STREAM_CHUNK_SIZE) {
+                len = GREENTEA_STREAM_CHUNK_SIZE;
+            }
+            greentea_write_data(chunk, len, NULL);
+        }
         greentea_write_postamble();
     }
 }
 
-void greentea_send_kv(const char *key, const char *val, const int result)
+#if GREENTEA_CLIENT_FORMAT
+extern "C" void greentea_vsend_kvf(const char *key, const char *format, va_list args)
 {
-    if (key) {
-        greentea_write_preamble();
-        greentea_write_string(key);
-        greentea_putc(';');
-        greentea_write_string(val);
-        greentea_putc(';');
-        greentea_write_int(result);
+    if (key && format) {
+        greentea_write_header(key);
+        greentea_vformat(greentea_write_data, NULL, format, args);
         greentea_write_postamble();
-
     }
 }
 
+extern "C" void greentea_send_kvf(const char *key, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    greentea_vsend_kvf(key, format, args);
+    va_end(args);
+}
+#endif // GREENTEA_CLIENT_FORMAT
+
+void greentea_send_kv(const char *key, const int val)
+{
+    greentea::send(key, val);
+}
+
+#if GREENTEA_CLIENT_FORMAT
+void greentea_send_kv(const char *key, const double val)
+{
+    greentea::send(key, val);
+}
+
+void greentea_send_kv(const char *key, const float val)
+{
+    greentea::send(key, val);
+}
+#endif // GREENTEA_CLIENT_FORMAT
+
+void greentea_send_kv(const char *key, const char *val, const int result)
+{
+    greentea::send(key, val, result);
+}
+
 void greentea_send_kv(const char *key, const char *val, const int passes, const int failures)
 {
-    if (key) {
-        greentea_write_preamble();
-        greentea_write_string(key);
-        greentea_putc(';');
-        greentea_write_string(val);
-        greentea_putc(';');
-        greentea_write_int(passes);
-        greentea_putc(';');
-        greentea_write_int(failures);
-        greentea_write_postamble();
-    }
+    greentea::send(key, val, passes, failures);
 }
 
 void greentea_send_kv(const char *key, const int passes, const int failures)
 {
-    if (key) {
-        greentea_write_preamble();
-        greentea_write_string(key);
-        greentea_putc(';');
-        greentea_write_int(passes);
-        greentea_putc(';');
-        greentea_write_int(failures);
-        greentea_write_postamble();
-    }
+    greentea::send(key, passes, failures);
 }
 
 /**
@@ -284,7 +1347,7 @@ void greentea_send_kv(const char *key, const int passes, const int failures)
  */
 static void greentea_notify_timeout(const int timeout)
 {
-    greentea_send_kv(GREENTEA_TEST_ENV_TIMEOUT, timeout);
+    greentea_send_protocol(GREENTEA_TEST_ENV_TIMEOUT, timeout);
 }
 
 /**
@@ -302,7 +1365,7 @@ static void greentea_notify_timeout(const int timeout)
  */
 static void greentea_notify_hosttest(const char *host_test_name)
 {
-    greentea_send_kv(GREENTEA_TEST_ENV_HOST_TEST_NAME, host_test_name);
+    greentea_send_protocol(GREENTEA_TEST_ENV_HOST_TEST_NAME, host_test_name);
 }
 
 /**
@@ -329,8 +1392,9 @@ static void greentea_notify_completion(const int result)
     __gcov_flush();
     coverage_report = false;
 #endif
-    greentea_send_kv(GREENTEA_TEST_ENV_END, val);
-    greentea_send_kv(GREENTEA_TEST_ENV_EXIT, 0);
+    greentea_send_protocol(GREENTEA_TEST_ENV_END, val);
+    greentea_journal_sync();
+    greentea_send_protocol(GREENTEA_TEST_ENV_EXIT, 0);
 }
 
 /**
@@ -338,265 +1402,352 @@ static void greentea_notify_completion(const int result)
  */
 static void greentea_notify_version()
 {
-    greentea_send_kv(GREENTEA_TEST_ENV_HOST_TEST_VERSION, GREENTEA_CLIENT_VERSION_STRING);
+    greentea_send_protocol(GREENTEA_TEST_ENV_HOST_TEST_VERSION, GREENTEA_CLIENT_VERSION_STRING);
 }
 
+#if GREENTEA_CLIENT_PARSER
 /**
- *****************************************************************************
- *  Parse engine for KV values which replaces scanf
- *****************************************************************************
- *
- *  Example usage:
- *
- *  char key[10];
- *  char value[48];
- *
- *  greentea_parse_kv(key, value, 10, 48);
- *  greentea_parse_kv(key, value, 10, 48);
+ * Wait for a message from the host, dropping the messages with other keys.
  *
+ * @return true if the message arrived in time, false on timeout or at the end of the stream
  */
-
-
-static int gettok(char *, const int);
-static int getNextToken(char *, const int);
-static int HandleKV(char *,  char *,  const int,  const int);
-static int isstring(int);
+static bool greentea_wait_for(const char *key, uint32_t timeout_ms)
+{
+    char received[16];
+    char value[16];
+    const uint64_t start_us = greentea_time_us();
+    while (1) {
+        const uint64_t elapsed_ms = (greentea_time_us() - start_us) / 1000;
+        if (elapsed_ms >= timeout_ms ||
+                greentea_parse_kv_timeout(received, value, sizeof(received), sizeof(value),
+                                          timeout_ms - (uint32_t)elapsed_ms) <= 0) {
+            return false;
+        }
+        if (strcmp(received, key) == 0) {
+            return true;
+        }
+    }
+}
 
 /**
- * Current token of key-value protocol's tokenizer
+ * Record the "<framing>,<max value size>,<max line rate>" the host advertised before __sync.
  */
-static int CurTok = 0;
+static void greentea_parse_host_capabilities(const char *value)
+{
+    const char *rate = strrchr(value, ',');
+    host_capable = true;
+    host_line_rate = rate ? strtoul(rate + 1, NULL, 10) : 0;
+    // The framing comes first, "kv+stream+log+journal+shard"
+    const char *framing_end = strchr(value, ',');
+    const char *journal = strstr(value, "journal");
+    host_journal = journal && (!framing_end || journal < framing_end);
+    const char *shard = strstr(value, "shard");
+    host_shard = shard && (!framing_end || shard < framing_end);
+}
 
 /**
- * @enum Token enumeration for key-value protocol tokenizer
+ * \brief Send to the host what greentea-client and its transport support, and switch
+ *        to the fastest line rate both sides support.
  *
- *       This enum is used by key-value protocol tokenizer
- *       to detect parts of protocol in stream.
+ * @details Only hosts which advertised their own capabilities before __sync are sent
+ *          anything, others may not know the message. A new line rate is used once the
+ *          host confirms it at that rate, otherwise the suite carries on regardless, as
+ *          the host has switched already.
  *
- *       tok_eof       ::= EOF (end of file)
- *       tok_open      ::= "{{"
- *       tok_close     ::= "}}"
- *       tok_semicolon ::= ";"
- *       tok_string    ::= [a-zA-Z0-9_-!@#$%^&*()]+    // See isstring() function
+ * @param max_value_size Largest value the suite accepts from the host
  */
-enum Token {
-    tok_eof = -1,
-    tok_open = -2,
-    tok_close = -3,
-    tok_semicolon = -4,
-    tok_string = -5
-};
+static void greentea_notify_capabilities(size_t max_value_size)
+{
+    if (!host_capable) {
+        return;
+    }
+    const char *const framing = "kv+stream"
+#if GREENTEA_CLIENT_LOG
+                                "+log"
+#endif
+#if GREENTEA_CLIENT_JOURNAL
+                                "+journal"
+#endif
+#if GREENTEA_CLIENT_EXTENDED
+                                "+shard"
+#endif
+                                ;
+    const unsigned long device_rate = greentea_max_line_rate();
+    const unsigned long rate = device_rate < host_line_rate ? device_rate : host_line_rate;
+    greentea_send_protocol(GREENTEA_TEST_ENV_CAPABILITIES, framing, (unsigned long)max_value_size, rate);
+    if (rate == 0) {
+        return;
+    }
 
-extern "C" int greentea_parse_kv(char *out_key,
-                                 char *out_value,
-                                 const int out_key_size,
-                                 const int out_value_size)
+    greentea_flush_pending();
+    if (greentea_set_line_rate(rate) != 0) {
+        return;
+    }
+    greentea_wait_for(GREENTEA_TEST_ENV_LINE_RATE, GREENTEA_LINE_RATE_TIMEOUT_MS);
+}
+#else
+static void greentea_notify_capabilities(size_t)
 {
-    getNextToken(0, 0);
-    while (1) {
-        switch (CurTok) {
-            case tok_eof:
-                return 0;
-
-            case tok_open:
-                if (HandleKV(out_key, out_value, out_key_size, out_value_size)) {
-                    // We've found {{ KEY ; VALUE }} expression
-                    return 1;
-                }
-                break;
+}
+#endif // GREENTEA_CLIENT_PARSER
 
-            default:
-                // Load next token and pray...
-                getNextToken(0, 0);
-                break;
-        }
+#if GREENTEA_CLIENT_JOURNAL
+/**
+ * Write a journaled message again, numbered as it was the first time.
+ */
+static void greentea_journal_resend(unsigned long seq, const void *data, size_t size, void *)
+{
+    if (!data) {
+        greentea_write_seq(seq);
+        return;
     }
+    const greentea_iovec iov = { data, size };
+    greentea_write_iov(&iov, 1);
 }
 
 /**
- *  Get the next token from the stream.
+ * Serve a {{__replay;<n>}} request the parser found, which the caller of the parsing
+ * function never sees.
  *
- *  Key-value TOKENIZER feature.
- *
- *  @details This function is used by the key-value parser to determine
- *           if the key-value message is embedded in the data stream.
- *
- *  @param str Output parameters to store token string value
- *  @param str_size Size of 'str' parameter in bytes (characters)
+ * @return true if the message was a replay request
  */
-static int getNextToken(char *str, const int str_size)
+static bool greentea_journal_serve(const greentea_kv_parser *parser)
 {
-    return CurTok = gettok(str, str_size);
+    const size_t key_len = sizeof(GREENTEA_TEST_ENV_REPLAY) - 1;
+    // A value going to a sink is not in its buffer any more
+    if (!greentea_journal_last() || parser->value.sink || parser->key.length != key_len ||
+            (size_t)parser->key.idx != key_len || memcmp(parser->key.str, GREENTEA_TEST_ENV_REPLAY, key_len) != 0) {
+        return false;
+    }
+    // A truncated number only replays more than requested
+    unsigned long from = 0;
+    for (int i = 0; i < parser->value.idx && isdigit((unsigned char)parser->value.str[i]); i++) {
+        from = from * 10 + (parser->value.str[i] - '0');
+    }
+    greentea_output_lock();
+    frame_bytes = 0;
+    greentea_journal_replay(from, greentea_journal_resend, NULL);
+    greentea_flush_locked();
+    greentea_output_unlock();
+    return true;
 }
 
 /**
- *  Check if a character is a punctuation.
- *
- *  Auxilary key-value TOKENIZER function.
- *
- *  @details Defines if character is in subset of allowed punctuation
- *           characters which can be part of a key or value string.
- *           Invalid punctuation characters are: ";{}"
- *
- *  @param c Input character to check
- *  @return Return 1 if character is allowed punctuation character, otherwise return 0
- *
+ * Tell a host which numbers the journaled messages how many there were, and serve the
+ * replays it requests until it has all of them still in the journal.
  */
-static int ispunctuation(int c)
+static void greentea_journal_sync()
 {
-    static const char punctuation[] = "_-!@#$%^&*()=+:<>,./?\\\"'";  // No ";{}"
-    for (size_t i = 0; i < sizeof(punctuation); ++i) {
-        if (c == punctuation[i]) {
-            return 1;
-        }
+    const unsigned long last = greentea_journal_last();
+    if (!last || !host_journal) {
+        return;
     }
-    return 0;
+    greentea_send_protocol(GREENTEA_TEST_ENV_JOURNAL_END, last);
+    greentea_wait_for(GREENTEA_TEST_ENV_JOURNAL_DONE, GREENTEA_JOURNAL_TIMEOUT_MS);
+}
+#elif GREENTEA_CLIENT_PARSER
+static bool greentea_journal_serve(const greentea_kv_parser *)
+{
+    return false;
 }
 
+static void greentea_journal_sync()
+{
+}
+#else
+static void greentea_journal_sync()
+{
+}
+#endif // GREENTEA_CLIENT_JOURNAL
+
+#if GREENTEA_CLIENT_PARSER
 /**
- *  Check if character is string token character.
+ *****************************************************************************
+ *  Parse engine for KV values which replaces scanf
+ *****************************************************************************
  *
- *  Auxilary key-value TOKENIZER function.
+ *  Reads the stream with greentea_getc() and hands it to a greentea_kv_parser.
  *
- *  @details Defines if character is in subset of allowed string
- *           token characters.
- *           String defines set of characters which can be a key or value string.
+ *  Example usage:
  *
- *           Allowed subset includes:
- *           - Alphanumerical characters
- *           - Digits
- *           - White spaces and
- *           - subset of punctuation characters.
+ *  char key[10];
+ *  char value[48];
  *
- *  @param c Input character to check
- *  @return Return 1 if character is allowed punctuation character, otherwise return false
+ *  greentea_parse_kv(key, value, 10, 48);
+ *  greentea_parse_kv(key, value, 10, 48);
  *
  */
-static int isstring(int c)
+
+/**
+ * Read the next character from the stream and record it to the trace in progress.
+ */
+static int greentea_getc_traced()
 {
-    return (isalpha(c) ||
-            isdigit(c) ||
-            isspace(c) ||
-            ispunctuation(c));
+    const int c = greentea_getc();
+#if GREENTEA_CLIENT_TRACE
+    if (c != EOF) {
+        // The recorder collects both directions, and a log drain may be writing on another thread
+        const char byte = c;
+        greentea_output_lock();
+        greentea_trace_record(GREENTEA_TRACE_RX, &byte, 1);
+        greentea_output_unlock();
+    }
+#endif
+    return c;
 }
 
 /**
- *  TOKENIZER of key-value protocol.
- *
- *  Actual key-value TOKENIZER engine.
- *
- *  @details TOKENIZER defines #Token enum to map recognized tokens to integer values.
- *
- *           <TOK_EOF>       ::= EOF (end of file)
- *           <TOK_OPEN>      ::= "{{"
- *           <TOK_CLOSE>     ::= "}}"
- *           <TOK_SEMICOLON> ::= ";"
- *           <TOK_STRING>    ::= [a-zA-Z0-9_-!@#$%^&*()]+    // See isstring() function *
+ * State of the parser reading from greentea_getc(), kept between calls,
+ * -1 until the first call
+ */
+static int stream_state = -1;
+
+/**
+ * Wait for input until a time limit, measured from a start time.
  *
- *  @param out_str Output string with parsed token (string)
- *  @param str_size Size of str buffer we can use
+ * @return 1 if input is available or waiting is not supported, 0 on timeout
+ */
+static int greentea_wait_rx_until(uint64_t start_us, uint32_t timeout_ms)
+{
+    // Without a clock, greentea_time_us() stays at 0 and each wait gets the full time
+    const uint64_t elapsed_ms = (greentea_time_us() - start_us) / 1000;
+    const uint32_t remaining_ms = elapsed_ms >= timeout_ms ? 0 : timeout_ms - (uint32_t)elapsed_ms;
+    return greentea_wait_rx(remaining_ms) != 0;
+}
+
+/**
+ * Read the stream until a complete key-value message or the end of the stream is found.
  *
- *  @return Return #Token enum value used by parser to check for key-value occurrences
+ * @param parser Parser with the destinations of the key and value
+ * @param timeout_ms Maximum time to wait in milliseconds, negative to wait for ever
  *
+ * @return 1 if key-value pair was found, 0 if end of the stream was found, -1 on timeout
  */
-static int gettok(char *out_str, const int str_size)
+static int ParseKV(greentea_kv_parser *parser, int64_t timeout_ms = -1)
 {
-    static int LastChar = '!';
-    static int str_idx = 0;
-
-    // whitespace ::=
-    while (isspace(LastChar)) {
-        LastChar = greentea_getc();
+    greentea_flush_pending();
+    if (stream_state >= 0) {
+        parser->state = stream_state;
     }
-
-    // string ::= [a-zA-Z0-9_-!@#$%^&*()]+
-    if (isstring(LastChar)) {
-        str_idx = 0;
-        if (out_str && str_idx < str_size - 1) {
-            out_str[str_idx++] = LastChar;
+    const uint64_t start_us = timeout_ms >= 0 ? greentea_time_us() : 0;
+    int found = 0;
+    while (!found) {
+        if (timeout_ms >= 0 && !greentea_wait_rx_until(start_us, timeout_ms)) {
+            // The destinations of a partial message are the caller's, start afresh next time
+            stream_state = -1;
+            return -1;
         }
-
-        while (isstring((LastChar = greentea_getc())))
-            if (out_str && str_idx < str_size - 1) {
-                out_str[str_idx++] = LastChar;
-            }
-        if (out_str && str_idx < str_size) {
-            out_str[str_idx] = '\0';
+        const int c = greentea_getc_traced();
+        if (c == EOF) {
+            break;
+        }
+        found = greentea_kv_parser_push(parser, c) == GREENTEA_KV_MESSAGE;
+        if (found && greentea_journal_serve(parser)) {
+            found = 0;
         }
-
-        return tok_string;
-    }
-
-    // semicolon ::= ';'
-    if (LastChar == ';') {
-        LastChar = greentea_getc();
-        return tok_semicolon;
     }
-
-    // open ::= '{{'
-    if (LastChar == '{') {
-        LastChar = greentea_getc();
-        if (LastChar == '{') {
-            LastChar = greentea_getc();
-            return tok_open;
+    if (found && (timeout_ms < 0 || greentea_wait_rx(0) != 0)) {
+        // Offset the line ending sent by Greentea python tool after the message
+        const int c = greentea_getc_traced();
+        if (c != EOF) {
+            greentea_kv_parser_push(parser, c);
         }
     }
+    stream_state = parser->state;
+    return found;
+}
 
-    // close ::= '}'
-    if (LastChar == '}') {
-        LastChar = greentea_getc();
-        if (LastChar == '}') {
-            greentea_getc(); //offset the extra '\n' send by Greentea python tool
-            LastChar = '!';
-            return tok_close;
+extern "C" int greentea_parse_kv(char *out_key,
+                                 char *out_value,
+                                 const int out_key_size,
+                                 const int out_value_size)
+{
+    greentea_kv_parser parser;
+    greentea_kv_parser_init(&parser, out_key, out_key_size, out_value, out_value_size, 0);
+    return ParseKV(&parser);
+}
+
+extern "C" int greentea_parse_kv_timeout(char *out_key,
+                                         char *out_value,
+                                         const int out_key_size,
+                                         const int out_value_size,
+                                         uint32_t timeout_ms)
+{
+    greentea_kv_parser parser;
+    greentea_kv_parser_init(&parser, out_key, out_key_size, out_value, out_value_size, 0);
+    return ParseKV(&parser, timeout_ms);
+}
+
+extern "C" int greentea_parse_kv_n(char *out_key, size_t out_key_size, size_t *out_key_len,
+                                   char *out_value, size_t out_value_size, size_t *out_value_len)
+{
+    greentea_kv_parser parser;
+    greentea_kv_parser_init(&parser, out_key, out_key_size, out_value, out_value_size, 0);
+    parser.key.terminated = false;
+    parser.value.terminated = false;
+    const int found = ParseKV(&parser);
+    if (found) {
+        if (out_key_len) {
+            *out_key_len = parser.key.length;
+        }
+        if (out_value_len) {
+            *out_value_len = parser.value.length;
         }
     }
+    return found;
+}
 
-    if (LastChar == EOF) {
-        return tok_eof;
+extern "C" int greentea_parse_kv_stream(char *out_key,
+                                        const int out_key_size,
+                                        greentea_value_sink sink,
+                                        void *context,
+                                        uint32_t *out_crc)
+{
+    char chunk[GREENTEA_STREAM_CHUNK_SIZE];
+    greentea_kv_parser parser;
+    if (!sink) {
+        return 0;
     }
+    greentea_kv_parser_init(&parser, out_key, out_key_size, chunk, sizeof(chunk), 0);
+    parser.value.sink = sink;
+    parser.value.context = context;
+    parser.value.terminated = false;
+    const int found = ParseKV(&parser);
+    if (found && out_crc) {
+        *out_crc = ~parser.value.crc;
+    }
+    return found;
+}
 
-    // Otherwise, just return the character as its ascii value.
-    int ThisChar = LastChar;
-    LastChar = greentea_getc();
-    return ThisChar;
+extern "C" int greentea_kv_parser_read(greentea_kv_parser *parser)
+{
+    // Called for each character, so only messages the flush policy held back are flushed
+    greentea_output_lock();
+    if (pending_frames) {
+        greentea_flush_locked();
+    }
+    greentea_output_unlock();
+    const int c = greentea_getc_traced();
+    if (c == EOF) {
+        return EOF;
+    }
+    if (greentea_kv_parser_push(parser, c) != GREENTEA_KV_MESSAGE || greentea_journal_serve(parser)) {
+        return GREENTEA_KV_INCOMPLETE;
+    }
+    return GREENTEA_KV_MESSAGE;
 }
 
-/**
- *  Key-value parser.
- *
- *  @details Key-value message grammar.
- *
- *           <MESSAGE>: <TOK_OPEN> <TOK_STRING> <TOK_SEMICOLON> <TOK_STRING> <TOK_CLOSE>
- *
- *           Examples:
- *           message:     "{{__timeout; 1000}}"
- *                        "{{__sync; 12345678-1234-5678-1234-567812345678}}"
- *
- *  @param out_key Output buffer to store key string value
- *  @param out_value Output buffer to store value string value
- *  @param out_key_size Buffer 'out_key' buffer size
- *  @param out_value_size Buffer 'out_value_size' buffer size
- *
- *  @return Returns 1 if key-value message was parsed successfully in stream of tokens from tokenizer
- */
-static int HandleKV(char *out_key,
-                    char *out_value,
-                    const int out_key_size,
-                    const int out_value_size)
+extern "C" void greentea_value_arena_sink(const char *data, size_t size, void *context)
 {
-    // We already started with <open>
-    if (getNextToken(out_key, out_key_size) == tok_string) {
-        if (getNextToken(0, 0) == tok_semicolon) {
-            if (getNextToken(out_value, out_value_size) == tok_string) {
-                if (getNextToken(0, 0) == tok_close) {
-                    // <open> <string> <semicolon> <string> <close>
-                    // Found "{{KEY;VALUE}}" expression
-                    return 1;
-                }
-            }
-        }
+    greentea_value_arena *arena = static_cast<greentea_value_arena *>(context);
+    if (!data) {
+        arena->length = 0;
+        return;
     }
-    getNextToken(0, 0);
-    return 0;
+    if (arena->length < arena->size) {
+        const size_t room = arena->size - arena->length;
+        memcpy(arena->buffer + arena->length, data, size < room ? size : room);
+    }
+    arena->length += size;
 }
+#endif // GREENTEA_CLIENT_PARSER
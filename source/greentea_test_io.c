@@ -17,6 +17,44 @@
 
 #include "greentea-client/test_io.h"
 #include <stdio.h>
+#include <string.h>
+
+/**
+ * Size of the buffer of greentea-client's output. Output is only handed to stdout when
+ * greentea-client calls greentea_flush() at a message boundary, or when the buffer is full.
+ * stdout itself keeps the buffering mode of the application.
+ */
+#ifndef GREENTEA_STDIO_BUFFER_SIZE
+#define GREENTEA_STDIO_BUFFER_SIZE  256
+#endif
+
+static char stdout_buffer[GREENTEA_STDIO_BUFFER_SIZE];
+static size_t stdout_pending = 0;
+
+/**
+ * Hand the buffered output to stdout.
+ */
+static void greentea_stdout_drain(void)
+{
+    fwrite(stdout_buffer, 1, stdout_pending, stdout);
+    stdout_pending = 0;
+}
+
+/**
+ * Buffer output, writing data larger than the buffer straight to stdout.
+ */
+static void greentea_stdout_write(const void *data, size_t size)
+{
+    if (stdout_pending + size > sizeof(stdout_buffer)) {
+        greentea_stdout_drain();
+        if (size > sizeof(stdout_buffer)) {
+            fwrite(data, 1, size, stdout);
+            return;
+        }
+    }
+    memcpy(stdout_buffer + stdout_pending, data, size);
+    stdout_pending += size;
+}
 
 int greentea_getc()
 {
@@ -26,11 +64,33 @@ int greentea_getc()
 
 void greentea_putc(int c)
 {
-    putchar(c);
+    const char byte = (char)c;
+    greentea_stdout_write(&byte, 1);
 }
 
 
 void greentea_write_string(const char *str)
 {
-    puts(str);
+    greentea_write_n(str, strlen(str));
+}
+
+
+void greentea_write_n(const char *str, size_t len)
+{
+    greentea_stdout_write(str, len);
+}
+
+
+void greentea_writev(const struct greentea_iovec *iov, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        greentea_stdout_write(iov[i].iov_base, iov[i].iov_len);
+    }
+}
+
+
+void greentea_flush(void)
+{
+    greentea_stdout_drain();
+    fflush(stdout);
 }
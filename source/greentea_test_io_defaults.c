@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ *  Default implementations of the optional functions of test_io.h
+ *
+ *  These are weak definitions: an application or I/O backend providing
+ *  its own definition of a function replaces the default at link time.
+ */
+
+#include <string.h>
+#include "greentea-client/test_io.h"
+
+#if defined(__ICCARM__)
+#define GREENTEA_WEAK __weak
+#else
+#define GREENTEA_WEAK __attribute__((weak))
+#endif
+
+/**
+ * Size of the buffer used to NUL-terminate data for greentea_write_string()
+ */
+#define GREENTEA_DEFAULT_WRITE_CHUNK_SIZE   32
+
+GREENTEA_WEAK void greentea_write_n(const char *str, size_t len)
+{
+    char chunk[GREENTEA_DEFAULT_WRITE_CHUNK_SIZE + 1];
+    while (len) {
+        const size_t size = len < GREENTEA_DEFAULT_WRITE_CHUNK_SIZE ? len : GREENTEA_DEFAULT_WRITE_CHUNK_SIZE;
+        memcpy(chunk, str, size);
+        chunk[size] = '\0';
+        greentea_write_string(chunk);
+        // greentea_write_string() stops at a NUL byte of the data, which goes out on its own
+        size_t written = strlen(chunk);
+        if (written < size) {
+            greentea_putc('\0');
+            written++;
+        }
+        str += written;
+        len -= written;
+    }
+}
+
+GREENTEA_WEAK void greentea_writev(const struct greentea_iovec *iov, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        greentea_write_n((const char *)iov[i].iov_base, iov[i].iov_len);
+    }
+}
+
+GREENTEA_WEAK void greentea_flush(void)
+{
+}
+
+GREENTEA_WEAK uint64_t greentea_time_us(void)
+{
+    return 0;
+}
+
+GREENTEA_WEAK int greentea_wait_rx(uint32_t timeout_ms)
+{
+    (void)timeout_ms;
+    return -1;
+}
+
+GREENTEA_WEAK int greentea_periodic_timer(uint32_t interval_ms, greentea_timer_callback callback)
+{
+    (void)interval_ms;
+    (void)callback;
+    return -1;
+}
+
+GREENTEA_WEAK uint32_t greentea_max_line_rate(void)
+{
+    return 0;
+}
+
+GREENTEA_WEAK int greentea_set_line_rate(uint32_t bits_per_s)
+{
+    (void)bits_per_s;
+    return -1;
+}
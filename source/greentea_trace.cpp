@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstring>
+#include "greentea-client/test_io.h"
+#include "greentea_trace.h"
+
+/**
+ *****************************************************************************
+ *  Varint encoding
+ *****************************************************************************
+ */
+
+size_t greentea_varint_encode(uint8_t *buffer, uint64_t val)
+{
+    size_t len = 0;
+    while (val >= 0x80) {
+        buffer[len++] = (uint8_t)(val | 0x80);
+        val >>= 7;
+    }
+    buffer[len++] = (uint8_t)val;
+    return len;
+}
+
+size_t greentea_varint_decode(const uint8_t *data, size_t size, uint64_t *val)
+{
+    uint64_t result = 0;
+    for (size_t i = 0; i < size && i < GREENTEA_VARINT_SIZE; i++) {
+        result |= (uint64_t)(data[i] & 0x7F) << (7 * i);
+        if (!(data[i] & 0x80)) {
+            *val = result;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+#if GREENTEA_CLIENT_TRACE
+
+/**
+ *****************************************************************************
+ *  Trace recording
+ *****************************************************************************
+ */
+
+static greentea_trace_output trace_output = NULL;
+static void *trace_context = NULL;
+
+/**
+ * Time of the last record written, records store their time relative to it
+ */
+static uint64_t trace_last_us = 0;
+
+/**
+ * Record being collected
+ */
+static uint8_t pending_data[GREENTEA_TRACE_RECORD_SIZE];
+static size_t pending_size = 0;
+static greentea_trace_direction pending_direction = GREENTEA_TRACE_TX;
+static uint64_t pending_us = 0;
+
+static void trace_write_record(greentea_trace_direction direction, uint64_t time_us,
+                               const void *data, size_t size)
+{
+    uint8_t header[1 + 2 * GREENTEA_VARINT_SIZE];
+    size_t len = 0;
+    // A clock going backwards must not wrap the delta around
+    if (time_us < trace_last_us) {
+        time_us = trace_last_us;
+    }
+    header[len++] = (uint8_t)direction;
+    len += greentea_varint_encode(header + len, time_us - trace_last_us);
+    len += greentea_varint_encode(header + len, size);
+    trace_output(header, len, trace_context);
+    trace_output(data, size, trace_context);
+    trace_last_us = time_us;
+}
+
+static void trace_flush_pending()
+{
+    if (pending_size) {
+        trace_write_record(pending_direction, pending_us, pending_data, pending_size);
+        pending_size = 0;
+    }
+}
+
+void greentea_trace_record(greentea_trace_direction direction, const void *data, size_t size)
+{
+    if (!trace_output || !size) {
+        return;
+    }
+    if (pending_size && (direction != pending_direction || pending_size + size > sizeof(pending_data))) {
+        trace_flush_pending();
+    }
+    if (size > sizeof(pending_data)) {
+        // Too large to be collected, e.g. a long key or value sent in place
+        trace_write_record(direction, greentea_time_us(), data, size);
+        return;
+    }
+    if (!pending_size) {
+        pending_direction = direction;
+        pending_us = greentea_time_us();
+    }
+    memcpy(pending_data + pending_size, data, size);
+    pending_size += size;
+}
+
+extern "C" void greentea_trace_start(greentea_trace_output output, void *context)
+{
+    static const uint8_t header[] = {
+        GREENTEA_TRACE_MAGIC[0], GREENTEA_TRACE_MAGIC[1], GREENTEA_TRACE_MAGIC[2], GREENTEA_TRACE_MAGIC[3],
+        GREENTEA_TRACE_VERSION
+    };
+
+    greentea_trace_stop();
+    if (output) {
+        output(header, sizeof(header), context);
+        trace_output = output;
+        trace_context = context;
+        trace_last_us = greentea_time_us();
+    }
+}
+
+extern "C" void greentea_trace_stop(void)
+{
+    if (trace_output) {
+        trace_flush_pending();
+        trace_output = NULL;
+        trace_context = NULL;
+    }
+}
+
+#endif // GREENTEA_CLIENT_TRACE
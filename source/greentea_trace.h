@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GREENTEA_CLIENT_TRACE_H_
+#define GREENTEA_CLIENT_TRACE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "greentea-client/test_trace.h"
+
+/**
+ *  Greentea-client internal trace helpers, see test_trace.h for the trace format
+ */
+
+/**
+ * Buffer size large enough for any varint encoded by greentea_varint_encode()
+ */
+#define GREENTEA_VARINT_SIZE    10
+
+/**
+ * Encode an unsigned LEB128 varint.
+ *
+ * @param buffer Output buffer of at least GREENTEA_VARINT_SIZE bytes
+ * @param val Value to encode
+ *
+ * @return Number of bytes written
+ */
+size_t greentea_varint_encode(uint8_t *buffer, uint64_t val);
+
+/**
+ * Decode an unsigned LEB128 varint.
+ *
+ * @param data Encoded data
+ * @param size Number of bytes available
+ * @param val Receives the value
+ *
+ * @return Number of bytes read, 0 if the data ends before the varint or it is too long
+ */
+size_t greentea_varint_decode(const uint8_t *data, size_t size, uint64_t *val);
+
+#if GREENTEA_CLIENT_TRACE
+/**
+ * Record traffic to the trace in progress, if any.
+ *
+ * @param direction Direction of the traffic
+ * @param data Bytes read or written
+ * @param size Number of bytes
+ */
+void greentea_trace_record(enum greentea_trace_direction direction, const void *data, size_t size);
+#else
+static inline void greentea_trace_record(enum greentea_trace_direction, const void *, size_t)
+{
+}
+#endif // GREENTEA_CLIENT_TRACE
+
+#endif // GREENTEA_CLIENT_TRACE_H_
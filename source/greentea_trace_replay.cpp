@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ *  Implementation of test_io.h replaying a recorded trace, see test_trace.h
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include "greentea-client/test_io.h"
+#include "greentea_trace.h"
+
+/**
+ * Position in the records of one direction of a trace.
+ *
+ * @details Input and output are replayed independently, each cursor skips the records
+ *          of the other direction but accounts for their time.
+ */
+struct ReplayCursor {
+    size_t offset;          /**< Offset of the next record header */
+    const uint8_t *data;    /**< Remaining bytes of the current record */
+    size_t size;
+    uint64_t time_us;       /**< Recorded time of the current record */
+};
+
+/**
+ * Size of the trace header, the magic followed by the version byte
+ */
+static const size_t replay_header_size = sizeof(GREENTEA_TRACE_MAGIC) - 1 + 1;
+
+static const uint8_t *replay_trace = NULL;
+static size_t replay_size = 0;
+static greentea_replay_timing replay_timing = GREENTEA_REPLAY_FAST;
+static std::chrono::steady_clock::time_point replay_started;
+
+static ReplayCursor rx_cursor;
+static ReplayCursor tx_cursor;
+static greentea_replay_status replay_status;
+
+/**
+ * Move a cursor to the next record of a direction.
+ *
+ * @return true if a record was found, false at the end of the trace or if it is truncated
+ */
+static bool replay_next_record(ReplayCursor *cursor, greentea_trace_direction direction)
+{
+    while (cursor->offset < replay_size) {
+        const uint8_t *p = replay_trace + cursor->offset;
+        const size_t available = replay_size - cursor->offset;
+        uint64_t delta = 0;
+        uint64_t size = 0;
+        size_t len = 1;
+        size_t n;
+
+        if ((n = greentea_varint_decode(p + len, available - len, &delta)) == 0) {
+            break;
+        }
+        len += n;
+        if ((n = greentea_varint_decode(p + len, available - len, &size)) == 0 || size > available - len - n) {
+            break;
+        }
+        len += n;
+
+        cursor->offset += len + size;
+        cursor->time_us += delta;
+        if (p[0] == direction && size) {
+            cursor->data = p + len;
+            cursor->size = size;
+            return true;
+        }
+    }
+    cursor->offset = replay_size;
+    cursor->size = 0;
+    return false;
+}
+
+/**
+ * Count the output bytes in the trace.
+ */
+static size_t replay_count_tx()
+{
+    ReplayCursor cursor = { replay_header_size, NULL, 0, 0 };
+    size_t total = 0;
+    while (replay_next_record(&cursor, GREENTEA_TRACE_TX)) {
+        total += cursor.size;
+    }
+    return total;
+}
+
+extern "C" int greentea_replay_start(const void *trace, size_t size, greentea_replay_timing timing)
+{
+    const uint8_t *data = static_cast<const uint8_t *>(trace);
+    if (!data || size < replay_header_size ||
+            memcmp(data, GREENTEA_TRACE_MAGIC, replay_header_size - 1) != 0 ||
+            data[replay_header_size - 1] != GREENTEA_TRACE_VERSION) {
+        return -1;
+    }
+
+    replay_trace = data;
+    replay_size = size;
+    replay_timing = timing;
+    replay_started = std::chrono::steady_clock::now();
+    rx_cursor = { replay_header_size, NULL, 0, 0 };
+    tx_cursor = rx_cursor;
+    replay_status = {};
+    replay_status.tx_expected = replay_count_tx();
+    return 0;
+}
+
+extern "C" void greentea_replay_get_status(greentea_replay_status *status)
+{
+    *status = replay_status;
+}
+
+uint64_t greentea_time_us(void)
+{
+    if (replay_timing == GREENTEA_REPLAY_REALTIME) {
+        const auto elapsed = std::chrono::steady_clock::now() - replay_started;
+        return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    }
+    return rx_cursor.time_us > tx_cursor.time_us ? rx_cursor.time_us : tx_cursor.time_us;
+}
+
+int greentea_getc()
+{
+    if (!rx_cursor.size) {
+        if (!replay_trace || !replay_next_record(&rx_cursor, GREENTEA_TRACE_RX)) {
+            return EOF;
+        }
+        if (replay_timing == GREENTEA_REPLAY_REALTIME) {
+            std::this_thread::sleep_until(replay_started + std::chrono::microseconds(rx_cursor.time_us));
+        }
+    }
+    rx_cursor.size--;
+    replay_status.rx_delivered++;
+    return *rx_cursor.data++;
+}
+
+void greentea_write_n(const char *str, size_t len)
+{
+    replay_status.tx_written += len;
+    while (len && !replay_status.diverged) {
+        if (!tx_cursor.size && (!replay_trace || !replay_next_record(&tx_cursor, GREENTEA_TRACE_TX))) {
+            replay_status.diverged = 1;
+            break;
+        }
+        const size_t n = len < tx_cursor.size ? len : tx_cursor.size;
+        size_t matched = 0;
+        while (matched < n && tx_cursor.data[matched] == (uint8_t)str[matched]) {
+            matched++;
+        }
+        replay_status.tx_matched += matched;
+        tx_cursor.data += n;
+        tx_cursor.size -= n;
+        str += n;
+        len -= n;
+        if (matched < n) {
+            replay_status.diverged = 1;
+        }
+    }
+}
+
+void greentea_writev(const struct greentea_iovec *iov, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        greentea_write_n(static_cast<const char *>(iov[i].iov_base), iov[i].iov_len);
+    }
+}
+
+void greentea_write_string(const char *str)
+{
+    greentea_write_n(str, strlen(str));
+}
+
+void greentea_putc(int c)
+{
+    const char byte = c;
+    greentea_write_n(&byte, 1);
+}
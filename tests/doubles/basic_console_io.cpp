@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cstdio>
+
+#include "greentea-client/test_io.h"
+#include "basic_console_io.h"
+
+static std::string _stdout;
+
+BasicConsole::~BasicConsole()
+{
+    _stdout.clear();
+}
+
+std::string BasicConsole::get_stdout() const
+{
+    return _stdout;
+}
+
+int greentea_getc()
+{
+    return EOF;
+}
+
+void greentea_putc(int c)
+{
+    _stdout.push_back(c);
+}
+
+void greentea_write_string(const char *str)
+{
+    _stdout.append(str);
+}
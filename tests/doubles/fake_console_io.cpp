@@ -20,6 +20,12 @@
 
 static std::string _stdout;
 static std::string _stdin;
+static std::string::size_type _flushed;
+static int _flush_count;
+static int _writev_count;
+static uint64_t _time_us;
+static uint32_t _timer_interval_ms;
+static greentea_timer_callback _timer_callback;
 
 Console::Console()
 {
@@ -30,6 +36,38 @@ std::string Console::get_stdout() const
     return _stdout;
 }
 
+std::string Console::get_flushed() const
+{
+    return _stdout.substr(0, _flushed);
+}
+
+int Console::get_flush_count() const
+{
+    return _flush_count;
+}
+
+int Console::get_writev_count() const
+{
+    return _writev_count;
+}
+
+void Console::set_time_us(uint64_t time_us)
+{
+    _time_us = time_us;
+}
+
+uint32_t Console::get_timer_interval() const
+{
+    return _timer_interval_ms;
+}
+
+void Console::fire_timer() const
+{
+    if (_timer_callback) {
+        _timer_callback();
+    }
+}
+
 void Console::set_stdin(const std::string &str)
 {
     _stdin.append(str);
@@ -40,6 +78,12 @@ Console::~Console()
 {
     _stdout = {};
     _stdin = {};
+    _flushed = 0;
+    _flush_count = 0;
+    _writev_count = 0;
+    _time_us = 0;
+    _timer_interval_ms = 0;
+    _timer_callback = nullptr;
 }
 
 int greentea_getc()
@@ -61,3 +105,44 @@ void greentea_write_string(const char *str)
 {
     _stdout.append(str);
 }
+
+void greentea_write_n(const char *str, size_t len)
+{
+    _stdout.append(str, len);
+}
+
+void greentea_writev(const struct greentea_iovec *iov, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        _stdout.append(static_cast<const char *>(iov[i].iov_base), iov[i].iov_len);
+    }
+    _writev_count++;
+}
+
+void greentea_flush(void)
+{
+    _flushed = _stdout.size();
+    _flush_count++;
+}
+
+uint64_t greentea_time_us(void)
+{
+    return _time_us;
+}
+
+int greentea_periodic_timer(uint32_t interval_ms, greentea_timer_callback callback)
+{
+    _timer_interval_ms = interval_ms;
+    _timer_callback = interval_ms ? callback : nullptr;
+    return 0;
+}
+
+int greentea_wait_rx(uint32_t timeout_ms)
+{
+    if (_stdin.empty()) {
+        // Time passes while nothing arrives
+        _time_us += (uint64_t)timeout_ms * 1000;
+        return 0;
+    }
+    return 1;
+}
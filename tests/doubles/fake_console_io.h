@@ -16,6 +16,7 @@
 #ifndef _FAKE_CONSOLE_IO
 #define _FAKE_CONSOLE_IO
 
+#include <cstdint>
 #include <string>
 
 struct Console {
@@ -24,6 +25,20 @@ struct Console {
 
     void set_stdin(const std::string &);
     std::string get_stdout() const;
+
+    // Output written up to the last greentea_flush()
+    std::string get_flushed() const;
+    int get_flush_count() const;
+
+    // Number of greentea_writev() calls
+    int get_writev_count() const;
+
+    void set_time_us(uint64_t);
+
+    // Period of the timer started with greentea_periodic_timer(), 0 if stopped
+    uint32_t get_timer_interval() const;
+    // Call the timer callback as if a period elapsed
+    void fire_timer() const;
 };
 
 #endif // _FAKE_CONSOLE_IO
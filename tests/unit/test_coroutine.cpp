@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "fake_console_io.h"
+#include "greentea-client/test_coroutine.h"
+#include "greentea-client/test_journal.h"
+
+class CoroutineTest: public testing::Test {
+public:
+    Console fake_console;
+
+protected:
+    virtual void TearDown() override
+    {
+        fake_console = {};
+    }
+};
+
+static greentea::task converse(const char *name, int rounds, std::vector<std::string> &replies)
+{
+    for (int i = 0; i < rounds; i++) {
+        co_await greentea::send(name, i);
+        const greentea::message reply = co_await greentea::recv(name);
+        replies.push_back(std::string(reply.key) + "=" + std::string(reply.value));
+    }
+}
+
+TEST_F(CoroutineTest, RunsConversationsOnOneThread)
+{
+    std::vector<std::string> replies[2];
+    greentea::scheduler conversations;
+    ASSERT_TRUE(conversations.spawn(converse("a", 2, replies[0])));
+    ASSERT_TRUE(conversations.spawn(converse("b", 1, replies[1])));
+    ASSERT_EQ(fake_console.get_stdout(), "{{a;0}}\r\n{{b;0}}\r\n");
+
+    const std::string input = "{{b;x}}\r\n{{a;y}}\r\n";
+    conversations.feed(input.data(), input.size());
+    ASSERT_EQ(fake_console.get_stdout(), "{{a;0}}\r\n{{b;0}}\r\n{{a;1}}\r\n");
+    ASSERT_FALSE(conversations.done());
+
+    conversations.feed("{{a;z}}", 7);
+    ASSERT_TRUE(conversations.done());
+    ASSERT_EQ(replies[0], std::vector<std::string>({ "a=y", "a=z" }));
+    ASSERT_EQ(replies[1], std::vector<std::string>({ "b=x" }));
+    ASSERT_EQ(conversations.unhandled(), 0u);
+}
+
+static greentea::task receive(const char *key, std::vector<std::string> &values)
+{
+    const greentea::message msg = co_await greentea::recv(key);
+    values.push_back(std::string(msg.value) + "/" + std::to_string(msg.length));
+}
+
+TEST_F(CoroutineTest, HandsMessagesToWaitersInOrder)
+{
+    std::vector<std::string> values;
+    greentea::scheduler conversations;
+    conversations.spawn(receive("key", values));
+    conversations.spawn(receive("key", values));
+    conversations.spawn(receive(nullptr, values));
+
+    const std::string long_value(GREENTEA_MAX_VALUE_SIZE + 10, 'v');
+    const std::string input = "{{other;1}}{{key;first}}{{key;" + long_value + "}}{{last;3}}";
+    conversations.feed(input.data(), input.size());
+
+    ASSERT_TRUE(conversations.done());
+    ASSERT_EQ(values, std::vector<std::string>({
+        "1/1", "first/5", long_value.substr(0, GREENTEA_MAX_VALUE_SIZE) + "/" + std::to_string(long_value.size())
+    }));
+    ASSERT_EQ(conversations.unhandled(), 1u);
+}
+
+TEST_F(CoroutineTest, RunsUntilTasksReturn)
+{
+    std::vector<std::string> replies;
+    fake_console.set_stdin("{{a;ok}}\r\n{{a;done}}\r\n{{a;unread}}\r\n");
+    greentea::scheduler conversations;
+    conversations.spawn(converse("a", 2, replies));
+
+    ASSERT_TRUE(conversations.run());
+    ASSERT_EQ(replies, std::vector<std::string>({ "a=ok", "a=done" }));
+    // The line ending of the last message is left to the next reader
+    ASSERT_EQ(greentea_getc(), '\r');
+}
+
+TEST_F(CoroutineTest, StopsRunningAtEndOfStream)
+{
+    std::vector<std::string> replies;
+    fake_console.set_stdin("{{a;ok}}\r\n");
+    greentea::scheduler conversations;
+    conversations.spawn(converse("a", 2, replies));
+
+    ASSERT_FALSE(conversations.run());
+    ASSERT_EQ(replies, std::vector<std::string>({ "a=ok" }));
+}
+
+TEST_F(CoroutineTest, FlushesHeldBackOutputBeforeReading)
+{
+    // Without a flush before each read, the host would never see the messages it answers
+    greentea_set_flush_policy(GREENTEA_FLUSH_BATCH, 0);
+    std::vector<std::string> replies;
+    fake_console.set_stdin("{{a;ok}}\r\n{{a;done}}\r\n");
+    greentea::scheduler conversations;
+    conversations.spawn(converse("a", 2, replies));
+    ASSERT_EQ(fake_console.get_flushed(), "");
+
+    ASSERT_TRUE(conversations.run());
+    greentea_set_flush_policy(GREENTEA_FLUSH_FRAME, 0);
+    ASSERT_EQ(replies, std::vector<std::string>({ "a=ok", "a=done" }));
+    ASSERT_EQ(fake_console.get_flushed(), "{{a;0}}\r\n{{a;1}}\r\n");
+}
+
+TEST_F(CoroutineTest, ServesReplayRequestsWhileRunning)
+{
+    char journal[64];
+    greentea_journal_start(journal, sizeof(journal));
+    std::vector<std::string> replies;
+    fake_console.set_stdin("{{__replay;1}}\r\n{{a;ok}}\r\n");
+    greentea::scheduler conversations;
+    conversations.spawn(converse("a", 1, replies));
+
+    ASSERT_TRUE(conversations.run());
+    greentea_journal_stop();
+    ASSERT_EQ(replies, std::vector<std::string>({ "a=ok" }));
+    ASSERT_EQ(conversations.unhandled(), 0u);
+    ASSERT_EQ(fake_console.get_stdout(), "{{a;0}}\r\n{{__seq;1}}\r\n{{a;0}}\r\n");
+}
+
+struct frame_guard {
+    int &destroyed;
+    ~frame_guard()
+    {
+        destroyed++;
+    }
+};
+
+static greentea::task wait_forever(int &destroyed)
+{
+    frame_guard guard{destroyed};
+    co_await greentea::recv("never");
+}
+
+TEST_F(CoroutineTest, DestroysWaitingTasksWithScheduler)
+{
+    int destroyed = 0;
+    {
+        greentea::scheduler conversations;
+        conversations.spawn(wait_forever(destroyed));
+        conversations.spawn(wait_forever(destroyed));
+        ASSERT_EQ(destroyed, 0);
+    }
+    ASSERT_EQ(destroyed, 2);
+
+    // A task which is never spawned is freed without running
+    {
+        greentea::task unspawned = wait_forever(destroyed);
+        ASSERT_TRUE(unspawned);
+    }
+    ASSERT_EQ(destroyed, 2);
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <chrono>
+#include <pty.h>
+#include <string>
+#include <sys/wait.h>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "greentea-client/test_env.h"
+#include "greentea-host/daemon.h"
+#include "greentea-host/harness.h"
+
+using namespace greentea::host;
+
+static int passing_suite()
+{
+    GREENTEA_SETUP(5, "default_auto");
+    GREENTEA_TESTCASE_START("case");
+    GREENTEA_TESTCASE_FINISH("case", 1, 0);
+    GREENTEA_TESTSUITE_RESULT(1);
+    return 0;
+}
+
+static int hanging_suite()
+{
+    GREENTEA_SETUP(1, "default_auto");
+    std::this_thread::sleep_for(std::chrono::seconds(10));
+    return 0;
+}
+
+/**
+ * Run a suite in a child process on the slave end of a new PTY, returning the master end.
+ */
+static int spawn_on_pty(int (*suite)(), std::vector<pid_t> &children)
+{
+    int master;
+    int slave;
+    struct termios tio;
+    cfmakeraw(&tio);
+    if (openpty(&master, &slave, nullptr, &tio, nullptr) != 0) {
+        return -1;
+    }
+    const pid_t pid = fork();
+    if (pid == 0) {
+        close(master);
+        set_device_fd(slave);
+        _exit(suite());
+    }
+    close(slave);
+    children.push_back(pid);
+    return master;
+}
+
+static void reap(std::vector<pid_t> &children)
+{
+    for (pid_t pid : children) {
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+    }
+}
+
+TEST(HostDaemonTest, RunsSuitesOnManyChannels)
+{
+    const int channels = 16;
+    std::vector<pid_t> children;
+    dut_daemon d(2000);
+    d.on_text([](size_t, const std::string &) {});
+    int finished = 0;
+    d.on_finished([&finished](size_t, session &) {
+        finished++;
+    });
+
+    for (int i = 0; i < channels; i++) {
+        ASSERT_EQ(d.add_channel("dut" + std::to_string(i), spawn_on_pty(passing_suite, children)), i);
+    }
+    d.run();
+    reap(children);
+
+    ASSERT_EQ(finished, channels);
+    ASSERT_EQ(d.active_count(), 0u);
+    for (int i = 0; i < channels; i++) {
+        const result &res = d.channel(i).get_result();
+        ASSERT_EQ(res.status, "success") << d.channel_name(i);
+        ASSERT_EQ(res.testcases.size(), 1u);
+        ASSERT_EQ(res.testcases[0].passed, 1);
+    }
+}
+
+TEST(HostDaemonTest, TimesOutChannelsIndependently)
+{
+    std::vector<pid_t> children;
+    dut_daemon d(2000);
+    d.on_text([](size_t, const std::string &) {});
+    d.add_channel("hanging", spawn_on_pty(hanging_suite, children));
+    d.add_channel("passing", spawn_on_pty(passing_suite, children));
+
+    const auto start = std::chrono::steady_clock::now();
+    d.run();
+    reap(children);
+
+    ASSERT_EQ(d.channel(0).get_result().status, "timeout");
+    ASSERT_EQ(d.channel(1).get_result().status, "success");
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+}
@@ -0,0 +1,581 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "greentea-client/test_env.h"
+#include "greentea-client/test_journal.h"
+#include "greentea-client/test_log.h"
+#include "greentea-client/test_runner.h"
+#include "greentea-host/harness.h"
+
+using namespace greentea::host;
+
+static int passing_suite()
+{
+    static const char *const names[] = { "first", "second;with separator" };
+    GREENTEA_SETUP(5, "default_auto");
+    GREENTEA_TESTCASE_NAMES(names, 2);
+    GREENTEA_TESTCASE_START("first");
+    GREENTEA_TESTCASE_FINISH("first", 2, 0);
+    GREENTEA_TESTCASE_START("second;with separator");
+    GREENTEA_TESTCASE_FINISH("second;with separator", 1, 1);
+    GREENTEA_TESTSUITE_RESULT(1);
+    return 0;
+}
+
+static int failing_suite()
+{
+    GREENTEA_SETUP(5, "default_auto");
+    GREENTEA_TESTSUITE_RESULT(0);
+    return 0;
+}
+
+static int hanging_suite()
+{
+    GREENTEA_SETUP(1, "default_auto");
+    std::this_thread::sleep_for(std::chrono::seconds(10));
+    GREENTEA_TESTSUITE_RESULT(1);
+    return 0;
+}
+
+static int stuck_testcase_suite()
+{
+    GREENTEA_SETUP(30, "default_auto");
+    GREENTEA_TESTCASE_START("stuck", 200);
+    std::this_thread::sleep_for(std::chrono::seconds(10));
+    GREENTEA_TESTCASE_FINISH("stuck", 1, 0);
+    GREENTEA_TESTSUITE_RESULT(1);
+    return 0;
+}
+
+static int silent_suite()
+{
+    return 0;
+}
+
+static int echo_suite()
+{
+    GREENTEA_SETUP(5, "echo");
+    greentea_send_kv("ping", 42);
+    char key[8];
+    char value[8];
+    greentea_parse_kv(key, value, sizeof(key), sizeof(value));
+    GREENTEA_TESTSUITE_RESULT(strcmp(key, "pong") == 0 && strcmp(value, "42") == 0);
+    return 0;
+}
+
+static int impatient_suite()
+{
+    GREENTEA_SETUP(5, "default_auto");
+    char key[8];
+    char value[8];
+    GREENTEA_TESTSUITE_RESULT(greentea_parse_kv_timeout(key, value, sizeof(key), sizeof(value), 100) == -1);
+    return 0;
+}
+
+static const char long_name[] = "a name much longer than what fits a single record of the deferred log";
+
+static int logging_suite()
+{
+    GREENTEA_SETUP(5, "default_auto");
+    GREENTEA_LOG("case %d of %u", -1, 3u);
+    GREENTEA_LOG("%s=%04x %c %.2f %lld", "mask", 0xbeef, 'z', 2.5, -5000000000LL);
+    greentea_log_drain();
+    GREENTEA_LOG("%*d|%-5s|%%", 4, 7, "ab");
+    GREENTEA_LOG("%s %d", long_name, 5);
+    GREENTEA_TESTSUITE_RESULT(1);
+    return 0;
+}
+
+static int clock_sync_suite()
+{
+    GREENTEA_SETUP(5, "default_auto");
+    const int first = GREENTEA_CLOCK_SYNC();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    const int second = GREENTEA_CLOCK_SYNC();
+    GREENTEA_TESTSUITE_RESULT(first == 0 && second == 0);
+    return 0;
+}
+
+static int link_bench_suite()
+{
+    GREENTEA_SETUP(5, "default_auto");
+    greentea_link_bench_result bench;
+    const bool measured = GREENTEA_LINK_BENCH(&bench) == 0 && bench.rtt_max_us >= bench.rtt_p50_us;
+    GREENTEA_TESTCASE_START("after");
+    GREENTEA_TESTCASE_FINISH("after", 1, 0);
+    GREENTEA_TESTSUITE_RESULT(measured);
+    return 0;
+}
+
+static int journal_suite()
+{
+    static char journal[512];
+    GREENTEA_SETUP(5, "default_auto");
+    greentea_journal_start(journal, sizeof(journal));
+    GREENTEA_TESTCASE_START("first");
+    GREENTEA_TESTCASE_FINISH("first", 1, 0);
+    greentea_send_kv("custom", 1);
+    GREENTEA_TESTSUITE_RESULT(1);
+    greentea_journal_stop();
+    return 0;
+}
+
+class HostHarnessTest: public testing::TestWithParam<run_mode> {
+protected:
+    options quiet() const
+    {
+        options opts;
+        opts.mode = GetParam();
+        opts.echo = false;
+        opts.report = false;
+        opts.sync_timeout_ms = 1000;
+        return opts;
+    }
+};
+
+TEST_P(HostHarnessTest, RecordsPassingSuite)
+{
+    harness h(quiet());
+    const result res = h.run(passing_suite);
+
+    ASSERT_EQ(res.status, "success");
+    ASSERT_EQ(res.exit_code, 0);
+    ASSERT_EQ(res.timeout, 5);
+    ASSERT_EQ(res.host_test_name, "default_auto");
+    ASSERT_EQ(res.testcases.size(), 2u);
+    ASSERT_EQ(res.testcases[0].name, "first");
+    ASSERT_EQ(res.testcases[0].passed, 2);
+    ASSERT_EQ(res.testcases[0].failed, 0);
+    ASSERT_TRUE(res.testcases[0].finished);
+    ASSERT_EQ(res.testcases[1].name, "second;with separator");
+    ASSERT_EQ(res.testcases[1].passed, 1);
+    ASSERT_EQ(res.testcases[1].failed, 1);
+    ASSERT_TRUE(res.summary.received);
+    ASSERT_EQ(res.summary.count, 2);
+    ASSERT_EQ(res.summary.passed, 1);
+    ASSERT_EQ(res.summary.failed, 1);
+    ASSERT_EQ(res.summary.durations_us.size(), 2u);
+}
+
+TEST_P(HostHarnessTest, ReportsFailingSuite)
+{
+    harness h(quiet());
+    const result res = h.run(failing_suite);
+
+    ASSERT_EQ(res.status, "failure");
+    ASSERT_EQ(res.exit_code, 1);
+}
+
+TEST_P(HostHarnessTest, ReportsSuiteWithoutSync)
+{
+    harness h(quiet());
+    const result res = h.run(silent_suite);
+
+    ASSERT_EQ(res.status, "no_sync");
+    ASSERT_EQ(res.exit_code, 1);
+}
+
+TEST_P(HostHarnessTest, CallsHandlers)
+{
+    harness h(quiet());
+    h.on("ping", [](harness & h, const std::string &, const std::string & value) {
+        h.send("pong", value);
+    });
+    const result res = h.run(echo_suite);
+
+    ASSERT_EQ(res.status, "success");
+}
+
+TEST_P(HostHarnessTest, ReceiveTimesOutWithoutReply)
+{
+    harness h(quiet());
+    const result res = h.run(impatient_suite);
+
+    ASSERT_EQ(res.status, "success");
+}
+
+TEST_P(HostHarnessTest, DecodesLog)
+{
+    harness h(quiet());
+    const result res = h.run(logging_suite);
+
+    ASSERT_EQ(res.status, "success");
+    ASSERT_EQ(res.log.size(), 4u);
+    ASSERT_EQ(res.log[0], "case -1 of 3");
+    ASSERT_EQ(res.log[1], "mask=beef z 2.50 -5000000000");
+    ASSERT_EQ(res.log[2], "   7|ab   |%");
+    // The name is cut short and the number left out to fit the record
+    ASSERT_EQ(res.log[3].substr(0, 40), std::string(long_name, 40));
+    ASSERT_EQ(res.log[3].substr(res.log[3].size() - 2), " ?");
+    ASSERT_EQ(res.log_dropped, 0u);
+}
+
+TEST_P(HostHarnessTest, DecodesLogWithExtractedStrings)
+{
+    options opts = quiet();
+    opts.log_strings = GREENTEA_TEST_LOG_STRINGS;
+    harness h(opts);
+    const result res = h.run(logging_suite);
+
+    ASSERT_EQ(res.log.size(), 4u);
+    ASSERT_EQ(res.log[0], "case -1 of 3");
+}
+
+TEST_P(HostHarnessTest, SynchronizesClock)
+{
+    harness h(quiet());
+    const result res = h.run(clock_sync_suite);
+
+    ASSERT_EQ(res.status, "success");
+    ASSERT_EQ(res.clock.count, 2);
+    // The DUT and the host share the same clock here
+    ASSERT_GE(res.clock.rtt_us, 0);
+    ASSERT_LE(std::llabs(res.clock.offset_us), res.clock.rtt_us + 1);
+    ASSERT_GT(res.clock.device_us, 0);
+    ASSERT_NEAR(res.clock.to_host_us(res.clock.device_us + 500), res.clock.device_us + 500 + res.clock.offset_us, 1);
+}
+
+TEST_P(HostHarnessTest, BenchmarksEachLink)
+{
+    for (link_type link : { link_type::socket, link_type::pipe, link_type::pty }) {
+        options opts = quiet();
+        opts.link = link;
+        opts.link_bench_pings = 20;
+        opts.link_bench_bytes = 10000;
+        harness h(opts);
+        const result res = h.run(link_bench_suite);
+
+        ASSERT_EQ(res.status, "success") << (int)link;
+        ASSERT_EQ(res.testcases.size(), 1u);
+        ASSERT_EQ(res.link_bench.pings, 20);
+        ASSERT_LE(res.link_bench.rtt_p50_us, res.link_bench.rtt_p90_us);
+        ASSERT_LE(res.link_bench.rtt_p99_us, res.link_bench.rtt_max_us);
+        ASSERT_GT(res.link_bench.to_host_bytes_per_s, 0);
+        ASSERT_GT(res.link_bench.to_device_bytes_per_s, 0);
+    }
+}
+
+TEST_P(HostHarnessTest, ExchangesCapabilities)
+{
+    harness h(quiet());
+    const result res = h.run(passing_suite);
+
+    ASSERT_TRUE(res.capabilities.received);
+    ASSERT_EQ(res.capabilities.max_value_size, (size_t)GREENTEA_MAX_VALUE_SIZE);
+    ASSERT_EQ(res.capabilities.framing, "kv+stream+log+journal+shard");
+    ASSERT_EQ(res.capabilities.line_rate, 0u);
+}
+
+TEST_P(HostHarnessTest, SwitchesLineRateOfPty)
+{
+    options opts = quiet();
+    opts.link = link_type::pty;
+    opts.max_line_rate = 230400;
+    harness h(opts);
+    const result res = h.run(passing_suite);
+
+    ASSERT_EQ(res.status, "success");
+    ASSERT_EQ(res.capabilities.line_rate, 230400u);
+    ASSERT_EQ(res.testcases.size(), 2u);
+}
+
+TEST_P(HostHarnessTest, SkipsLinkBenchmarkByDefault)
+{
+    harness h(quiet());
+    const result res = h.run(link_bench_suite);
+
+    ASSERT_EQ(res.status, "failure");
+    ASSERT_EQ(res.link_bench.pings, 0);
+}
+
+TEST_P(HostHarnessTest, CountsJournaledMessages)
+{
+    harness h(quiet());
+    const result res = h.run(journal_suite);
+
+    ASSERT_EQ(res.status, "success");
+    ASSERT_EQ(res.testcases.size(), 1u);
+    ASSERT_TRUE(res.testcases[0].finished);
+    // The test case messages, custom, the summary and end at least
+    ASSERT_GE(res.journal.messages, 5u);
+    ASSERT_EQ(res.journal.recovered, 0u);
+    ASSERT_EQ(res.journal.duplicates, 0u);
+    ASSERT_EQ(res.journal.lost, 0u);
+}
+
+INSTANTIATE_TEST_SUITE_P(RunModes, HostHarnessTest, testing::Values(run_mode::fork, run_mode::thread),
+[](const testing::TestParamInfo<run_mode> &info)
+{
+    return info.param == run_mode::fork ? "Fork" : "Thread";
+});
+
+static const char *const sharded_cases[] = { "a", "b", "c", "d", "e" };
+
+static int sharded_suite()
+{
+    GREENTEA_SETUP(5, "default_auto");
+    GREENTEA_TESTCASE_SHARD(sharded_cases, 5);
+    for (size_t i = 0; i < 5; i++) {
+        if (greentea_testcase_assigned(i)) {
+            GREENTEA_TESTCASE_START(sharded_cases[i]);
+            GREENTEA_TESTCASE_FINISH(sharded_cases[i], 1, 0);
+        }
+    }
+    GREENTEA_TESTSUITE_RESULT(1);
+    return 0;
+}
+
+TEST_P(HostHarnessTest, MergesShardsOfSuite)
+{
+    std::vector<result> shards;
+    for (size_t i = 0; i < 3; i++) {
+        options opts = quiet();
+        opts.shard_index = i;
+        opts.shard_count = 3;
+        harness h(opts);
+        shards.push_back(h.run(sharded_suite));
+        ASSERT_EQ(shards.back().status, "success");
+    }
+    const result merged = merge_results(shards);
+
+    ASSERT_EQ(merged.status, "success");
+    ASSERT_EQ(merged.exit_code, 0);
+    ASSERT_EQ(merged.timeout, 5);
+    std::vector<std::string> names;
+    for (const testcase_result &testcase : merged.testcases) {
+        ASSERT_TRUE(testcase.finished);
+        names.push_back(testcase.name);
+    }
+    ASSERT_EQ(names, std::vector<std::string>({ "a", "d", "b", "e", "c" }));
+    ASSERT_EQ(merged.summary.count, 5);
+    ASSERT_EQ(merged.summary.passed, 5);
+    ASSERT_EQ(merged.summary.durations_us.size(), 5u);
+}
+
+TEST_P(HostHarnessTest, RunsTestCasesByName)
+{
+    options opts = quiet();
+    opts.shard_cases = { "e", "b" };
+    harness h(opts);
+    const result res = h.run(sharded_suite);
+
+    ASSERT_EQ(res.status, "success");
+    ASSERT_EQ(res.testcases.size(), 2u);
+    ASSERT_EQ(res.testcases[0].name, "b");
+    ASSERT_EQ(res.testcases[1].name, "e");
+}
+
+static void runner_case_pass()
+{
+    GREENTEA_CHECK(true);
+}
+
+static void runner_case_fail()
+{
+    GREENTEA_CHECK(false);
+}
+
+static const greentea_case runner_cases[] = {
+    { "first", runner_case_pass, 0, 0 },
+    { "second", runner_case_fail, 0, 0 },
+    { "third", runner_case_pass, 1000, 0 },
+    { "fourth", runner_case_fail, 0, 0 },
+};
+
+static int runner_suite()
+{
+    GREENTEA_SETUP(5, "default_auto");
+    return greentea_run_cases(runner_cases, 4) ? 1 : 0;
+}
+
+TEST_P(HostHarnessTest, RunsFailedTestCasesAgain)
+{
+    harness first(quiet());
+    const result res = first.run(runner_suite);
+    ASSERT_EQ(res.status, "failure");
+    ASSERT_EQ(res.testcases.size(), 4u);
+
+    options opts = quiet();
+    for (size_t i = 0; i < res.testcases.size(); i++) {
+        if (res.testcases[i].failed) {
+            opts.shard_cases.push_back("#" + std::to_string(i));
+        }
+    }
+    harness again(opts);
+    const result rerun = again.run(runner_suite);
+
+    ASSERT_EQ(rerun.status, "failure");
+    ASSERT_EQ(rerun.testcases.size(), 2u);
+    ASSERT_EQ(rerun.testcases[0].name, "second");
+    ASSERT_EQ(rerun.testcases[1].name, "fourth");
+    ASSERT_EQ(rerun.summary.count, 2);
+    ASSERT_EQ(rerun.summary.failed, 2);
+}
+
+static void sleeping_case()
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    greentea_send_kv("slept", 100);
+    GREENTEA_CHECK(true);
+}
+
+static const greentea_case sleeping_cases[] = {
+    { "s0", sleeping_case, 0, GREENTEA_CASE_PARALLEL_SAFE },
+    { "s1", sleeping_case, 0, GREENTEA_CASE_PARALLEL_SAFE },
+    { "s2", sleeping_case, 0, GREENTEA_CASE_PARALLEL_SAFE },
+    { "s3", sleeping_case, 0, GREENTEA_CASE_PARALLEL_SAFE },
+    { "s4", sleeping_case, 0, GREENTEA_CASE_PARALLEL_SAFE },
+    { "s5", sleeping_case, 0, GREENTEA_CASE_PARALLEL_SAFE },
+    { "s6", sleeping_case, 0, GREENTEA_CASE_PARALLEL_SAFE },
+    { "s7", sleeping_case, 0, GREENTEA_CASE_PARALLEL_SAFE },
+};
+
+static int parallel_suite()
+{
+    GREENTEA_SETUP(5, "default_auto");
+    greentea_set_case_workers(8);
+    return greentea_run_cases(sleeping_cases, 8) ? 1 : 0;
+}
+
+TEST_P(HostHarnessTest, RunsParallelTestCasesAtOnce)
+{
+    int slept = 0;
+    harness h(quiet());
+    h.on("slept", [&slept](harness &, const std::string &, const std::string &) {
+        slept++;
+    });
+    const result res = h.run(parallel_suite);
+
+    ASSERT_EQ(res.status, "success");
+    ASSERT_EQ(slept, 8);
+    ASSERT_EQ(res.testcases.size(), 8u);
+    for (size_t i = 0; i < 8; i++) {
+        ASSERT_EQ(res.testcases[i].name, "s" + std::to_string(i));
+        ASSERT_TRUE(res.testcases[i].finished);
+    }
+    ASSERT_EQ(res.summary.durations_us.size(), 8u);
+    // One after the other, the test cases would take 800 ms
+    ASSERT_LT(res.duration_ms, 400);
+}
+
+TEST(HostHarnessTimeoutTest, KillsSuiteOnTimeout)
+{
+    options opts;
+    opts.echo = false;
+    opts.report = false;
+    harness h(opts);
+
+    const auto start = std::chrono::steady_clock::now();
+    const result res = h.run(hanging_suite);
+
+    ASSERT_EQ(res.status, "timeout");
+    ASSERT_EQ(res.exit_code, 1);
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+}
+
+TEST(HostHarnessTimeoutTest, AbortsStuckTestCase)
+{
+    options opts;
+    opts.echo = false;
+    opts.report = false;
+    harness h(opts);
+
+    const auto start = std::chrono::steady_clock::now();
+    const result res = h.run(stuck_testcase_suite);
+
+    ASSERT_EQ(res.status, "testcase_timeout");
+    ASSERT_EQ(res.exit_code, 1);
+    ASSERT_EQ(res.testcases.size(), 1u);
+    ASSERT_FALSE(res.testcases[0].finished);
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+}
+
+TEST(HostSessionTest, DetectsLostHeartbeat)
+{
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    session s(fds[0], 1000);
+    s.start();
+
+    // Answer the __sync message as the DUT
+    char sync[128];
+    const ssize_t bytes = read(fds[1], sync, sizeof(sync) - 1);
+    ASSERT_GT(bytes, 0);
+    sync[bytes] = '\0';
+    const std::string uuid = std::string(sync).substr(std::string(sync).find("{{__sync;") + 9, 36);
+    const std::string output = "{{__sync;" + uuid + "}}\n{{__timeout;60}}\n{{__heartbeat;50}}\n";
+    s.feed(output.data(), output.size());
+
+    const auto deadline = s.deadline();
+    ASSERT_LE(deadline, session::clock::now() + std::chrono::milliseconds(150));
+    std::this_thread::sleep_until(deadline);
+    s.expire();
+
+    ASSERT_EQ(s.get_result().status, "heartbeat_lost");
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(HostSessionTest, RequestsLostJournaledMessages)
+{
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    session s(fds[0], 1000);
+    s.start();
+
+    char received[256];
+    ssize_t bytes = read(fds[1], received, sizeof(received) - 1);
+    ASSERT_GT(bytes, 0);
+    received[bytes] = '\0';
+    const std::string uuid = std::string(received).substr(std::string(received).find("{{__sync;") + 9, 36);
+    // The DUT numbers its messages, and the second one is lost
+    std::string output = "{{__sync;" + uuid + "}}\n{{__seq;1}}\n{{__testcase_start;a}}\n"
+                         "{{__seq;3}}\n{{__testcase_start;c}}\n";
+    s.feed(output.data(), output.size());
+    bytes = read(fds[1], received, sizeof(received) - 1);
+    ASSERT_GT(bytes, 0);
+    ASSERT_EQ(std::string(received, bytes), "{{__replay;2}}\n");
+
+    // The replay repeats what the host already has, and the last message is lost for good
+    output = "{{__seq;2}}\n{{__testcase_start;b}}\n{{__seq;3}}\n{{__testcase_start;c}}\n"
+             "{{__seq;4}}\n{{end;success}}\n{{__journal_end;5}}\n{{__exit;0}}\n";
+    s.feed(output.data(), output.size());
+    bytes = read(fds[1], received, sizeof(received) - 1);
+    ASSERT_GT(bytes, 0);
+    ASSERT_EQ(std::string(received, bytes), "{{__replay;5}}\n{{__journal_done;0}}\n");
+
+    const result &res = s.get_result();
+    ASSERT_EQ(res.status, "success");
+    ASSERT_EQ(res.testcases.size(), 3u);
+    ASSERT_EQ(res.testcases[2].name, "b");
+    ASSERT_EQ(res.journal.messages, 4u);
+    ASSERT_EQ(res.journal.recovered, 1u);
+    ASSERT_EQ(res.journal.duplicates, 1u);
+    ASSERT_EQ(res.journal.lost, 1u);
+    close(fds[0]);
+    close(fds[1]);
+}
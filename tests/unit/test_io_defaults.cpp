@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "basic_console_io.h"
+#include "greentea-client/test_env.h"
+
+class IoDefaultsTest: public testing::Test {
+public:
+    BasicConsole console;
+};
+
+TEST_F(IoDefaultsTest, WritesEmbeddedNulBytes)
+{
+    const std::string value = std::string("a\0b", 3) + std::string(40, 'c') + std::string("\0\0d", 3);
+
+    greentea_send_kv_n("bin", 3, value.data(), value.size());
+
+    ASSERT_EQ(console.get_stdout(), "{{bin;" + value + "}}\r\n");
+}
@@ -13,12 +13,26 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdarg>
+#include <cstring>
+#include <limits>
+#include <random>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <gtest/gtest.h>
 
 #include "fake_console_io.h"
 #include "greentea-client/test_env.h"
+#include "greentea-client/test_journal.h"
+#include "greentea-client/test_log.h"
+#include "greentea-client/test_runner.h"
+#include "greentea-client/test_trace.h"
 
 class KiViProtocolTest: public testing::Test {
 public:
@@ -96,6 +110,424 @@ TEST_F(KiViProtocolTest, SendStringValueAndPassFailCount)
     ASSERT_EQ(console, output);
 }
 
+enum class Color : uint8_t { red = 1, blue = 7 };
+enum Plain { PLAIN_A = -3 };
+
+TEST_F(KiViProtocolTest, SendTypedValues)
+{
+    const std::string name = "adc0";
+    greentea::send("sample", name, int8_t(-128), uint64_t(18446744073709551615ULL), Color::blue, PLAIN_A, 'c', "lit",
+                   true, 1.5);
+
+    const std::string console = fake_console.get_stdout();
+    ASSERT_EQ(console, "{{sample;adc0;-128;18446744073709551615;7;-3;c;lit;1;1.5}}\r\n");
+}
+
+TEST_F(KiViProtocolTest, ComputesExactFrameSize)
+{
+    const char *text = "hey";
+    greentea::send("key", text, -12345, INT64_MIN, 0u);
+
+    const std::string console = fake_console.get_stdout();
+    ASSERT_EQ(greentea::frame_size("key", text, -12345, INT64_MIN, 0u), console.size());
+}
+
+TEST_F(KiViProtocolTest, SendFloatingPointValues)
+{
+    greentea_send_kv("d", 0.1);
+    greentea_send_kv("f", 0.1f);
+    greentea::send("v", 250.0, -1.5e-7, 1e100, 5e-324, 1.7976931348623157e308, 0.0, -0.0, 123456.789f,
+                   std::numeric_limits<double>::infinity(), std::numeric_limits<double>::quiet_NaN());
+
+    const std::string console = fake_console.get_stdout();
+    ASSERT_EQ(console, "{{d;0.1}}\r\n{{f;0.1}}\r\n"
+              "{{v;250.0;-1.5e-07;1e+100;5e-324;1.7976931348623157e+308;0.0;-0.0;123456.79;inf;nan}}\r\n");
+}
+
+TEST_F(KiViProtocolTest, SendFloatingPointValuesRoundTrip)
+{
+    std::mt19937_64 random(1);
+    for (int i = 0; i < 10000; i++) {
+        uint64_t bits = random();
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        if (!std::isfinite(value)) {
+            continue;
+        }
+        float single = static_cast<float>(i % 2 ? value : 1.0 / value);
+
+        fake_console = {};
+        greentea::send("v", value, single);
+
+        const std::string console = fake_console.get_stdout();
+        const std::string::size_type first = console.find(';') + 1;
+        const std::string::size_type second = console.find(';', first) + 1;
+        ASSERT_EQ(strtod(console.c_str() + first, nullptr), value) << console;
+        ASSERT_EQ(strtof(console.c_str() + second, nullptr), single) << console;
+    }
+}
+
+TEST_F(KiViProtocolTest, SendWideIntegerValue)
+{
+    greentea_send_kv("size", static_cast<size_t>(4294967296ULL));
+
+    const std::string console = fake_console.get_stdout();
+    ASSERT_EQ(console, "{{size;4294967296}}\r\n");
+}
+
+TEST_F(KiViProtocolTest, SendsMessageAsSingleGatherList)
+{
+    greentea::send("key", "value", 1, 2u);
+    greentea_send_kv("hello", "99");
+
+    ASSERT_EQ(fake_console.get_writev_count(), 2);
+    ASSERT_EQ(fake_console.get_stdout(), "{{key;value;1;2}}\r\n{{hello;99}}\r\n");
+}
+
+TEST_F(KiViProtocolTest, SendUnterminatedKeyAndValue)
+{
+    const char packet[] = { 'r', 'x', 'p', 'a', 'y', 'l', 'o', 'a', 'd' };
+    greentea_send_kv_n(packet, 2, packet + 2, 7);
+    greentea::send_n(packet, 2, 1);
+
+    ASSERT_EQ(fake_console.get_stdout(), "{{rx;payload}}\r\n{{rx;1}}\r\n");
+}
+
+static size_t produce_from_string(char *buffer, size_t size, void *context)
+{
+    std::string *remaining = static_cast<std::string *>(context);
+    const size_t len = remaining->copy(buffer, size);
+    remaining->erase(0, len);
+    return len;
+}
+
+TEST_F(KiViProtocolTest, SendStreamedValue)
+{
+    const std::string key = "dump";
+    std::string value;
+    for (int i = 0; i < 1000; i++) {
+        value += std::to_string(i % 10);
+    }
+    const std::string output = "{{" + key + ";" + value + "}}\r\n";
+
+    std::string remaining = value;
+    greentea_send_kv_stream(key.c_str(), produce_from_string, &remaining);
+
+    const std::string console = fake_console.get_stdout();
+    ASSERT_EQ(console, output);
+}
+
+TEST_F(KiViProtocolTest, SendStreamedEmptyValue)
+{
+    const std::string key = "dump";
+    const std::string output = "{{" + key + ";}}\r\n";
+
+    std::string remaining;
+    greentea_send_kv_stream(key.c_str(), produce_from_string, &remaining);
+
+    const std::string console = fake_console.get_stdout();
+    ASSERT_EQ(console, output);
+}
+
+TEST_F(KiViProtocolTest, SendFormattedValue)
+{
+    greentea_send_kvf("fmt", "%d,%u,%ld,%llu,%x,%X,%s,%c,%%", -42, 42u, -1234567L, 18446744073709551615ULL, 0xbeef, 0xbeef,
+                      "str", 'c');
+
+    const std::string console = fake_console.get_stdout();
+    ASSERT_EQ(console, "{{fmt;-42,42,-1234567,18446744073709551615,beef,BEEF,str,c,%}}\r\n");
+}
+
+TEST_F(KiViProtocolTest, SendFormattedWidthAndPrecision)
+{
+    greentea_send_kvf("fmt", "%5d|%-5d|%05d|%.3s|%*s|%lld", -42, 42, -42, "abcdef", 4, "ab", -9223372036854775807LL - 1);
+
+    const std::string console = fake_console.get_stdout();
+    ASSERT_EQ(console, "{{fmt;  -42|42   |-0042|abc|  ab|-9223372036854775808}}\r\n");
+}
+
+TEST_F(KiViProtocolTest, SendFormattedShortIntegers)
+{
+    greentea_send_kvf("fmt", "%hhx,%hhd,%hd,%hu,%hX", -1, 200, 70000, 70000u, -1);
+
+    const std::string console = fake_console.get_stdout();
+    ASSERT_EQ(console, "{{fmt;ff,-56,4464,4464,FFFF}}\r\n");
+}
+
+/**
+ * Send through greentea_vsend_kvf(), whose format is not checked by the compiler,
+ * for conversions that printf accepts but warns about
+ */
+static void send_kvf_unchecked(const char *key, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    greentea_vsend_kvf(key, format, args);
+    va_end(args);
+}
+
+TEST_F(KiViProtocolTest, SendFormattedIntegerPrecision)
+{
+    // The '0' flag is ignored with a precision, which -Wformat points out
+    send_kvf_unchecked("fmt", "%.3d|%.3d|%.4x|%6.3u|%-6.3d|%06.3d|%.0d|%.0u|%.2d", 7, -7, 0xab, 5u, 42, 1, 0, 0u, 1234);
+
+    const std::string console = fake_console.get_stdout();
+    ASSERT_EQ(console, "{{fmt;007|-007|00ab|   005|042   |   001|||1234}}\r\n");
+}
+
+TEST_F(KiViProtocolTest, SendFormattedFixedPoint)
+{
+    greentea_send_kvf("fmt", "%f,%.2f,%.0f,%.3f,%08.2f", 3.25, -0.125, 2.5, 1e-4, -1.5);
+
+    const std::string console = fake_console.get_stdout();
+    ASSERT_EQ(console, "{{fmt;3.250000,-0.12,2,0.000,-0001.50}}\r\n");
+}
+
+TEST_F(KiViProtocolTest, SendFormattedFixedPointLikePrintf)
+{
+    // Rounded from the exact binary value, ties to even, and the sign of zero kept
+    greentea_send_kvf("fmt", "%.2f,%.1f,%.0f,%.0f,%.1f,%.9f,%f,%f", 0.125, 0.15, 3.5, 0.5, -0.0, 1e-9, 1e20,
+                      -std::numeric_limits<double>::infinity());
+
+    const std::string console = fake_console.get_stdout();
+    ASSERT_EQ(console, "{{fmt;0.12,0.1,4,0,-0.0,0.000000001,ovf,-inf}}\r\n");
+}
+
+TEST_F(KiViProtocolTest, SendFormattedLongString)
+{
+    const std::string value(200, 'x');
+
+    greentea_send_kvf("fmt", "<%s>", value.c_str());
+
+    const std::string console = fake_console.get_stdout();
+    ASSERT_EQ(console, "{{fmt;<" + value + ">}}\r\n");
+}
+
+static void sink_to_string(const char *data, size_t size, void *context)
+{
+    std::string *received = static_cast<std::string *>(context);
+    if (data) {
+        received->append(data, size);
+    } else {
+        received->clear();
+    }
+}
+
+TEST_F(KiViProtocolTest, ParseStreamedValue)
+{
+    std::string value;
+    for (int i = 0; i < 1000; i++) {
+        value += std::to_string(i % 10);
+    }
+    fake_console.set_stdin("{{firmware;" + value + "}}\n");
+
+    char key[16];
+    std::string received;
+    uint32_t crc = 0;
+    ASSERT_NE(greentea_parse_kv_stream(key, sizeof(key), sink_to_string, &received, &crc), 0);
+
+    ASSERT_STREQ(key, "firmware");
+    ASSERT_EQ(received, value);
+    // CRC-32 check value
+    fake_console.set_stdin("{{check;123456789}}\n");
+    received.clear();
+    ASSERT_NE(greentea_parse_kv_stream(key, sizeof(key), sink_to_string, &received, &crc), 0);
+    ASSERT_EQ(crc, 0xCBF43926u);
+}
+
+TEST_F(KiViProtocolTest, ParseStreamedValueIntoArena)
+{
+    fake_console.set_stdin("{{vector;0123456789}}\n");
+
+    char key[16];
+    char buffer[4];
+    greentea_value_arena arena = { buffer, sizeof(buffer), 0 };
+    ASSERT_NE(greentea_parse_kv_stream(key, sizeof(key), greentea_value_arena_sink, &arena, NULL), 0);
+
+    ASSERT_EQ(arena.length, 10u);
+    ASSERT_EQ(std::string(buffer, sizeof(buffer)), "0123");
+}
+
+TEST_F(KiViProtocolTest, FlushesEveryFrameByDefault)
+{
+    greentea_send_kv("a", 1);
+    greentea_send_kv("b", "2");
+
+    ASSERT_EQ(fake_console.get_flush_count(), 2);
+    ASSERT_EQ(fake_console.get_flushed(), "{{a;1}}\r\n{{b;2}}\r\n");
+}
+
+TEST_F(KiViProtocolTest, FlushesBatchOfFrames)
+{
+    greentea_set_flush_policy(GREENTEA_FLUSH_BATCH, 3);
+    const int flushes = fake_console.get_flush_count();
+
+    greentea_send_kv("a", 1);
+    greentea_send_kv("b", 2);
+    ASSERT_EQ(fake_console.get_flush_count(), flushes);
+    greentea_send_kv("c", 3);
+    ASSERT_EQ(fake_console.get_flush_count(), flushes + 1);
+    ASSERT_EQ(fake_console.get_flushed(), "{{a;1}}\r\n{{b;2}}\r\n{{c;3}}\r\n");
+
+    greentea_set_flush_policy(GREENTEA_FLUSH_FRAME, 0);
+}
+
+TEST_F(KiViProtocolTest, HeartbeatFlushesPendingBatch)
+{
+    ASSERT_EQ(GREENTEA_HEARTBEAT(500), 0);
+    greentea_set_flush_policy(GREENTEA_FLUSH_BATCH, 2);
+    const int flushes = fake_console.get_flush_count();
+
+    greentea_send_kv("a", 1);
+    ASSERT_EQ(fake_console.get_flush_count(), flushes);
+    fake_console.fire_timer();
+    ASSERT_EQ(fake_console.get_flush_count(), flushes + 1);
+    ASSERT_EQ(fake_console.get_flushed(), "{{__heartbeat;500}}\r\n{{a;1}}\r\n{{__heartbeat;500}}\r\n");
+
+    // The batch starts again after the heartbeat
+    greentea_send_kv("b", 2);
+    ASSERT_EQ(fake_console.get_flush_count(), flushes + 1);
+    greentea_send_kv("c", 3);
+    ASSERT_EQ(fake_console.get_flush_count(), flushes + 2);
+
+    greentea_set_flush_policy(GREENTEA_FLUSH_FRAME, 0);
+    GREENTEA_TESTSUITE_RESULT(1);
+}
+
+TEST_F(KiViProtocolTest, FlushesAtFrameBoundaryAfterByteThreshold)
+{
+    greentea_set_flush_policy(GREENTEA_FLUSH_BYTES, 12);
+
+    greentea_send_kv("a", 1);
+    ASSERT_EQ(fake_console.get_flushed(), "");
+    greentea_send_kv("b", 22);
+    ASSERT_EQ(fake_console.get_flushed(), "{{a;1}}\r\n{{b;22}}\r\n");
+
+    greentea_set_flush_policy(GREENTEA_FLUSH_FRAME, 0);
+}
+
+TEST_F(KiViProtocolTest, FlushesAfterTimeThreshold)
+{
+    greentea_set_flush_policy(GREENTEA_FLUSH_TIME, 5);
+
+    fake_console.set_time_us(1000);
+    greentea_send_kv("a", 1);
+    fake_console.set_time_us(5999);
+    greentea_send_kv("b", 2);
+    ASSERT_EQ(fake_console.get_flushed(), "");
+    fake_console.set_time_us(6000);
+    greentea_send_kv("c", 3);
+    ASSERT_EQ(fake_console.get_flushed(), "{{a;1}}\r\n{{b;2}}\r\n{{c;3}}\r\n");
+
+    greentea_set_flush_policy(GREENTEA_FLUSH_FRAME, 0);
+}
+
+TEST_F(KiViProtocolTest, FlushesPendingOutputBeforeReading)
+{
+    greentea_set_flush_policy(GREENTEA_FLUSH_BATCH, 0);
+    greentea_send_kv("a", 1);
+    ASSERT_EQ(fake_console.get_flushed(), "");
+
+    char key[8];
+    char value[8];
+    fake_console.set_stdin("{{k;v}}\n");
+    greentea_parse_kv(key, value, sizeof(key), sizeof(value));
+    ASSERT_EQ(fake_console.get_flushed(), "{{a;1}}\r\n");
+
+    greentea_set_flush_policy(GREENTEA_FLUSH_FRAME, 0);
+}
+
+TEST_F(KiViProtocolTest, ParseUnterminatedKeyAndValue)
+{
+    fake_console.set_stdin("{{key;12345678}}\n{{longer_key;9}}\n");
+
+    char key[3];
+    char value[8];
+    size_t key_len = 0;
+    size_t value_len = 0;
+    ASSERT_NE(greentea_parse_kv_n(key, sizeof(key), &key_len, value, sizeof(value), &value_len), 0);
+    ASSERT_EQ(std::string(key, key_len), "key");
+    ASSERT_EQ(std::string(value, value_len), "12345678");
+
+    // Lengths larger than the buffers tell that the data was truncated
+    ASSERT_NE(greentea_parse_kv_n(key, sizeof(key), &key_len, value, sizeof(value), &value_len), 0);
+    ASSERT_EQ(key_len, 10u);
+    ASSERT_EQ(std::string(key, sizeof(key)), "lon");
+    ASSERT_EQ(std::string(value, value_len), "9");
+}
+
+TEST_F(KiViProtocolTest, ParsesInterleavedStreams)
+{
+    const std::string first = "noise{{first;1}}\r\n{{broken;}} {{ second ; 2 }}\r\n";
+    const std::string second = "{{ab{{other;value}}\n";
+    char key[2][16];
+    char value[2][16];
+    greentea_kv_parser parser[2];
+    greentea_kv_parser_init(&parser[0], key[0], sizeof(key[0]), value[0], sizeof(value[0]), 0);
+    greentea_kv_parser_init(&parser[1], key[1], sizeof(key[1]), value[1], sizeof(value[1]), 0);
+
+    std::vector<std::string> messages[2];
+    for (size_t i = 0; i < std::max(first.size(), second.size()); i++) {
+        const std::string *input[2] = { &first, &second };
+        for (int p = 0; p < 2; p++) {
+            if (i < input[p]->size() &&
+                    greentea_kv_parser_push(&parser[p], (*input[p])[i]) == GREENTEA_KV_MESSAGE) {
+                messages[p].push_back(std::string(key[p]) + "=" + value[p]);
+            }
+        }
+    }
+
+    ASSERT_EQ(messages[0], std::vector<std::string>({ "first=1", "second =2 " }));
+    ASSERT_EQ(messages[1], std::vector<std::string>({ "other=value" }));
+}
+
+TEST_F(KiViProtocolTest, ParsesMessagesWithSeveralValues)
+{
+    const std::string input = "{{__testcase_finish;name [x];1;0}}\r\n{{next;a}}";
+    char key[32];
+    char value[32];
+    greentea_kv_parser parser;
+    greentea_kv_parser_init(&parser, key, sizeof(key), value, sizeof(value), GREENTEA_KV_MULTI_VALUE);
+
+    size_t consumed = 0;
+    ASSERT_EQ(greentea_kv_parser_feed(&parser, input.data(), input.size(), &consumed), GREENTEA_KV_MESSAGE);
+    ASSERT_EQ(consumed, input.find("}}") + 2);
+    ASSERT_STREQ(key, "__testcase_finish");
+    ASSERT_STREQ(value, "name [x];1;0");
+    ASSERT_EQ(parser.value.length, 12u);
+
+    const size_t offset = consumed;
+    ASSERT_EQ(greentea_kv_parser_feed(&parser, input.data() + offset, input.size() - offset, &consumed), GREENTEA_KV_MESSAGE);
+    ASSERT_STREQ(key, "next");
+}
+
+static void append_to_string(const void *data, size_t size, void *context)
+{
+    static_cast<std::string *>(context)->append(static_cast<const char *>(data), size);
+}
+
+TEST_F(KiViProtocolTest, RecordsTrafficToTrace)
+{
+    std::string trace;
+    fake_console.set_time_us(100);
+    greentea_trace_start(append_to_string, &trace);
+
+    char key[8];
+    char value[8];
+    fake_console.set_stdin("{{k;v}}\n");
+    greentea_parse_kv(key, value, sizeof(key), sizeof(value));
+    fake_console.set_time_us(350);
+    greentea_send_kv("a", 1);
+    greentea_trace_stop();
+    greentea_send_kv("b", 2);
+
+    // Header, input record at +0us and output record at +250us
+    const std::string expected = std::string("GTTR\x01", 5) +
+                                 std::string("\x01\x00\x08{{k;v}}\n", 11) +
+                                 std::string("\x00\xfa\x01\x09{{a;1}}\r\n", 13);
+    ASSERT_EQ(trace, expected);
+}
+
 TEST_F(KiViProtocolTest, PerformsSetupHandshake)
 {
     const int timeout = 99;
@@ -117,6 +549,42 @@ TEST_F(KiViProtocolTest, PerformsSetupHandshake)
     ASSERT_TRUE(test_name_pos != std::string::npos && test_name_pos > timeout_pos);
 }
 
+TEST_F(KiViProtocolTest, ExchangesCapabilitiesWithHost)
+{
+    fake_console.set_stdin("{{__capabilities;kv+stream+log,1023,115200}}\n{{__sync;0}}\n");
+
+    GREENTEA_SETUP(10, "default_auto");
+
+    // The fake transport can not change its line rate, so it is kept
+    const std::string console = fake_console.get_stdout();
+    const std::string::size_type version_pos = console.find("{{__version;");
+    const std::string::size_type capabilities_pos = console.find("{{__capabilities;kv+stream+log+journal+shard;" +
+                                                                 std::to_string(GREENTEA_MAX_VALUE_SIZE) + ";0}}\r\n");
+    const std::string::size_type timeout_pos = console.find("{{__timeout;10}}");
+    ASSERT_NE(version_pos, std::string::npos);
+    ASSERT_TRUE(capabilities_pos != std::string::npos && capabilities_pos > version_pos);
+    ASSERT_TRUE(timeout_pos != std::string::npos && timeout_pos > capabilities_pos);
+}
+
+TEST_F(KiViProtocolTest, AdvertisesValueSizeOfSetupBuffer)
+{
+    fake_console.set_stdin("{{__capabilities;kv,1023,0}}\n{{__sync;0}}\n");
+    char uuid[40];
+
+    GREENTEA_SETUP_UUID(10, "default_auto", uuid, sizeof(uuid));
+
+    ASSERT_NE(fake_console.get_stdout().find("{{__capabilities;kv+stream+log+journal+shard;39;0}}"), std::string::npos);
+}
+
+TEST_F(KiViProtocolTest, SendsNoCapabilitiesToOtherHosts)
+{
+    fake_console.set_stdin("{{__sync;0}}\n");
+
+    GREENTEA_SETUP(10, "default_auto");
+
+    ASSERT_EQ(fake_console.get_stdout().find("__capabilities"), std::string::npos);
+}
+
 TEST_F(KiViProtocolTest, SendsStartTestcaseMessage)
 {
     const std::string test_name = "test";
@@ -151,6 +619,609 @@ TEST_F(KiViProtocolTest, SendsFinishTestcaseMessage)
     ASSERT_TRUE(failures_pos != std::string::npos && failures_pos > passes_pos);
 }
 
+TEST_F(KiViProtocolTest, SendsTestCaseSummary)
+{
+    const char *const names[] = { "one", "two", "three" };
+    // Test cases reported by other tests are not part of this suite
+    GREENTEA_TESTSUITE_RESULT(1);
+    fake_console = {};
+
+    GREENTEA_TESTCASE_NAMES(names, 3);
+    fake_console.set_time_us(1000);
+    GREENTEA_TESTCASE_START("one");
+    fake_console.set_time_us(1250);
+    GREENTEA_TESTCASE_FINISH("one", 2, 0);
+    GREENTEA_TESTCASE_START("two");
+    fake_console.set_time_us(5000001250ULL);
+    GREENTEA_TESTCASE_FINISH("two", 1, 1);
+    GREENTEA_TESTSUITE_RESULT(0);
+
+    const std::string console = fake_console.get_stdout();
+    ASSERT_EQ(console, "{{__testcase_name;one}}\r\n{{__testcase_name;two}}\r\n{{__testcase_name;three}}\r\n"
+              "{{__testcase_count;3}}\r\n"
+              "{{__testcase_start;one}}\r\n{{__testcase_finish;one;2;0}}\r\n"
+              "{{__testcase_start;two}}\r\n{{__testcase_finish;two;1;1}}\r\n"
+              "{{__testcase_summary;1;1}}\r\n{{__testcase_durations;250,4294967295}}\r\n"
+              "{{end;failure}}\r\n{{__exit;0}}\r\n");
+}
+
+TEST_F(KiViProtocolTest, SendsDurationsOfFirstTestCases)
+{
+    GREENTEA_TESTSUITE_RESULT(1);
+    fake_console = {};
+
+    for (uint64_t i = 0; i < GREENTEA_SUMMARY_MAX_CASES + 6; i++) {
+        fake_console.set_time_us(1000 * i + 1);
+        GREENTEA_TESTCASE_START("case");
+        fake_console.set_time_us(1000 * i + 1 + i);
+        GREENTEA_TESTCASE_FINISH("case", 1, 0);
+    }
+    GREENTEA_TESTSUITE_RESULT(1);
+
+    std::string durations = "{{__testcase_durations;0";
+    for (int i = 1; i < GREENTEA_SUMMARY_MAX_CASES; i++) {
+        durations += "," + std::to_string(i);
+    }
+    durations += "}}\r\n";
+    const std::string console = fake_console.get_stdout();
+    ASSERT_NE(console.find("{{__testcase_summary;" + std::to_string(GREENTEA_SUMMARY_MAX_CASES + 6) + ";0}}\r\n" +
+                           durations), std::string::npos);
+}
+
+TEST_F(KiViProtocolTest, ParseGivesUpAfterTimeout)
+{
+    char key[8];
+    char value[8];
+    fake_console.set_time_us(1000);
+    ASSERT_EQ(greentea_parse_kv_timeout(key, value, sizeof(key), sizeof(value), 250), -1);
+    ASSERT_EQ(greentea_time_us(), 251000u);
+
+    fake_console.set_stdin("{{a;1}}\n");
+    ASSERT_EQ(greentea_parse_kv_timeout(key, value, sizeof(key), sizeof(value), 0), 1);
+    ASSERT_STREQ(key, "a");
+    ASSERT_STREQ(value, "1");
+}
+
+TEST_F(KiViProtocolTest, ParseDiscardsMessageCutByTimeout)
+{
+    char key[8];
+    char value[8];
+    fake_console.set_stdin("{{cut;");
+    ASSERT_EQ(greentea_parse_kv_timeout(key, value, sizeof(key), sizeof(value), 10), -1);
+
+    fake_console.set_stdin("off}}\n{{b;2}}\n");
+    ASSERT_EQ(greentea_parse_kv_timeout(key, value, sizeof(key), sizeof(value), 10), 1);
+    ASSERT_STREQ(key, "b");
+    ASSERT_STREQ(value, "2");
+}
+
+TEST_F(KiViProtocolTest, SetupGivesUpWithoutHost)
+{
+    ASSERT_EQ(GREENTEA_SETUP_TIMEOUT(10, "default_auto", 500), -1);
+
+    fake_console = {};
+    fake_console.set_stdin("{{__sync;0dad4a9d-59a3-4aec-810d-d5fb09d852c1}}\n");
+    ASSERT_EQ(GREENTEA_SETUP_TIMEOUT(10, "default_auto", 500), 0);
+    const std::string console = fake_console.get_stdout();
+    ASSERT_NE(console.find("{{__sync;0dad4a9d-59a3-4aec-810d-d5fb09d852c1}}"), std::string::npos);
+    ASSERT_NE(console.find("{{__host_test_name;default_auto}}"), std::string::npos);
+}
+
+TEST_F(KiViProtocolTest, SendsTestCaseTimeout)
+{
+    GREENTEA_TESTCASE_START("slow", 2500);
+
+    const std::string console = fake_console.get_stdout();
+    ASSERT_EQ(console, "{{__testcase_start;slow}}\r\n{{__testcase_timeout;2500}}\r\n");
+}
+
+static size_t produce_during_heartbeat(char *, size_t, void *context)
+{
+    // The timer fires while the message is being written
+    static_cast<Console *>(context)->fire_timer();
+    return 0;
+}
+
+TEST_F(KiViProtocolTest, SendsHeartbeatOutsideOfMessages)
+{
+    ASSERT_EQ(GREENTEA_HEARTBEAT(500), 0);
+    ASSERT_EQ(fake_console.get_timer_interval(), 500u);
+    fake_console.fire_timer();
+    greentea_send_kv_stream("dump", produce_during_heartbeat, &fake_console);
+    GREENTEA_TESTSUITE_RESULT(1);
+    fake_console.fire_timer();
+
+    const std::string console = fake_console.get_stdout();
+    ASSERT_EQ(console.substr(0, console.find("{{end")), "{{__heartbeat;500}}\r\n{{__heartbeat;500}}\r\n{{dump;}}\r\n");
+    ASSERT_EQ(fake_console.get_timer_interval(), 0u);
+    ASSERT_EQ(console.find("__heartbeat", console.find("{{end")), std::string::npos);
+}
+
+TEST_F(KiViProtocolTest, SendsLogRecordsWhenDrained)
+{
+    GREENTEA_LOG("count %d", -2);
+    GREENTEA_LOG("name %s", "first");
+    ASSERT_EQ(fake_console.get_stdout(), "");
+
+    greentea_log_drain();
+    greentea_log_drain();
+
+    const std::string console = fake_console.get_stdout();
+    ASSERT_EQ(console.find("{{__log;"), 0u);
+    ASSERT_EQ(console.find("}}\r\n"), console.size() - 4);
+    ASSERT_EQ(console.find_first_not_of("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/", 8),
+              console.size() - 4);
+}
+
+static size_t produce_during_drain(char *, size_t, void *)
+{
+    // A timer drains the log while the message is being written
+    greentea_log_drain();
+    return 0;
+}
+
+TEST_F(KiViProtocolTest, DrainsLogOutsideOfMessages)
+{
+    GREENTEA_LOG("pending");
+    greentea_send_kv_stream("dump", produce_during_drain, NULL);
+    ASSERT_EQ(fake_console.get_stdout(), "{{dump;}}\r\n");
+
+    GREENTEA_TESTSUITE_RESULT(1);
+    const std::string console = fake_console.get_stdout();
+    ASSERT_EQ(console.find("{{__log;"), console.find("{{dump;}}\r\n") + 11);
+    ASSERT_LT(console.find("{{__log;"), console.find("{{end;"));
+}
+
+TEST_F(KiViProtocolTest, ReportsDroppedLogRecords)
+{
+    const uint32_t dropped = greentea_log_dropped();
+    for (int i = 0; i < GREENTEA_LOG_BUFFER_SIZE / 8; i++) {
+        GREENTEA_LOG("record %d of %s", i, "a record which does not fit");
+    }
+    ASSERT_GT(greentea_log_dropped(), dropped);
+
+    greentea_log_drain();
+
+    const std::string console = fake_console.get_stdout();
+    ASSERT_EQ(console.find("{{__log_dropped;" + std::to_string(greentea_log_dropped()) + "}}\r\n"), 0u);
+    ASSERT_NE(console.find("{{__log;"), std::string::npos);
+}
+
+static const char *const shard_test_cases[] ={ "a", "b", "c", "d", "e" };
+
+static const char shard_handshake[] = "{{__capabilities;kv+stream+shard,1023,0}}\n{{__sync;0}}\n";
+
+TEST_F(KiViProtocolTest, RunsShardAssignedByIndex)
+{
+    fake_console.set_stdin(std::string(shard_handshake) + "{{__shard;1/3}}\n");
+    GREENTEA_SETUP(10, "default_auto");
+    const size_t sent = fake_console.get_stdout().size();
+
+    ASSERT_EQ(GREENTEA_TESTCASE_SHARD(shard_test_cases, 5), 2u);
+
+    const std::string console = fake_console.get_stdout().substr(sent);
+    ASSERT_EQ(console, "{{__testcase_name;a}}\r\n{{__testcase_name;b}}\r\n{{__testcase_name;c}}\r\n"
+              "{{__testcase_name;d}}\r\n{{__testcase_name;e}}\r\n{{__shard_request;5}}\r\n"
+              "{{__testcase_count;2}}\r\n");
+    const bool assigned[] = { false, true, false, false, true };
+    for (size_t i = 0; i < 5; i++) {
+        ASSERT_EQ(greentea_testcase_assigned(i), assigned[i]) << i;
+    }
+}
+
+TEST_F(KiViProtocolTest, RunsTestCasesAssignedByName)
+{
+    // Longer than a stream chunk, so names are split across sink calls
+    std::string names;
+    for (int i = 0; i < 40; i++) {
+        names += "unknown" + std::to_string(i) + ",";
+    }
+    names += "b,d," + std::string(GREENTEA_SHARD_NAME_SIZE * 2, 'x') + ",e";
+    fake_console.set_stdin(shard_handshake + std::string("{{__other;ignored}}\n{{__shard_cases;") + names + "}}\n");
+    GREENTEA_SETUP(10, "default_auto");
+
+    ASSERT_EQ(GREENTEA_TESTCASE_SHARD(shard_test_cases, 5), 3u);
+
+    const bool assigned[] = { false, true, false, true, true };
+    for (size_t i = 0; i < 5; i++) {
+        ASSERT_EQ(greentea_testcase_assigned(i), assigned[i]) << i;
+    }
+    ASSERT_NE(fake_console.get_stdout().find("{{__testcase_count;3}}"), std::string::npos);
+}
+
+TEST_F(KiViProtocolTest, RunsTestCasesAssignedByPosition)
+{
+    fake_console.set_stdin(std::string(shard_handshake) + "{{__shard_cases;#4,#0,#5,#,#1x,c}}\n");
+    GREENTEA_SETUP(10, "default_auto");
+
+    ASSERT_EQ(GREENTEA_TESTCASE_SHARD(shard_test_cases, 5), 3u);
+
+    const bool assigned[] = { true, false, true, false, true };
+    for (size_t i = 0; i < 5; i++) {
+        ASSERT_EQ(greentea_testcase_assigned(i), assigned[i]) << i;
+    }
+}
+
+TEST_F(KiViProtocolTest, RunsAllTestCasesWithoutShardCapability)
+{
+    // A host without the capability is not asked, and what it sends later is left unread
+    fake_console.set_stdin("{{__sync;0}}\n{{__shard;1/3}}\n");
+    GREENTEA_SETUP(10, "default_auto");
+    const size_t sent = fake_console.get_stdout().size();
+
+    ASSERT_EQ(GREENTEA_TESTCASE_SHARD(shard_test_cases, 5), 5u);
+
+    const std::string console = fake_console.get_stdout().substr(sent);
+    ASSERT_EQ(console, "{{__testcase_name;a}}\r\n{{__testcase_name;b}}\r\n{{__testcase_name;c}}\r\n"
+              "{{__testcase_name;d}}\r\n{{__testcase_name;e}}\r\n{{__testcase_count;5}}\r\n");
+    for (size_t i = 0; i < 5; i++) {
+        ASSERT_TRUE(greentea_testcase_assigned(i)) << i;
+    }
+    ASSERT_EQ(greentea_getc(), '{');
+}
+
+static std::string runner_calls;
+
+static void runner_case_pass()
+{
+    runner_calls += "pass,";
+    GREENTEA_CHECK(1 + 1 == 2);
+    GREENTEA_CHECK(true);
+}
+
+static void runner_case_fail()
+{
+    runner_calls += "fail,";
+    GREENTEA_CHECK(true);
+    GREENTEA_CHECK(1 + 1 == 3);
+}
+
+static void runner_case_empty()
+{
+    runner_calls += "empty,";
+}
+
+static const greentea_case runner_cases[] = {
+    { "pass", runner_case_pass, 0, 0 },
+    { "fail", runner_case_fail, 0, 0 },
+    { "empty", runner_case_empty, 250, 0 },
+};
+
+TEST_F(KiViProtocolTest, RunnerRunsTestCasesInOrder)
+{
+    fake_console.set_stdin("{{__sync;0}}\n");
+    GREENTEA_SETUP(10, "default_auto");
+    const size_t sent = fake_console.get_stdout().size();
+    runner_calls.clear();
+
+    ASSERT_EQ(greentea_run_cases(runner_cases, 3), 1u);
+
+    ASSERT_EQ(runner_calls, "pass,fail,empty,");
+    const std::string console = fake_console.get_stdout().substr(sent);
+    ASSERT_EQ(console.find("{{__testcase_name;pass}}\r\n{{__testcase_name;fail}}\r\n"
+                           "{{__testcase_name;empty}}\r\n{{__testcase_count;3}}\r\n"
+                           "{{__testcase_start;pass}}\r\n{{__testcase_finish;pass;2;0}}\r\n"
+                           "{{__testcase_start;fail}}\r\n{{__testcase_finish;fail;1;1}}\r\n"
+                           "{{__testcase_start;empty}}\r\n{{__testcase_timeout;250}}\r\n"
+                           "{{__testcase_finish;empty;0;0}}\r\n{{__testcase_summary;2;1}}\r\n"), 0u);
+    ASSERT_NE(console.find("{{end;failure}}"), std::string::npos);
+}
+
+TEST_F(KiViProtocolTest, RunnerRunsTestCasesChosenByHost)
+{
+    fake_console.set_stdin("{{__capabilities;kv+stream+shard,1023,0}}\n{{__sync;0}}\n{{__shard_cases;#1,empty}}\n");
+    GREENTEA_SETUP(10, "default_auto");
+    runner_calls.clear();
+
+    ASSERT_EQ(greentea_run_cases(runner_cases, 3), 1u);
+
+    ASSERT_EQ(runner_calls, "fail,empty,");
+    const std::string console = fake_console.get_stdout();
+    ASSERT_NE(console.find("{{__shard_request;3}}\r\n{{__testcase_count;2}}\r\n{{__testcase_start;fail}}"),
+              std::string::npos);
+    ASSERT_EQ(console.find("{{__testcase_start;pass}}"), std::string::npos);
+}
+
+GREENTEA_CASE(registered_first)
+{
+    runner_calls += "first,";
+    GREENTEA_CHECK(true);
+}
+
+GREENTEA_CASE(registered_second)
+{
+    runner_calls += "second,";
+}
+
+GREENTEA_CASE_TIMEOUT(registered_third, 100)
+{
+    runner_calls += "third,";
+}
+
+TEST_F(KiViProtocolTest, RunnerRunsRegisteredTestCases)
+{
+    fake_console.set_stdin("{{__sync;0}}\n");
+    GREENTEA_SETUP(10, "default_auto");
+    runner_calls.clear();
+
+    ASSERT_EQ(greentea_run_registered_cases(), 0u);
+
+    ASSERT_EQ(runner_calls, "first,second,third,");
+    const std::string console = fake_console.get_stdout();
+    ASSERT_NE(console.find("{{__testcase_count;3}}\r\n{{__testcase_start;registered_first}}\r\n"
+                           "{{__testcase_finish;registered_first;1;0}}\r\n"), std::string::npos);
+    ASSERT_NE(console.find("{{__testcase_start;registered_third}}\r\n{{__testcase_timeout;100}}\r\n"),
+              std::string::npos);
+    ASSERT_NE(console.find("{{end;success}}"), std::string::npos);
+}
+
+static std::atomic<int> parallel_running(0);
+static std::thread::id suite_thread;
+
+/**
+ * Wait for all four parallel test cases to run at once, the first one finishing last.
+ */
+static void parallel_case(int index)
+{
+    parallel_running++;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (parallel_running < 4 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    GREENTEA_CHECK(parallel_running >= 4);
+    GREENTEA_CHECK(std::this_thread::get_id() != suite_thread);
+    if (index == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    greentea_send_kv("from", index);
+}
+
+static void serial_case()
+{
+    GREENTEA_CHECK(std::this_thread::get_id() == suite_thread);
+    greentea_send_kv("from", "serial");
+}
+
+static const greentea_case parallel_cases[] = {
+    { "p0", [] { parallel_case(0); }, 0, GREENTEA_CASE_PARALLEL_SAFE },
+    { "p1", [] { parallel_case(1); }, 0, GREENTEA_CASE_PARALLEL_SAFE },
+    { "p2", [] { parallel_case(2); }, 0, GREENTEA_CASE_PARALLEL_SAFE },
+    { "p3", [] { parallel_case(3); }, 0, GREENTEA_CASE_PARALLEL_SAFE },
+    { "serial", serial_case, 0, 0 },
+    { "limited", serial_case, 100, GREENTEA_CASE_PARALLEL_SAFE },
+    { "alone", serial_case, 0, GREENTEA_CASE_PARALLEL_SAFE },
+};
+
+TEST_F(KiViProtocolTest, RunnerRunsParallelTestCasesConcurrently)
+{
+    fake_console.set_stdin("{{__sync;0}}\n");
+    GREENTEA_SETUP(10, "default_auto");
+    const size_t sent = fake_console.get_stdout().size();
+    parallel_running = 0;
+    suite_thread = std::this_thread::get_id();
+    greentea_set_case_workers(4);
+
+    const size_t failed = greentea_run_cases(parallel_cases, 7);
+    greentea_set_case_workers(0);
+
+    ASSERT_EQ(failed, 0u);
+    // In the order of the test cases, whichever finished first
+    std::string expected;
+    for (int i = 0; i < 4; i++) {
+        const std::string name = "p" + std::to_string(i);
+        expected += "{{__testcase_start;" + name + "}}\r\n";
+        expected += "{{from;" + std::to_string(i) + "}}\r\n{{__testcase_finish;" + name + ";2;0}}\r\n";
+    }
+    // A test case with a timeout runs on the thread of the suite, as does one on its own
+    expected += "{{__testcase_start;serial}}\r\n{{from;serial}}\r\n{{__testcase_finish;serial;1;0}}\r\n"
+                "{{__testcase_start;limited}}\r\n{{__testcase_timeout;100}}\r\n{{from;serial}}\r\n"
+                "{{__testcase_finish;limited;1;0}}\r\n"
+                "{{__testcase_start;alone}}\r\n{{from;serial}}\r\n{{__testcase_finish;alone;1;0}}\r\n"
+                "{{__testcase_summary;7;0}}\r\n{{end;success}}\r\n";
+    const std::string console = fake_console.get_stdout().substr(sent);
+    const std::string::size_type start = console.find("{{__testcase_start;p0}}");
+    ASSERT_NE(start, std::string::npos);
+    ASSERT_EQ(console.substr(start, expected.size()), expected);
+}
+
+static std::string clock_pongs(uint64_t host_us)
+{
+    std::string pongs;
+    for (int seq = 0; seq < GREENTEA_CLOCK_SYNC_ROUNDS; seq++) {
+        pongs += "{{__clock_pong;" + std::to_string(seq) + "," + std::to_string(host_us) + "," +
+                 std::to_string(host_us + seq) + "}}\n";
+    }
+    return pongs;
+}
+
+TEST_F(KiViProtocolTest, SynchronizesClockWithHost)
+{
+    fake_console.set_stdin("{{__sync;0}}\n");
+    GREENTEA_SETUP(10, "default_auto");
+
+    // Other messages and answers to earlier pings are skipped
+    fake_console = {};
+    fake_console.set_time_us(1000);
+    fake_console.set_stdin("{{other;1}}\n{{__clock_pong;7,1,1}}\n" + clock_pongs(3000));
+    ASSERT_EQ(GREENTEA_CLOCK_SYNC(), 0);
+    std::string console = fake_console.get_stdout();
+    ASSERT_EQ(console.substr(0, 26), "{{__clock_ping;0;1000}}\r\n{");
+    ASSERT_NE(console.find("{{__clock_ping;7;1000}}\r\n"), std::string::npos);
+    ASSERT_NE(console.find("{{__clock_sync;1000;2000;0;0}}\r\n"), std::string::npos);
+
+    // The offset grew by 1 ms over 1 s
+    fake_console = {};
+    fake_console.set_time_us(1001000);
+    fake_console.set_stdin(clock_pongs(1004000));
+    ASSERT_EQ(GREENTEA_CLOCK_SYNC(), 0);
+    console = fake_console.get_stdout();
+    ASSERT_NE(console.find("{{__clock_sync;1001000;3000;0;1000000}}\r\n"), std::string::npos);
+}
+
+TEST_F(KiViProtocolTest, ClockSyncGivesUpWithoutClockOrHost)
+{
+    ASSERT_EQ(GREENTEA_CLOCK_SYNC(), -1);
+    ASSERT_EQ(fake_console.get_stdout(), "");
+
+    fake_console.set_time_us(1000);
+    ASSERT_EQ(GREENTEA_CLOCK_SYNC(), -1);
+    ASSERT_EQ(fake_console.get_stdout(), "{{__clock_ping;0;1000}}\r\n");
+}
+
+TEST_F(KiViProtocolTest, ServesLinkBenchmark)
+{
+    fake_console.set_stdin("{{__link_bench_ping;0}}\n{{__link_bench_data;abcd}}\n{{__link_bench_data;ef}}\n"
+                           "{{__link_bench_ack;0}}\n{{__link_bench_send;" +
+                           std::to_string(GREENTEA_LINK_BENCH_CHUNK_SIZE + 3) + "}}\n"
+                           "{{__link_bench_done;10,20,30,40,5000,6000}}\n");
+    greentea_link_bench_result result;
+    ASSERT_EQ(GREENTEA_LINK_BENCH(&result), 0);
+    ASSERT_EQ(result.rtt_p50_us, 10u);
+    ASSERT_EQ(result.rtt_max_us, 40u);
+    ASSERT_EQ(result.to_host_bytes_per_s, 5000u);
+    ASSERT_EQ(result.to_device_bytes_per_s, 6000u);
+
+    const std::string chunk = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ01";
+    ASSERT_EQ(chunk.size(), (size_t)GREENTEA_LINK_BENCH_CHUNK_SIZE);
+    ASSERT_EQ(fake_console.get_stdout(),
+              "{{__link_bench_request;" + std::to_string(GREENTEA_LINK_BENCH_CHUNK_SIZE) + "}}\r\n"
+              "{{__link_bench_pong;0}}\r\n"
+              "{{__link_bench_ack;6}}\r\n"
+              "{{__link_bench_data;" + chunk + "}}\r\n"
+              "{{__link_bench_data;012}}\r\n"
+              "{{__link_bench_ack;" + std::to_string(GREENTEA_LINK_BENCH_CHUNK_SIZE + 3) + "}}\r\n"
+              "{{__link_bench_result;10;20;30;40;5000;6000}}\r\n");
+}
+
+TEST_F(KiViProtocolTest, LinkBenchmarkSkippedByHost)
+{
+    fake_console.set_stdin("{{__link_bench_done;skip}}\n");
+    ASSERT_EQ(GREENTEA_LINK_BENCH(NULL), -1);
+    ASSERT_EQ(fake_console.get_stdout().find("__link_bench_result"), std::string::npos);
+
+    // No host answering at all
+    ASSERT_EQ(GREENTEA_LINK_BENCH(NULL), -1);
+}
+
+TEST_F(KiViProtocolTest, JournalsResultsAndReplaysThem)
+{
+    fake_console.set_stdin("{{__capabilities;kv+stream+log+journal,1023,0}}\n{{__sync;0}}\n");
+    GREENTEA_SETUP(10, "default_auto");
+    char journal[256];
+    greentea_journal_start(journal, sizeof(journal));
+
+    GREENTEA_TESTCASE_START("first");
+    greentea_send_kv("__internal", 1);
+    greentea_send_kv("custom", 5);
+    GREENTEA_TESTCASE_FINISH("first", 1, 0);
+    const std::string sent = fake_console.get_stdout();
+    ASSERT_EQ(sent.substr(sent.find("{{__seq;1}}")),
+              "{{__seq;1}}\r\n{{__testcase_start;first}}\r\n{{__internal;1}}\r\n{{__seq;2}}\r\n{{custom;5}}\r\n"
+              "{{__seq;3}}\r\n{{__testcase_finish;first;1;0}}\r\n");
+
+    // The request is served while the suite waits for its own message
+    char key[16];
+    char value[16];
+    fake_console.set_stdin("{{__replay;2}}\n{{k;v}}\n");
+    ASSERT_EQ(greentea_parse_kv(key, value, sizeof(key), sizeof(value)), 1);
+    ASSERT_STREQ(key, "k");
+    ASSERT_EQ(fake_console.get_stdout().substr(sent.size()),
+              "{{__seq;2}}\r\n{{custom;5}}\r\n{{__seq;3}}\r\n{{__testcase_finish;first;1;0}}\r\n");
+
+    fake_console.set_stdin("{{__replay;1}}\n{{__journal_done;0}}\n");
+    GREENTEA_TESTSUITE_RESULT(1);
+    greentea_journal_stop();
+    const std::string console = fake_console.get_stdout();
+    const std::string::size_type end_pos = console.find("{{end;success}}\r\n");
+    const std::string::size_type journal_end_pos = console.find("{{__journal_end;", end_pos);
+    ASSERT_NE(end_pos, std::string::npos);
+    ASSERT_EQ(console.rfind("{{", end_pos - 1), console.rfind("{{__seq;", end_pos));
+    ASSERT_EQ(journal_end_pos, end_pos + 17);
+    ASSERT_LT(console.find("{{__seq;1}}\r\n{{__testcase_start;first}}", journal_end_pos),
+              console.find("{{__exit;0}}"));
+}
+
+TEST_F(KiViProtocolTest, NumbersJournaledMessagesOnlyForHostsTakingThem)
+{
+    fake_console.set_stdin("{{__sync;0}}\n");
+    GREENTEA_SETUP(10, "default_auto");
+    char journal[256];
+    greentea_journal_start(journal, sizeof(journal));
+
+    GREENTEA_TESTCASE_START("first");
+    GREENTEA_TESTSUITE_RESULT(1);
+    greentea_journal_stop();
+
+    const std::string console = fake_console.get_stdout();
+    ASSERT_NE(console.find("{{__testcase_start;first}}"), std::string::npos);
+    ASSERT_EQ(console.find("__seq"), std::string::npos);
+    ASSERT_EQ(console.find("__journal_end"), std::string::npos);
+}
+
+TEST_F(KiViProtocolTest, JournalDropsOldestMessages)
+{
+    fake_console.set_stdin("{{__capabilities;kv+stream+log+journal,1023,0}}\n{{__sync;0}}\n");
+    GREENTEA_SETUP(10, "default_auto");
+    // Room for 5 entries of "{{a;n}}\r\n" and their lengths
+    char journal[64];
+    greentea_journal_start(journal, sizeof(journal));
+
+    for (int i = 1; i <= 8; i++) {
+        greentea_send_kv("a", i);
+    }
+    // Too large for the journal, which keeps the others
+    greentea_send_kv("big", std::string(100, 'x').c_str());
+    const size_t sent = fake_console.get_stdout().size();
+
+    char key[16];
+    char value[16];
+    fake_console.set_stdin("{{__replay;1}}\n{{k;v}}\n");
+    ASSERT_EQ(greentea_parse_kv(key, value, sizeof(key), sizeof(value)), 1);
+    greentea_journal_stop();
+    ASSERT_EQ(fake_console.get_stdout().substr(sent),
+              "{{__seq;4}}\r\n{{a;4}}\r\n{{__seq;5}}\r\n{{a;5}}\r\n{{__seq;6}}\r\n{{a;6}}\r\n"
+              "{{__seq;7}}\r\n{{a;7}}\r\n{{__seq;8}}\r\n{{a;8}}\r\n");
+}
+
+/**
+ * Journal store in a string, checking the accesses stay within the store
+ */
+static void write_store(size_t offset, const void *data, size_t size, void *context)
+{
+    std::string *store = static_cast<std::string *>(context);
+    ASSERT_LE(offset + size, store->size());
+    store->replace(offset, size, static_cast<const char *>(data), size);
+}
+
+static void read_store(size_t offset, void *data, size_t size, void *context)
+{
+    const std::string *store = static_cast<const std::string *>(context);
+    ASSERT_LE(offset + size, store->size());
+    memcpy(data, store->data() + offset, size);
+}
+
+TEST_F(KiViProtocolTest, JournalsIntoUserStore)
+{
+    fake_console.set_stdin("{{__capabilities;kv+stream+log+journal,1023,0}}\n{{__sync;0}}\n");
+    GREENTEA_SETUP(10, "default_auto");
+    // Entries wrap around the end of the store
+    std::string store(50, '\0');
+    const greentea_journal_store journal = { store.size(), write_store, read_store, &store };
+    greentea_journal_start_store(&journal);
+
+    for (int i = 10; i < 20; i++) {
+        greentea_send_kv("key", i);
+    }
+    const size_t sent = fake_console.get_stdout().size();
+
+    char key[16];
+    char value[16];
+    fake_console.set_stdin("{{__replay;9}}\n{{k;v}}\n");
+    ASSERT_EQ(greentea_parse_kv(key, value, sizeof(key), sizeof(value)), 1);
+    greentea_journal_stop();
+    ASSERT_EQ(fake_console.get_stdout().substr(sent), "{{__seq;9}}\r\n{{key;18}}\r\n{{__seq;10}}\r\n{{key;19}}\r\n");
+}
+
 TEST_F(KiViProtocolTest, SendsTestSuiteResultMessage)
 {
     const int result = 1;
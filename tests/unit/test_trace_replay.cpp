@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <chrono>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "greentea-client/test_env.h"
+#include "greentea-client/test_trace.h"
+
+class TraceReplayTest: public testing::Test {
+protected:
+    std::string trace = std::string("GTTR\x01", 5);
+
+    void record(greentea_trace_direction direction, unsigned delta_us, const std::string &data)
+    {
+        trace.push_back(direction);
+        for (; delta_us >= 0x80; delta_us >>= 7) {
+            trace.push_back(static_cast<char>(delta_us | 0x80));
+        }
+        trace.push_back(static_cast<char>(delta_us));
+        trace.push_back(static_cast<char>(data.size()));
+        trace.append(data);
+    }
+
+    void record_setup_session()
+    {
+        const std::string uuid = "0dad4a9d-59a3-4aec-810d-d5fb09d852c1";
+        record(GREENTEA_TRACE_RX, 1000, "{{__sync;" + uuid + "}}\n");
+        record(GREENTEA_TRACE_TX, 20, "mbedmbedmbedmbedmbedmbedmbedmbed\r\n");
+        record(GREENTEA_TRACE_TX, 0, "{{__sync;" + uuid + "}}\r\n");
+        record(GREENTEA_TRACE_TX, 0, "{{__version;" GREENTEA_CLIENT_VERSION_STRING "}}\r\n");
+        record(GREENTEA_TRACE_TX, 0, "{{__timeout;10}}\r\n{{__host_test_name;echo}}\r\n");
+    }
+};
+
+TEST_F(TraceReplayTest, RejectsInvalidTrace)
+{
+    ASSERT_EQ(greentea_replay_start("GTTR\x02", 5, GREENTEA_REPLAY_FAST), -1);
+    ASSERT_EQ(greentea_replay_start("GT", 2, GREENTEA_REPLAY_FAST), -1);
+    ASSERT_EQ(greentea_replay_start(trace.data(), trace.size(), GREENTEA_REPLAY_FAST), 0);
+}
+
+TEST_F(TraceReplayTest, ReplaysSetupHandshake)
+{
+    record_setup_session();
+    ASSERT_EQ(greentea_replay_start(trace.data(), trace.size(), GREENTEA_REPLAY_FAST), 0);
+
+    GREENTEA_SETUP(10, "echo");
+
+    greentea_replay_status status;
+    greentea_replay_get_status(&status);
+    ASSERT_EQ(status.diverged, 0);
+    ASSERT_EQ(status.tx_written, status.tx_expected);
+    ASSERT_EQ(status.tx_matched, status.tx_expected);
+    // The virtual clock follows the recorded time
+    ASSERT_EQ(greentea_time_us(), 1020u);
+
+    char key[8];
+    char value[8];
+    ASSERT_EQ(greentea_parse_kv(key, value, sizeof(key), sizeof(value)), 0);
+}
+
+TEST_F(TraceReplayTest, DetectsDivergingOutput)
+{
+    record_setup_session();
+    ASSERT_EQ(greentea_replay_start(trace.data(), trace.size(), GREENTEA_REPLAY_FAST), 0);
+
+    GREENTEA_SETUP(20, "echo");
+
+    greentea_replay_status status;
+    greentea_replay_get_status(&status);
+    ASSERT_NE(status.diverged, 0);
+    ASSERT_EQ(status.tx_matched, status.tx_expected - std::string("10}}\r\n{{__host_test_name;echo}}\r\n").size());
+}
+
+TEST_F(TraceReplayTest, ReplaysWithOriginalTiming)
+{
+    record(GREENTEA_TRACE_RX, 30000, "{{k;v}}\n");
+    ASSERT_EQ(greentea_replay_start(trace.data(), trace.size(), GREENTEA_REPLAY_REALTIME), 0);
+
+    const auto start = std::chrono::steady_clock::now();
+    char key[8];
+    char value[8];
+    ASSERT_NE(greentea_parse_kv(key, value, sizeof(key), sizeof(value)), 0);
+    ASSERT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(30));
+    ASSERT_STREQ(key, "k");
+    ASSERT_STREQ(value, "v");
+}
@@ -0,0 +1,557 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cfloat>
+#include <climits>
+#include <csignal>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <sys/personality.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "greentea-client/test_env.h"
+#include "greentea-client/test_io.h"
+#include "greentea-client/test_journal.h"
+#include "greentea-client/test_log.h"
+#include "greentea-client/test_runner.h"
+#include "greentea-client/test_trace.h"
+
+/**
+ *  Benchmark run by greentea-api-report, which counts the instructions executed by calls to
+ *  the public functions of greentea-client. Each call runs in a child process which is
+ *  single-stepped with ptrace, so the count is exact and does not depend on the load of the
+ *  machine. The worst case over the inputs of each function is printed as
+ *  "<symbol> <instructions>", one line per function.
+ */
+
+/**
+ * Stop counting a call after this many instructions, which only a call waiting for
+ * input the benchmark does not provide could reach
+ */
+static const long max_instructions = 10000000;
+
+/**
+ *****************************************************************************
+ *  In-memory transport
+ *****************************************************************************
+ */
+
+/**
+ * Messages of the host, queued before the call
+ */
+static const char *rx_data = "";
+static size_t rx_pos = 0;
+
+/**
+ * Bytes written by greentea-client
+ */
+static size_t tx_bytes = 0;
+
+/**
+ * Time, advanced on each reading so that timeouts expire
+ */
+static uint64_t time_us = 0;
+
+static greentea_timer_callback timer_callback = nullptr;
+
+extern "C" int greentea_getc()
+{
+    return rx_data[rx_pos] ? static_cast<unsigned char>(rx_data[rx_pos++]) : EOF;
+}
+
+extern "C" void greentea_putc(int)
+{
+    tx_bytes++;
+}
+
+extern "C" void greentea_write_string(const char *str)
+{
+    tx_bytes += strlen(str);
+}
+
+extern "C" void greentea_write_n(const char *, size_t len)
+{
+    tx_bytes += len;
+}
+
+extern "C" void greentea_writev(const struct greentea_iovec *iov, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        tx_bytes += iov[i].iov_len;
+    }
+}
+
+extern "C" void greentea_flush(void)
+{
+}
+
+extern "C" uint64_t greentea_time_us(void)
+{
+    return time_us += 10;
+}
+
+extern "C" int greentea_wait_rx(uint32_t)
+{
+    return rx_data[rx_pos] != '\0';
+}
+
+extern "C" int greentea_periodic_timer(uint32_t interval_ms, greentea_timer_callback callback)
+{
+    timer_callback = interval_ms ? callback : nullptr;
+    return 0;
+}
+
+/**
+ *****************************************************************************
+ *  Calls
+ *****************************************************************************
+ */
+
+static const char sync_message[] = "{{__sync;0dad4a9d-59a3-4aec-810d-d5fb09d852c1}}\n";
+static const char capable_sync_messages[] =
+    "{{__capabilities;kv+stream+log,1023,921600}}\n"
+    "{{__sync;0dad4a9d-59a3-4aec-810d-d5fb09d852c1}}\n";
+
+/**
+ * Longest name of a test case sent with the summary
+ */
+static const char long_name[] = "a test case with a name of 47 characters______";
+
+static const char *const names[] = {
+    "first", "second", "third", "fourth", "fifth", "sixth", "seventh", long_name
+};
+static const size_t name_count = sizeof(names) / sizeof(names[0]);
+
+/**
+ * A value of GREENTEA_MAX_VALUE_SIZE characters
+ */
+static const char long_value[] = "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcde";
+
+static char key[16];
+static char value[GREENTEA_UUID_LENGTH];
+static greentea_value_arena arena = { value, sizeof(value), 0 };
+static greentea_kv_parser parser;
+
+static void run_test_cases()
+{
+    GREENTEA_TESTCASE_NAMES(names, name_count);
+    for (size_t i = 0; i < name_count; i++) {
+        GREENTEA_TESTCASE_START(names[i]);
+        GREENTEA_TESTCASE_FINISH(names[i], 1, 0);
+    }
+}
+
+static void fill_log()
+{
+    for (int i = 0; i < 8; i++) {
+        GREENTEA_LOG("case %s took %u us, %d retries", long_name, 4000000000u, INT_MIN);
+    }
+}
+
+static size_t produce_value(char *buffer, size_t size, void *)
+{
+    static size_t produced = 0;
+    if (produced >= 256) {
+        return 0;
+    }
+    memset(buffer, 'x', size);
+    produced += size;
+    return size;
+}
+
+static void discard_trace(const void *, size_t, void *)
+{
+}
+
+static void vsend_kvf(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    greentea_vsend_kvf("values", format, args);
+    va_end(args);
+}
+
+static void init_parser()
+{
+    greentea_kv_parser_init(&parser, key, sizeof(key), value, sizeof(value), 0);
+}
+
+static char journal[512];
+
+static void journal_write(size_t offset, const void *data, size_t size, void *)
+{
+    memcpy(journal + offset, data, size);
+}
+
+static void journal_read(size_t offset, void *data, size_t size, void *)
+{
+    memcpy(data, journal + offset, size);
+}
+
+static const greentea_journal_store journal_store = { sizeof(journal), journal_write, journal_read, nullptr };
+
+static void check_case()
+{
+    GREENTEA_CHECK(true);
+    GREENTEA_CHECK(false);
+}
+
+static const greentea_case cases[] = {
+    { "first", check_case, 0, 0 }, { "second", check_case, 0, 0 }, { "third", check_case, 0, 0 },
+    { "fourth", check_case, 0, 0 }, { "fifth", check_case, 0, 0 }, { "sixth", check_case, 0, 0 },
+    { "seventh", check_case, 0, 0 }, { long_name, check_case, 4000000000u, 0 },
+};
+static const size_t case_count = sizeof(cases) / sizeof(cases[0]);
+
+GREENTEA_CASE(registered)
+{
+    GREENTEA_CHECK(true);
+}
+
+GREENTEA_CASE_TIMEOUT(registered_with_timeout, 1000)
+{
+    GREENTEA_CHECK(false);
+}
+
+/**
+ * Set up with a host which chooses the test cases the runner runs.
+ */
+static void assigning_host()
+{
+    rx_data = "{{__capabilities;kv+stream+shard,1023,921600}}\n"
+              "{{__sync;0dad4a9d-59a3-4aec-810d-d5fb09d852c1}}\n";
+    rx_pos = 0;
+    GREENTEA_SETUP(10, "default_auto");
+}
+
+/**
+ * Set up with a host numbering the journaled messages, and fill the journal so that the
+ * messages wrap around its end and drop the oldest ones.
+ */
+static void fill_journal()
+{
+    rx_data = "{{__capabilities;kv+stream+log+journal,1023,921600}}\n"
+              "{{__sync;0dad4a9d-59a3-4aec-810d-d5fb09d852c1}}\n";
+    rx_pos = 0;
+    GREENTEA_SETUP(10, "default_auto");
+    greentea_journal_start(journal, sizeof(journal));
+    run_test_cases();
+    run_test_cases();
+}
+
+/**
+ * A call to count, with the state and input it starts from. The calls of a function cover
+ * the inputs taking the longest path through it.
+ */
+struct api_call {
+    const char *symbol;     /**< Function called, as in the call graph */
+    void (*prepare)();      /**< Sets up the state before counting, or NULL */
+    const char *input;      /**< Messages of the host, or NULL */
+    void (*call)();
+};
+
+static const api_call calls[] = {
+    { "GREENTEA_SETUP", nullptr, sync_message, [] { GREENTEA_SETUP(10, "default_auto"); } },
+    { "GREENTEA_SETUP", nullptr, capable_sync_messages, [] { GREENTEA_SETUP(10, "default_auto"); } },
+    {
+        "GREENTEA_SETUP_TIMEOUT", nullptr, capable_sync_messages,
+        [] { GREENTEA_SETUP_TIMEOUT(10, "default_auto", 1000); }
+    },
+    {
+        "GREENTEA_SETUP_TIMEOUT", nullptr, "",
+        [] { GREENTEA_SETUP_TIMEOUT(10, "default_auto", 1000); }
+    },
+    {
+        "_Z19GREENTEA_SETUP_UUIDiPKcPcm", nullptr, capable_sync_messages,
+        [] { GREENTEA_SETUP_UUID(10, "default_auto", value, sizeof(value)); }
+    },
+    { "_Z25GREENTEA_TESTSUITE_RESULTi", nullptr, nullptr, [] { GREENTEA_TESTSUITE_RESULT(1); } },
+    {
+        "_Z25GREENTEA_TESTSUITE_RESULTi", fill_journal, "{{__replay;1}}\n{{__journal_done;0}}\n",
+        [] { GREENTEA_TESTSUITE_RESULT(1); }
+    },
+    {
+        "_Z25GREENTEA_TESTSUITE_RESULTi", [] { run_test_cases(); fill_log(); }, nullptr,
+        [] { GREENTEA_TESTSUITE_RESULT(0); }
+    },
+    { "_Z23GREENTEA_TESTCASE_STARTPKc", nullptr, nullptr, [] { GREENTEA_TESTCASE_START(long_name); } },
+    {
+        "_Z23GREENTEA_TESTCASE_STARTPKcj", nullptr, nullptr,
+        [] { GREENTEA_TESTCASE_START(long_name, 4000000000u); }
+    },
+    {
+        "_Z24GREENTEA_TESTCASE_FINISHPKcmm", [] { GREENTEA_TESTCASE_START(long_name, 1000); }, nullptr,
+        [] { GREENTEA_TESTCASE_FINISH(long_name, 1, 0); }
+    },
+    {
+        "_Z24GREENTEA_TESTCASE_FINISHPKcmm", nullptr, nullptr,
+        [] { GREENTEA_TESTCASE_FINISH(long_name, ULONG_MAX, ULONG_MAX); }
+    },
+    {
+        "_Z24GREENTEA_TESTCASE_FINISHPKcmm", fill_journal, nullptr,
+        [] { GREENTEA_TESTCASE_FINISH(long_name, ULONG_MAX, ULONG_MAX); }
+    },
+    {
+        "_Z23GREENTEA_TESTCASE_NAMESPKPKcm", nullptr, nullptr,
+        [] { GREENTEA_TESTCASE_NAMES(names, name_count); }
+    },
+    {
+        "_Z23GREENTEA_TESTCASE_SHARDPKPKcm", assigning_host, "{{__shard;1/2}}\n",
+        [] { GREENTEA_TESTCASE_SHARD(names, name_count); }
+    },
+    {
+        "_Z23GREENTEA_TESTCASE_SHARDPKPKcm", assigning_host, "{{__shard_cases;first,fifth,eighth}}\n",
+        [] { GREENTEA_TESTCASE_SHARD(names, name_count); }
+    },
+    { "_Z26greentea_testcase_assignedm", nullptr, nullptr, [] { greentea_testcase_assigned(7); } },
+    {
+        "_Z26greentea_testcase_assignedm", [] {
+            assigning_host();
+            rx_data = "{{__shard_cases;first,fifth,eighth}}\n";
+            rx_pos = 0;
+            GREENTEA_TESTCASE_SHARD(names, name_count);
+        },
+        nullptr, [] { greentea_testcase_assigned(7); }
+    },
+    { "greentea_send_kv", nullptr, nullptr, [] { greentea_send_kv("value", long_value); } },
+    { "greentea_send_kv", fill_journal, nullptr, [] { greentea_send_kv("value", long_value); } },
+    {
+        "greentea_send_kv_n", nullptr, nullptr,
+        [] { greentea_send_kv_n("value", 5, long_value, sizeof(long_value) - 1); }
+    },
+    { "_Z16greentea_send_kvPKci", nullptr, nullptr, [] { greentea_send_kv("value", INT_MIN); } },
+    { "_Z16greentea_send_kvPKcd", nullptr, nullptr, [] { greentea_send_kv("value", -DBL_MAX); } },
+    { "_Z16greentea_send_kvPKcd", nullptr, nullptr, [] { greentea_send_kv("value", 5e-324); } },
+    { "_Z16greentea_send_kvPKcd", nullptr, nullptr, [] { greentea_send_kv("value", -0.1); } },
+    { "_Z16greentea_send_kvPKcf", nullptr, nullptr, [] { greentea_send_kv("value", -FLT_MAX); } },
+    { "_Z16greentea_send_kvPKcf", nullptr, nullptr, [] { greentea_send_kv("value", 1e-45f); } },
+    {
+        "_Z16greentea_send_kvPKcS0_i", nullptr, nullptr,
+        [] { greentea_send_kv("value", long_name, INT_MIN); }
+    },
+    {
+        "_Z16greentea_send_kvPKcS0_ii", nullptr, nullptr,
+        [] { greentea_send_kv("value", long_name, INT_MIN, INT_MIN); }
+    },
+    { "_Z16greentea_send_kvPKcii", nullptr, nullptr, [] { greentea_send_kv("value", INT_MIN, INT_MIN); } },
+    {
+        "greentea_send_kvf", nullptr, nullptr,
+        [] { greentea_send_kvf("values", "%s %d %lu %x %.3f", long_name, INT_MIN, ULONG_MAX, UINT_MAX, -DBL_MAX); }
+    },
+    {
+        "greentea_vsend_kvf", nullptr, nullptr,
+        [] { vsend_kvf("%s %d %lu %x %.3f", long_name, INT_MIN, ULONG_MAX, UINT_MAX, -DBL_MAX); }
+    },
+    {
+        "greentea_send_kv_stream", nullptr, nullptr,
+        [] { greentea_send_kv_stream("value", produce_value, nullptr); }
+    },
+    {
+        "greentea_set_flush_policy", nullptr, nullptr,
+        [] { greentea_set_flush_policy(GREENTEA_FLUSH_BYTES, 256); }
+    },
+    {
+        "greentea_parse_kv", nullptr, sync_message,
+        [] { greentea_parse_kv(key, value, sizeof(key), sizeof(value)); }
+    },
+    {
+        "greentea_parse_kv", fill_journal, "{{__replay;1}}\n{{__sync;0}}\n",
+        [] { greentea_parse_kv(key, value, sizeof(key), sizeof(value)); }
+    },
+    {
+        "greentea_parse_kv_timeout", nullptr, sync_message,
+        [] { greentea_parse_kv_timeout(key, value, sizeof(key), sizeof(value), 1000); }
+    },
+    {
+        "greentea_parse_kv_n", nullptr, sync_message,
+        [] {
+            size_t key_len;
+            size_t value_len;
+            greentea_parse_kv_n(key, sizeof(key), &key_len, value, sizeof(value), &value_len);
+        }
+    },
+    {
+        "greentea_parse_kv_stream", nullptr, sync_message,
+        [] {
+            uint32_t crc;
+            greentea_parse_kv_stream(key, sizeof(key), greentea_value_arena_sink, &arena, &crc);
+        }
+    },
+    {
+        "greentea_value_arena_sink", nullptr, nullptr,
+        [] { greentea_value_arena_sink(long_value, sizeof(long_value) - 1, &arena); }
+    },
+    { "greentea_kv_parser_init", nullptr, nullptr, init_parser },
+    {
+        "greentea_kv_parser_push", [] {
+            size_t consumed;
+            init_parser();
+            greentea_kv_parser_feed(&parser, sync_message, sizeof(sync_message) - 3, &consumed);
+        },
+        nullptr, [] { greentea_kv_parser_push(&parser, '}'); }
+    },
+    {
+        "greentea_kv_parser_push", init_parser, nullptr,
+        [] { greentea_kv_parser_push(&parser, '{'); }
+    },
+    {
+        "greentea_kv_parser_feed", init_parser, nullptr,
+        [] {
+            size_t consumed;
+            greentea_kv_parser_feed(&parser, sync_message, sizeof(sync_message) - 1, &consumed);
+        }
+    },
+    {
+        "greentea_kv_parser_read", [] {
+            size_t consumed;
+            fill_journal();
+            init_parser();
+            greentea_kv_parser_feed(&parser, "{{__replay;1}", 13, &consumed);
+        },
+        "}", [] { greentea_kv_parser_read(&parser); }
+    },
+    { "GREENTEA_HEARTBEAT", nullptr, nullptr, [] { GREENTEA_HEARTBEAT(1000); } },
+    { "greentea_heartbeat", [] { GREENTEA_HEARTBEAT(4000000000u); }, nullptr, [] { timer_callback(); } },
+    {
+        "GREENTEA_CLOCK_SYNC", nullptr,
+        "{{__clock_pong;0,18446744073709551615,18446744073709551615}}\n"
+        "{{__clock_pong;1,18446744073709551615,18446744073709551615}}\n"
+        "{{__clock_pong;2,18446744073709551615,18446744073709551615}}\n"
+        "{{__clock_pong;3,18446744073709551615,18446744073709551615}}\n"
+        "{{__clock_pong;4,18446744073709551615,18446744073709551615}}\n"
+        "{{__clock_pong;5,18446744073709551615,18446744073709551615}}\n"
+        "{{__clock_pong;6,18446744073709551615,18446744073709551615}}\n"
+        "{{__clock_pong;7,18446744073709551615,18446744073709551615}}\n",
+        [] { GREENTEA_CLOCK_SYNC(); }
+    },
+    {
+        "greentea_log", nullptr, nullptr,
+        [] { GREENTEA_LOG("case %s took %u us, %d retries", long_name, 4000000000u, INT_MIN); }
+    },
+    { "greentea_journal_start", nullptr, nullptr, [] { greentea_journal_start(journal, sizeof(journal)); } },
+    { "greentea_journal_start_store", nullptr, nullptr, [] { greentea_journal_start_store(&journal_store); } },
+    { "greentea_journal_stop", fill_journal, nullptr, greentea_journal_stop },
+    { "greentea_log_drain", fill_log, nullptr, greentea_log_drain },
+    { "greentea_run_registered_cases", nullptr, nullptr, [] { greentea_run_registered_cases(); } },
+    { "greentea_run_cases", nullptr, nullptr, [] { greentea_run_cases(cases, case_count); } },
+    {
+        "greentea_run_cases", assigning_host, "{{__shard_cases;first,#4,#7}}\n",
+        [] { greentea_run_cases(cases, case_count); }
+    },
+    { "greentea_set_case_workers", nullptr, nullptr, [] { greentea_set_case_workers(0); } },
+    { "greentea_case_check", nullptr, nullptr, [] { greentea_case_check(0); } },
+    { "greentea_trace_start", nullptr, nullptr, [] { greentea_trace_start(discard_trace, nullptr); } },
+    {
+        "greentea_trace_stop", [] {
+            greentea_trace_start(discard_trace, nullptr);
+            greentea_send_kv("value", long_value);
+        },
+        nullptr, greentea_trace_stop
+    },
+};
+
+/**
+ *****************************************************************************
+ *  Counting
+ *****************************************************************************
+ */
+
+/**
+ * Count the instructions executed by a call in a child process, including the two stops
+ * around it, which the calibration subtracts.
+ *
+ * @return Number of instructions, or -1 if the call could not be traced or did not return
+ */
+static long count_instructions(const api_call *c)
+{
+    const pid_t pid = fork();
+    if (pid == 0) {
+        if (c && c->prepare) {
+            c->prepare();
+        }
+        rx_data = c && c->input ? c->input : "";
+        rx_pos = 0;
+        if (ptrace(PTRACE_TRACEME, 0, nullptr, nullptr) != 0) {
+            _exit(1);
+        }
+        raise(SIGSTOP);
+        if (c) {
+            c->call();
+        }
+        raise(SIGSTOP);
+        _exit(0);
+    }
+    if (pid < 0) {
+        return -1;
+    }
+
+    int status;
+    long count = -1;
+    if (waitpid(pid, &status, 0) == pid && WIFSTOPPED(status) && WSTOPSIG(status) == SIGSTOP) {
+        for (long steps = 0; steps < max_instructions; steps++) {
+            if (ptrace(PTRACE_SINGLESTEP, pid, nullptr, nullptr) != 0
+                    || waitpid(pid, &status, 0) != pid || !WIFSTOPPED(status)) {
+                break;
+            }
+            if (WSTOPSIG(status) == SIGSTOP) {
+                count = steps;
+                break;
+            }
+        }
+    }
+    kill(pid, SIGKILL);
+    waitpid(pid, &status, 0);
+    return count;
+}
+
+int main(int, char *argv[])
+{
+    // Copying and scanning strings takes a path depending on their alignment, which is the
+    // same on every run without address space layout randomization
+    const int persona = personality(0xffffffff);
+    if (persona != -1 && !(persona & ADDR_NO_RANDOMIZE)
+            && personality(persona | ADDR_NO_RANDOMIZE) != -1) {
+        execv("/proc/self/exe", argv);
+    }
+
+    const long calibration = count_instructions(nullptr);
+    if (calibration < 0) {
+        fprintf(stderr, "greentea-api-bench: can not single-step a child process\n");
+        return 2;
+    }
+
+    std::map<std::string, long> worst;
+    for (const api_call &c : calls) {
+        const long count = count_instructions(&c);
+        if (count < 0) {
+            fprintf(stderr, "greentea-api-bench: %s did not return\n", c.symbol);
+            return 1;
+        }
+        long &instructions = worst[c.symbol];
+        if (count - calibration > instructions) {
+            instructions = count - calibration;
+        }
+    }
+    for (const auto &w : worst) {
+        printf("%s %ld\n", w.first.c_str(), w.second);
+    }
+    return 0;
+}
@@ -0,0 +1,261 @@
+# Copyright (c) 2021 ARM Limited. All rights reserved.
+# SPDX-License-Identifier: Apache-2.0
+
+# Builds greentea-client with all features for a profile and reports the worst case of each
+# public function: the stack it needs, from the call graph written by GCC, and on the host
+# the instructions it executes, counted by greentea-api-bench. Fails if a function exceeds
+# its budget in budgets.cmake.
+#
+# cmake -DPROFILE=<host|cortex-m4> -DSOURCE_DIR=<greentea> -DBINARY_DIR=<dir>
+#       -P api_report.cmake
+
+cmake_minimum_required(VERSION 3.14)
+
+foreach(var PROFILE SOURCE_DIR BINARY_DIR)
+    if(NOT ${var})
+        message(FATAL_ERROR "${var} is not set")
+    endif()
+endforeach()
+
+set(report_dir "${SOURCE_DIR}/tools/api-report")
+
+if(PROFILE STREQUAL "host")
+    set(profile_args)
+elseif(PROFILE STREQUAL "cortex-m4")
+    # Deferred logging is left out on Armv6-M, so only Armv7-M builds all the public functions
+    set(profile_args -DCMAKE_TOOLCHAIN_FILE=${SOURCE_DIR}/tools/size-report/arm-none-eabi.cmake
+        -DGREENTEA_SIZE_CPU=${PROFILE})
+else()
+    message(FATAL_ERROR "Unknown profile ${PROFILE}")
+endif()
+
+include("${report_dir}/budgets.cmake")
+if(NOT PROFILE STREQUAL "host")
+    # Parallel test cases need the threads of a native build
+    list(REMOVE_ITEM GREENTEA_API_FUNCTIONS greentea_set_case_workers)
+endif()
+
+set(build_dir "${BINARY_DIR}/${PROFILE}")
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -S ${report_dir} -B ${build_dir} -DCMAKE_BUILD_TYPE=MinSizeRel ${profile_args}
+    OUTPUT_QUIET
+    RESULT_VARIABLE result
+)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "Could not configure ${PROFILE}")
+endif()
+include("${build_dir}/api.cmake")
+execute_process(
+    COMMAND ${CMAKE_COMMAND} --build ${build_dir} --target ${TARGETS}
+    OUTPUT_QUIET
+    RESULT_VARIABLE result
+)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "Could not build ${PROFILE}")
+endif()
+
+# Functions of test_io.h, which belong to the application, as do the functions of callbacks
+set(io_hooks greentea_getc greentea_putc greentea_write_string greentea_write_n greentea_writev
+    greentea_flush greentea_time_us greentea_wait_rx greentea_periodic_timer greentea_max_line_rate
+    greentea_set_line_rate)
+
+# Reads the call graph of each object, written next to it as <source>.ci. A node is a
+# function with the stack its frame takes, or an external function without it.
+foreach(object IN LISTS CLIENT_OBJECTS)
+    string(REGEX REPLACE "\\.o(bj)?$" ".ci" graph "${object}")
+    if(NOT EXISTS "${graph}")
+        message(FATAL_ERROR "No call graph ${graph}")
+    endif()
+    file(READ "${graph}" content)
+    # Neither separators nor brackets of a CMake list
+    string(REGEX REPLACE "[][;]" "_" content "${content}")
+    string(REPLACE "\n" ";" lines "${content}")
+    foreach(line IN LISTS lines)
+        if(line MATCHES "^node: { title: \"([^\"]*)\"")
+            set(function "${CMAKE_MATCH_1}")
+            if(line MATCHES "([0-9]+) bytes \\(([a-z,]+)\\)")
+                set(frame ${CMAKE_MATCH_1})
+                if(DEFINED frame_${function} AND "${frame_${function}}" GREATER frame)
+                    set(frame ${frame_${function}})
+                endif()
+                set(frame_${function} ${frame})
+                if(CMAKE_MATCH_2 STREQUAL "dynamic")
+                    set(flags_${function} dynamic)
+                endif()
+            endif()
+        elseif(line MATCHES "^edge: { sourcename: \"([^\"]*)\" targetname: \"([^\"]*)\"")
+            list(APPEND callees_${CMAKE_MATCH_1} "${CMAKE_MATCH_2}")
+        endif()
+    endforeach()
+endforeach()
+
+# Computes the worst case stack of a function and what it calls which is not in the call
+# graph, into the global properties api_stack_<function> and api_flags_<function>
+function(stack_usage function)
+    set_property(GLOBAL PROPERTY api_visiting_${function} 1)
+    set(stack 0)
+    set(flags ${flags_${function}})
+    foreach(callee IN LISTS callees_${function})
+        if(callee IN_LIST io_hooks)
+            list(APPEND flags io)
+        elseif(callee STREQUAL "__indirect_call")
+            list(APPEND flags callback)
+        elseif(NOT DEFINED frame_${callee})
+            list(APPEND flags lib)
+        else()
+            get_property(visiting GLOBAL PROPERTY api_visiting_${callee})
+            get_property(done GLOBAL PROPERTY api_stack_${callee} SET)
+            if(visiting AND NOT done)
+                list(APPEND flags recursion)
+            else()
+                if(NOT done)
+                    stack_usage("${callee}")
+                endif()
+                get_property(callee_stack GLOBAL PROPERTY api_stack_${callee})
+                get_property(callee_flags GLOBAL PROPERTY api_flags_${callee})
+                if(callee_stack GREATER stack)
+                    set(stack ${callee_stack})
+                endif()
+                list(APPEND flags ${callee_flags})
+            endif()
+        endif()
+    endforeach()
+    math(EXPR stack "${frame_${function}} + ${stack}")
+    list(REMOVE_DUPLICATES flags)
+    list(SORT flags)
+    set_property(GLOBAL PROPERTY api_stack_${function} ${stack})
+    set_property(GLOBAL PROPERTY api_flags_${function} "${flags}")
+endfunction()
+
+# Instructions of each call on the host, "<symbol> <count>" per line
+set(measured FALSE)
+if(BENCH_COMMAND)
+    execute_process(
+        COMMAND ${BENCH_COMMAND}
+        OUTPUT_VARIABLE output
+        RESULT_VARIABLE result
+    )
+    if(result EQUAL 2)
+        message(WARNING "Instructions are not counted, the benchmark can not trace its calls")
+    elseif(NOT result EQUAL 0)
+        message(FATAL_ERROR "greentea-api-bench failed")
+    else()
+        set(measured TRUE)
+        string(REPLACE "\n" ";" lines "${output}")
+        foreach(line IN LISTS lines)
+            if(line MATCHES "^([^ ]+) ([0-9]+)$")
+                set(instructions_${CMAKE_MATCH_1} ${CMAKE_MATCH_2})
+            endif()
+        endforeach()
+    endif()
+endif()
+
+# Names of the functions as declared, one per line
+set(names ${GREENTEA_API_FUNCTIONS})
+if(CXXFILT)
+    execute_process(
+        COMMAND ${CXXFILT} ${GREENTEA_API_FUNCTIONS}
+        OUTPUT_VARIABLE output
+        OUTPUT_STRIP_TRAILING_WHITESPACE
+        RESULT_VARIABLE result
+    )
+    if(result EQUAL 0)
+        string(REPLACE "\n" ";" names "${output}")
+    endif()
+endif()
+
+# Aligns a column of the report
+set(blanks "                                                                      ")
+function(pad_left text width out)
+    string(LENGTH "${text}" length)
+    math(EXPR padding "${width} - ${length}")
+    if(padding LESS 0)
+        set(padding 0)
+    endif()
+    string(SUBSTRING "${blanks}" 0 ${padding} spaces)
+    set(${out} "${spaces}${text}" PARENT_SCOPE)
+endfunction()
+function(pad_right text width out)
+    string(LENGTH "${text}" length)
+    math(EXPR padding "${width} - ${length}")
+    if(padding LESS 0)
+        set(padding 0)
+    endif()
+    string(SUBSTRING "${blanks}" 0 ${padding} spaces)
+    set(${out} "${text}${spaces}" PARENT_SCOPE)
+endfunction()
+
+set(regressions)
+set(report "greentea-client worst case per call for ${PROFILE}, stack in bytes\n")
+pad_right("function" 68 line)
+string(APPEND report "${line}   stack  budget  instructions    budget  calls\n")
+
+set(index 0)
+foreach(function IN LISTS GREENTEA_API_FUNCTIONS)
+    list(GET names ${index} name)
+    math(EXPR index "${index} + 1")
+    if(NOT DEFINED frame_${function})
+        message(FATAL_ERROR "${name} is not in the call graph")
+    endif()
+
+    set(budget ${GREENTEA_API_BUDGET_${PROFILE}_${function}})
+    set(stack_budget)
+    set(instructions_budget)
+    if(budget)
+        list(GET budget 0 stack_budget)
+        list(LENGTH budget length)
+        if(length GREATER 1)
+            list(GET budget 1 instructions_budget)
+        endif()
+    endif()
+
+    stack_usage("${function}")
+    get_property(stack GLOBAL PROPERTY api_stack_${function})
+    get_property(flags GLOBAL PROPERTY api_flags_${function})
+    pad_right("${name}" 68 line)
+    if("recursion" IN_LIST flags OR "dynamic" IN_LIST flags)
+        # The frames of a recursion or an unbounded alloca are not counted
+        set(stack ">${stack}")
+        if(stack_budget)
+            list(APPEND regressions "${name} stack: unbounded")
+        endif()
+    elseif(stack_budget AND stack GREATER stack_budget)
+        list(APPEND regressions "${name} stack: ${stack} > ${stack_budget}")
+    endif()
+    pad_left("${stack}" 8 column)
+    string(APPEND line "${column}")
+    if(NOT stack_budget)
+        set(stack_budget "none")
+    endif()
+    pad_left("${stack_budget}" 8 column)
+    string(APPEND line "${column}")
+
+    set(instructions "-")
+    if(DEFINED instructions_${function})
+        set(instructions ${instructions_${function}})
+        if(instructions_budget AND instructions GREATER instructions_budget)
+            list(APPEND regressions "${name} instructions: ${instructions} > ${instructions_budget}")
+        endif()
+    elseif(measured AND instructions_budget)
+        list(APPEND regressions "${name} instructions: not measured")
+    endif()
+    pad_left("${instructions}" 14 column)
+    string(APPEND line "${column}")
+    if(NOT instructions_budget)
+        set(instructions_budget "none")
+    endif()
+    pad_left("${instructions_budget}" 10 column)
+    string(APPEND line "${column}")
+
+    string(REPLACE ";" "," flags "${flags}")
+    string(APPEND report "${line}  ${flags}\n")
+endforeach()
+
+string(APPEND report "The stack of io, callback and lib calls is not counted: it is that of the application's "
+    "test_io.h functions, callbacks and the C library.")
+message("${report}")
+
+if(regressions)
+    string(REPLACE ";" "\n  " regressions "${regressions}")
+    message(FATAL_ERROR "Over the budget of ${PROFILE}:\n  ${regressions}")
+endif()
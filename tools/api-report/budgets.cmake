@@ -0,0 +1,107 @@
+# Copyright (c) 2021 ARM Limited. All rights reserved.
+# SPDX-License-Identifier: Apache-2.0
+
+# Public functions reported by greentea-api-report, by symbol, in the order of the headers
+set(GREENTEA_API_FUNCTIONS
+    GREENTEA_SETUP
+    GREENTEA_SETUP_TIMEOUT
+    _Z19GREENTEA_SETUP_UUIDiPKcPcm
+    _Z25GREENTEA_TESTSUITE_RESULTi
+    _Z23GREENTEA_TESTCASE_STARTPKc
+    _Z23GREENTEA_TESTCASE_STARTPKcj
+    _Z24GREENTEA_TESTCASE_FINISHPKcmm
+    _Z23GREENTEA_TESTCASE_NAMESPKPKcm
+    _Z23GREENTEA_TESTCASE_SHARDPKPKcm
+    _Z26greentea_testcase_assignedm
+    _Z16greentea_send_kvPKci
+    _Z16greentea_send_kvPKcd
+    _Z16greentea_send_kvPKcf
+    _Z16greentea_send_kvPKcii
+    _Z16greentea_send_kvPKcS0_i
+    _Z16greentea_send_kvPKcS0_ii
+    GREENTEA_HEARTBEAT
+    greentea_heartbeat
+    GREENTEA_CLOCK_SYNC
+    GREENTEA_LINK_BENCH
+    greentea_send_kv
+    greentea_send_kv_n
+    greentea_send_kvf
+    greentea_vsend_kvf
+    greentea_send_kv_stream
+    greentea_set_flush_policy
+    greentea_parse_kv
+    greentea_parse_kv_timeout
+    greentea_parse_kv_n
+    greentea_parse_kv_stream
+    greentea_value_arena_sink
+    greentea_kv_parser_init
+    greentea_kv_parser_push
+    greentea_kv_parser_feed
+    greentea_kv_parser_read
+    greentea_journal_start
+    greentea_journal_start_store
+    greentea_journal_stop
+    greentea_log
+    greentea_log_drain
+    greentea_run_registered_cases
+    greentea_run_cases
+    greentea_set_case_workers
+    greentea_case_check
+    greentea_trace_start
+    greentea_trace_stop
+)
+
+# Budgets of greentea-api-report: stack in bytes and instructions that a call of a function
+# may take in the worst case, per profile. They are set from a measurement with some headroom,
+# functions without a budget are only reported. The instructions of GREENTEA_LINK_BENCH
+# depend on how long the host runs the benchmark.
+
+# x86-64 Linux, GCC 12, MinSizeRel
+set(GREENTEA_API_BUDGET_host_GREENTEA_SETUP 928 16200)
+set(GREENTEA_API_BUDGET_host_GREENTEA_SETUP_TIMEOUT 928 18500)
+set(GREENTEA_API_BUDGET_host__Z19GREENTEA_SETUP_UUIDiPKcPcm 864 16200)
+set(GREENTEA_API_BUDGET_host__Z25GREENTEA_TESTSUITE_RESULTi 656 16900)
+set(GREENTEA_API_BUDGET_host__Z23GREENTEA_TESTCASE_STARTPKc 528 340)
+set(GREENTEA_API_BUDGET_host__Z23GREENTEA_TESTCASE_STARTPKcj 720 760)
+set(GREENTEA_API_BUDGET_host__Z24GREENTEA_TESTCASE_FINISHPKcmm 816 2300)
+set(GREENTEA_API_BUDGET_host__Z23GREENTEA_TESTCASE_NAMESPKPKcm 560 2900)
+set(GREENTEA_API_BUDGET_host__Z23GREENTEA_TESTCASE_SHARDPKPKcm 752 11300)
+set(GREENTEA_API_BUDGET_host__Z26greentea_testcase_assignedm 16 30)
+set(GREENTEA_API_BUDGET_host__Z16greentea_send_kvPKci 528 460)
+set(GREENTEA_API_BUDGET_host__Z16greentea_send_kvPKcd 512 1700)
+set(GREENTEA_API_BUDGET_host__Z16greentea_send_kvPKcf 512 1600)
+set(GREENTEA_API_BUDGET_host__Z16greentea_send_kvPKcii 608 670)
+set(GREENTEA_API_BUDGET_host__Z16greentea_send_kvPKcS0_i 608 570)
+set(GREENTEA_API_BUDGET_host__Z16greentea_send_kvPKcS0_ii 752 800)
+set(GREENTEA_API_BUDGET_host_GREENTEA_HEARTBEAT 240 190)
+set(GREENTEA_API_BUDGET_host_greentea_heartbeat 208 240)
+set(GREENTEA_API_BUDGET_host_GREENTEA_CLOCK_SYNC 1120 89800)
+set(GREENTEA_API_BUDGET_host_GREENTEA_LINK_BENCH 1264)
+set(GREENTEA_API_BUDGET_host_greentea_send_kv 528 1200)
+set(GREENTEA_API_BUDGET_host_greentea_send_kv_n 416 300)
+set(GREENTEA_API_BUDGET_host_greentea_send_kvf 672 3200)
+set(GREENTEA_API_BUDGET_host_greentea_vsend_kvf 432 3200)
+set(GREENTEA_API_BUDGET_host_greentea_send_kv_stream 448 1420)
+set(GREENTEA_API_BUDGET_host_greentea_set_flush_policy 64 40)
+set(GREENTEA_API_BUDGET_host_greentea_parse_kv 384 9900)
+set(GREENTEA_API_BUDGET_host_greentea_parse_kv_timeout 400 7900)
+set(GREENTEA_API_BUDGET_host_greentea_parse_kv_n 400 6800)
+set(GREENTEA_API_BUDGET_host_greentea_parse_kv_stream 464 9600)
+set(GREENTEA_API_BUDGET_host_greentea_value_arena_sink 16 90)
+set(GREENTEA_API_BUDGET_host_greentea_kv_parser_init 16 50)
+set(GREENTEA_API_BUDGET_host_greentea_kv_parser_push 112 30)
+set(GREENTEA_API_BUDGET_host_greentea_kv_parser_feed 160 4700)
+set(GREENTEA_API_BUDGET_host_greentea_kv_parser_read 224 5850)
+set(GREENTEA_API_BUDGET_host_greentea_journal_start 80 40)
+set(GREENTEA_API_BUDGET_host_greentea_journal_start_store 32 30)
+set(GREENTEA_API_BUDGET_host_greentea_journal_stop 16 20)
+set(GREENTEA_API_BUDGET_host_greentea_log 480 1300)
+set(GREENTEA_API_BUDGET_host_greentea_log_drain 608 10400)
+set(GREENTEA_API_BUDGET_host_greentea_run_registered_cases 1296 5000)
+set(GREENTEA_API_BUDGET_host_greentea_run_cases 1280 14800)
+set(GREENTEA_API_BUDGET_host_greentea_set_case_workers 16 10)
+set(GREENTEA_API_BUDGET_host_greentea_case_check 16 10)
+set(GREENTEA_API_BUDGET_host_greentea_trace_start 160 40)
+set(GREENTEA_API_BUDGET_host_greentea_trace_stop 128 80)
+
+# Cortex-M profiles are reported until budgets are measured with arm-none-eabi-gcc
@@ -0,0 +1,151 @@
+"""
+Copyright (c) 2021 ARM Limited
+SPDX-License-Identifier: Apache-2.0
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+Decode the __log messages of GREENTEA_LOG() in the output of a test suite, e.g. as
+captured by mbedhtrun, for hosts other than the native harness.
+
+Usage: greentea_log.py <log-strings> [output]
+
+<log-strings> is the greentea_log_table section of the suite's image, as written by the
+greentea_log_strings() CMake function. Lines of the output are copied to stdout, with each
+{{__log;...}} message replaced by the lines it holds. The output is read from stdin if no
+file is given.
+"""
+
+import base64
+import re
+import struct
+import sys
+
+LOG_MESSAGE = re.compile(r"\{\{__log;([A-Za-z0-9+/]*)\}\}")
+CONVERSION = re.compile(r"%([-+ #0]*)(\*|\d*)(?:\.(\*|\d*))?(?:hh|h|ll|l|j|z|t|L)?(.)")
+
+
+class Record:
+    """Reader of the arguments of a record, see test_log.h."""
+
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def varint(self):
+        value = 0
+        shift = 0
+        while self.pos < len(self.data):
+            byte = self.data[self.pos]
+            self.pos += 1
+            value |= (byte & 0x7F) << shift
+            shift += 7
+            if not byte & 0x80:
+                return value
+        raise IndexError
+
+    def zigzag(self):
+        value = self.varint()
+        return (value >> 1) ^ -(value & 1)
+
+    def floating(self):
+        if self.pos + 8 > len(self.data):
+            raise IndexError
+        value = struct.unpack_from("<d", self.data, self.pos)[0]
+        self.pos += 8
+        return value
+
+    def string(self):
+        length = self.varint()
+        if self.pos + length > len(self.data):
+            raise IndexError
+        value = self.data[self.pos:self.pos + length].decode("utf-8", "replace")
+        self.pos += length
+        return value
+
+
+def format_record(strings, data):
+    record = Record(data)
+    identifier = record.varint()
+    if identifier >= len(strings):
+        return "<unknown log format {}>".format(identifier)
+    end = strings.find(b"\0", identifier)
+    fmt = strings[identifier:end if end >= 0 else len(strings)].decode("utf-8", "replace")
+
+    def convert(match):
+        flags, width, precision, conversion = match.groups()
+        if conversion == "%":
+            return "%"
+        try:
+            if width == "*":
+                width = str(record.zigzag())
+            if precision == "*":
+                precision = str(record.zigzag())
+            spec = "%" + flags + width + ("." + precision if precision is not None else "")
+            if conversion in "di":
+                return (spec + "d") % record.zigzag()
+            if conversion in "uoxX":
+                return (spec + conversion.replace("u", "d")) % record.varint()
+            if conversion == "c":
+                return (spec + "c") % record.varint()
+            if conversion == "p":
+                return "0x%x" % record.varint()
+            if conversion in "aA":
+                text = record.floating().hex()
+                return text.upper() if conversion == "A" else text
+            if conversion in "fFeEgG":
+                return (spec + conversion) % record.floating()
+            if conversion == "s":
+                return (spec + "s") % record.string()
+            if conversion == "n":
+                return ""
+        except IndexError:
+            # Left out of the record, which was full
+            return "?"
+        return match.group(0)
+
+    return CONVERSION.sub(convert, fmt)
+
+
+def decode(strings, value):
+    data = base64.b64decode(value + "=" * (-len(value) % 4))
+    lines = []
+    pos = 0
+    while pos < len(data):
+        length = data[pos]
+        pos += 1
+        if length == 0 or pos + length > len(data):
+            break
+        lines.append(format_record(strings, data[pos:pos + length]))
+        pos += length
+    return lines
+
+
+def main():
+    if len(sys.argv) not in (2, 3):
+        sys.stderr.write("Usage: greentea_log.py <log-strings> [output]\n")
+        return 2
+    with open(sys.argv[1], "rb") as table:
+        strings = table.read()
+    output = open(sys.argv[2], errors="replace") if len(sys.argv) == 3 else sys.stdin
+    for line in output:
+        match = LOG_MESSAGE.search(line)
+        if match:
+            for text in decode(strings, match.group(1)):
+                print(text)
+        else:
+            sys.stdout.write(line)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,21 @@
+# Copyright (c) 2021 ARM Limited. All rights reserved.
+# SPDX-License-Identifier: Apache-2.0
+
+# Bare-metal Cortex-M toolchain of greentea-size-report and greentea-api-report, with newlib-nano.
+# The core is selected with GREENTEA_SIZE_CPU, e.g. cortex-m0plus or cortex-m4.
+set(CMAKE_SYSTEM_NAME Generic)
+set(CMAKE_SYSTEM_PROCESSOR arm)
+
+set(CMAKE_C_COMPILER arm-none-eabi-gcc)
+set(CMAKE_CXX_COMPILER arm-none-eabi-g++)
+set(CMAKE_TRY_COMPILE_TARGET_TYPE STATIC_LIBRARY)
+
+if(NOT GREENTEA_SIZE_CPU)
+    set(GREENTEA_SIZE_CPU cortex-m4)
+endif()
+
+set(CMAKE_C_FLAGS_INIT "-mcpu=${GREENTEA_SIZE_CPU} -mthumb")
+set(CMAKE_CXX_FLAGS_INIT "-mcpu=${GREENTEA_SIZE_CPU} -mthumb -fno-exceptions -fno-rtti")
+set(CMAKE_EXE_LINKER_FLAGS_INIT "-mcpu=${GREENTEA_SIZE_CPU} -mthumb --specs=nano.specs --specs=nosys.specs")
+
+set(GREENTEA_SIZE_TOOL_NAMES arm-none-eabi-size)
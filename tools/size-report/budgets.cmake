@@ -0,0 +1,15 @@
+# Copyright (c) 2021 ARM Limited. All rights reserved.
+# SPDX-License-Identifier: Apache-2.0
+
+# Budgets of greentea-size-report: text, data and bss in bytes that a configuration may
+# add to the image without greentea-client, per profile. They are set from a measurement
+# with some headroom. A configuration without a budget fails the report after it is printed,
+# which gives the measurement to start from.
+
+# x86-64 Linux, GCC 13, libstdc++ and libc linked dynamically
+set(GREENTEA_SIZE_BUDGET_host_full 20992 224 896)
+set(GREENTEA_SIZE_BUDGET_host_compact 12800 128 64)
+set(GREENTEA_SIZE_BUDGET_host_tx-only 9728 128 64)
+set(GREENTEA_SIZE_BUDGET_host_minimal 2944 64 64)
+
+# Cortex-M profiles fail until budgets are measured with arm-none-eabi-gcc
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2021, ARM Limited, All Rights Reserved
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#if !defined(GREENTEA_SIZE_BASELINE)
+#include "greentea-client/test_env.h"
+#include "greentea-client/test_log.h"
+#endif
+
+/**
+ *  Test application measured by greentea-size-report, which uses each feature of the
+ *  configuration once. The baseline image is built from the same file without greentea-client.
+ */
+
+/**
+ * Stands in for the data register of a UART
+ */
+static volatile int uart_data;
+
+extern "C" int greentea_getc()
+{
+    return uart_data;
+}
+
+extern "C" void greentea_putc(int c)
+{
+    uart_data = c;
+}
+
+extern "C" void greentea_write_string(const char *str)
+{
+    while (*str) {
+        greentea_putc(*str++);
+    }
+}
+
+int main()
+{
+#if defined(GREENTEA_SIZE_BASELINE)
+    greentea_putc(greentea_getc());
+#else
+    GREENTEA_SETUP(10, "default_auto");
+    GREENTEA_TESTCASE_START("case");
+    greentea_send_kv("value", 42);
+#if GREENTEA_CLIENT_FORMAT
+    greentea_send_kv("ratio", 0.5);
+    greentea_send_kvf("values", "%d/%u", -1, 2u);
+#endif
+#if GREENTEA_CLIENT_PARSER
+    char key[16];
+    char value[16];
+    greentea_parse_kv(key, value, sizeof(key), sizeof(value));
+#endif
+    GREENTEA_LOG("case %s took %u us", "case", 100u);
+    GREENTEA_TESTCASE_FINISH("case", 1, 0);
+    GREENTEA_TESTSUITE_RESULT(1);
+#endif
+    return 0;
+}
@@ -0,0 +1,130 @@
+# Copyright (c) 2021 ARM Limited. All rights reserved.
+# SPDX-License-Identifier: Apache-2.0
+
+# Builds representative configurations of greentea-client for a profile and reports
+# how much each adds to an image without it. Fails if a configuration exceeds its
+# budget in budgets.cmake, or has none, so that a profile is only used once it is budgeted.
+#
+# cmake -DPROFILE=<host|cortex-m0plus|cortex-m4> -DSOURCE_DIR=<greentea> -DBINARY_DIR=<dir>
+#       -P size_report.cmake
+
+cmake_minimum_required(VERSION 3.14)
+
+foreach(var PROFILE SOURCE_DIR BINARY_DIR)
+    if(NOT ${var})
+        message(FATAL_ERROR "${var} is not set")
+    endif()
+endforeach()
+
+set(report_dir "${SOURCE_DIR}/tools/size-report")
+
+# Configurations, as options of greentea-client
+set(configs full compact tx-only minimal)
+set(options_full)
+set(options_compact -DGREENTEA_CLIENT_EXTENDED=OFF -DGREENTEA_CLIENT_TRACE=OFF -DGREENTEA_CLIENT_LOG=OFF
+    -DGREENTEA_CLIENT_JOURNAL=OFF -DGREENTEA_CLIENT_PARALLEL=OFF)
+set(options_tx-only -DGREENTEA_CLIENT_PARSER=OFF -DGREENTEA_CLIENT_EXTENDED=OFF -DGREENTEA_CLIENT_TRACE=OFF
+    -DGREENTEA_CLIENT_LOG=OFF -DGREENTEA_CLIENT_PARALLEL=OFF)
+set(options_minimal -DGREENTEA_CLIENT_PARSER=OFF -DGREENTEA_CLIENT_FORMAT=OFF
+    -DGREENTEA_CLIENT_EXTENDED=OFF -DGREENTEA_CLIENT_TRACE=OFF -DGREENTEA_CLIENT_LOG=OFF
+    -DGREENTEA_CLIENT_PARALLEL=OFF)
+
+if(PROFILE STREQUAL "host")
+    set(profile_args)
+elseif(PROFILE MATCHES "^cortex-m")
+    set(profile_args -DCMAKE_TOOLCHAIN_FILE=${report_dir}/arm-none-eabi.cmake -DGREENTEA_SIZE_CPU=${PROFILE})
+else()
+    message(FATAL_ERROR "Unknown profile ${PROFILE}")
+endif()
+
+include("${report_dir}/budgets.cmake")
+
+# Reads the text, data and bss sizes of an image from the Berkeley output of size
+function(read_sizes size_tool image out)
+    execute_process(
+        COMMAND ${size_tool} ${image}
+        OUTPUT_VARIABLE output
+        RESULT_VARIABLE result
+    )
+    if(NOT result EQUAL 0 OR NOT output MATCHES "\n[ \t]*([0-9]+)[ \t]+([0-9]+)[ \t]+([0-9]+)")
+        message(FATAL_ERROR "Could not read the size of ${image}")
+    endif()
+    set(${out} ${CMAKE_MATCH_1} ${CMAKE_MATCH_2} ${CMAKE_MATCH_3} PARENT_SCOPE)
+endfunction()
+
+# Aligns a column of the report
+set(blanks "                    ")
+function(pad_left text width out)
+    string(LENGTH "${text}" length)
+    math(EXPR padding "${width} - ${length}")
+    string(SUBSTRING "${blanks}" 0 ${padding} spaces)
+    set(${out} "${spaces}${text}" PARENT_SCOPE)
+endfunction()
+function(pad_right text width out)
+    string(LENGTH "${text}" length)
+    math(EXPR padding "${width} - ${length}")
+    string(SUBSTRING "${blanks}" 0 ${padding} spaces)
+    set(${out} "${text}${spaces}" PARENT_SCOPE)
+endfunction()
+
+set(sections text data bss)
+set(regressions)
+set(report "greentea-client footprint for ${PROFILE}, in bytes over the image without it\n")
+string(APPEND report "config        text      data       bss    budget\n")
+
+foreach(config IN LISTS configs)
+    set(build_dir "${BINARY_DIR}/${PROFILE}/${config}")
+    execute_process(
+        COMMAND ${CMAKE_COMMAND} -S ${report_dir} -B ${build_dir} -DCMAKE_BUILD_TYPE=MinSizeRel
+                ${profile_args} ${options_${config}}
+        OUTPUT_QUIET
+        RESULT_VARIABLE result
+    )
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "Could not configure ${config} for ${PROFILE}")
+    endif()
+    execute_process(
+        COMMAND ${CMAKE_COMMAND} --build ${build_dir} --target greentea-size-baseline greentea-size-image
+        OUTPUT_QUIET
+        RESULT_VARIABLE result
+    )
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "Could not build ${config} for ${PROFILE}")
+    endif()
+
+    include("${build_dir}/images.cmake")
+    read_sizes(${SIZE_TOOL} ${BASELINE_IMAGE} baseline)
+    read_sizes(${SIZE_TOOL} ${CLIENT_IMAGE} image)
+
+    set(budget ${GREENTEA_SIZE_BUDGET_${PROFILE}_${config}})
+    pad_right("${config}" 8 line)
+    foreach(i RANGE 2)
+        list(GET baseline ${i} base)
+        list(GET image ${i} size)
+        math(EXPR delta "${size} - ${base}")
+        pad_left("${delta}" 10 column)
+        string(APPEND line "${column}")
+        if(budget)
+            list(GET budget ${i} limit)
+            list(GET sections ${i} section)
+            if(delta GREATER limit)
+                list(APPEND regressions "${config} ${section}: ${delta} > ${limit}")
+            endif()
+        endif()
+    endforeach()
+    if(budget)
+        string(REPLACE ";" "/" budget "${budget}")
+        string(APPEND line "    ${budget}")
+    else()
+        string(APPEND line "    none")
+        list(APPEND regressions "${config}: no budget")
+    endif()
+    string(APPEND report "${line}\n")
+endforeach()
+
+message("${report}")
+
+if(regressions)
+    string(REPLACE ";" "\n  " regressions "${regressions}")
+    message(FATAL_ERROR "Not within the budget of ${PROFILE}:\n  ${regressions}")
+endif()